@@ -0,0 +1,23 @@
+-- BEGIN 2.2.0 MODS 
+
+CREATE TABLE IF NOT EXISTS `nagios_configdigests` (
+  `configdigest_id` int(11) NOT NULL auto_increment,
+  `instance_id` smallint(6) NOT NULL default '0',
+  `config_type` smallint(6) NOT NULL default '0',
+  `object_id` int(11) NOT NULL default '0',
+  `objecttype_id` smallint(6) NOT NULL default '0',
+  `digest` bigint(20) unsigned NOT NULL default '0',
+  PRIMARY KEY  (`configdigest_id`),
+  UNIQUE KEY `instance_id` (`instance_id`,`config_type`,`object_id`)
+) ENGINE=MyISAM  COMMENT='Digests of object definitions';
+
+set @exist := (select count(*) from information_schema.columns where table_name = 'nagios_logentries' and column_name = 'logentry_digest');
+set @sqlstmt := if( @exist > 0, 'select ''INFO: Column already exists.''', 'ALTER TABLE `nagios_logentries` ADD `logentry_digest` bigint(20) unsigned NOT NULL default ''0'', ADD KEY `logentry_digest` (`instance_id`,`logentry_time`,`logentry_digest`)');
+PREPARE stmt FROM @sqlstmt;
+EXECUTE stmt;
+
+-- --------------------------------------------------------
+
+--
+
+-- END 2.2.0 MODS 
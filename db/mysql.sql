@@ -113,6 +113,23 @@ CREATE TABLE IF NOT EXISTS `nagios_comments` (
 
 -- --------------------------------------------------------
 
+--
+-- Table structure for table `nagios_configdigests`
+--
+
+CREATE TABLE IF NOT EXISTS `nagios_configdigests` (
+  `configdigest_id` int(11) NOT NULL auto_increment,
+  `instance_id` smallint(6) NOT NULL default '0',
+  `config_type` smallint(6) NOT NULL default '0',
+  `object_id` int(11) NOT NULL default '0',
+  `objecttype_id` smallint(6) NOT NULL default '0',
+  `digest` bigint(20) unsigned NOT NULL default '0',
+  PRIMARY KEY  (`configdigest_id`),
+  UNIQUE KEY `instance_id` (`instance_id`,`config_type`,`object_id`)
+) ENGINE=MyISAM  COMMENT='Digests of object definitions';
+
+-- --------------------------------------------------------
+
 --
 -- Table structure for table `nagios_configfiles`
 --
@@ -834,8 +851,10 @@ CREATE TABLE IF NOT EXISTS `nagios_logentries` (
   `logentry_data` varchar(255) character set latin1 NOT NULL default '',
   `realtime_data` smallint(6) NOT NULL default '0',
   `inferred_data_extracted` smallint(6) NOT NULL default '0',
+  `logentry_digest` bigint(20) unsigned NOT NULL default '0',
   PRIMARY KEY  (`logentry_id`),
-  UNIQUE KEY `instance_id` (`instance_id`,`logentry_time`,`entry_time`,`entry_time_usec`,`logentry_id`)
+  UNIQUE KEY `instance_id` (`instance_id`,`logentry_time`,`entry_time`,`entry_time_usec`,`logentry_id`),
+  KEY `logentry_digest` (`instance_id`,`logentry_time`,`logentry_digest`)
 ) ENGINE=MyISAM COMMENT='Historical record of log entries';
 
 -- --------------------------------------------------------
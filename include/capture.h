@@ -0,0 +1,53 @@
+/**
+ * @file capture.h Recording of the raw client input of ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_CAPTURE_H_INCLUDED
+#define NDO2DB_CAPTURE_H_INCLUDED
+
+#include <sys/time.h>
+
+/*
+ * A capture file starts with the NDO2DB_CAPTURE_MAGIC line.  Every read
+ * from the client follows as a "<seconds>.<microseconds> <bytes>" line
+ * with the time it arrived, then the bytes exactly as they were read.
+ * file2sock replays capture files.
+ */
+#define NDO2DB_CAPTURE_MAGIC                    "NDOCAPTURE 1"
+#define NDO2DB_CAPTURE_BUFFER                   (256*1024)	/* bytes held before writing */
+#define NDO2DB_CAPTURE_FLUSH_TIME               1		/* seconds between writes at most */
+
+
+/* the capture of one client connection */
+typedef struct ndo2db_capture_struct{
+	int fd;					/* -1 when not capturing */
+	char *buffer;
+	size_t used;
+	time_t last_flush;
+	struct ndo2db_capture_struct *next;	/* open captures of this process */
+        }ndo2db_capture;
+
+
+int ndo2db_capture_open(ndo2db_capture *);
+int ndo2db_capture_write(ndo2db_capture *,const char *,size_t);
+int ndo2db_capture_close(ndo2db_capture *);
+int ndo2db_capture_idle(void);
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * @file common.h NDO common declarations
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ * Copyright 2005-2009 Ethan Galstad
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO_COMMON_H_INCLUDED
+#define NDO_COMMON_H_INCLUDED
+
+#ifdef HAVE_SSL
+#include <>
+#endif
+
+#define NDO_TRUE      1
+#define NDO_FALSE     0
+
+#define NDO_ERROR     -1
+#define NDO_OK        0
+
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * @file configdigest.h Skipping unchanged definitions in ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_CONFIGDIGEST_H_INCLUDED
+#define NDO2DB_CONFIGDIGEST_H_INCLUDED
+
+#include "ndo2db.h"
+#include "db.h"
+
+
+/***************** structures *****************/
+
+/* the digest of one object's definition */
+typedef struct ndo2db_config_digest_struct{
+	unsigned long object_id;
+	int object_type;
+	unsigned long long digest;
+	int seen;			/* the dump in progress has defined it */
+        }ndo2db_config_digest;
+
+/* the digests of a config dump */
+typedef struct ndo2db_config_digests_struct{
+	int active;			/* checking definitions for the dump in progress */
+	int loaded;			/* the stored digests could be read */
+	ndo2db_config_digest *stored;	/* as the last dump left them, sorted by object id */
+	int stored_count;
+	ndo2db_config_digest *changed;	/* new and changed definitions, stored when the dump ends */
+	int changed_count;
+	int changed_allocated;
+	unsigned long skipped;		/* definitions in the dump that were unchanged */
+	unsigned long written;
+	unsigned long removed;
+        }ndo2db_config_digest_set;
+
+
+/***************** functions *******************/
+
+int ndo2db_config_digest_start(ndo2db_idi *);
+int ndo2db_config_digest_check(ndo2db_idi *);
+int ndo2db_config_digest_end(ndo2db_idi *);
+int ndo2db_config_digest_free(ndo2db_idi *);
+
+#endif
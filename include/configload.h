@@ -0,0 +1,63 @@
+/**
+ * @file configload.h Bulk loading of ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_CONFIGLOAD_H_INCLUDED
+#define NDO2DB_CONFIGLOAD_H_INCLUDED
+
+#include "ndo2db.h"
+#include "db.h"
+
+
+#define NDO2DB_CONFIG_LOAD_VALUES               65536	/* arena block for held values */
+
+
+/***************** structures *****************/
+
+/* rows held for one table */
+typedef struct ndo2db_config_rows_struct{
+	char *columns;			/* from the first row, a member row's id column comes first */
+	char **values;			/* the rest of each row, closing parenthesis included */
+	unsigned long *object_id;	/* the definition each row belongs to */
+	int rows;
+	int allocated;
+        }ndo2db_config_rows;
+
+/* the rows of a config dump, written when it ends */
+typedef struct ndo2db_config_load_struct{
+	int active;			/* holding rows for the dump in progress */
+	struct timeval start_time;
+	ndo2db_config_rows table[NDO2DB_MAX_DBTABLES];
+	int held;
+	unsigned long rows;		/* written since the dump started */
+	unsigned long statements;
+	ndo_arena values;
+        }ndo2db_config_load;
+
+
+/***************** functions *******************/
+
+int ndo2db_config_load_start(ndo2db_idi *);
+int ndo2db_config_load_add(ndo2db_idi *,int,char *,unsigned long,unsigned long *);
+int ndo2db_config_load_flush(ndo2db_idi *);
+int ndo2db_config_load_end(ndo2db_idi *);
+int ndo2db_config_load_free(ndo2db_idi *);
+
+#endif
@@ -46,8 +46,61 @@ typedef struct ndo2db_dbconfig_struct{
 	unsigned long max_contactnotificationmethods_age;
 	unsigned long max_logentries_age;
 	unsigned long max_acknowledgements_age;	
+	int batch_rows;
+	int archive_batch_rows;
+	unsigned long batch_bytes;
+	unsigned long batch_delay;
+	int commit_events;
+	unsigned long commit_interval;
+	int prepared_statements;
+	unsigned long trim_chunk_rows;
+	unsigned long trim_chunk_time;
+	unsigned long trim_pause;
         }ndo2db_dbconfig;
 
+#define NDO2DB_DEFAULT_BATCH_ROWS                     1		/* 1 = every row is its own statement */
+#define NDO2DB_DEFAULT_ARCHIVE_BATCH_ROWS             1000		/* rows per statement for log2ndo imports */
+#define NDO2DB_DEFAULT_BATCH_BYTES                    (1024*1024)
+#define NDO2DB_DEFAULT_BATCH_DELAY                    1000		/* ms */
+#define NDO2DB_BATCH_STATS_INTERVAL                   60		/* seconds between rate reports */
+#define NDO2DB_MAX_REPLAY_ATTEMPTS                    3
+#define NDO2DB_DEFAULT_TRIM_CHUNK_TIME                200		/* ms */
+#define NDO2DB_DEFAULT_TRIM_PAUSE                     100		/* ms */
+#define NDO2DB_TRIM_INTERVAL                          60		/* seconds between trims */
+#define NDO2DB_PARTITION_INTERVAL                     3600		/* seconds between partition upkeep */
+#define NDO2DB_PARTITION_DAYS_AHEAD                   7		/* days of empty partitions kept ready */
+#define NDO2DB_PARTITION_LOCK                         "ndo2db_partitions"	/* named lock, per database */
+#define NDO2DB_UNIX_EPOCH_DAYS                        719528		/* TO_DAYS('1970-01-01') */
+#define NDO2DB_ER_NEED_REPREPARE                      1615		/* from mysqld_error.h */
+
+/************ row descriptor fields ************/
+
+#define NDO2DB_FIELD_INT                              0		/* input item, written as an int */
+#define NDO2DB_FIELD_ULONG                            1		/* input item, written as an unsigned long */
+#define NDO2DB_FIELD_DOUBLE                           2		/* input item, written as a double */
+#define NDO2DB_FIELD_TIME                             3		/* input item, seconds since the epoch */
+#define NDO2DB_FIELD_STRING                           4		/* input item, written as (escaped) text */
+#define NDO2DB_FIELD_ARG                              5		/* value passed by the handler, e.g. an object id */
+#define NDO2DB_FIELD_ARGTIME                          6		/* time passed by the handler */
+
+/* one column of a row and where its value comes from */
+typedef struct ndo2db_dbfield_struct{
+	const char *column;
+	int type;
+	int item;		/* NDO_DATA_* index, or the handler's argument index */
+        }ndo2db_dbfield;
+
+/* the columns of a table a handler writes, every one is updated on duplicate keys */
+typedef struct ndo2db_dbrow_struct{
+	int table;
+	int fields;
+	const ndo2db_dbfield *field;
+	char *columns;		/* built by ndo2db_db_init_row() at startup */
+	char *values;
+        }ndo2db_dbrow;
+
+#define NDO2DB_DBROW(table,fields)                    {(table),(int)(sizeof(fields)/sizeof(fields[0])),(fields),NULL,NULL}
+
 /*************** DB server types ***************/
 
 #define NDO2DB_DBTABLE_INSTANCES                      0
@@ -120,8 +173,19 @@ typedef struct ndo2db_dbconfig_struct{
 #define NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS    66
 #define NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS 67
 #define NDO2DB_DBTABLE_SERVICEPARENTSERVICES          68
+#define NDO2DB_DBTABLE_CONFIGDIGESTS                  69
+
+#define NDO2DB_MAX_DBTABLES                           70
 
-#define NDO2DB_MAX_DBTABLES                           69
+
+/* a table whose rows are deleted once they are older than its max_*_age */
+typedef struct ndo2db_dbtrimtable_struct{
+	int table;
+	char *id_column;
+	char *time_column;
+        }ndo2db_dbtrimtable;
+
+#define NDO2DB_MAX_TRIMTABLES                         11
 
 
 /**************** Object types *****************/
@@ -162,6 +226,36 @@ int ndo2db_db_clear_table(ndo2db_idi *,char *);
 int ndo2db_db_get_latest_data_time(ndo2db_idi *,char *,char *,unsigned long *);
 int ndo2db_db_perform_maintenance(ndo2db_idi *);
 int ndo2db_db_trim_data_table(ndo2db_idi *,char *,char *,unsigned long);
+unsigned long ndo2db_db_trim_age(ndo2db_idi *,int);
+int ndo2db_db_partition_table(ndo2db_idi *,ndo2db_dbtrimtable *,time_t);
+int ndo2db_db_partition_tables(ndo2db_idi *,time_t);
+
+char *ndo2db_db_update_clause(const char *);
+int ndo2db_db_batch_add(ndo2db_idi *,int,const char *,const char *,char *);
+int ndo2db_db_flush_batch(ndo2db_idi *,int);
+int ndo2db_db_flush_batches(ndo2db_idi *);
+int ndo2db_db_flush_expired_batches(ndo2db_idi *);
+int ndo2db_db_free_batches(ndo2db_idi *);
+
+ndo2db_dbstmt *ndo2db_db_stmt_begin(ndo2db_idi *,int,const char *,const char *,const char *);
+int ndo2db_db_stmt_bind_int(ndo2db_dbstmt *,long long);
+int ndo2db_db_stmt_bind_double(ndo2db_dbstmt *,double);
+int ndo2db_db_stmt_bind_string(ndo2db_dbstmt *,const char *);
+int ndo2db_db_stmt_execute(ndo2db_idi *,ndo2db_dbstmt *);
+int ndo2db_db_close_statements(ndo2db_dbstmt **);
+int ndo2db_db_free_statements(ndo2db_dbstmt **);
+
+int ndo2db_db_init_row(ndo2db_dbrow *);
+int ndo2db_db_write_row(ndo2db_idi *,ndo2db_dbrow *,const unsigned long *);
+
+int ndo2db_db_transactions_enabled(void);
+int ndo2db_db_begin_event(ndo2db_idi *);
+int ndo2db_db_end_event(ndo2db_idi *);
+int ndo2db_db_commit(ndo2db_idi *);
+int ndo2db_db_free_transaction(ndo2db_idi *);
+unsigned long ndo2db_db_insert_id(ndo2db_idi *);
+
+int ndo2db_db_report_stats(void);
 
 extern int ndo2db_log_debug_info(int, int, const char *, ...);
 #endif
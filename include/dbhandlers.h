@@ -25,20 +25,33 @@
 
 #include "ndo2db.h"
 #define NAGIOS_SIZEOF_ARRAY(var)       (sizeof(var)/sizeof(var[0]))
+#define NDO2DB_LOGENTRY_DATA_SIZE      255		/* logentry_data is a varchar(255) */
 
 int ndo2db_get_object_id(ndo2db_idi *,int,char *,char *,unsigned long *);
 int ndo2db_get_object_id_with_insert(ndo2db_idi *,int,char *,char *,unsigned long *);
+int ndo2db_get_object_ids_with_insert(ndo2db_idi *,ndo2db_object_key *,int);
+int ndo2db_remember_new_object(ndo2db_idi *,int,char *,char *,unsigned long);
+int ndo2db_restore_new_objects(ndo2db_idi *);
+int ndo2db_forget_new_objects(ndo2db_idi *);
 
 int ndo2db_get_cached_object_ids(ndo2db_idi *);
 int ndo2db_get_cached_object_id(ndo2db_idi *,int,char *,char *,unsigned long *);
 int ndo2db_add_cached_object_id(ndo2db_idi *,int,char *,char *,unsigned long);
+int ndo2db_init_object_cache(ndo2db_idi *);
+int ndo2db_reserve_object_cache(ndo2db_idi *,unsigned long);
 int ndo2db_free_cached_object_ids(ndo2db_idi *);
 
+unsigned int ndo2db_object_hash(int,const char *,const char *);
 int ndo2db_object_hashfunc(const char *,const char *,int);
 int ndo2db_compare_object_hashdata(const char *,const char *,const char *,const char *);
 
+int ndo2db_init_status_rows(void);
+
 int ndo2db_set_all_objects_as_inactive(ndo2db_idi *);
 int ndo2db_set_object_as_active(ndo2db_idi *,int,unsigned long);
+int ndo2db_save_active_objects(ndo2db_idi *);
+int ndo2db_free_active_objects(ndo2db_idi *);
+int ndo2db_free_logentry_window(ndo2db_idi *);
 
 int ndo2db_handle_logentry(ndo2db_idi *);
 int ndo2db_handle_processdata(ndo2db_idi *);
@@ -70,6 +83,7 @@ int ndo2db_handle_statechangedata(ndo2db_idi *);
 int ndo2db_handle_configfilevariables(ndo2db_idi *,int);
 int ndo2db_handle_configvariables(ndo2db_idi *);
 int ndo2db_handle_runtimevariables(ndo2db_idi *);
+int ndo2db_save_config_row(ndo2db_idi *,int,char *,unsigned long,unsigned long *);
 int ndo2db_handle_configdumpstart(ndo2db_idi *);
 int ndo2db_handle_configdumpend(ndo2db_idi *);
 int ndo2db_handle_hostdefinition(ndo2db_idi *);
@@ -85,5 +99,5 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *);
 int ndo2db_handle_contactdefinition(ndo2db_idi *);
 int ndo2db_handle_contactgroupdefinition(ndo2db_idi *);
 int ndo2db_handle_activeobjectlist(ndo2db_idi *);
-int ndo2db_save_custom_variables(ndo2db_idi *,int, unsigned long, char *);
+int ndo2db_save_custom_variables(ndo2db_idi *,int, unsigned long, time_t);
 #endif
@@ -0,0 +1,106 @@
+/**
+ * @file eventserver.h Event driven (epoll) connection handling for ndo2db daemon
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_EVENTSERVER_H_INCLUDED
+#define NDO2DB_EVENTSERVER_H_INCLUDED
+
+#include <pthread.h>
+#include "ndo2db.h"
+#include "utils.h"
+#include "capture.h"
+
+
+/*************** server models ****************/
+#define NDO2DB_SERVER_FORK                      0	/* two processes per client (default) */
+#define NDO2DB_SERVER_EVENT                     1	/* one process, epoll plus writer threads */
+
+#define NDO2DB_DEFAULT_WRITER_THREADS           4
+#define NDO2DB_MAX_WRITER_THREADS               64
+
+#define NDO2DB_EVENT_READ_SIZE                  (64*1024)	/* max bytes per read() */
+#define NDO2DB_EVENT_MAX_READS                  16		/* reads per client per wakeup */
+#define NDO2DB_EVENT_MAX_EVENTS                 64
+#define NDO2DB_EVENT_PAUSE_CHECK                100		/* ms between checks of paused clients */
+
+
+/*************** work item types ****************/
+#define NDO2DB_EVENT_CHUNK_OPEN                 0
+#define NDO2DB_EVENT_CHUNK_DATA                 1
+#define NDO2DB_EVENT_CHUNK_CLOSE                2
+#define NDO2DB_EVENT_CHUNK_TICK                 3	/* no client, write out status held too long */
+
+
+/***************** structures *****************/
+
+struct ndo2db_writer_struct;
+
+/* a connected client, owned by the epoll thread until it is closed */
+typedef struct ndo2db_event_client_struct{
+	int sd;
+	int paused;
+	int shut_down;
+	struct ndo2db_writer_struct *writer;
+	ndo2db_idi idi;
+	ndo_lbuf lbuf;
+	ndo2db_capture capture;			/* used by the epoll thread only */
+	size_t queued_bytes;			/* guarded by the writer's lock */
+	struct ndo2db_event_client_struct *next_paused;
+	int holding_status;			/* used by the writer only */
+	struct ndo2db_event_client_struct *next_holding;
+        }ndo2db_event_client;
+
+/* a unit of work for a writer thread */
+typedef struct ndo2db_event_chunk_struct{
+	int type;
+	ndo2db_event_client *client;
+	size_t len;
+	struct ndo2db_event_chunk_struct *next;
+	char data[1];
+        }ndo2db_event_chunk;
+
+/* a writer thread and the database connection it owns */
+typedef struct ndo2db_writer_struct{
+	int id;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	ndo2db_event_chunk *head;
+	ndo2db_event_chunk *tail;
+	size_t queued_bytes;
+	int shutdown;
+	int clients;
+	int holding_clients;			/* clients with status held back, guarded by the lock */
+	int tick_pending;			/* guarded by the lock */
+	int busy;				/* handling a chunk, guarded by the lock */
+	struct ndo2db_event_client_struct *holding;	/* used by the writer only */
+	int connected;
+#ifdef USE_MYSQL
+	MYSQL *mysql_conn;
+#endif
+	ndo2db_dbstmt **stmt;
+        }ndo2db_writer;
+
+
+/***************** functions *******************/
+
+int ndo2db_event_server(int);
+
+#endif
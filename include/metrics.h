@@ -0,0 +1,98 @@
+/**
+ * @file metrics.h Live ingest metrics for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_METRICS_H_INCLUDED
+#define NDO2DB_METRICS_H_INCLUDED
+
+#include <pthread.h>
+#include <sys/time.h>
+#include "ndo2db.h"
+
+
+#define NDO2DB_METRICS_MAX_CONNECTIONS          64	/* later connections share one slot */
+#define NDO2DB_METRICS_TYPES                    76	/* NDO2DB_INPUT_DATA_* values */
+#define NDO2DB_METRICS_BUCKETS                  14	/* latency buckets, +Inf not included */
+#define NDO2DB_METRICS_REQUEST_WAIT             100	/* ms to wait for an HTTP request */
+
+/* database round trips */
+#define NDO2DB_METRICS_DB_QUERY                 0
+#define NDO2DB_METRICS_DB_EXECUTE               1
+#define NDO2DB_METRICS_DB_COMMIT                2
+#define NDO2DB_METRICS_DB_OPS                   3
+
+/* caches */
+#define NDO2DB_METRICS_CACHE_OBJECTS            0	/* object ids */
+#define NDO2DB_METRICS_CACHE_STATUS             1	/* held status updates replaced by newer ones */
+#define NDO2DB_METRICS_CACHE_CONFIGDIGESTS      2	/* unchanged definitions */
+#define NDO2DB_METRICS_CACHES                   3
+
+
+/* counters of one client connection, only ever added to */
+typedef struct ndo2db_metrics_slot_struct{
+	int used;
+	pid_t pid;				/* process that claimed it */
+	unsigned long connection;		/* number of the connection, from 1 */
+	char instance[64];
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long events[NDO2DB_METRICS_TYPES];	/* received */
+	unsigned long long errors;		/* statements that failed */
+	unsigned long long dropped_bytes;	/* input that could not be buffered */
+	unsigned long long queue_bytes;		/* read but not yet handled */
+	unsigned long long cache_hits[NDO2DB_METRICS_CACHES];
+	unsigned long long cache_misses[NDO2DB_METRICS_CACHES];
+        }ndo2db_metrics_slot;
+
+/* latency histogram, non-cumulative bucket counts */
+typedef struct ndo2db_metrics_histogram_struct{
+	unsigned long long bucket[NDO2DB_METRICS_BUCKETS+1];
+	unsigned long long usec;
+        }ndo2db_metrics_histogram;
+
+/* everything, in memory shared by all ndo2db processes */
+typedef struct ndo2db_metrics_struct{
+	pthread_mutex_t lock;			/* claiming and retiring slots, reading */
+	unsigned long connections;
+	ndo2db_metrics_slot closed;		/* what connections that are gone added up to */
+	ndo2db_metrics_slot other;		/* connections that found no free slot */
+	ndo2db_metrics_slot slot[NDO2DB_METRICS_MAX_CONNECTIONS];
+	ndo2db_metrics_histogram handler[NDO2DB_METRICS_TYPES];
+	ndo2db_metrics_histogram db[NDO2DB_METRICS_DB_OPS];
+        }ndo2db_metrics;
+
+
+int ndo2db_metrics_init(char *);
+void ndo2db_metrics_cleanup(void);
+
+int ndo2db_metrics_open(ndo2db_idi *);
+int ndo2db_metrics_close(ndo2db_idi *);
+void ndo2db_metrics_hello(ndo2db_idi *);
+
+void ndo2db_metrics_start(struct timeval *);
+void ndo2db_metrics_received(ndo2db_idi *,int);
+void ndo2db_metrics_handled(int,struct timeval *);
+void ndo2db_metrics_db(ndo2db_idi *,int,struct timeval *,int);
+void ndo2db_metrics_input(ndo2db_idi *,unsigned long,unsigned long);
+void ndo2db_metrics_dropped(ndo2db_idi *,unsigned long);
+void ndo2db_metrics_queue(ndo2db_idi *,unsigned long);
+void ndo2db_metrics_cache(ndo2db_idi *,int,int);
+
+#endif
@@ -56,21 +56,114 @@ typedef struct ndo2db_mbuf_struct{
         }ndo2db_mbuf;
 
 
+struct ndo2db_partition_pool_struct;
+struct ndo2db_status_cache_struct;
+struct ndo2db_object_batch_struct;
+struct ndo2db_config_load_struct;
+struct ndo2db_config_digests_struct;
+
+/* a completed event's data, detached from the connection that parsed it */
+typedef struct ndo2db_input_event_struct{
+	int input_data;
+	char **buffered_input;
+	ndo2db_mbuf mbuf[NDO2DB_MAX_MBUF_ITEMS];
+	struct ndo2db_input_event_struct *next;
+        }ndo2db_input_event;
+
+/* rows waiting to be written to one table with a single statement */
+typedef struct ndo2db_dbbatch_struct{
+	char *buffer;
+	size_t used_size;
+	size_t allocated_size;
+	size_t prefix_size;
+	char *suffix;
+	int rows;
+	struct timeval first_row_time;
+        }ndo2db_dbbatch;
+
+/* a prepared statement for one table and the values bound to its parameters */
+typedef struct ndo2db_dbstmt_struct{
+	char *sql;
+	int params;
+	int bound;
+	int unusable;
+	int profile;			/* table and kind, for the SQL profile */
+#ifdef USE_MYSQL
+	MYSQL_STMT *handle;
+	MYSQL_BIND *bind;
+#endif
+	long long *ints;
+	double *doubles;
+	unsigned long *lengths;
+        }ndo2db_dbstmt;
+
 typedef struct ndo2db_dbobject_struct{
+	const char *name1;		/* interned in the cache's name arena */
+	const char *name2;
+	unsigned int hash;
+	int object_type;
+	unsigned long object_id;
+        }ndo2db_dbobject;
+
+/* object ids by type and name - open addressing, an empty slot has no names */
+typedef struct ndo2db_object_cache_struct{
+	ndo2db_dbobject *slot;
+	unsigned long slots;		/* always a power of two */
+	unsigned long objects;
+	ndo_arena names;
+	unsigned long lookups;
+	unsigned long probes;
+	struct ndo2db_object_file_struct *file;	/* shared with other processes, if configured */
+        }ndo2db_object_cache;
+
+/* an object we need the id of */
+typedef struct ndo2db_object_key_struct{
+	int object_type;
 	char *name1;
 	char *name2;
+        }ndo2db_object_key;
+
+/* an object added since the last commit, so it can be put back if the transaction is lost */
+typedef struct ndo2db_new_object_struct{
 	int object_type;
+	char *name1;
+	char *name2;
 	unsigned long object_id;
-	struct ndo2db_dbobject_struct *nexthash;
-        }ndo2db_dbobject;
+	struct ndo2db_new_object_struct *next;
+        }ndo2db_new_object;
+
+/* a stored log entry - its digest is never zero, so an empty slot has none */
+typedef struct ndo2db_logentry_digest_struct{
+	time_t logentry_time;
+	unsigned long long digest;
+        }ndo2db_logentry_digest;
+
+/* digests of every log entry stored between two times, open addressing */
+typedef struct ndo2db_logentry_window_struct{
+	ndo2db_logentry_digest *slot;
+	unsigned long slots;		/* always a power of two */
+	unsigned long entries;
+	time_t start_time;		/* the window holds start_time up to, but not including, end_time */
+	time_t end_time;
+        }ndo2db_logentry_window;
+
+/* ids of the objects a config dump says are active, saved when the dump ends */
+typedef struct ndo2db_active_objects_struct{
+	unsigned long *object_id;
+	int objects;
+	int allocated;
+	int reconcile;			/* objects that aren't listed become inactive */
+        }ndo2db_active_objects;
 
 
 typedef struct ndo2db_dbconninfo_struct{
 	int server_type;
 	int connected;
 	int error;
+	int partition_writer;
+	int archived;			/* client sends archived log entries (log2ndo) */
 #ifdef USE_MYSQL
-	MYSQL mysql_conn;
+	MYSQL *mysql_conn;
 	MYSQL_RES *mysql_result;
 	MYSQL_ROW mysql_row;
 #endif
@@ -98,9 +191,29 @@ typedef struct ndo2db_dbconninfo_struct{
 	unsigned long max_logentries_age;
 	unsigned long max_acknowledgements_age;
 	time_t last_table_trim_time;
+	time_t last_partition_time;
+	time_t last_checkin_time;
 	time_t last_logentry_time;
 	char *last_logentry_data;
-	ndo2db_dbobject **object_hashlist;
+	ndo2db_logentry_window logentry_window;
+	ndo2db_object_cache *object_cache;
+	ndo2db_dbbatch **batch;
+	int batched_rows;
+	char *row_buffer;
+	size_t row_buffer_size;
+	ndo2db_dbstmt **stmt;
+	ndo2db_dbstmt *last_stmt;
+	int transaction_events;
+	int transaction_failed;
+	int transaction_replaying;
+	struct timeval transaction_start_time;
+	ndo2db_input_event *transaction_head;
+	ndo2db_input_event *transaction_tail;
+	ndo2db_input_event *transaction_event;
+	unsigned long transaction_notification_id;
+	unsigned long transaction_contact_notification_id;
+	ndo2db_new_object *new_objects;
+	int new_objects_lost;
         }ndo2db_dbconninfo;
 
 
@@ -124,7 +237,18 @@ typedef struct ndo2db_input_data_info_struct{
 	int current_object_config_type;
 	char **buffered_input;
 	ndo2db_mbuf mbuf[NDO2DB_MAX_MBUF_ITEMS];
+	ndo_arena input_arena;			/* holds the event being parsed */
+	char **input_slots;
+	int input_in_arena;
 	ndo2db_dbconninfo dbinfo;
+	struct ndo2db_partition_pool_struct *partitions;
+	struct ndo2db_status_cache_struct *status_cache;
+	struct ndo2db_object_batch_struct *object_batch;
+	struct ndo2db_config_load_struct *config_load;
+	struct ndo2db_config_digests_struct *config_digests;
+	struct ndo2db_trimmer_struct *trimmer;
+	struct ndo2db_metrics_slot_struct *metrics;
+	ndo2db_active_objects active_objects;
         }ndo2db_idi;
 
 
@@ -136,7 +260,11 @@ typedef struct ndo2db_input_data_info_struct{
 
 /*************** misc definitions **************/
 #define NDO2DB_INPUT_BUFFER                             1024
-#define NDO2DB_OBJECT_HASHSLOTS                         1024
+#define NDO2DB_INPUT_ARENA_BLOCK                        16384
+#define NDO2DB_OBJECT_HASHSLOTS                         1024	/* initial object cache size, it grows */
+#define NDO2DB_LOGENTRY_WINDOW                          3600	/* seconds of stored log entries checked for duplicates at once */
+#define NDO2DB_LOGENTRY_HASHSLOTS                       1024	/* initial log entry window size, it grows */
+#define NDO2DB_QUEUE_IDLE_WAIT                          1000	/* msecs the database writer waits for input before its timed work */
 
 
 /*********** types of input sections ***********/
@@ -242,16 +370,21 @@ void ndo2db_child_sighandler(int);
 
 int ndo2db_free_program_memory(void);
 int ndo2db_free_input_memory(ndo2db_idi *);
+int ndo2db_save_input_data(ndo2db_idi *,ndo2db_input_event *);
+int ndo2db_restore_input_data(ndo2db_idi *,ndo2db_input_event *);
+int ndo2db_copy_input_data(ndo2db_idi *,ndo2db_input_event *);
+int ndo2db_free_input_event(ndo2db_input_event *);
 int ndo2db_free_connection_memory(ndo2db_idi *);
 
 int ndo2db_wait_for_connections(void);
 int ndo2db_handle_client_connection(int);
 int ndo2db_idi_init(ndo2db_idi *);
-int ndo2db_check_for_client_input(ndo2db_idi *,ndo_dbuf *);
 int ndo2db_handle_client_input(ndo2db_idi *,char *);
 
 int ndo2db_start_input_data(ndo2db_idi *);
 int ndo2db_end_input_data(ndo2db_idi *);
+int ndo2db_write_input_data(ndo2db_idi *);
+int ndo2db_handle_input_data(ndo2db_idi *);
 int ndo2db_add_input_data_item(ndo2db_idi *,int,char *);
 int ndo2db_add_input_data_mbuf(ndo2db_idi *,int,int,char *);
 
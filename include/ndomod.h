@@ -35,11 +35,16 @@ typedef struct ndomod_sink_buffer_struct{
 	unsigned long items;
 	unsigned long maxitems;
 	unsigned long overflow;
+	unsigned long flushed_items;
+	unsigned long flushed_bytes;
         }ndomod_sink_buffer;
 
 
 #define NDOMOD_MAX_BUFLEN   16384
 
+#define NDOMOD_FLUSH_EVENT_INTERVAL                   1     /* seconds between paced buffer flushes */
+#define NDOMOD_FLUSH_LOG_INTERVAL                     10    /* seconds between flush progress messages */
+
 
 #define NDOMOD_PROCESS_PROCESS_DATA                   1
 #define NDOMOD_PROCESS_TIMED_EVENT_DATA               2
@@ -98,6 +103,8 @@ int ndomod_write_to_sink(char *,int,int);
 int ndomod_rotate_sink_file(void *);
 int ndomod_hello_sink(int,int);
 int ndomod_goodbye_sink(void);
+int ndomod_flush_sink_buffer(int);
+int ndomod_flush_sink_buffer_event(void *);
 
 int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long);
 int ndomod_sink_buffer_deinit(ndomod_sink_buffer *sbuf);
@@ -107,6 +114,8 @@ char *ndomod_sink_buffer_pop(ndomod_sink_buffer *sbuf);
 int ndomod_sink_buffer_items(ndomod_sink_buffer *sbuf);
 unsigned long ndomod_sink_buffer_get_overflow(ndomod_sink_buffer *sbuf);
 int ndomod_sink_buffer_set_overflow(ndomod_sink_buffer *sbuf,unsigned long);
+unsigned long ndomod_sink_buffer_get_flushed_items(ndomod_sink_buffer *sbuf);
+unsigned long ndomod_sink_buffer_get_flushed_bytes(ndomod_sink_buffer *sbuf);
 
 int ndomod_load_unprocessed_data(char *);
 int ndomod_save_unprocessed_data(char *);
@@ -0,0 +1,51 @@
+/**
+ * @file objectbatch.h Bulk object registration for ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_OBJECTBATCH_H_INCLUDED
+#define NDO2DB_OBJECTBATCH_H_INCLUDED
+
+#include "ndo2db.h"
+
+
+#define NDO2DB_OBJECT_BATCH_NAMES               65536	/* arena block for held names */
+
+
+/***************** structures *****************/
+
+/* definitions held back until the objects they name have ids */
+typedef struct ndo2db_object_batch_struct{
+	ndo2db_input_event *head;
+	ndo2db_input_event *tail;
+	int definitions;
+	ndo2db_object_key *key;
+	int keys;
+	int allocated_keys;
+	ndo_arena names;
+        }ndo2db_object_batch;
+
+
+/***************** functions *******************/
+
+int ndo2db_object_batch_add(ndo2db_idi *);
+int ndo2db_object_batch_flush(ndo2db_idi *);
+int ndo2db_object_batch_free(ndo2db_idi *);
+
+#endif
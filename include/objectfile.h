@@ -0,0 +1,81 @@
+/**
+ * @file objectfile.h Object id dictionary shared by ndo2db processes
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_OBJECTFILE_H_INCLUDED
+#define NDO2DB_OBJECTFILE_H_INCLUDED
+
+#include "ndo2db.h"
+
+
+#define NDO2DB_OBJECT_FILE_MAGIC                "NDOOBJ1"
+#define NDO2DB_OBJECT_FILE_NONAME               0xffff	/* name length of a NULL name */
+#define NDO2DB_OBJECT_FILE_BUFFER               65536	/* records written at once while rebuilding */
+
+
+/***************** structures *****************/
+
+/* the start of the file, the records follow it */
+typedef struct ndo2db_object_file_header_struct{
+	char magic[8];
+	char table[120];		/* database and table the ids came from */
+	unsigned long instance_id;
+	unsigned long retired;		/* set once a rebuilt file has replaced this one */
+	unsigned long objects;
+	unsigned long max_object_id;
+	unsigned long used;		/* bytes of records after the header */
+        }ndo2db_object_file_header;
+
+/* one object, followed by its NUL terminated names and padded to a long */
+typedef struct ndo2db_object_record_struct{
+	unsigned long object_id;
+	int object_type;
+	unsigned short name1_length;
+	unsigned short name2_length;
+        }ndo2db_object_record;
+
+typedef struct ndo2db_object_file_struct{
+	char *path;
+	int fd;
+	char *map;
+	size_t mapped;
+	unsigned long used;		/* bytes of records already in the cache */
+	char *new_path;			/* the file being rebuilt */
+	int new_fd;
+	ndo2db_object_file_header new_header;	/* counts what's in the buffer */
+	unsigned long min_object_id;
+	char *buffer;			/* records not written yet */
+	size_t buffered;
+	size_t allocated;
+        }ndo2db_object_file;
+
+
+/***************** functions *******************/
+
+int ndo2db_object_file_load(ndo2db_idi *);
+int ndo2db_object_file_refresh(ndo2db_idi *);
+int ndo2db_object_file_append(ndo2db_idi *,int,char *,char *,unsigned long);
+int ndo2db_object_file_flush(ndo2db_idi *);
+int ndo2db_object_file_rebuild_start(ndo2db_idi *);
+int ndo2db_object_file_rebuild_add(ndo2db_idi *,int,char *,char *,unsigned long);
+int ndo2db_object_file_rebuild_end(ndo2db_idi *,int);
+int ndo2db_object_file_close(ndo2db_idi *);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file partition.h Object-partitioned database writer threads for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_PARTITION_H_INCLUDED
+#define NDO2DB_PARTITION_H_INCLUDED
+
+#include <pthread.h>
+#include "ndo2db.h"
+
+
+#define NDO2DB_MAX_PARTITION_WRITERS            64
+#define NDO2DB_PARTITION_QUEUE_ITEMS            1024	/* max events queued per writer */
+
+
+/*************** event routing ****************/
+#define NDO2DB_PARTITION_BARRIER                -1	/* drain all writers, handle inline */
+#define NDO2DB_PARTITION_SERIAL                 -2	/* always handled by writer 0 */
+#define NDO2DB_PARTITION_BY_HOST                -3	/* writer chosen by host name */
+#define NDO2DB_PARTITION_BY_CONTACT             -4	/* writer chosen by contact name */
+
+
+/***************** structures *****************/
+
+struct ndo2db_partition_pool_struct;
+
+/* a writer thread and the database connection it owns */
+typedef struct ndo2db_partition_writer_struct{
+	int id;
+	pthread_t thread;
+	pthread_cond_t cond;
+	ndo2db_input_event *head;
+	ndo2db_input_event *tail;
+	int queued;
+	ndo2db_idi idi;
+	struct ndo2db_partition_pool_struct *pool;
+        }ndo2db_partition_writer;
+
+typedef struct ndo2db_partition_pool_struct{
+	int writers;
+	int running;
+	int pending;
+	int shutdown;
+	int sync_needed;
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	ndo2db_partition_writer *writer;
+        }ndo2db_partition_pool;
+
+
+/***************** functions *******************/
+
+int ndo2db_partition_start(ndo2db_idi *,int);
+int ndo2db_partition_dispatch(ndo2db_idi *);
+int ndo2db_partition_drain(ndo2db_idi *);
+int ndo2db_partition_stop(ndo2db_idi *);
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file profile.h SQL statement profiler for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_PROFILE_H_INCLUDED
+#define NDO2DB_PROFILE_H_INCLUDED
+
+#include <pthread.h>
+#include <sys/time.h>
+#include "ndo2db.h"
+#include "db.h"
+
+
+#define NDO2DB_PROFILE_BUCKETS                  40	/* 16us to 12s, two per doubling, +Inf not included */
+#define NDO2DB_PROFILE_WINDOW                   60	/* seconds per percentile window */
+#define NDO2DB_PROFILE_MAX_SLOW                 100	/* most slow statements sql_profile_slow_count can keep */
+#define NDO2DB_PROFILE_SLOW_PER_SECOND          10	/* slow statements captured at most */
+#define NDO2DB_PROFILE_SQL_LENGTH               512	/* of a slow statement's text kept */
+
+#define NDO2DB_DEFAULT_PROFILE_SLOW_TIME        100	/* ms */
+#define NDO2DB_DEFAULT_PROFILE_SLOW_COUNT       20
+
+/* statement kinds */
+#define NDO2DB_PROFILE_SELECT                   0
+#define NDO2DB_PROFILE_INSERT                   1
+#define NDO2DB_PROFILE_UPSERT                   2
+#define NDO2DB_PROFILE_UPDATE                   3
+#define NDO2DB_PROFILE_DELETE                   4
+#define NDO2DB_PROFILE_OTHER                    5
+#define NDO2DB_PROFILE_KINDS                    6
+
+/* statements on tables we don't know are counted as this table */
+#define NDO2DB_PROFILE_NO_TABLE                 NDO2DB_MAX_DBTABLES
+#define NDO2DB_PROFILE_KEYS                     ((NDO2DB_MAX_DBTABLES+1)*NDO2DB_PROFILE_KINDS)
+
+
+/* latencies of one window, non-cumulative bucket counts */
+typedef struct ndo2db_profile_window_struct{
+	time_t number;				/* start time / NDO2DB_PROFILE_WINDOW */
+	unsigned long long bucket[NDO2DB_PROFILE_BUCKETS+1];
+        }ndo2db_profile_window;
+
+/* statements of one kind on one table */
+typedef struct ndo2db_profile_stat_struct{
+	unsigned long long count;
+	unsigned long long usec;
+	unsigned long long max_usec;
+	ndo2db_profile_window window[2];	/* the current and the last one */
+        }ndo2db_profile_stat;
+
+typedef struct ndo2db_profile_slow_struct{
+	time_t time;
+	pid_t pid;
+	unsigned long usec;
+	int key;
+	char sql[NDO2DB_PROFILE_SQL_LENGTH];
+        }ndo2db_profile_slow;
+
+/* everything, in memory shared by all ndo2db processes */
+typedef struct ndo2db_profile_struct{
+	pthread_mutex_t lock;			/* new windows and slow statements */
+	time_t start_time;
+	ndo2db_profile_stat stat[NDO2DB_PROFILE_KEYS];
+	unsigned long slow_next;		/* slow statements captured so far */
+	time_t slow_second;
+	int slow_in_second;
+	ndo2db_profile_slow slow[NDO2DB_PROFILE_MAX_SLOW];
+        }ndo2db_profile;
+
+
+int ndo2db_profile_init(void);
+int ndo2db_profile_classify(const char *);
+void ndo2db_profile_statement(int,const char *,struct timeval *);
+int ndo2db_profile_report(ndo_dbuf *);
+
+#endif
@@ -1,5 +1,5 @@
 /**
- * @file queue.h Simple message queue for ndo2db daemon
+ * @file queue.h Shared memory byte queue for ndo2db daemon
  */
 /*
  * Copyright 2012-2014 Nagios Core Development Team and Community Contributors
@@ -22,27 +22,64 @@
 #ifndef NDO_QUEUE_H_INCLUDED
 #define NDO_QUEUE_H_INCLUDED
 
-#define NDO_QUEUE_PATH "."
-#define NDO_QUEUE_ID 9504
-#define NDO_MAX_MSG_SIZE 1024
-#define NDO_MSG_TYPE 1
+#include <pthread.h>
 
-struct queue_msg
-{
-    long type;
-    char text[NDO_MAX_MSG_SIZE];
-};
+#define NDO_QUEUE_DEFAULT_SIZE 16		/* Megabytes */
+#define NDO_QUEUE_MAX_CHUNK (64*1024)	/* Max bytes handed out per reserve/peek */
 
-/* remove queue from system */
-void del_queue();
+/*
+ * Single producer/single consumer byte ring shared between the process
+ * reading from the client socket and the process writing to the database.
+ * The control block and the data area live in one anonymous shared
+ * mapping that is created before the DB writer is forked.  head and tail
+ * are running byte counts; their difference is the number of queued bytes.
+ */
+typedef struct ndo_queue_struct{
+	pthread_mutex_t lock;
+	pthread_cond_t readable;
+	pthread_cond_t writable;
+	unsigned long long head;
+	unsigned long long tail;
+	size_t size;
+	int closed;
+	int reader_waiting;
+	int writer_waiting;
+	pid_t reader_pid;
+	pid_t writer_pid;
+	unsigned long writer_waits;
+	char data[1];
+}ndo_queue;
+
+/* create the shared queue (call in the producer, before forking the consumer) */
+int ndo_queue_init(size_t);
+
+/* unmap the queue from this process */
+void ndo_queue_free(void);
+
+/* remember which process consumes the queue */
+void ndo_queue_set_reader(pid_t);
 
-/* initialize new queue or open existing */
-int get_queue_id();
+/* producer: get contiguous free space, waiting while the queue is full */
+char *ndo_queue_reserve(size_t *);
+
+/* producer: publish bytes written into reserved space */
+void ndo_queue_commit(size_t);
+
+/* producer: no more data will be written */
+void ndo_queue_close(void);
+
+/*
+ * consumer: get contiguous queued bytes, waiting while the queue is empty.
+ * Returns NULL once the producer is done (or has died) and everything has
+ * been read, and an empty chunk (*len == 0) if nothing arrived within the
+ * timeout (in milliseconds, negative waits for data).
+ */
+char *ndo_queue_peek(size_t *, int);
 
-/* insert into queue */
-void push_into_queue(char*);
+/* consumer: give consumed bytes back to the producer */
+void ndo_queue_release(size_t);
 
-/* get and delete from queue */
-char* pop_from_queue();
+/* number of bytes currently queued */
+size_t ndo_queue_used(void);
 
 #endif /* NDO_QUEUE_H_INCLUDED */
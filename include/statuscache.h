@@ -0,0 +1,59 @@
+/**
+ * @file statuscache.h Write-behind cache for ndo2db status updates
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_STATUSCACHE_H_INCLUDED
+#define NDO2DB_STATUSCACHE_H_INCLUDED
+
+#include "ndo2db.h"
+
+
+#define NDO2DB_STATUS_CACHE_HASHSLOTS           4096
+
+
+/***************** structures *****************/
+
+/* the latest status update for one object that hasn't been written yet */
+typedef struct ndo2db_status_entry_struct{
+	char *name1;
+	char *name2;
+	ndo2db_input_event *event;
+	struct ndo2db_status_entry_struct *nexthash;
+	struct ndo2db_status_entry_struct *next;
+        }ndo2db_status_entry;
+
+typedef struct ndo2db_status_cache_struct{
+	ndo2db_status_entry **hashlist;
+	ndo2db_status_entry *head;
+	ndo2db_status_entry *tail;
+	int dirty;
+	struct timeval first_update_time;
+	unsigned long updates;
+        }ndo2db_status_cache;
+
+
+/***************** functions *******************/
+
+int ndo2db_status_cache_add(ndo2db_idi *);
+int ndo2db_status_cache_flush(ndo2db_idi *);
+int ndo2db_status_cache_flush_expired(ndo2db_idi *);
+int ndo2db_status_cache_free(ndo2db_idi *);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file trimmer.h Background table trimming for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NDO2DB_TRIMMER_H_INCLUDED
+#define NDO2DB_TRIMMER_H_INCLUDED
+
+#include <pthread.h>
+#include "ndo2db.h"
+#include "db.h"
+
+
+#define NDO2DB_TRIM_MIN_CHUNK                   10	/* rows */
+#define NDO2DB_TRIM_MAX_CHUNK_GROWTH            16	/* chunks grow to at most this many times trim_chunk_rows */
+
+
+/* how far a table has been trimmed */
+typedef struct ndo2db_trim_state_struct{
+	unsigned long chunk_rows;		/* adapts to trim_chunk_time */
+	unsigned long rows;			/* deleted in the current pass */
+	unsigned long statements;
+	unsigned long msec;			/* spent deleting, pauses excluded */
+        }ndo2db_trim_state;
+
+/* the trimming thread of a client connection and the database connection it owns */
+typedef struct ndo2db_trimmer_struct{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int requested;
+	int shutdown;
+	ndo2db_idi idi;
+	ndo2db_trim_state state[NDO2DB_MAX_TRIMTABLES];
+        }ndo2db_trimmer;
+
+
+
+int ndo2db_trimmer_wake(ndo2db_idi *);
+int ndo2db_trimmer_stop(ndo2db_idi *);
+
+#endif
@@ -38,11 +38,44 @@ typedef struct ndo_dbuf_struct{
 	unsigned long chunk_size;
         }ndo_dbuf;
 
+typedef struct ndo_lbuf_struct{
+	char *buf;
+	unsigned long start;		/* first byte of the current (partial) line */
+	unsigned long scanned;		/* bytes already searched for a newline */
+	unsigned long used_size;
+	unsigned long allocated_size;
+        }ndo_lbuf;
+
+typedef struct ndo_arena_block_struct{
+	struct ndo_arena_block_struct *next;
+	unsigned long size;
+	unsigned long used;
+	char *data;
+        }ndo_arena_block;
+
+typedef struct ndo_arena_struct{
+	ndo_arena_block *head;
+	ndo_arena_block *current;	/* block allocations are being made from */
+	unsigned long block_size;
+        }ndo_arena;
+
 
 int ndo_dbuf_init(ndo_dbuf *,int);
 int ndo_dbuf_free(ndo_dbuf *);
 int ndo_dbuf_strcat(ndo_dbuf *,char *);
 
+int ndo_lbuf_init(ndo_lbuf *,unsigned long);
+int ndo_lbuf_free(ndo_lbuf *);
+char *ndo_lbuf_reserve(ndo_lbuf *,unsigned long);
+void ndo_lbuf_commit(ndo_lbuf *,unsigned long);
+char *ndo_lbuf_next_line(ndo_lbuf *,unsigned long *);
+
+int ndo_arena_init(ndo_arena *,unsigned long);
+int ndo_arena_free(ndo_arena *);
+void *ndo_arena_alloc(ndo_arena *,unsigned long);
+char *ndo_arena_strdup(ndo_arena *,const char *);
+void ndo_arena_reset(ndo_arena *);
+
 int my_rename(char *,char *);
 
 void ndomod_strip(char *);
@@ -0,0 +1,191 @@
+/**
+ * @file capture.c Recording of the raw client input of ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With capture_file set, everything a client sends is also written, as
+ * it was read and with the time it arrived, to a file of its own named
+ * <capture_file>.<time>.<pid>.<n>.  Replaying such a file with file2sock
+ * puts the same load on another ndo2db, at the pace it originally came
+ * in or faster.  Reads are buffered and written at least every
+ * NDO2DB_CAPTURE_FLUSH_TIME seconds, by the next read or, on a connection
+ * that has gone quiet, by ndo2db_capture_idle(), which the readers call
+ * when they have waited that long for input.  If writing fails the
+ * capture of that connection stops and the input is still handled as
+ * usual.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/capture.h"
+
+extern char *ndo2db_capture_file;
+
+static unsigned long ndo2db_capture_count=0L;
+static ndo2db_capture *ndo2db_captures=NULL;
+
+
+
+/* writes bytes to the capture file, giving up on the capture if that fails */
+static int ndo2db_capture_output(ndo2db_capture *cap, const char *buf, size_t len){
+	ssize_t result=0;
+
+	while(len>0){
+		if((result=write(cap->fd,buf,len))<0){
+			if(errno==EINTR)
+				continue;
+			syslog(LOG_USER|LOG_INFO,"Error: Could not write to the capture file, no longer capturing this connection: %s\n",strerror(errno));
+			close(cap->fd);
+			cap->fd=-1;
+			return NDO_ERROR;
+		        }
+		buf+=result;
+		len-=(size_t)result;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* writes out everything that is buffered */
+static int ndo2db_capture_flush(ndo2db_capture *cap){
+	int result=NDO_OK;
+
+	result=ndo2db_capture_output(cap,cap->buffer,cap->used);
+	cap->used=0;
+	cap->last_flush=time(NULL);
+
+	return result;
+        }
+
+
+/* starts capturing a new connection, if captures were asked for */
+int ndo2db_capture_open(ndo2db_capture *cap){
+	char *name=NULL;
+	size_t size=0;
+
+	cap->fd=-1;
+	cap->buffer=NULL;
+	cap->used=0;
+	cap->last_flush=time(NULL);
+	cap->next=NULL;
+
+	if(ndo2db_capture_file==NULL)
+		return NDO_OK;
+
+	ndo2db_capture_count++;
+	size=strlen(ndo2db_capture_file)+64;
+	if((name=(char *)malloc(size))==NULL)
+		return NDO_ERROR;
+	snprintf(name,size,"%s.%lu.%lu.%lu",ndo2db_capture_file,(unsigned long)cap->last_flush,(unsigned long)getpid(),ndo2db_capture_count);
+
+	if((cap->buffer=(char *)malloc(NDO2DB_CAPTURE_BUFFER))==NULL || (cap->fd=open(name,O_WRONLY|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR|S_IRGRP))==-1){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not open capture file '%s': %s\n",name,strerror(errno));
+		my_free(cap->buffer);
+		free(name);
+		return NDO_ERROR;
+	        }
+
+	cap->used=snprintf(cap->buffer,NDO2DB_CAPTURE_BUFFER,"%s\n",NDO2DB_CAPTURE_MAGIC);
+	cap->next=ndo2db_captures;
+	ndo2db_captures=cap;
+
+	syslog(LOG_USER|LOG_INFO,"Capturing client input to '%s'\n",name);
+	free(name);
+
+	return NDO_OK;
+        }
+
+
+/* records one read from the client */
+int ndo2db_capture_write(ndo2db_capture *cap, const char *buf, size_t len){
+	struct timeval now;
+	char header[64];
+	size_t headerlen=0;
+
+	if(cap->fd<0)
+		return NDO_OK;
+
+	gettimeofday(&now,NULL);
+	headerlen=(size_t)snprintf(header,sizeof(header),"%lu.%06lu %lu\n",(unsigned long)now.tv_sec,(unsigned long)now.tv_usec,(unsigned long)len);
+
+	if(cap->used+headerlen+len>NDO2DB_CAPTURE_BUFFER && ndo2db_capture_flush(cap)==NDO_ERROR)
+		return NDO_ERROR;
+
+	memcpy(cap->buffer+cap->used,header,headerlen);
+	cap->used+=headerlen;
+
+	/* reads larger than the buffer go straight to the file */
+	if(headerlen+len>NDO2DB_CAPTURE_BUFFER){
+		if(ndo2db_capture_flush(cap)==NDO_ERROR)
+			return NDO_ERROR;
+		return ndo2db_capture_output(cap,buf,len);
+	        }
+
+	memcpy(cap->buffer+cap->used,buf,len);
+	cap->used+=len;
+
+	if(now.tv_sec-cap->last_flush>=NDO2DB_CAPTURE_FLUSH_TIME)
+		return ndo2db_capture_flush(cap);
+
+	return NDO_OK;
+        }
+
+
+/* finishes the capture of a connection that is gone */
+int ndo2db_capture_close(ndo2db_capture *cap){
+	ndo2db_capture **cp=&ndo2db_captures;
+	int result=NDO_OK;
+
+	for(;*cp!=NULL;cp=&(*cp)->next){
+		if(*cp==cap){
+			*cp=cap->next;
+			break;
+		        }
+	        }
+
+	if(cap->fd>=0){
+		result=ndo2db_capture_flush(cap);
+		if(cap->fd>=0)
+			close(cap->fd);
+		cap->fd=-1;
+	        }
+	my_free(cap->buffer);
+
+	return result;
+        }
+
+
+/* writes out what quiet connections have had buffered for a while */
+int ndo2db_capture_idle(void){
+	ndo2db_capture *cap=NULL;
+	time_t now=time(NULL);
+
+	for(cap=ndo2db_captures;cap!=NULL;cap=cap->next){
+		if(cap->fd>=0 && cap->used>0 && now-cap->last_flush>=NDO2DB_CAPTURE_FLUSH_TIME)
+			ndo2db_capture_flush(cap);
+	        }
+
+	return NDO_OK;
+        }
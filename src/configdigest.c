@@ -0,0 +1,534 @@
+/**
+ * @file configdigest.c Skipping unchanged definitions in ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every config dump repeats the whole configuration, most of it the same
+ * as last time.  With config_digests set, a digest of each host, service,
+ * group, contact, timeperiod and command definition is kept in the
+ * configdigests table.  A definition whose digest matches the one stored
+ * for its object is not written again; one that differs has the member
+ * rows and custom variables it wrote last time deleted before it is
+ * written.  When the dump ends the new digests are stored, and the rows
+ * of objects the dump no longer defines are deleted.
+ *
+ * The tables the digests cover are no longer cleared when Nagios starts,
+ * so they are only ever changed by what changed in the configuration.
+ * A dump with no digests to compare against, the first after the option
+ * is set or one the digests can't be read for, clears them itself.
+ */
+
+#define _GNU_SOURCE		/* asprintf() */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/configdigest.h"
+#include "../include/metrics.h"
+
+extern int ndo2db_config_digests;
+
+extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern ndo2db_dbconfig ndo2db_db_settings;
+
+
+
+/****************************************************************************/
+/* DEFINITIONS                                                              */
+/****************************************************************************/
+
+/* a definition the digests cover */
+typedef struct ndo2db_config_definition_struct{
+	int input_data;
+	int object_type;
+	int name1;			/* the buffered input holding the object's names */
+	int name2;
+	int table;
+	const char *object_column;	/* finds the definition's row by its object id */
+	const char *id_column;		/* the definition's row id, as member rows refer to it */
+	int members[4];			/* tables of rows written with the definition, ended by -1 */
+	int custom_variables;
+        }ndo2db_config_definition;
+
+static const ndo2db_config_definition ndo2db_config_definitions[]={
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_HOSTNAME,-1,NDO2DB_DBTABLE_HOSTS,"host_object_id","host_id"
+		,{NDO2DB_DBTABLE_HOSTPARENTHOSTS,NDO2DB_DBTABLE_HOSTCONTACTGROUPS,NDO2DB_DBTABLE_HOSTCONTACTS,-1},NDO_TRUE},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO_DATA_HOSTNAME,NDO_DATA_SERVICEDESCRIPTION,NDO2DB_DBTABLE_SERVICES,"service_object_id","service_id"
+#ifdef BUILD_NAGIOS_4X
+		,{NDO2DB_DBTABLE_SERVICEPARENTSERVICES,NDO2DB_DBTABLE_SERVICECONTACTGROUPS,NDO2DB_DBTABLE_SERVICECONTACTS,-1},NDO_TRUE},
+#else
+		,{NDO2DB_DBTABLE_SERVICECONTACTGROUPS,NDO2DB_DBTABLE_SERVICECONTACTS,-1},NDO_TRUE},
+#endif
+	{NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION,NDO2DB_OBJECTTYPE_HOSTGROUP,NDO_DATA_HOSTGROUPNAME,-1,NDO2DB_DBTABLE_HOSTGROUPS,"hostgroup_object_id","hostgroup_id"
+		,{NDO2DB_DBTABLE_HOSTGROUPMEMBERS,-1},NDO_FALSE},
+	{NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION,NDO2DB_OBJECTTYPE_SERVICEGROUP,NDO_DATA_SERVICEGROUPNAME,-1,NDO2DB_DBTABLE_SERVICEGROUPS,"servicegroup_object_id","servicegroup_id"
+		,{NDO2DB_DBTABLE_SERVICEGROUPMEMBERS,-1},NDO_FALSE},
+	{NDO2DB_INPUT_DATA_COMMANDDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_COMMANDNAME,-1,NDO2DB_DBTABLE_COMMANDS,"object_id",NULL
+		,{-1},NDO_FALSE},
+	{NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_TIMEPERIODNAME,-1,NDO2DB_DBTABLE_TIMEPERIODS,"timeperiod_object_id","timeperiod_id"
+		,{NDO2DB_DBTABLE_TIMEPERIODTIMERANGES,-1},NDO_FALSE},
+	{NDO2DB_INPUT_DATA_CONTACTDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO_DATA_CONTACTNAME,-1,NDO2DB_DBTABLE_CONTACTS,"contact_object_id","contact_id"
+		,{NDO2DB_DBTABLE_CONTACTADDRESSES,NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS,-1},NDO_TRUE},
+	{NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO_DATA_CONTACTGROUPNAME,-1,NDO2DB_DBTABLE_CONTACTGROUPS,"contactgroup_object_id","contactgroup_id"
+		,{NDO2DB_DBTABLE_CONTACTGROUPMEMBERS,-1},NDO_FALSE}
+        };
+
+#define NDO2DB_CONFIG_DEFINITIONS (int)(sizeof(ndo2db_config_definitions)/sizeof(ndo2db_config_definitions[0]))
+
+
+static int ndo2db_config_digest_compare(const void *p1, const void *p2){
+	const ndo2db_config_digest *d1=(const ndo2db_config_digest *)p1;
+	const ndo2db_config_digest *d2=(const ndo2db_config_digest *)p2;
+
+	return (d1->object_id<d2->object_id)?-1:(d1->object_id>d2->object_id)?1:0;
+        }
+
+
+/* FNV-1a over every field of the definition but its timestamp, and every line of its lists */
+static unsigned long long ndo2db_config_digest_compute(ndo2db_idi *idi){
+	register unsigned long long result=14695981039346656037ULL;
+	register const unsigned char *ptr=NULL;
+	int x=0;
+	int y=0;
+
+	result=(result^(unsigned long long)(idi->current_input_data&0xff))*1099511628211ULL;
+
+	for(x=0;x<NDO_MAX_DATA_TYPES;x++){
+		if(x==NDO_DATA_TIMESTAMP || idi->buffered_input[x]==NULL)
+			continue;
+		result=(result^(unsigned long long)(x&0xff))*1099511628211ULL;
+		result=(result^(unsigned long long)((x>>8)&0xff))*1099511628211ULL;
+		for(ptr=(const unsigned char *)idi->buffered_input[x];*ptr;ptr++)
+			result=(result^*ptr)*1099511628211ULL;
+		result=(result^0xffULL)*1099511628211ULL;
+	        }
+
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		for(y=0;y<idi->mbuf[x].used_lines;y++){
+			if(idi->mbuf[x].buffer[y]==NULL)
+				continue;
+			result=(result^(unsigned long long)(x|0x80))*1099511628211ULL;
+			for(ptr=(const unsigned char *)idi->mbuf[x].buffer[y];*ptr;ptr++)
+				result=(result^*ptr)*1099511628211ULL;
+			result=(result^0xffULL)*1099511628211ULL;
+		        }
+	        }
+
+	return result;
+        }
+
+
+/* deletes the member rows and custom variables of some objects' definitions (or of all of them if object_ids is NULL), and the definitions themselves if they're gone */
+static int ndo2db_config_digest_delete(ndo2db_idi *idi, const ndo2db_config_definition *definition, const char *object_ids, int removed){
+	char *buf=NULL;
+	char *in=NULL;
+	int result=NDO_OK;
+	int x=0;
+
+	for(x=0;definition->members[x]>=0;x++){
+		if(object_ids==NULL || asprintf(&in," AND d.%s IN (%s)",definition->object_column,object_ids)==-1)
+			in=NULL;
+		if(asprintf(&buf,"DELETE m FROM %s AS m JOIN %s AS d ON m.%s=d.%s WHERE d.instance_id='%lu' AND d.config_type='%d'%s"
+			    ,ndo2db_db_tablenames[definition->members[x]]
+			    ,ndo2db_db_tablenames[definition->table]
+			    ,definition->id_column
+			    ,definition->id_column
+			    ,idi->dbinfo.instance_id
+			    ,idi->current_object_config_type
+			    ,(in==NULL)?"":in
+			   )==-1)
+			buf=NULL;
+		if(ndo2db_db_query(idi,buf)!=NDO_OK)
+			result=NDO_ERROR;
+		free(buf);
+		free(in);
+	        }
+
+	if(definition->custom_variables==NDO_TRUE && object_ids!=NULL){
+		if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND config_type='%d' AND object_id IN (%s)"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]
+			    ,idi->dbinfo.instance_id
+			    ,idi->current_object_config_type
+			    ,object_ids
+			   )==-1)
+			buf=NULL;
+		if(ndo2db_db_query(idi,buf)!=NDO_OK)
+			result=NDO_ERROR;
+		free(buf);
+	        }
+
+	if(removed==NDO_FALSE)
+		return result;
+
+	if(object_ids==NULL || asprintf(&in," AND %s IN (%s)",definition->object_column,object_ids)==-1)
+		in=NULL;
+	if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND config_type='%d'%s"
+		    ,ndo2db_db_tablenames[definition->table]
+		    ,idi->dbinfo.instance_id
+		    ,idi->current_object_config_type
+		    ,(in==NULL)?"":in
+		   )==-1)
+		buf=NULL;
+	if(ndo2db_db_query(idi,buf)!=NDO_OK)
+		result=NDO_ERROR;
+	free(buf);
+	free(in);
+
+	if(object_ids==NULL)
+		return result;
+
+	if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND config_type='%d' AND object_id IN (%s)"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGDIGESTS]
+		    ,idi->dbinfo.instance_id
+		    ,idi->current_object_config_type
+		    ,object_ids
+		   )==-1)
+		buf=NULL;
+	if(ndo2db_db_query(idi,buf)!=NDO_OK)
+		result=NDO_ERROR;
+	free(buf);
+
+	return result;
+        }
+
+
+/* deletes every definition the digests cover, as Nagios starting would have without them */
+static int ndo2db_config_digest_clear(ndo2db_idi *idi){
+	char *buf=NULL;
+	int result=NDO_OK;
+	int x=0;
+
+	for(x=0;x<NDO2DB_CONFIG_DEFINITIONS;x++){
+		if(ndo2db_config_digest_delete(idi,&ndo2db_config_definitions[x],NULL,NDO_TRUE)!=NDO_OK)
+			result=NDO_ERROR;
+	        }
+
+	if(asprintf(&buf,"DELETE FROM %s WHERE instance_id='%lu' AND config_type='%d'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]
+		    ,idi->dbinfo.instance_id
+		    ,idi->current_object_config_type
+		   )==-1)
+		buf=NULL;
+	if(ndo2db_db_query(idi,buf)!=NDO_OK)
+		result=NDO_ERROR;
+	free(buf);
+
+	return result;
+        }
+
+
+/* reads the digests the last dump of this type stored */
+static int ndo2db_config_digest_load(ndo2db_idi *idi, ndo2db_config_digest_set *digests){
+	ndo2db_config_digest *new_stored=NULL;
+	char *buf=NULL;
+	int allocated=0;
+	int result=NDO_OK;
+
+	if(asprintf(&buf,"SELECT object_id, objecttype_id, digest FROM %s WHERE instance_id='%lu' AND config_type='%d'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGDIGESTS]
+		    ,idi->dbinfo.instance_id
+		    ,idi->current_object_config_type
+		   )==-1)
+		buf=NULL;
+
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		if(idi->dbinfo.mysql_result!=NULL){
+			while((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+				if(digests->stored_count==allocated){
+					allocated=(allocated==0)?1024:allocated*2;
+					if((new_stored=(ndo2db_config_digest *)realloc(digests->stored,allocated*sizeof(ndo2db_config_digest)))==NULL){
+						result=NDO_ERROR;
+						break;
+					        }
+					digests->stored=new_stored;
+				        }
+				ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&digests->stored[digests->stored_count].object_id);
+				ndo2db_convert_string_to_int(idi->dbinfo.mysql_row[1],&digests->stored[digests->stored_count].object_type);
+				digests->stored[digests->stored_count].digest=(idi->dbinfo.mysql_row[2]==NULL)?0ULL:strtoull(idi->dbinfo.mysql_row[2],NULL,10);
+				digests->stored[digests->stored_count].seen=NDO_FALSE;
+				digests->stored_count++;
+			        }
+			mysql_free_result(idi->dbinfo.mysql_result);
+		        }
+		else if(mysql_errno(idi->dbinfo.mysql_conn)!=0)
+			result=NDO_ERROR;
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+
+	qsort(digests->stored,digests->stored_count,sizeof(ndo2db_config_digest),ndo2db_config_digest_compare);
+
+	return result;
+        }
+
+
+/* stores the digests of the definitions that were written */
+static int ndo2db_config_digest_save(ndo2db_idi *idi, ndo2db_config_digest_set *digests){
+	ndo_dbuf dbuf;
+	char *suffix=NULL;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int first=0;
+	int x=0;
+
+	if(digests->changed_count==0)
+		return NDO_OK;
+
+	if((suffix=ndo2db_db_update_clause("objecttype_id, digest"))==NULL)
+		return NDO_ERROR;
+
+	for(first=0;first<digests->changed_count && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&dbuf,65536);
+
+		if(asprintf(&buf,"INSERT INTO %s (instance_id, config_type, object_id, objecttype_id, digest) VALUES ",ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGDIGESTS])==-1)
+			buf=NULL;
+		ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+
+		for(x=first;x<digests->changed_count && (x==first || dbuf.used_size<ndo2db_db_settings.batch_bytes);x++){
+			if(asprintf(&buf,"%s('%lu','%d','%lu','%d','%llu')"
+				    ,(x==first)?"":","
+				    ,idi->dbinfo.instance_id
+				    ,idi->current_object_config_type
+				    ,digests->changed[x].object_id
+				    ,digests->changed[x].object_type
+				    ,digests->changed[x].digest
+				   )==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+		        }
+		ndo_dbuf_strcat(&dbuf,suffix);
+
+		result=ndo2db_db_query(idi,dbuf.buf);
+
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	free(suffix);
+
+	return result;
+        }
+
+
+/* deletes the rows of objects the dump no longer defines */
+static int ndo2db_config_digest_remove(ndo2db_idi *idi, ndo2db_config_digest_set *digests){
+	const ndo2db_config_definition *definition=NULL;
+	ndo_dbuf dbuf;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int d=0;
+	int x=0;
+
+	for(d=0;d<NDO2DB_CONFIG_DEFINITIONS;d++){
+		definition=&ndo2db_config_definitions[d];
+
+		ndo_dbuf_init(&dbuf,4096);
+
+		for(x=0;x<=digests->stored_count;x++){
+
+			/* a list is deleted when it's long enough, or there's nothing left to add to it */
+			if(dbuf.used_size>0 && (x==digests->stored_count || dbuf.used_size>=ndo2db_db_settings.batch_bytes)){
+				if(ndo2db_config_digest_delete(idi,definition,dbuf.buf,NDO_TRUE)!=NDO_OK)
+					result=NDO_ERROR;
+				ndo_dbuf_free(&dbuf);
+				ndo_dbuf_init(&dbuf,4096);
+			        }
+			if(x==digests->stored_count)
+				break;
+
+			if(digests->stored[x].seen==NDO_TRUE || digests->stored[x].object_type!=definition->object_type)
+				continue;
+
+			if(asprintf(&buf,"%s'%lu'",(dbuf.used_size==0)?"":",",digests->stored[x].object_id)==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+			digests->removed++;
+		        }
+
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	return result;
+        }
+
+
+
+/****************************************************************************/
+/* DIGEST FUNCTIONS                                                         */
+/****************************************************************************/
+
+/* a config dump is starting, read the digests it will be checked against */
+int ndo2db_config_digest_start(ndo2db_idi *idi){
+	ndo2db_config_digest_set *digests=NULL;
+
+	if(idi==NULL || ndo2db_config_digests==NDO_FALSE)
+		return NDO_OK;
+
+	if((digests=idi->config_digests)==NULL){
+		if((digests=(ndo2db_config_digest_set *)calloc(1,sizeof(ndo2db_config_digest_set)))==NULL)
+			return NDO_ERROR;
+		idi->config_digests=digests;
+	        }
+
+	digests->stored_count=0;
+	digests->changed_count=0;
+	digests->skipped=0L;
+	digests->written=0L;
+	digests->removed=0L;
+
+	if(ndo2db_config_digest_load(idi,digests)==NDO_OK)
+		digests->loaded=NDO_TRUE;
+	else{
+		syslog(LOG_USER|LOG_INFO,"Error: Could not read config digests, all definitions will be written (has the database been upgraded?)\n");
+		digests->stored_count=0;
+		digests->loaded=NDO_FALSE;
+	        }
+
+	/* with nothing to compare the dump against, the definitions left from before it are deleted */
+	if(digests->stored_count==0)
+		ndo2db_config_digest_clear(idi);
+
+	digests->active=NDO_TRUE;
+
+	return NDO_OK;
+        }
+
+
+/* checks the current definition against its digest, returns NDO_TRUE if it's unchanged and needn't be written */
+int ndo2db_config_digest_check(ndo2db_idi *idi){
+	ndo2db_config_digest_set *digests=NULL;
+	const ndo2db_config_definition *definition=NULL;
+	ndo2db_config_digest key;
+	ndo2db_config_digest *stored=NULL;
+	ndo2db_config_digest *new_changed=NULL;
+	unsigned long long digest=0ULL;
+	unsigned long object_id=0L;
+	char object_ids[32];
+	int x=0;
+
+	if(idi==NULL || (digests=idi->config_digests)==NULL || digests->active==NDO_FALSE || idi->buffered_input==NULL)
+		return NDO_FALSE;
+
+	for(x=0;x<NDO2DB_CONFIG_DEFINITIONS;x++){
+		if(ndo2db_config_definitions[x].input_data==idi->current_input_data){
+			definition=&ndo2db_config_definitions[x];
+			break;
+		        }
+	        }
+	if(definition==NULL)
+		return NDO_FALSE;
+
+	/* the handler changes the buffered input, so this comes first */
+	digest=ndo2db_config_digest_compute(idi);
+
+	if(ndo2db_get_object_id_with_insert(idi,definition->object_type,idi->buffered_input[definition->name1],(definition->name2<0)?NULL:idi->buffered_input[definition->name2],&object_id)!=NDO_OK || object_id==0L)
+		return NDO_FALSE;
+
+	key.object_id=object_id;
+	stored=(ndo2db_config_digest *)bsearch(&key,digests->stored,digests->stored_count,sizeof(ndo2db_config_digest),ndo2db_config_digest_compare);
+
+	if(stored!=NULL){
+		stored->seen=NDO_TRUE;
+		if(stored->digest==digest){
+			ndo2db_set_object_as_active(idi,definition->object_type,object_id);
+			digests->skipped++;
+			ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_CONFIGDIGESTS,NDO_TRUE);
+			return NDO_TRUE;
+		        }
+	        }
+
+	/* members the definition no longer has would otherwise be left behind */
+	if(stored!=NULL){
+		snprintf(object_ids,sizeof(object_ids),"'%lu'",object_id);
+		ndo2db_config_digest_delete(idi,definition,object_ids,NDO_FALSE);
+	        }
+
+	digests->written++;
+	ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_CONFIGDIGESTS,NDO_FALSE);
+
+	if(digests->loaded==NDO_FALSE)
+		return NDO_FALSE;
+
+	if(digests->changed_count==digests->changed_allocated){
+		x=(digests->changed_allocated==0)?256:digests->changed_allocated*2;
+		if((new_changed=(ndo2db_config_digest *)realloc(digests->changed,x*sizeof(ndo2db_config_digest)))==NULL)
+			return NDO_FALSE;
+		digests->changed=new_changed;
+		digests->changed_allocated=x;
+	        }
+	digests->changed[digests->changed_count].object_id=object_id;
+	digests->changed[digests->changed_count].object_type=definition->object_type;
+	digests->changed[digests->changed_count].digest=digest;
+	digests->changed[digests->changed_count].seen=NDO_TRUE;
+	digests->changed_count++;
+
+	return NDO_FALSE;
+        }
+
+
+/* the config dump has ended, store its digests and delete what it didn't define */
+int ndo2db_config_digest_end(ndo2db_idi *idi){
+	ndo2db_config_digest_set *digests=NULL;
+	int result=NDO_OK;
+
+	if(idi==NULL || (digests=idi->config_digests)==NULL || digests->active==NDO_FALSE)
+		return NDO_OK;
+
+	if(digests->loaded==NDO_TRUE){
+		if(ndo2db_config_digest_remove(idi,digests)!=NDO_OK)
+			result=NDO_ERROR;
+		if(ndo2db_config_digest_save(idi,digests)!=NDO_OK)
+			result=NDO_ERROR;
+	        }
+
+	syslog(LOG_USER|LOG_INFO,"Config dump: %lu definitions written, %lu unchanged, %lu removed\n",digests->written,digests->skipped,digests->removed);
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Config dump: %lu definitions written, %lu unchanged, %lu removed\n",digests->written,digests->skipped,digests->removed);
+
+	digests->active=NDO_FALSE;
+	digests->stored_count=0;
+	digests->changed_count=0;
+
+	return result;
+        }
+
+
+/* drops the digests */
+int ndo2db_config_digest_free(ndo2db_idi *idi){
+	ndo2db_config_digest_set *digests=NULL;
+
+	if(idi==NULL || (digests=idi->config_digests)==NULL)
+		return NDO_OK;
+
+	free(digests->stored);
+	free(digests->changed);
+	free(digests);
+	idi->config_digests=NULL;
+
+	return NDO_OK;
+        }
@@ -0,0 +1,528 @@
+/**
+ * @file configload.c Bulk loading of ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A config dump writes a row for every definition and another for every
+ * member of its lists, each with a statement of its own.  With
+ * config_bulk_load set, the rows are held from the start of the dump to
+ * its end, and then written a table at a time with multi-row statements
+ * in a single transaction.
+ *
+ * Member rows name their definition by the id its row was given, which
+ * isn't known while the rows are held, so the definition's object id
+ * stands in for it.  The definitions are written first, their ids are
+ * read back by object id, and the member rows are written with the real
+ * ids.  Escalations have no object to find their row by, so they are
+ * still written as they arrive; their members are held like any others.
+ */
+
+#define _GNU_SOURCE		/* asprintf() */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/configload.h"
+
+extern int ndo2db_config_bulk_load;
+
+extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern ndo2db_dbconfig ndo2db_db_settings;
+
+
+
+/****************************************************************************/
+/* CONFIG TABLES                                                            */
+/****************************************************************************/
+
+/* a table config dumps write to */
+typedef struct ndo2db_config_table_struct{
+	int table;
+	const char *id_column;		/* a definition's own id, or the definition's id in a member row */
+	const char *object_column;	/* finds a definition's row by its object id */
+	int definition;			/* the table a member row's id refers to, -1 if none */
+        }ndo2db_config_table;
+
+/* a definition's row, found by its object id */
+typedef struct ndo2db_config_id_struct{
+	unsigned long object_id;
+	unsigned long id;
+        }ndo2db_config_id;
+
+/* in the order they are written, definitions before the rows that refer to them */
+static const ndo2db_config_table ndo2db_config_tables[]={
+	{NDO2DB_DBTABLE_HOSTS,"host_id","host_object_id",-1},
+	{NDO2DB_DBTABLE_SERVICES,"service_id","service_object_id",-1},
+	{NDO2DB_DBTABLE_HOSTGROUPS,"hostgroup_id","hostgroup_object_id",-1},
+	{NDO2DB_DBTABLE_SERVICEGROUPS,"servicegroup_id","servicegroup_object_id",-1},
+	{NDO2DB_DBTABLE_CONTACTGROUPS,"contactgroup_id","contactgroup_object_id",-1},
+	{NDO2DB_DBTABLE_CONTACTS,"contact_id","contact_object_id",-1},
+	{NDO2DB_DBTABLE_TIMEPERIODS,"timeperiod_id","timeperiod_object_id",-1},
+
+	{NDO2DB_DBTABLE_HOSTPARENTHOSTS,"host_id",NULL,NDO2DB_DBTABLE_HOSTS},
+	{NDO2DB_DBTABLE_HOSTCONTACTGROUPS,"host_id",NULL,NDO2DB_DBTABLE_HOSTS},
+	{NDO2DB_DBTABLE_HOSTCONTACTS,"host_id",NULL,NDO2DB_DBTABLE_HOSTS},
+	{NDO2DB_DBTABLE_SERVICEPARENTSERVICES,"service_id",NULL,NDO2DB_DBTABLE_SERVICES},
+	{NDO2DB_DBTABLE_SERVICECONTACTGROUPS,"service_id",NULL,NDO2DB_DBTABLE_SERVICES},
+	{NDO2DB_DBTABLE_SERVICECONTACTS,"service_id",NULL,NDO2DB_DBTABLE_SERVICES},
+	{NDO2DB_DBTABLE_HOSTGROUPMEMBERS,"hostgroup_id",NULL,NDO2DB_DBTABLE_HOSTGROUPS},
+	{NDO2DB_DBTABLE_SERVICEGROUPMEMBERS,"servicegroup_id",NULL,NDO2DB_DBTABLE_SERVICEGROUPS},
+	{NDO2DB_DBTABLE_CONTACTGROUPMEMBERS,"contactgroup_id",NULL,NDO2DB_DBTABLE_CONTACTGROUPS},
+	{NDO2DB_DBTABLE_CONTACTADDRESSES,"contact_id",NULL,NDO2DB_DBTABLE_CONTACTS},
+	{NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS,"contact_id",NULL,NDO2DB_DBTABLE_CONTACTS},
+	{NDO2DB_DBTABLE_TIMEPERIODTIMERANGES,"timeperiod_id",NULL,NDO2DB_DBTABLE_TIMEPERIODS},
+
+	{NDO2DB_DBTABLE_COMMANDS,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_HOSTDEPENDENCIES,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_SERVICEDEPENDENCIES,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_HOSTESCALATIONCONTACTS,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTS,NULL,NULL,-1},
+	{NDO2DB_DBTABLE_CUSTOMVARIABLES,NULL,NULL,-1}
+        };
+
+#define NDO2DB_CONFIG_TABLES (int)(sizeof(ndo2db_config_tables)/sizeof(ndo2db_config_tables[0]))
+
+
+static const ndo2db_config_table *ndo2db_config_load_table(int table){
+	int x=0;
+
+	for(x=0;x<NDO2DB_CONFIG_TABLES;x++){
+		if(ndo2db_config_tables[x].table==table)
+			return &ndo2db_config_tables[x];
+	        }
+
+	return NULL;
+        }
+
+
+static int ndo2db_config_load_compare_ids(const void *p1, const void *p2){
+	const ndo2db_config_id *id1=(const ndo2db_config_id *)p1;
+	const ndo2db_config_id *id2=(const ndo2db_config_id *)p2;
+
+	return (id1->object_id<id2->object_id)?-1:(id1->object_id>id2->object_id)?1:0;
+        }
+
+
+/* splits "column='value', ..." into a list of columns and a list of values, taking out the id column's value */
+static char *ndo2db_config_load_split(ndo2db_config_load *load, char *buf, const char *id_column, char **columns, unsigned long *id){
+	char *values=NULL;
+	char *cols=NULL;
+	char *v=NULL;
+	char *c=NULL;
+	char *p=NULL;
+	char *name=NULL;
+	char *value=NULL;
+	size_t name_length=0;
+	size_t value_length=0;
+	int depth=0;
+
+	if((values=(char *)ndo_arena_alloc(&load->values,strlen(buf)+2))==NULL)
+		return NULL;
+	v=values;
+
+	/* the column list only has to be made once per table */
+	if(*columns==NULL){
+		if((cols=(char *)malloc(strlen(buf)+((id_column==NULL)?0:strlen(id_column))+2))==NULL)
+			return NULL;
+		c=cols;
+		if(id_column!=NULL)
+			c+=sprintf(c,"%s",id_column);
+	        }
+
+	for(p=buf;*p!='\x0';){
+
+		while(*p==' ' || *p==',')
+			p++;
+		if(*p=='\x0')
+			break;
+
+		name=p;
+		while(*p!='\x0' && *p!='=')
+			p++;
+		name_length=p-name;
+		if(*p=='=')
+			p++;
+
+		/* a quoted (and escaped) string, or something like FROM_UNIXTIME(...) */
+		value=p;
+		if(*p=='\''){
+			for(p++;*p!='\x0' && *p!='\'';p++){
+				if(*p=='\\' && p[1]!='\x0')
+					p++;
+			        }
+			if(*p=='\'')
+				p++;
+		        }
+		else{
+			for(depth=0;*p!='\x0' && (depth>0 || *p!=',');p++){
+				if(*p=='(')
+					depth++;
+				else if(*p==')')
+					depth--;
+			        }
+		        }
+		value_length=p-value;
+
+		if(id_column!=NULL && strlen(id_column)==name_length && !strncmp(name,id_column,name_length)){
+			*id=strtoul(value+((*value=='\'')?1:0),NULL,10);
+			continue;
+		        }
+
+		if(cols!=NULL){
+			if(c>cols)
+				*c++=',';
+			memcpy(c,name,name_length);
+			c+=name_length;
+		        }
+
+		if(v>values)
+			*v++=',';
+		memcpy(v,value,value_length);
+		v+=value_length;
+	        }
+
+	*v++=')';
+	*v='\x0';
+
+	if(cols!=NULL){
+		*c='\x0';
+		*columns=cols;
+	        }
+
+	return values;
+        }
+
+
+
+/****************************************************************************/
+/* LOAD FUNCTIONS                                                           */
+/****************************************************************************/
+
+/* a config dump is starting, its rows are held if bulk loading is on */
+int ndo2db_config_load_start(ndo2db_idi *idi){
+	ndo2db_config_load *load=NULL;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	if((load=idi->config_load)==NULL){
+		if((load=(ndo2db_config_load *)calloc(1,sizeof(ndo2db_config_load)))==NULL)
+			return NDO_ERROR;
+		ndo_arena_init(&load->values,NDO2DB_CONFIG_LOAD_VALUES);
+		idi->config_load=load;
+	        }
+
+	/* rows from a dump that never ended go in on their own */
+	ndo2db_config_load_flush(idi);
+
+	gettimeofday(&load->start_time,NULL);
+	load->rows=0L;
+	load->statements=0L;
+	load->active=(ndo2db_config_bulk_load==NDO_TRUE)?NDO_TRUE:NDO_FALSE;
+
+	return NDO_OK;
+        }
+
+
+/* holds a row given as "column='value', ...", returns NDO_TRUE if it was taken */
+int ndo2db_config_load_add(ndo2db_idi *idi, int table, char *buf, unsigned long object_id, unsigned long *row_id){
+	ndo2db_config_load *load=NULL;
+	ndo2db_config_rows *rows=NULL;
+	const ndo2db_config_table *config_table=NULL;
+	unsigned long definition_id=0L;
+	char **new_values=NULL;
+	unsigned long *new_object_id=NULL;
+	int new_allocated=0;
+	char *values=NULL;
+
+	if(idi==NULL || buf==NULL || (load=idi->config_load)==NULL || load->active==NDO_FALSE)
+		return NDO_FALSE;
+
+	if((config_table=ndo2db_config_load_table(table))==NULL)
+		return NDO_FALSE;
+
+	/* a handler that needs the row's id has to be able to find it later */
+	if(row_id!=NULL && config_table->object_column==NULL)
+		return NDO_FALSE;
+
+	rows=&load->table[table];
+	if(rows->rows==rows->allocated){
+		new_allocated=(rows->allocated==0)?256:rows->allocated*2;
+		if((new_values=(char **)realloc(rows->values,new_allocated*sizeof(char *)))==NULL)
+			return NDO_FALSE;
+		rows->values=new_values;
+		if((new_object_id=(unsigned long *)realloc(rows->object_id,new_allocated*sizeof(unsigned long)))==NULL)
+			return NDO_FALSE;
+		rows->object_id=new_object_id;
+		rows->allocated=new_allocated;
+	        }
+
+	if((values=ndo2db_config_load_split(load,buf,(config_table->definition>=0)?config_table->id_column:NULL,&rows->columns,&definition_id))==NULL)
+		return NDO_FALSE;
+
+	rows->values[rows->rows]=values;
+	rows->object_id[rows->rows]=(config_table->definition>=0)?definition_id:object_id;
+	rows->rows++;
+	load->held++;
+
+	/* stands in for the id until the row is written */
+	if(row_id!=NULL)
+		*row_id=object_id;
+
+	return NDO_TRUE;
+        }
+
+
+/* reads back the ids the database gave a table's definitions */
+static int ndo2db_config_load_read_ids(ndo2db_idi *idi, ndo2db_config_load *load, const ndo2db_config_table *config_table, ndo2db_config_id **ids, int *found){
+	ndo2db_config_rows *rows=&load->table[config_table->table];
+	ndo_dbuf dbuf;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int first=0;
+	int x=0;
+
+	if((*ids=(ndo2db_config_id *)malloc(rows->rows*sizeof(ndo2db_config_id)))==NULL)
+		return NDO_ERROR;
+	*found=0;
+
+	for(first=0;first<rows->rows && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&dbuf,4096);
+
+		if(asprintf(&buf,"SELECT %s, %s FROM %s WHERE instance_id='%lu' AND config_type='%d' AND %s IN ("
+			    ,config_table->object_column
+			    ,config_table->id_column
+			    ,ndo2db_db_tablenames[config_table->table]
+			    ,idi->dbinfo.instance_id
+			    ,idi->current_object_config_type
+			    ,config_table->object_column
+			   )==-1)
+			buf=NULL;
+		ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+
+		for(x=first;x<rows->rows && (x==first || dbuf.used_size<ndo2db_db_settings.batch_bytes);x++){
+			if(asprintf(&buf,"%s'%lu'",(x==first)?"":",",rows->object_id[x])==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+		        }
+		ndo_dbuf_strcat(&dbuf,")");
+
+		if((result=ndo2db_db_query(idi,dbuf.buf))==NDO_OK){
+			load->statements++;
+			idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+			if(idi->dbinfo.mysql_result!=NULL){
+				while(*found<rows->rows && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+					ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&(*ids)[*found].object_id);
+					ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[1],&(*ids)[*found].id);
+					(*found)++;
+				        }
+				mysql_free_result(idi->dbinfo.mysql_result);
+			        }
+			else if(mysql_errno(idi->dbinfo.mysql_conn)!=0)
+				result=NDO_ERROR;
+			idi->dbinfo.mysql_result=NULL;
+		        }
+
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	qsort(*ids,*found,sizeof(ndo2db_config_id),ndo2db_config_load_compare_ids);
+
+	return result;
+        }
+
+
+/* writes a table's held rows with as few statements as batch_bytes allows */
+static int ndo2db_config_load_write(ndo2db_idi *idi, ndo2db_config_load *load, const ndo2db_config_table *config_table, ndo2db_config_id **ids, int *found){
+	ndo2db_config_rows *rows=&load->table[config_table->table];
+	ndo2db_config_id key;
+	ndo2db_config_id *definition=NULL;
+	ndo_dbuf dbuf;
+	char *suffix=NULL;
+	char *buf=NULL;
+	int result=NDO_OK;
+	int first=0;
+	int x=0;
+
+	if(rows->rows==0)
+		return NDO_OK;
+
+	if((suffix=ndo2db_db_update_clause(rows->columns))==NULL)
+		return NDO_ERROR;
+
+	for(first=0;first<rows->rows && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&dbuf,65536);
+
+		if(asprintf(&buf,"INSERT INTO %s (%s) VALUES ",ndo2db_db_tablenames[config_table->table],rows->columns)==-1)
+			buf=NULL;
+		ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+
+		for(x=first;x<rows->rows && (x==first || dbuf.used_size<ndo2db_db_settings.batch_bytes);x++){
+
+			/* member rows get the id their definition was given */
+			if(config_table->definition>=0){
+				key.object_id=rows->object_id[x];
+				definition=(ndo2db_config_id *)bsearch(&key,ids[config_table->definition],found[config_table->definition],sizeof(ndo2db_config_id),ndo2db_config_load_compare_ids);
+				if(asprintf(&buf,"%s('%lu',",(x==first)?"":",",(definition==NULL)?0L:definition->id)==-1)
+					buf=NULL;
+			        }
+			else if(asprintf(&buf,"%s(",(x==first)?"":",")==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+
+			ndo_dbuf_strcat(&dbuf,rows->values[x]);
+		        }
+		ndo_dbuf_strcat(&dbuf,suffix);
+
+		if((result=ndo2db_db_query(idi,dbuf.buf))==NDO_OK){
+			load->rows+=x-first;
+			load->statements++;
+		        }
+
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	free(suffix);
+
+	/* rows that refer to these definitions are written later */
+	if(result==NDO_OK && config_table->object_column!=NULL)
+		result=ndo2db_config_load_read_ids(idi,load,config_table,&ids[config_table->table],&found[config_table->table]);
+
+	return result;
+        }
+
+
+/* writes the held rows in one transaction */
+int ndo2db_config_load_flush(ndo2db_idi *idi){
+	ndo2db_config_load *load=NULL;
+	ndo2db_config_id *ids[NDO2DB_MAX_DBTABLES];
+	int found[NDO2DB_MAX_DBTABLES];
+	int result=NDO_ERROR;
+	int attempt=0;
+	int x=0;
+
+	if(idi==NULL || (load=idi->config_load)==NULL || load->held==0)
+		return NDO_OK;
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Writing %d held config dump rows\n",load->held);
+
+	/* whatever came before the dump is committed on its own */
+	ndo2db_db_commit(idi);
+
+	/* the rows are all still here, so a lost connection just means starting over */
+	for(attempt=1;attempt<=NDO2DB_MAX_REPLAY_ATTEMPTS && result==NDO_ERROR;attempt++){
+
+		memset(ids,0,sizeof(ids));
+		memset(found,0,sizeof(found));
+
+		result=ndo2db_db_query(idi,"START TRANSACTION");
+		for(x=0;x<NDO2DB_CONFIG_TABLES && result==NDO_OK;x++)
+			result=ndo2db_config_load_write(idi,load,&ndo2db_config_tables[x],ids,found);
+
+		if(result==NDO_OK && mysql_commit(idi->dbinfo.mysql_conn)){
+			syslog(LOG_USER|LOG_INFO,"Error: mysql_commit() failed: '%s'\n",mysql_error(idi->dbinfo.mysql_conn));
+			ndo2db_handle_db_error(idi,0);
+			result=NDO_ERROR;
+		        }
+
+		if(result==NDO_ERROR){
+			syslog(LOG_USER|LOG_INFO,"Error: Could not write %d config dump rows (attempt %d)\n",load->held,attempt);
+			if(idi->dbinfo.connected==NDO_TRUE)
+				mysql_rollback(idi->dbinfo.mysql_conn);
+		        }
+
+		for(x=0;x<NDO2DB_MAX_DBTABLES;x++)
+			free(ids[x]);
+	        }
+
+	if(result==NDO_ERROR)
+		syslog(LOG_USER|LOG_INFO,"Error: %d config dump rows have been lost\n",load->held);
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++)
+		load->table[x].rows=0;
+	load->held=0;
+	ndo_arena_reset(&load->values);
+
+	return result;
+        }
+
+
+/* writes what's left of a config dump and reports how long it took */
+int ndo2db_config_load_end(ndo2db_idi *idi){
+	ndo2db_config_load *load=NULL;
+	struct timeval now;
+	double seconds=0.0;
+	int result=NDO_OK;
+
+	if(idi==NULL || (load=idi->config_load)==NULL)
+		return NDO_OK;
+
+	result=ndo2db_config_load_flush(idi);
+
+	gettimeofday(&now,NULL);
+	seconds=(double)(now.tv_sec-load->start_time.tv_sec)+(double)(now.tv_usec-load->start_time.tv_usec)/1000000.0;
+
+	if(load->active==NDO_TRUE){
+		syslog(LOG_USER|LOG_INFO,"Config dump applied in %.3f seconds (%lu rows bulk loaded with %lu statements)\n",seconds,load->rows,load->statements);
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Config dump applied in %.3f seconds (%lu rows bulk loaded with %lu statements)\n",seconds,load->rows,load->statements);
+	        }
+	else{
+		syslog(LOG_USER|LOG_INFO,"Config dump applied in %.3f seconds\n",seconds);
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Config dump applied in %.3f seconds\n",seconds);
+	        }
+
+	load->active=NDO_FALSE;
+
+	return result;
+        }
+
+
+/* drops the held rows */
+int ndo2db_config_load_free(ndo2db_idi *idi){
+	ndo2db_config_load *load=NULL;
+	int x=0;
+
+	if(idi==NULL || (load=idi->config_load)==NULL)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		free(load->table[x].columns);
+		free(load->table[x].values);
+		free(load->table[x].object_id);
+	        }
+
+	ndo_arena_free(&load->values);
+	free(load);
+	idi->config_load=NULL;
+
+	return NDO_OK;
+        }
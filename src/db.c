@@ -29,11 +29,30 @@
 #include "../include/ndo2db.h"
 #include "../include/dbhandlers.h"
 #include "../include/db.h"
+#include "../include/trimmer.h"
+#include "../include/metrics.h"
+#include "../include/profile.h"
+
+#include <pthread.h>
+#include <float.h>
 
 extern int errno;
 
 extern ndo2db_dbconfig ndo2db_db_settings;
-extern time_t ndo2db_db_last_checkin_time;
+
+ndo2db_dbtrimtable ndo2db_db_trimtables[NDO2DB_MAX_TRIMTABLES]={
+	{NDO2DB_DBTABLE_TIMEDEVENTS,"timedevent_id","scheduled_time"},
+	{NDO2DB_DBTABLE_SYSTEMCOMMANDS,"systemcommand_id","start_time"},
+	{NDO2DB_DBTABLE_SERVICECHECKS,"servicecheck_id","start_time"},
+	{NDO2DB_DBTABLE_HOSTCHECKS,"hostcheck_id","start_time"},
+	{NDO2DB_DBTABLE_EVENTHANDLERS,"eventhandler_id","start_time"},
+	{NDO2DB_DBTABLE_EXTERNALCOMMANDS,"externalcommand_id","entry_time"},
+	{NDO2DB_DBTABLE_NOTIFICATIONS,"notification_id","start_time"},
+	{NDO2DB_DBTABLE_CONTACTNOTIFICATIONS,"contactnotification_id","start_time"},
+	{NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS,"contactnotificationmethod_id","start_time"},
+	{NDO2DB_DBTABLE_LOGENTRIES,"logentry_id","entry_time"},
+	{NDO2DB_DBTABLE_ACKNOWLEDGEMENTS,"acknowledgement_id","entry_time"}
+        };
 
 char *ndo2db_db_rawtablenames[NDO2DB_MAX_DBTABLES]={
 	"instances",
@@ -105,11 +124,30 @@ char *ndo2db_db_rawtablenames[NDO2DB_MAX_DBTABLES]={
 	"hostescalation_contactgroups",
 	"serviceescalation_contactgroups",
 	"service_parentservices",
+	"configdigests",
         };
 
 
 char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
 
+/* batched insert counters, shared by every connection in this process */
+static pthread_mutex_t ndo2db_db_batch_stats_lock=PTHREAD_MUTEX_INITIALIZER;
+static unsigned long ndo2db_db_batch_rows[NDO2DB_MAX_DBTABLES];
+static unsigned long ndo2db_db_batch_statements[NDO2DB_MAX_DBTABLES];
+static unsigned long ndo2db_db_batch_reported_rows[NDO2DB_MAX_DBTABLES];
+static unsigned long ndo2db_db_batch_reported_statements[NDO2DB_MAX_DBTABLES];
+static time_t ndo2db_db_batch_report_time=(time_t)0L;
+
+/* transaction counters, protected by the same lock */
+static unsigned long ndo2db_db_commits=0L;
+static unsigned long ndo2db_db_committed_events=0L;
+static unsigned long ndo2db_db_commit_usec=0L;
+static unsigned long ndo2db_db_max_commit_usec=0L;
+static unsigned long ndo2db_db_replays=0L;
+
+static int ndo2db_db_discard_batches(ndo2db_idi *);
+static int ndo2db_db_commit_transaction(ndo2db_idi *);
+
 /*
 #define DEBUG_NDO2DB_QUERIES 1
 */
@@ -128,8 +166,10 @@ int ndo2db_db_init(ndo2db_idi *idi){
 	/* initialize db server type */
 	idi->dbinfo.server_type=ndo2db_db_settings.server_type;
 
-	/* initialize table names */
+	/* initialize table names (shared by all connections in this process) */
 	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(ndo2db_db_tablenames[x]!=NULL)
+			continue;
 		if((ndo2db_db_tablenames[x]=(char *)malloc(strlen(ndo2db_db_rawtablenames[x])+((ndo2db_db_settings.dbprefix==NULL)?0:strlen(ndo2db_db_settings.dbprefix))+1))==NULL)
 			return NDO_ERROR;
 		sprintf(ndo2db_db_tablenames[x],"%s%s",(ndo2db_db_settings.dbprefix==NULL)?"":ndo2db_db_settings.dbprefix,ndo2db_db_rawtablenames[x]);
@@ -138,6 +178,8 @@ int ndo2db_db_init(ndo2db_idi *idi){
 	/* initialize other variables */
 	idi->dbinfo.connected=NDO_FALSE;
 	idi->dbinfo.error=NDO_FALSE;
+	idi->dbinfo.partition_writer=NDO_FALSE;
+	idi->dbinfo.archived=NDO_FALSE;
 	idi->dbinfo.instance_id=0L;
 	idi->dbinfo.conninfo_id=0L;
 	idi->dbinfo.latest_program_status_time=(time_t)0L;
@@ -161,15 +203,35 @@ int ndo2db_db_init(ndo2db_idi *idi){
 	idi->dbinfo.max_logentries_age=ndo2db_db_settings.max_logentries_age;
 	idi->dbinfo.max_acknowledgements_age=ndo2db_db_settings.max_acknowledgements_age;	
 	idi->dbinfo.last_table_trim_time=(time_t)0L;
+	idi->dbinfo.last_partition_time=(time_t)0L;
+	idi->dbinfo.last_checkin_time=(time_t)0L;
 	idi->dbinfo.last_logentry_time=(time_t)0L;
 	idi->dbinfo.last_logentry_data=NULL;
-	idi->dbinfo.object_hashlist=NULL;
-
-	/* initialize db structures, etc. */
-	if(!mysql_init(&idi->dbinfo.mysql_conn)){
-		syslog(LOG_USER|LOG_INFO,"Error: mysql_init() failed\n");
-		return NDO_ERROR;
-	}
+	idi->dbinfo.logentry_window.slot=NULL;
+	idi->dbinfo.logentry_window.slots=0L;
+	idi->dbinfo.logentry_window.entries=0L;
+	idi->dbinfo.logentry_window.start_time=(time_t)0L;
+	idi->dbinfo.logentry_window.end_time=(time_t)0L;
+	idi->dbinfo.object_cache=NULL;
+	idi->dbinfo.batch=NULL;
+	idi->dbinfo.batched_rows=0;
+	idi->dbinfo.row_buffer=NULL;
+	idi->dbinfo.row_buffer_size=0;
+	idi->dbinfo.stmt=NULL;
+	idi->dbinfo.last_stmt=NULL;
+	idi->dbinfo.transaction_events=0;
+	idi->dbinfo.transaction_failed=NDO_FALSE;
+	idi->dbinfo.transaction_replaying=NDO_FALSE;
+	idi->dbinfo.transaction_head=NULL;
+	idi->dbinfo.transaction_tail=NULL;
+	idi->dbinfo.transaction_event=NULL;
+	idi->dbinfo.transaction_notification_id=0L;
+	idi->dbinfo.transaction_contact_notification_id=0L;
+	idi->dbinfo.new_objects=NULL;
+	idi->dbinfo.new_objects_lost=NDO_FALSE;
+
+	/* the connection handle is allocated when we connect */
+	idi->dbinfo.mysql_conn=NULL;
 
 	return NDO_OK;
         }
@@ -192,6 +254,22 @@ int ndo2db_db_deinit(ndo2db_idi *idi){
 	/* free cached object ids */
 	ndo2db_free_cached_object_ids(idi);
 
+	/* free batch buffers */
+	ndo2db_db_free_batches(idi);
+
+	/* free log entry digests */
+	ndo2db_free_logentry_window(idi);
+
+	/* free prepared statements */
+	ndo2db_db_free_statements(idi->dbinfo.stmt);
+	idi->dbinfo.stmt=NULL;
+
+	/* free uncommitted events */
+	ndo2db_db_free_transaction(idi);
+	ndo2db_free_input_event(idi->dbinfo.transaction_event);
+	idi->dbinfo.transaction_event=NULL;
+	ndo2db_forget_new_objects(idi);
+
 	return NDO_OK;
         }
 
@@ -207,8 +285,15 @@ int ndo2db_db_connect(ndo2db_idi *idi){
 	if(idi->dbinfo.connected==NDO_TRUE)
 		return NDO_OK;
 
+	/* initialize db structures, etc. */
+	if(idi->dbinfo.mysql_conn==NULL && (idi->dbinfo.mysql_conn=mysql_init(NULL))==NULL){
+		syslog(LOG_USER|LOG_INFO,"Error: mysql_init() failed\n");
+		idi->disconnect_client=NDO_TRUE;
+		return NDO_ERROR;
+	}
+
 	if (!mysql_real_connect(
-			&idi->dbinfo.mysql_conn,
+			idi->dbinfo.mysql_conn,
 			ndo2db_db_settings.host,
 			ndo2db_db_settings.username,
 			ndo2db_db_settings.password,
@@ -217,13 +302,18 @@ int ndo2db_db_connect(ndo2db_idi *idi){
 			ndo2db_db_settings.socket,
 			CLIENT_REMEMBER_OPTIONS
 	)) {
-		mysql_close(&idi->dbinfo.mysql_conn);
-		syslog(LOG_USER|LOG_INFO,"Error: Could not connect to MySQL database: %s",mysql_error(&idi->dbinfo.mysql_conn));
+		syslog(LOG_USER|LOG_INFO,"Error: Could not connect to MySQL database: %s",mysql_error(idi->dbinfo.mysql_conn));
+		mysql_close(idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_conn=NULL;
 		result=NDO_ERROR;
 		idi->disconnect_client=NDO_TRUE;
 	} else {
 		idi->dbinfo.connected=NDO_TRUE;
 		syslog(LOG_USER|LOG_DEBUG,"Successfully connected to MySQL database");
+
+		/* we commit groups of events ourselves */
+		if(ndo2db_db_transactions_enabled()==NDO_TRUE)
+			mysql_autocommit(idi->dbinfo.mysql_conn,0);
 	}
 
 	return result;
@@ -240,8 +330,13 @@ int ndo2db_db_disconnect(ndo2db_idi *idi){
 	if(idi->dbinfo.connected==NDO_FALSE)
 		return NDO_OK;
 
+	/* statements don't survive their connection */
+	ndo2db_db_close_statements(idi->dbinfo.stmt);
+	idi->dbinfo.last_stmt=NULL;
+
 	/* close the connection to the database server */
-	mysql_close(&idi->dbinfo.mysql_conn);
+	mysql_close(idi->dbinfo.mysql_conn);
+	idi->dbinfo.mysql_conn=NULL;
 	idi->dbinfo.connected=NDO_FALSE;
 	syslog(LOG_USER|LOG_DEBUG,"Successfully disconnected from MySQL database");
 
@@ -261,11 +356,17 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 	if(idi->instance_name==NULL)
 		idi->instance_name=strdup("default");
 
+	ndo2db_metrics_hello(idi);
+
+	/* log imports get larger batches */
+	if(idi->disposition!=NULL && !strcmp(idi->disposition,NDO_API_DISPOSITION_ARCHIVED))
+		idi->dbinfo.archived=NDO_TRUE;
+
 	/* get existing instance */
 	if(asprintf(&buf,"SELECT instance_id FROM %s WHERE instance_name='%s'",ndo2db_db_tablenames[NDO2DB_DBTABLE_INSTANCES],idi->instance_name)==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&idi->dbinfo.instance_id);
 			have_instance=NDO_TRUE;
@@ -280,7 +381,7 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 		if(asprintf(&buf,"INSERT INTO %s SET instance_name='%s'",ndo2db_db_tablenames[NDO2DB_DBTABLE_INSTANCES],idi->instance_name)==-1)
 			buf=NULL;
 		if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-			idi->dbinfo.instance_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+			idi->dbinfo.instance_id=ndo2db_db_insert_id(idi);
 		}
 		free(buf);
 	        }
@@ -300,7 +401,7 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.conninfo_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.conninfo_id=ndo2db_db_insert_id(idi);
 	}
 	free(buf);
 	free(ts);
@@ -338,6 +439,10 @@ int ndo2db_db_hello(ndo2db_idi *idi){
 	/* set flags to clean event queue, etc. */
 	idi->dbinfo.clean_event_queue=NDO_TRUE;
 
+	/* our connection record must stick even if the next transaction fails */
+	if(ndo2db_db_transactions_enabled()==NDO_TRUE)
+		ndo2db_db_commit_transaction(idi);
+
 	/* set misc data */
 	idi->dbinfo.last_notification_id=0L;
 	idi->dbinfo.last_contact_notification_id=0L;
@@ -352,6 +457,9 @@ int ndo2db_db_goodbye(ndo2db_idi *idi){
 	char *buf=NULL;
 	char *ts=NULL;
 
+	/* write and commit anything still pending */
+	ndo2db_db_commit(idi);
+
 	ts=ndo2db_db_timet_to_sql(idi,idi->data_end_time);
 
 	/* record last connection information */
@@ -390,7 +498,7 @@ int ndo2db_db_checkin(ndo2db_idi *idi){
 	result=ndo2db_db_query(idi,buf);
 	free(buf);
 
-	time(&ndo2db_db_last_checkin_time);
+	time(&idi->dbinfo.last_checkin_time);
 
 	return result;
         }
@@ -401,31 +509,31 @@ int ndo2db_db_checkin(ndo2db_idi *idi){
 /* MISC FUNCTIONS                                                           */
 /****************************************************************************/
 
+/* copies a string, escaping it for a SQL statement, returns the length of the copy */
+static size_t ndo2db_db_escape_copy(char *newbuf, const char *buf){
+	static const ndo_charset special={13,{'\'','\"','*','\\','$','?','.','^','+','[',']','(',')'},{'\'','\"','*','\\','$','?','.','^','+','[',']','(',')'}};
+
+	if(buf==NULL){
+		newbuf[0]='\x0';
+		return 0;
+	        }
+
+	return ndo_escape_copy(newbuf,buf,strlen(buf),&special);
+        }
+
+
 /* escape a string for a SQL statement */
 char *ndo2db_db_escape_string(ndo2db_idi *idi, char *buf){
-	register int x,y,z;
 	char *newbuf=NULL;
 
 	if(idi==NULL || buf==NULL)
 		return NULL;
 
-	z=strlen(buf);
-
 	/* allocate space for the new string */
-	if((newbuf=(char *)malloc((z*2)+1))==NULL)
+	if((newbuf=(char *)malloc((strlen(buf)*2)+1))==NULL)
 		return NULL;
 
-	/* escape characters */
-	for(x=0,y=0;x<z;x++){
-
-		if(buf[x]=='\'' || buf[x]=='\"' || buf[x]=='*' || buf[x]=='\\' || buf[x]=='$' || buf[x]=='?' || buf[x]=='.' || buf[x]=='^' || buf[x]=='+' || buf[x]=='[' || buf[x]==']' || buf[x]=='(' || buf[x]==')')
-			newbuf[y++]='\\';
-
-		newbuf[y++]=buf[x];
-	        }
-
-	/* terminate escape string */
-	newbuf [y]='\0';
+	ndo2db_db_escape_copy(newbuf,buf);
 
 	return newbuf;
         }
@@ -453,8 +561,29 @@ char *ndo2db_db_sql_to_timet(ndo2db_idi *idi, char *field){
         }
 
 
+/* reconnects to the database server before a statement is run */
+static int ndo2db_db_reconnect(ndo2db_idi *idi){
+
+	/* the server threw away anything we hadn't committed, the replay writes the batched rows again */
+	if(ndo2db_db_transactions_enabled()==NDO_TRUE && (idi->dbinfo.transaction_replaying==NDO_FALSE || idi->dbinfo.transaction_events>0)){
+		idi->dbinfo.transaction_failed=NDO_TRUE;
+		ndo2db_db_discard_batches(idi);
+	        }
+
+	if(ndo2db_db_connect(idi)==NDO_ERROR)
+		return NDO_ERROR;
+
+	/* partition writers get their instance from the parser */
+	if(idi->dbinfo.partition_writer==NDO_FALSE)
+		ndo2db_db_hello(idi);
+
+	return NDO_OK;
+        }
+
+
 /* executes a SQL statement */
 int ndo2db_db_query(ndo2db_idi *idi, char *buf){
+	struct timeval start;
 	int result=NDO_OK;
 	int query_result=0;
 
@@ -462,11 +591,8 @@ int ndo2db_db_query(ndo2db_idi *idi, char *buf){
 		return NDO_ERROR;
 
 	/* if we're not connected, try and reconnect... */
-	if(idi->dbinfo.connected==NDO_FALSE){
-		if(ndo2db_db_connect(idi)==NDO_ERROR)
-			return NDO_ERROR;
-		ndo2db_db_hello(idi);
-	        }
+	if(idi->dbinfo.connected==NDO_FALSE && ndo2db_db_reconnect(idi)==NDO_ERROR)
+		return NDO_ERROR;
 
 #ifdef DEBUG_NDO2DB_QUERIES
 	printf("%s\n\n",buf);
@@ -474,15 +600,23 @@ int ndo2db_db_query(ndo2db_idi *idi, char *buf){
 
 	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"%s\n",buf);
 
-	if (mysql_query(&idi->dbinfo.mysql_conn,buf)) {
+	idi->dbinfo.last_stmt=NULL;
+
+	gettimeofday(&start,NULL);
+	if (mysql_query(idi->dbinfo.mysql_conn,buf)) {
 		syslog(LOG_USER|LOG_INFO,"Error: mysql_query() failed for '%s'\n",buf);
-		syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n", mysql_error(&idi->dbinfo.mysql_conn));
+		syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n", mysql_error(idi->dbinfo.mysql_conn));
 		result=NDO_ERROR;
 	}
+	ndo2db_metrics_db(idi,NDO2DB_METRICS_DB_QUERY,&start,result);
+	ndo2db_profile_statement(-1,buf,&start);
 
 	/* handle errors */
-	if(result==NDO_ERROR)
+	if(result==NDO_ERROR){
 		ndo2db_handle_db_error(idi,query_result);
+		if(idi->dbinfo.connected==NDO_FALSE && ndo2db_db_transactions_enabled()==NDO_TRUE)
+			idi->dbinfo.transaction_failed=NDO_TRUE;
+	        }
 
 	return result;
         }
@@ -509,7 +643,7 @@ int ndo2db_handle_db_error(ndo2db_idi *idi, int query_result){
 	if(idi->dbinfo.connected==NDO_FALSE)
 		return NDO_OK;
 
-	result=mysql_errno(&idi->dbinfo.mysql_conn);
+	result=mysql_errno(idi->dbinfo.mysql_conn);
 	if(result==CR_SERVER_LOST || result==CR_SERVER_GONE_ERROR){
 		syslog(LOG_USER|LOG_INFO,"Error: Connection to MySQL database has been lost!\n");
 		ndo2db_db_disconnect(idi);
@@ -562,7 +696,7 @@ int ndo2db_db_get_latest_data_time(ndo2db_idi *idi, char *table_name, char *fiel
 		buf=NULL;
 
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],t);
 		}
@@ -603,61 +737,1286 @@ int ndo2db_db_trim_data_table(ndo2db_idi *idi, char *table_name, char *field_nam
         }
 		
 
+/* how old a trimmed table's rows may get, 0 keeps them forever */
+unsigned long ndo2db_db_trim_age(ndo2db_idi *idi, int table){
+
+	switch(table){
+	case NDO2DB_DBTABLE_TIMEDEVENTS:
+		return idi->dbinfo.max_timedevents_age;
+	case NDO2DB_DBTABLE_SYSTEMCOMMANDS:
+		return idi->dbinfo.max_systemcommands_age;
+	case NDO2DB_DBTABLE_SERVICECHECKS:
+		return idi->dbinfo.max_servicechecks_age;
+	case NDO2DB_DBTABLE_HOSTCHECKS:
+		return idi->dbinfo.max_hostchecks_age;
+	case NDO2DB_DBTABLE_EVENTHANDLERS:
+		return idi->dbinfo.max_eventhandlers_age;
+	case NDO2DB_DBTABLE_EXTERNALCOMMANDS:
+		return idi->dbinfo.max_externalcommands_age;
+	case NDO2DB_DBTABLE_NOTIFICATIONS:
+		return idi->dbinfo.max_notifications_age;
+	case NDO2DB_DBTABLE_CONTACTNOTIFICATIONS:
+		return idi->dbinfo.max_contactnotifications_age;
+	case NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS:
+		return idi->dbinfo.max_contactnotificationmethods_age;
+	case NDO2DB_DBTABLE_LOGENTRIES:
+		return idi->dbinfo.max_logentries_age;
+	case NDO2DB_DBTABLE_ACKNOWLEDGEMENTS:
+		return idi->dbinfo.max_acknowledgements_age;
+	default:
+		break;
+	        }
+
+	return 0L;
+        }
+
+
+/* drops a day-partitioned table's partitions that only hold rows older than cutoff (0 keeps them) */
+/* and adds partitions for the days ahead, returns NDO_FALSE if the table isn't partitioned */
+int ndo2db_db_partition_table(ndo2db_idi *idi, ndo2db_dbtrimtable *trim, time_t cutoff){
+	char *table_name=NULL;
+	char *buf=NULL;
+	char *temp=NULL;
+	char *drop=NULL;
+	char *add=NULL;
+	char *maxvalue=NULL;
+	char name[16];
+	unsigned long partitions=0L;
+	unsigned long dropped=0L;
+	unsigned long added=0L;
+	unsigned long bound=0L;
+	unsigned long last_bound=0L;
+	unsigned long cutoff_days=0L;
+	unsigned long today=0L;
+	unsigned long day=0L;
+	struct tm tm;
+	time_t t;
+	int result=NDO_OK;
+
+	if(idi==NULL || trim==NULL)
+		return NDO_FALSE;
+
+	table_name=ndo2db_db_tablenames[trim->table];
+
+	/* the server does the date arithmetic, in the time zone the rows were written in */
+	if(asprintf(&buf,"SELECT PARTITION_NAME, PARTITION_DESCRIPTION, TO_DAYS(FROM_UNIXTIME(%lu)), TO_DAYS(NOW()) FROM information_schema.PARTITIONS WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='%s' AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_ORDINAL_POSITION"
+		    ,(unsigned long)cutoff
+		    ,table_name
+		   )==-1)
+		buf=NULL;
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		while(idi->dbinfo.mysql_result!=NULL && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+			if(idi->dbinfo.mysql_row[0]==NULL || idi->dbinfo.mysql_row[1]==NULL)
+				continue;
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[2],&cutoff_days);
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[3],&today);
+
+			/* new days are split off the catch-all partition */
+			if(!strcmp(idi->dbinfo.mysql_row[1],"MAXVALUE")){
+				free(maxvalue);
+				maxvalue=strdup(idi->dbinfo.mysql_row[0]);
+				continue;
+			        }
+
+			partitions++;
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[1],&bound);
+			if(bound>last_bound)
+				last_bound=bound;
+
+			/* every row is older than the cutoff */
+			if(cutoff>(time_t)0L && bound<=cutoff_days){
+				if(asprintf(&temp,"%s%s`%s`",(drop==NULL)?"":drop,(drop==NULL)?"":",",idi->dbinfo.mysql_row[0])==-1)
+					temp=NULL;
+				free(drop);
+				drop=temp;
+				dropped++;
+			        }
+		        }
+		mysql_free_result(idi->dbinfo.mysql_result);
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+
+	if(result==NDO_ERROR || (partitions==0L && maxvalue==NULL)){
+		free(maxvalue);
+		free(drop);
+		return NDO_FALSE;
+	        }
+
+	/* a table can't lose all of its partitions */
+	if(maxvalue==NULL && dropped==partitions)
+		dropped=0L;
+
+	if(dropped>0L && drop!=NULL){
+		if(asprintf(&buf,"ALTER TABLE %s DROP PARTITION %s",table_name,drop)==-1)
+			buf=NULL;
+		if(ndo2db_db_query(idi,buf)==NDO_ERROR)
+			dropped=0L;
+		free(buf);
+	        }
+	free(drop);
+
+	/* one partition per day, named after it */
+	for(day=(last_bound>0L)?last_bound:today;day>0L && day<=today+NDO2DB_PARTITION_DAYS_AHEAD;day++){
+		t=(time_t)(day-NDO2DB_UNIX_EPOCH_DAYS)*(time_t)86400;
+		gmtime_r(&t,&tm);
+		strftime(name,sizeof(name),"p%Y%m%d",&tm);
+		if(asprintf(&temp,"%s%sPARTITION %s VALUES LESS THAN (%lu)",(add==NULL)?"":add,(add==NULL)?"":", ",name,day+1)==-1)
+			temp=NULL;
+		free(add);
+		add=temp;
+		added++;
+	        }
+
+	if(added>0L && add!=NULL){
+		if(maxvalue!=NULL){
+			if(asprintf(&buf,"ALTER TABLE %s REORGANIZE PARTITION `%s` INTO (%s, PARTITION `%s` VALUES LESS THAN MAXVALUE)",table_name,maxvalue,add,maxvalue)==-1)
+				buf=NULL;
+		        }
+		else if(asprintf(&buf,"ALTER TABLE %s ADD PARTITION (%s)",table_name,add)==-1)
+			buf=NULL;
+		if(ndo2db_db_query(idi,buf)==NDO_ERROR)
+			added=0L;
+		free(buf);
+	        }
+	free(add);
+	free(maxvalue);
+
+	if(dropped>0L || added>0L)
+		syslog(LOG_USER|LOG_INFO,"Dropped %lu and added %lu partitions of %s.",dropped,added,ndo2db_db_rawtablenames[trim->table]);
+
+	return NDO_TRUE;
+        }
+
+
+/* takes (or gives back) the lock that keeps connections from changing partitions at once */
+static int ndo2db_db_partition_lock(ndo2db_idi *idi, int lock){
+	char *buf=NULL;
+	int locked=NDO_FALSE;
+
+	if(lock==NDO_TRUE){
+		if(asprintf(&buf,"SELECT GET_LOCK(CONCAT('%s.',DATABASE()),0)",NDO2DB_PARTITION_LOCK)==-1)
+			buf=NULL;
+	        }
+	else if(asprintf(&buf,"SELECT RELEASE_LOCK(CONCAT('%s.',DATABASE()))",NDO2DB_PARTITION_LOCK)==-1)
+		buf=NULL;
+
+	if(ndo2db_db_query(idi,buf)==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		if(idi->dbinfo.mysql_result!=NULL && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL && idi->dbinfo.mysql_row[0]!=NULL && !strcmp(idi->dbinfo.mysql_row[0],"1"))
+			locked=NDO_TRUE;
+		mysql_free_result(idi->dbinfo.mysql_result);
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+
+	return locked;
+        }
+
+
+/* keeps the partitions of all trimmed tables up to date, unless another connection is already at it */
+int ndo2db_db_partition_tables(ndo2db_idi *idi, time_t current_time){
+	ndo2db_dbtrimtable *trim=NULL;
+	unsigned long age=0L;
+	int x=0;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	/* every writer connection and the trimmer come by once an hour, one of them does the work */
+	if(ndo2db_db_partition_lock(idi,NDO_TRUE)==NDO_FALSE)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_TRIMTABLES;x++){
+		trim=&ndo2db_db_trimtables[x];
+		age=ndo2db_db_trim_age(idi,trim->table);
+		ndo2db_db_partition_table(idi,trim,(age==0L)?(time_t)0L:(time_t)((unsigned long)current_time-age));
+	        }
+
+	ndo2db_db_partition_lock(idi,NDO_FALSE);
+
+	return NDO_OK;
+        }
+
+
 /* performs some periodic table maintenance... */
 int ndo2db_db_perform_maintenance(ndo2db_idi *idi){
+	ndo2db_dbtrimtable *trim=NULL;
+	unsigned long age=0L;
 	time_t current_time;
+	int x=0;
 
 	/* get the current time */
 	time(&current_time);
 
 	/* trim tables */
-	if ((current_time-(time_t)60)>idi->dbinfo.last_table_trim_time) {
-		if (idi->dbinfo.max_timedevents_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming timedevents.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEDEVENTS],"scheduled_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_timedevents_age));
-		}
-		if (idi->dbinfo.max_systemcommands_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming systemcommands.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SYSTEMCOMMANDS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_systemcommands_age));
-		}
-		if (idi->dbinfo.max_servicechecks_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming servicechecks.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECHECKS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_servicechecks_age));
-		}
-		if (idi->dbinfo.max_hostchecks_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming hostchecks.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCHECKS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_hostchecks_age));
-		}
-		if (idi->dbinfo.max_eventhandlers_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming eventhandlers.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_EVENTHANDLERS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_eventhandlers_age));
-		}
-		if (idi->dbinfo.max_externalcommands_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming externalcommands.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_EXTERNALCOMMANDS],"entry_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_externalcommands_age));
-		}
-		if (idi->dbinfo.max_notifications_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming notifications.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_NOTIFICATIONS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_notifications_age));
-		}
-		if (idi->dbinfo.max_contactnotifications_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming contactnotifications.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_contactnotifications_age));
-		}
-		if (idi->dbinfo.max_contactnotificationmethods_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming contactnotificationmethods.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS],"start_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_contactnotificationmethods_age));
-		}
-		if (idi->dbinfo.max_logentries_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming logentries.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_LOGENTRIES],"entry_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_logentries_age));
-		}
-		if (idi->dbinfo.max_acknowledgements_age>0L) {
-			syslog(LOG_USER|LOG_INFO,"Trimming acknowledgements.");
-			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_ACKNOWLEDGEMENTS],"entry_time",(time_t)((unsigned long)current_time-idi->dbinfo.max_acknowledgements_age));
-		}
+	if ((current_time-(time_t)NDO2DB_TRIM_INTERVAL)>idi->dbinfo.last_table_trim_time) {
+
+		/* a thread with its own connection trims them a chunk at a time */
+		if(ndo2db_db_settings.trim_chunk_rows>0L && ndo2db_trimmer_wake(idi)==NDO_OK){
+			idi->dbinfo.last_table_trim_time=current_time;
+			return NDO_OK;
+		        }
+
+		/* don't hold an open transaction across long deletes */
+		ndo2db_db_commit(idi);
+
+		/* whole days of old rows go with their partitions, the rest is deleted below */
+		if((current_time-(time_t)NDO2DB_PARTITION_INTERVAL)>idi->dbinfo.last_partition_time){
+			ndo2db_db_partition_tables(idi,current_time);
+			idi->dbinfo.last_partition_time=current_time;
+		        }
+
+		for(x=0;x<NDO2DB_MAX_TRIMTABLES;x++){
+			trim=&ndo2db_db_trimtables[x];
+			if((age=ndo2db_db_trim_age(idi,trim->table))==0L)
+				continue;
+			syslog(LOG_USER|LOG_INFO,"Trimming %s.",ndo2db_db_rawtablenames[trim->table]);
+			ndo2db_db_trim_data_table(idi,ndo2db_db_tablenames[trim->table],trim->time_column,(time_t)((unsigned long)current_time-age));
+		        }
 		idi->dbinfo.last_table_trim_time=current_time;
 	}
 
 	return NDO_OK;
 }
+
+
+
+/****************************************************************************/
+/* BATCHED INSERTS                                                          */
+/****************************************************************************/
+
+/* returns an ON DUPLICATE KEY UPDATE clause that takes the new values of the given columns */
+char *ndo2db_db_update_clause(const char *updates){
+	char *clause=NULL;
+	char *buf=NULL;
+	char *temp=NULL;
+	char *col=NULL;
+	char *saveptr=NULL;
+
+	if(updates!=NULL && (temp=strdup(updates))!=NULL){
+		for(col=strtok_r(temp,", ",&saveptr);col!=NULL;col=strtok_r(NULL,", ",&saveptr)){
+			if(asprintf(&buf,"%s%s%s=VALUES(%s)",(clause==NULL)?"":clause,(clause==NULL)?" ON DUPLICATE KEY UPDATE ":", ",col,col)==-1)
+				buf=NULL;
+			free(clause);
+			clause=buf;
+			buf=NULL;
+		        }
+		free(temp);
+	        }
+
+	if(clause==NULL)
+		clause=strdup("");
+
+	return clause;
+        }
+
+
+/* returns the batch for a table, setting it up the first time it is used */
+static ndo2db_dbbatch *ndo2db_db_get_batch(ndo2db_idi *idi, int table, const char *columns, const char *updates){
+	ndo2db_dbbatch *batch=NULL;
+	char *temp=NULL;
+	size_t len=0;
+
+	if(idi->dbinfo.batch==NULL){
+		if((idi->dbinfo.batch=(ndo2db_dbbatch **)calloc(NDO2DB_MAX_DBTABLES,sizeof(ndo2db_dbbatch *)))==NULL)
+			return NULL;
+	        }
+
+	if((batch=idi->dbinfo.batch[table])!=NULL)
+		return batch;
+
+	if((batch=(ndo2db_dbbatch *)calloc(1,sizeof(ndo2db_dbbatch)))==NULL)
+		return NULL;
+
+	/* the statement prefix stays at the start of the buffer */
+	if(asprintf(&batch->buffer,"INSERT INTO %s (%s) VALUES ",ndo2db_db_tablenames[table],columns)==-1){
+		free(batch);
+		return NULL;
+	        }
+	batch->prefix_size=strlen(batch->buffer);
+	batch->used_size=batch->prefix_size;
+	batch->allocated_size=batch->prefix_size+1;
+
+	/* duplicate rows update the given columns with the new values */
+	if((batch->suffix=ndo2db_db_update_clause(updates))==NULL){
+		free(batch->buffer);
+		free(batch);
+		return NULL;
+	        }
+
+	/* make sure a flush can always append the suffix */
+	len=batch->allocated_size+strlen(batch->suffix)+NDO2DB_INPUT_BUFFER;
+	if((temp=(char *)realloc(batch->buffer,len))==NULL){
+		free(batch->suffix);
+		free(batch->buffer);
+		free(batch);
+		return NULL;
+	        }
+	batch->buffer=temp;
+	batch->allocated_size=len;
+
+	idi->dbinfo.batch[table]=batch;
+
+	return batch;
+        }
+
+
+/* adds a row to a table's next multi-row insert, writing it when it is full */
+int ndo2db_db_batch_add(ndo2db_idi *idi, int table, const char *columns, const char *updates, char *row){
+	ndo2db_dbbatch *batch=NULL;
+	size_t len=0;
+	size_t needed=0;
+	char *newbuf=NULL;
+
+	if(idi==NULL || columns==NULL || row==NULL || table<0 || table>=NDO2DB_MAX_DBTABLES)
+		return NDO_ERROR;
+
+	if((batch=ndo2db_db_get_batch(idi,table,columns,updates))==NULL)
+		return NDO_ERROR;
+
+	len=strlen(row);
+
+	/* keep statements below the configured size */
+	if(batch->rows>0 && batch->used_size+len+1>ndo2db_db_settings.batch_bytes)
+		ndo2db_db_flush_batch(idi,table);
+
+	/* room for a separator, the row, the suffix and a terminator */
+	needed=batch->used_size+len+strlen(batch->suffix)+2;
+	if(needed>batch->allocated_size){
+		if(needed<batch->allocated_size*2)
+			needed=batch->allocated_size*2;
+		if((newbuf=(char *)realloc(batch->buffer,needed))==NULL)
+			return NDO_ERROR;
+		batch->buffer=newbuf;
+		batch->allocated_size=needed;
+	        }
+
+	if(batch->rows>0)
+		batch->buffer[batch->used_size++]=',';
+	memcpy(batch->buffer+batch->used_size,row,len);
+	batch->used_size+=len;
+	batch->buffer[batch->used_size]='\x0';
+
+	if(batch->rows++==0)
+		gettimeofday(&batch->first_row_time,NULL);
+	idi->dbinfo.batched_rows++;
+
+	if(batch->rows>=ndo2db_db_settings.batch_rows && (idi->dbinfo.archived==NDO_FALSE || batch->rows>=ndo2db_db_settings.archive_batch_rows))
+		return ndo2db_db_flush_batch(idi,table);
+
+	return NDO_OK;
+        }
+
+
+/* writes the rows batched for a table */
+int ndo2db_db_flush_batch(ndo2db_idi *idi, int table){
+	ndo2db_dbbatch *batch=NULL;
+	int result=NDO_OK;
+	int rows=0;
+
+	if(idi==NULL || idi->dbinfo.batch==NULL || table<0 || table>=NDO2DB_MAX_DBTABLES)
+		return NDO_ERROR;
+
+	if((batch=idi->dbinfo.batch[table])==NULL || batch->rows==0)
+		return NDO_OK;
+
+	/* reconnect here, so rows that belong to a lost transaction aren't written twice */
+	if(idi->dbinfo.connected==NDO_FALSE && ndo2db_db_transactions_enabled()==NDO_TRUE){
+		if(ndo2db_db_reconnect(idi)==NDO_ERROR)
+			return NDO_ERROR;
+		if(batch->rows==0)
+			return NDO_OK;
+	        }
+
+	/* the buffer always has room for the suffix */
+	strcpy(batch->buffer+batch->used_size,batch->suffix);
+
+	/* reset first, in case the query ends up flushing batches itself */
+	rows=batch->rows;
+	idi->dbinfo.batched_rows-=rows;
+	batch->rows=0;
+	batch->used_size=batch->prefix_size;
+
+	result=ndo2db_db_query(idi,batch->buffer);
+
+	batch->buffer[batch->prefix_size]='\x0';
+
+	pthread_mutex_lock(&ndo2db_db_batch_stats_lock);
+	ndo2db_db_batch_rows[table]+=rows;
+	ndo2db_db_batch_statements[table]++;
+	pthread_mutex_unlock(&ndo2db_db_batch_stats_lock);
+
+	return result;
+        }
+
+
+/* writes the rows batched for all tables */
+int ndo2db_db_flush_batches(ndo2db_idi *idi){
+	int x=0;
+
+	if(idi==NULL || idi->dbinfo.batch==NULL || idi->dbinfo.batched_rows==0)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++)
+		ndo2db_db_flush_batch(idi,x);
+
+	return NDO_OK;
+        }
+
+
+/* writes batches whose oldest row has waited longer than batch_delay */
+int ndo2db_db_flush_expired_batches(ndo2db_idi *idi){
+	struct timeval now;
+	unsigned long age=0L;
+	int x=0;
+
+	if(idi==NULL || idi->dbinfo.batch==NULL || idi->dbinfo.batched_rows==0)
+		return NDO_OK;
+
+	gettimeofday(&now,NULL);
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(idi->dbinfo.batch[x]==NULL || idi->dbinfo.batch[x]->rows==0)
+			continue;
+		age=(now.tv_sec-idi->dbinfo.batch[x]->first_row_time.tv_sec)*1000L+(now.tv_usec-idi->dbinfo.batch[x]->first_row_time.tv_usec)/1000L;
+		if(age>=ndo2db_db_settings.batch_delay)
+			ndo2db_db_flush_batch(idi,x);
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* drops the rows batched so far without writing them */
+static int ndo2db_db_discard_batches(ndo2db_idi *idi){
+	int x=0;
+
+	if(idi==NULL || idi->dbinfo.batch==NULL)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(idi->dbinfo.batch[x]==NULL || idi->dbinfo.batch[x]->rows==0)
+			continue;
+		idi->dbinfo.batch[x]->rows=0;
+		idi->dbinfo.batch[x]->used_size=idi->dbinfo.batch[x]->prefix_size;
+		idi->dbinfo.batch[x]->buffer[idi->dbinfo.batch[x]->prefix_size]='\x0';
+	        }
+	idi->dbinfo.batched_rows=0;
+
+	return NDO_OK;
+        }
+
+
+/* frees batch buffers (unwritten rows are lost) */
+int ndo2db_db_free_batches(ndo2db_idi *idi){
+	int x=0;
+
+	if(idi==NULL)
+		return NDO_OK;
+
+	free(idi->dbinfo.row_buffer);
+	idi->dbinfo.row_buffer=NULL;
+	idi->dbinfo.row_buffer_size=0;
+
+	if(idi->dbinfo.batch==NULL)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(idi->dbinfo.batch[x]==NULL)
+			continue;
+		free(idi->dbinfo.batch[x]->buffer);
+		free(idi->dbinfo.batch[x]->suffix);
+		free(idi->dbinfo.batch[x]);
+	        }
+
+	free(idi->dbinfo.batch);
+	idi->dbinfo.batch=NULL;
+	idi->dbinfo.batched_rows=0;
+
+	return NDO_OK;
+        }
+
+
+/****************************************************************************/
+/* PREPARED STATEMENTS                                                      */
+/****************************************************************************/
+
+/* prepares a table's statement on the current connection */
+static int ndo2db_db_stmt_prepare(ndo2db_idi *idi, ndo2db_dbstmt *stmt){
+
+	if((stmt->handle=mysql_stmt_init(idi->dbinfo.mysql_conn))==NULL)
+		return NDO_ERROR;
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"PREPARE %s\n",stmt->sql);
+
+	if(mysql_stmt_prepare(stmt->handle,stmt->sql,strlen(stmt->sql)) || mysql_stmt_param_count(stmt->handle)!=(unsigned long)stmt->params){
+		syslog(LOG_USER|LOG_INFO,"Error: mysql_stmt_prepare() failed for '%s'\n",stmt->sql);
+		syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n",mysql_stmt_error(stmt->handle));
+		mysql_stmt_close(stmt->handle);
+		stmt->handle=NULL;
+		return NDO_ERROR;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* returns a table's prepared statement ready for binding, or NULL if the caller must build the query itself */
+ndo2db_dbstmt *ndo2db_db_stmt_begin(ndo2db_idi *idi, int table, const char *columns, const char *values, const char *updates){
+	ndo2db_dbstmt *stmt=NULL;
+	char *suffix=NULL;
+	const char *ptr=NULL;
+
+	if(idi==NULL || columns==NULL || values==NULL || table<0 || table>=NDO2DB_MAX_DBTABLES)
+		return NULL;
+
+	if(ndo2db_db_settings.prepared_statements==NDO_FALSE)
+		return NULL;
+
+	if(idi->dbinfo.stmt==NULL){
+		if((idi->dbinfo.stmt=(ndo2db_dbstmt **)calloc(NDO2DB_MAX_DBTABLES,sizeof(ndo2db_dbstmt *)))==NULL)
+			return NULL;
+	        }
+
+	/* set up the statement text and parameter buffers the first time the table is used */
+	if((stmt=idi->dbinfo.stmt[table])==NULL){
+
+		if((stmt=(ndo2db_dbstmt *)calloc(1,sizeof(ndo2db_dbstmt)))==NULL)
+			return NULL;
+
+		for(ptr=values;*ptr;ptr++){
+			if(*ptr=='?')
+				stmt->params++;
+		        }
+
+		suffix=ndo2db_db_update_clause(updates);
+		if(asprintf(&stmt->sql,"INSERT INTO %s (%s) VALUES (%s)%s",ndo2db_db_tablenames[table],columns,values,(suffix==NULL)?"":suffix)==-1)
+			stmt->sql=NULL;
+		free(suffix);
+		stmt->profile=ndo2db_profile_classify(stmt->sql);
+
+		stmt->bind=(MYSQL_BIND *)calloc(stmt->params+1,sizeof(MYSQL_BIND));
+		stmt->ints=(long long *)calloc(stmt->params+1,sizeof(long long));
+		stmt->doubles=(double *)calloc(stmt->params+1,sizeof(double));
+		stmt->lengths=(unsigned long *)calloc(stmt->params+1,sizeof(unsigned long));
+		if(stmt->sql==NULL || stmt->bind==NULL || stmt->ints==NULL || stmt->doubles==NULL || stmt->lengths==NULL)
+			stmt->unusable=NDO_TRUE;
+
+		idi->dbinfo.stmt[table]=stmt;
+	        }
+
+	if(stmt->unusable==NDO_TRUE)
+		return NULL;
+
+	/* if we're not connected, try and reconnect... */
+	if(idi->dbinfo.connected==NDO_FALSE && ndo2db_db_reconnect(idi)==NDO_ERROR)
+		return NULL;
+
+	/* statements are (re)prepared on the connection they run on */
+	if(stmt->handle==NULL && ndo2db_db_stmt_prepare(idi,stmt)==NDO_ERROR){
+		/* don't try again until we reconnect */
+		stmt->unusable=NDO_TRUE;
+		return NULL;
+	        }
+
+	stmt->bound=0;
+
+	return stmt;
+        }
+
+
+/* binds the next parameter to an integer value */
+int ndo2db_db_stmt_bind_int(ndo2db_dbstmt *stmt, long long value){
+	MYSQL_BIND *bind=NULL;
+
+	if(stmt==NULL || stmt->bound>=stmt->params)
+		return NDO_ERROR;
+
+	bind=&stmt->bind[stmt->bound];
+	stmt->ints[stmt->bound]=value;
+	bind->buffer_type=MYSQL_TYPE_LONGLONG;
+	bind->buffer=(void *)&stmt->ints[stmt->bound];
+	bind->buffer_length=0;
+	bind->length=NULL;
+	bind->is_null=NULL;
+	stmt->bound++;
+
+	return NDO_OK;
+        }
+
+
+/* binds the next parameter to a floating point value */
+int ndo2db_db_stmt_bind_double(ndo2db_dbstmt *stmt, double value){
+	MYSQL_BIND *bind=NULL;
+
+	if(stmt==NULL || stmt->bound>=stmt->params)
+		return NDO_ERROR;
+
+	bind=&stmt->bind[stmt->bound];
+	stmt->doubles[stmt->bound]=value;
+	bind->buffer_type=MYSQL_TYPE_DOUBLE;
+	bind->buffer=(void *)&stmt->doubles[stmt->bound];
+	bind->buffer_length=0;
+	bind->length=NULL;
+	bind->is_null=NULL;
+	stmt->bound++;
+
+	return NDO_OK;
+        }
+
+
+/* binds the next parameter to a string, which must stay around until the statement has been executed */
+int ndo2db_db_stmt_bind_string(ndo2db_dbstmt *stmt, const char *value){
+	MYSQL_BIND *bind=NULL;
+
+	if(stmt==NULL || stmt->bound>=stmt->params)
+		return NDO_ERROR;
+
+	if(value==NULL)
+		value="";
+
+	bind=&stmt->bind[stmt->bound];
+	stmt->lengths[stmt->bound]=strlen(value);
+	bind->buffer_type=MYSQL_TYPE_STRING;
+	bind->buffer=(void *)value;
+	bind->buffer_length=stmt->lengths[stmt->bound];
+	bind->length=&stmt->lengths[stmt->bound];
+	bind->is_null=NULL;
+	stmt->bound++;
+
+	return NDO_OK;
+        }
+
+
+/* executes a prepared statement with the values bound to it */
+int ndo2db_db_stmt_execute(ndo2db_idi *idi, ndo2db_dbstmt *stmt){
+	struct timeval start;
+	int attempt=0;
+
+	if(idi==NULL || stmt==NULL || stmt->handle==NULL)
+		return NDO_ERROR;
+
+	if(stmt->bound!=stmt->params){
+		syslog(LOG_USER|LOG_INFO,"Error: %d of %d parameters bound for '%s'\n",stmt->bound,stmt->params,stmt->sql);
+		return NDO_ERROR;
+	        }
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"EXECUTE %s\n",stmt->sql);
+
+	gettimeofday(&start,NULL);
+
+	for(attempt=0;attempt<2;attempt++){
+
+		if(!mysql_stmt_bind_param(stmt->handle,stmt->bind) && !mysql_stmt_execute(stmt->handle)){
+			ndo2db_metrics_db(idi,NDO2DB_METRICS_DB_EXECUTE,&start,NDO_OK);
+			ndo2db_profile_statement(stmt->profile,stmt->sql,&start);
+			idi->dbinfo.last_stmt=stmt;
+			return NDO_OK;
+		        }
+
+		/* the table changed underneath us */
+		if(attempt==0 && mysql_stmt_errno(stmt->handle)==NDO2DB_ER_NEED_REPREPARE){
+			mysql_stmt_close(stmt->handle);
+			stmt->handle=NULL;
+			if(ndo2db_db_stmt_prepare(idi,stmt)==NDO_ERROR)
+				return NDO_ERROR;
+			continue;
+		        }
+
+		break;
+	        }
+
+	ndo2db_metrics_db(idi,NDO2DB_METRICS_DB_EXECUTE,&start,NDO_ERROR);
+	ndo2db_profile_statement(stmt->profile,stmt->sql,&start);
+
+	syslog(LOG_USER|LOG_INFO,"Error: mysql_stmt_execute() failed for '%s'\n",stmt->sql);
+	syslog(LOG_USER|LOG_INFO,"mysql_error: '%s'\n",mysql_stmt_error(stmt->handle));
+
+	idi->dbinfo.last_stmt=NULL;
+	ndo2db_handle_db_error(idi,0);
+	if(idi->dbinfo.connected==NDO_FALSE && ndo2db_db_transactions_enabled()==NDO_TRUE)
+		idi->dbinfo.transaction_failed=NDO_TRUE;
+
+	return NDO_ERROR;
+        }
+
+
+/* closes prepared statements when their connection goes away */
+int ndo2db_db_close_statements(ndo2db_dbstmt **stmts){
+	int x=0;
+
+	if(stmts==NULL)
+		return NDO_OK;
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(stmts[x]==NULL)
+			continue;
+		if(stmts[x]->handle!=NULL)
+			mysql_stmt_close(stmts[x]->handle);
+		stmts[x]->handle=NULL;
+		/* a new connection gets another chance at preparing it */
+		if(stmts[x]->sql!=NULL && stmts[x]->bind!=NULL && stmts[x]->ints!=NULL && stmts[x]->doubles!=NULL && stmts[x]->lengths!=NULL)
+			stmts[x]->unusable=NDO_FALSE;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* frees prepared statements */
+int ndo2db_db_free_statements(ndo2db_dbstmt **stmts){
+	int x=0;
+
+	if(stmts==NULL)
+		return NDO_OK;
+
+	ndo2db_db_close_statements(stmts);
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(stmts[x]==NULL)
+			continue;
+		free(stmts[x]->sql);
+		free(stmts[x]->bind);
+		free(stmts[x]->ints);
+		free(stmts[x]->doubles);
+		free(stmts[x]->lengths);
+		free(stmts[x]);
+	        }
+	free(stmts);
+
+	return NDO_OK;
+        }
+
+
+
+/****************************************************************************/
+/* ROW DESCRIPTORS                                                          */
+/****************************************************************************/
+
+/* room for any number written as text, including quotes */
+#define NDO2DB_DBROW_NUMBER_SIZE                      48
+#define NDO2DB_DBROW_DOUBLE_SIZE                      (DBL_MAX_10_EXP+48)
+
+/*
+ * Builds the column and parameter lists of a row.  Row descriptors are
+ * shared by every thread, so this is done once at startup, before any
+ * writer thread or client process exists, and never again.
+ */
+int ndo2db_db_init_row(ndo2db_dbrow *row){
+	char *columns=NULL;
+	char *values=NULL;
+	size_t columns_size=1;
+	size_t values_size=1;
+	int result=NDO_OK;
+	int x=0;
+
+	if(row->columns==NULL){
+
+		for(x=0;x<row->fields;x++){
+			columns_size+=strlen(row->field[x].column)+2;
+			values_size+=sizeof("FROM_UNIXTIME(?),");
+		        }
+
+		columns=(char *)malloc(columns_size);
+		values=(char *)malloc(values_size);
+
+		if(columns==NULL || values==NULL){
+			free(columns);
+			free(values);
+			result=NDO_ERROR;
+		        }
+		else{
+			columns[0]='\x0';
+			values[0]='\x0';
+			for(x=0;x<row->fields;x++){
+				if(x>0){
+					strcat(columns,", ");
+					strcat(values,",");
+				        }
+				strcat(columns,row->field[x].column);
+				if(row->field[x].type==NDO2DB_FIELD_TIME || row->field[x].type==NDO2DB_FIELD_ARGTIME)
+					strcat(values,"FROM_UNIXTIME(?)");
+				else
+					strcat(values,"?");
+			        }
+			row->values=values;
+			row->columns=columns;
+		        }
+	        }
+
+	return result;
+        }
+
+
+/* binds every field of a row to its prepared statement */
+static int ndo2db_db_row_bind(ndo2db_idi *idi, ndo2db_dbrow *row, const unsigned long *args, ndo2db_dbstmt *stmt){
+	const ndo2db_dbfield *field=NULL;
+	unsigned long ulong_value=0L;
+	double double_value=0.0;
+	int int_value=0;
+	int x=0;
+
+	for(x=0,field=row->field;x<row->fields;x++,field++){
+
+		switch(field->type){
+
+		case NDO2DB_FIELD_INT:
+			int_value=0;
+			ndo2db_convert_string_to_int(idi->buffered_input[field->item],&int_value);
+			ndo2db_db_stmt_bind_int(stmt,int_value);
+			break;
+
+		case NDO2DB_FIELD_ULONG:
+		case NDO2DB_FIELD_TIME:
+			ulong_value=0L;
+			ndo2db_convert_string_to_unsignedlong(idi->buffered_input[field->item],&ulong_value);
+			ndo2db_db_stmt_bind_int(stmt,ulong_value);
+			break;
+
+		case NDO2DB_FIELD_DOUBLE:
+			double_value=0.0;
+			ndo2db_convert_string_to_double(idi->buffered_input[field->item],&double_value);
+			ndo2db_db_stmt_bind_double(stmt,double_value);
+			break;
+
+		case NDO2DB_FIELD_STRING:
+			ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[field->item]);
+			break;
+
+		default:
+			ndo2db_db_stmt_bind_int(stmt,args[field->item]);
+			break;
+		        }
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* writes a row as text into the connection's row buffer */
+static char *ndo2db_db_row_render(ndo2db_idi *idi, ndo2db_dbrow *row, const unsigned long *args){
+	const ndo2db_dbfield *field=NULL;
+	unsigned long ulong_value=0L;
+	double double_value=0.0;
+	int int_value=0;
+	size_t needed=3;
+	char *buf=NULL;
+	char *ptr=NULL;
+	int x=0;
+
+	/* make sure the longest possible row fits */
+	for(x=0,field=row->field;x<row->fields;x++,field++){
+		if(field->type==NDO2DB_FIELD_STRING)
+			needed+=(idi->buffered_input[field->item]==NULL)?3:strlen(idi->buffered_input[field->item])*2+3;
+		else if(field->type==NDO2DB_FIELD_DOUBLE)
+			needed+=NDO2DB_DBROW_DOUBLE_SIZE;
+		else
+			needed+=NDO2DB_DBROW_NUMBER_SIZE;
+	        }
+
+	if(needed>idi->dbinfo.row_buffer_size){
+		if((buf=(char *)realloc(idi->dbinfo.row_buffer,needed))==NULL)
+			return NULL;
+		idi->dbinfo.row_buffer=buf;
+		idi->dbinfo.row_buffer_size=needed;
+	        }
+
+	ptr=idi->dbinfo.row_buffer;
+	*ptr++='(';
+
+	for(x=0,field=row->field;x<row->fields;x++,field++){
+
+		if(x>0)
+			*ptr++=',';
+
+		switch(field->type){
+
+		case NDO2DB_FIELD_INT:
+			int_value=0;
+			ndo2db_convert_string_to_int(idi->buffered_input[field->item],&int_value);
+			ptr+=sprintf(ptr,"'%d'",int_value);
+			break;
+
+		case NDO2DB_FIELD_ULONG:
+			ulong_value=0L;
+			ndo2db_convert_string_to_unsignedlong(idi->buffered_input[field->item],&ulong_value);
+			ptr+=sprintf(ptr,"'%lu'",ulong_value);
+			break;
+
+		case NDO2DB_FIELD_TIME:
+			ulong_value=0L;
+			ndo2db_convert_string_to_unsignedlong(idi->buffered_input[field->item],&ulong_value);
+			ptr+=sprintf(ptr,"FROM_UNIXTIME(%lu)",ulong_value);
+			break;
+
+		case NDO2DB_FIELD_DOUBLE:
+			double_value=0.0;
+			ndo2db_convert_string_to_double(idi->buffered_input[field->item],&double_value);
+			ptr+=sprintf(ptr,"'%lf'",double_value);
+			break;
+
+		case NDO2DB_FIELD_STRING:
+			*ptr++='\'';
+			ptr+=ndo2db_db_escape_copy(ptr,idi->buffered_input[field->item]);
+			*ptr++='\'';
+			break;
+
+		case NDO2DB_FIELD_ARGTIME:
+			ptr+=sprintf(ptr,"FROM_UNIXTIME(%lu)",args[field->item]);
+			break;
+
+		default:
+			ptr+=sprintf(ptr,"'%lu'",args[field->item]);
+			break;
+		        }
+	        }
+
+	*ptr++=')';
+	*ptr='\x0';
+
+	return idi->dbinfo.row_buffer;
+        }
+
+
+/* writes (or batches) a row described by a field table, without allocating anything per row */
+int ndo2db_db_write_row(ndo2db_idi *idi, ndo2db_dbrow *row, const unsigned long *args){
+	ndo2db_dbstmt *stmt=NULL;
+	char *buf=NULL;
+
+	if(idi==NULL || row==NULL || idi->buffered_input==NULL)
+		return NDO_ERROR;
+
+	/* set up by ndo2db_db_init_row() at startup */
+	if(row->columns==NULL)
+		return NDO_ERROR;
+
+	/* batched rows are written as text, others go straight to a prepared statement */
+	if(ndo2db_db_settings.batch_rows<=1 && (stmt=ndo2db_db_stmt_begin(idi,row->table,row->columns,row->values,row->columns))!=NULL){
+		ndo2db_db_row_bind(idi,row,args,stmt);
+		return ndo2db_db_stmt_execute(idi,stmt);
+	        }
+
+	if((buf=ndo2db_db_row_render(idi,row,args))==NULL)
+		return NDO_ERROR;
+
+	/* queue the row, it is written with other rows for this table */
+	return ndo2db_db_batch_add(idi,row->table,row->columns,row->columns,buf);
+        }
+
+
+
+/****************************************************************************/
+/* TRANSACTIONS                                                             */
+/****************************************************************************/
+
+/* are events grouped into transactions? */
+int ndo2db_db_transactions_enabled(void){
+
+	if(ndo2db_db_settings.commit_events>1 || ndo2db_db_settings.commit_interval>0L)
+		return NDO_TRUE;
+
+	return NDO_FALSE;
+        }
+
+
+/* frees the events of the current (uncommitted) transaction */
+int ndo2db_db_free_transaction(ndo2db_idi *idi){
+	ndo2db_input_event *ev=NULL;
+	ndo2db_input_event *next_ev=NULL;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	for(ev=idi->dbinfo.transaction_head;ev!=NULL;ev=next_ev){
+		next_ev=ev->next;
+		ndo2db_free_input_event(ev);
+	        }
+
+	idi->dbinfo.transaction_head=NULL;
+	idi->dbinfo.transaction_tail=NULL;
+	idi->dbinfo.transaction_events=0;
+
+	return NDO_OK;
+        }
+
+
+/* runs the events of a transaction the server lost again on a new connection */
+static int ndo2db_db_replay_transaction(ndo2db_idi *idi){
+	ndo2db_input_event *ev=NULL;
+	ndo2db_input_event *next_ev=NULL;
+	int attempt=0;
+
+	idi->dbinfo.transaction_replaying=NDO_TRUE;
+
+	for(attempt=1;attempt<=NDO2DB_MAX_REPLAY_ATTEMPTS;attempt++){
+
+		idi->dbinfo.transaction_failed=NDO_FALSE;
+
+		/* throw away whatever made it into the new connection's transaction (the handlers reconnect if need be) */
+		if(idi->dbinfo.connected==NDO_TRUE)
+			mysql_rollback(idi->dbinfo.mysql_conn);
+
+		/* the log entries it had stored are gone with it */
+		ndo2db_free_logentry_window(idi);
+
+		/* rows still batched belong to these events, which write them again */
+		ndo2db_db_discard_batches(idi);
+
+		/* the objects it added keep their ids and are put back before the commit */
+		if(idi->dbinfo.new_objects!=NULL)
+			idi->dbinfo.new_objects_lost=NDO_TRUE;
+
+		/* notifications it wrote get new ids, the ones before it keep theirs */
+		idi->dbinfo.last_notification_id=idi->dbinfo.transaction_notification_id;
+		idi->dbinfo.last_contact_notification_id=idi->dbinfo.transaction_contact_notification_id;
+
+		syslog(LOG_USER|LOG_INFO,"Replaying %d uncommitted events (attempt %d)\n",idi->dbinfo.transaction_events,attempt);
+
+		/* the handlers take the events back one at a time */
+		ev=idi->dbinfo.transaction_head;
+		idi->dbinfo.transaction_head=NULL;
+		idi->dbinfo.transaction_tail=NULL;
+		idi->dbinfo.transaction_events=0;
+
+		for(;ev!=NULL;ev=next_ev){
+			next_ev=ev->next;
+			ndo2db_restore_input_data(idi,ev);
+			free(ev);
+			ndo2db_db_begin_event(idi);
+			ndo2db_handle_input_data(idi);
+			ndo2db_db_end_event(idi);
+		        }
+
+		pthread_mutex_lock(&ndo2db_db_batch_stats_lock);
+		ndo2db_db_replays++;
+		pthread_mutex_unlock(&ndo2db_db_batch_stats_lock);
+
+		if(idi->dbinfo.transaction_failed==NDO_FALSE && ndo2db_db_commit(idi)==NDO_OK){
+			idi->dbinfo.transaction_replaying=NDO_FALSE;
+			return NDO_OK;
+		        }
+	        }
+
+	syslog(LOG_USER|LOG_INFO,"Error: Could not replay %d uncommitted events, they have been lost\n",idi->dbinfo.transaction_events);
+	ndo2db_db_free_transaction(idi);
+	idi->dbinfo.transaction_failed=NDO_FALSE;
+	idi->dbinfo.transaction_replaying=NDO_FALSE;
+
+	return NDO_ERROR;
+        }
+
+
+/* keeps a copy of the event about to be handled, the handlers modify their input */
+int ndo2db_db_begin_event(ndo2db_idi *idi){
+	ndo2db_input_event *ev=NULL;
+
+	if(idi==NULL || ndo2db_db_transactions_enabled()==NDO_FALSE)
+		return NDO_OK;
+
+	/* a replay starts from the notifications the last commit left us with */
+	if(idi->dbinfo.transaction_events==0 && idi->dbinfo.transaction_replaying==NDO_FALSE){
+		idi->dbinfo.transaction_notification_id=idi->dbinfo.last_notification_id;
+		idi->dbinfo.transaction_contact_notification_id=idi->dbinfo.last_contact_notification_id;
+	        }
+
+	if((ev=(ndo2db_input_event *)malloc(sizeof(ndo2db_input_event)))==NULL)
+		return NDO_ERROR;
+	ndo2db_copy_input_data(idi,ev);
+
+	ndo2db_free_input_event(idi->dbinfo.transaction_event);
+	idi->dbinfo.transaction_event=ev;
+
+	return NDO_OK;
+        }
+
+
+/* keeps a handled event until it is committed, and commits when it's time */
+int ndo2db_db_end_event(ndo2db_idi *idi){
+	ndo2db_input_event *ev=NULL;
+	struct timeval now;
+	unsigned long age=0L;
+
+	if(idi==NULL || (ev=idi->dbinfo.transaction_event)==NULL)
+		return NDO_OK;
+
+	/* the transaction owns the copy from now on */
+	idi->dbinfo.transaction_event=NULL;
+
+	if(idi->dbinfo.transaction_tail==NULL)
+		idi->dbinfo.transaction_head=ev;
+	else
+		idi->dbinfo.transaction_tail->next=ev;
+	idi->dbinfo.transaction_tail=ev;
+
+	gettimeofday(&now,NULL);
+	if(idi->dbinfo.transaction_events++==0)
+		idi->dbinfo.transaction_start_time=now;
+
+	/* the replay loop decides for itself when to commit */
+	if(idi->dbinfo.transaction_replaying==NDO_TRUE)
+		return NDO_OK;
+
+	/* the connection dropped, so everything since the last commit is gone */
+	if(idi->dbinfo.transaction_failed==NDO_TRUE)
+		return ndo2db_db_replay_transaction(idi);
+
+	if(ndo2db_db_settings.commit_events>0 && idi->dbinfo.transaction_events>=ndo2db_db_settings.commit_events)
+		return ndo2db_db_commit(idi);
+
+	if(ndo2db_db_settings.commit_interval>0L){
+		age=(now.tv_sec-idi->dbinfo.transaction_start_time.tv_sec)*1000L+(now.tv_usec-idi->dbinfo.transaction_start_time.tv_usec)/1000L;
+		if(age>=ndo2db_db_settings.commit_interval)
+			return ndo2db_db_commit(idi);
+	        }
+
+	return NDO_OK;
+        }
+
+
+/*
+ * Writes batched rows and commits, possibly in the middle of an event.
+ * The events are let go only once all their rows are in; after a lost
+ * connection they are kept for the replay and only what the new
+ * connection has written since is committed.
+ */
+static int ndo2db_db_commit_transaction(ndo2db_idi *idi){
+	struct timeval start;
+	struct timeval end;
+	unsigned long usec=0L;
+	int failed=NDO_FALSE;
+	int events=0;
+
+	if((failed=idi->dbinfo.transaction_failed)==NDO_FALSE){
+		/* objects whose ids are already in use must be in before anything is committed */
+		if(ndo2db_restore_new_objects(idi)==NDO_ERROR)
+			return NDO_ERROR;
+		ndo2db_db_flush_batches(idi);
+		if(idi->dbinfo.transaction_failed==NDO_TRUE || idi->dbinfo.connected==NDO_FALSE)
+			return NDO_ERROR;
+	        }
+
+	gettimeofday(&start,NULL);
+	if(mysql_commit(idi->dbinfo.mysql_conn)){
+		ndo2db_metrics_db(idi,NDO2DB_METRICS_DB_COMMIT,&start,NDO_ERROR);
+		syslog(LOG_USER|LOG_INFO,"Error: mysql_commit() failed: '%s'\n",mysql_error(idi->dbinfo.mysql_conn));
+		ndo2db_handle_db_error(idi,0);
+		idi->dbinfo.transaction_failed=NDO_TRUE;
+		return NDO_ERROR;
+	        }
+	ndo2db_metrics_db(idi,NDO2DB_METRICS_DB_COMMIT,&start,NDO_OK);
+	gettimeofday(&end,NULL);
+
+	if(failed==NDO_TRUE)
+		return NDO_OK;
+
+	usec=(end.tv_sec-start.tv_sec)*1000000L+(end.tv_usec-start.tv_usec);
+	events=idi->dbinfo.transaction_events;
+
+	ndo2db_db_free_transaction(idi);
+	ndo2db_forget_new_objects(idi);
+
+	if(events>0){
+		pthread_mutex_lock(&ndo2db_db_batch_stats_lock);
+		ndo2db_db_commits++;
+		ndo2db_db_committed_events+=events;
+		ndo2db_db_commit_usec+=usec;
+		if(usec>ndo2db_db_max_commit_usec)
+			ndo2db_db_max_commit_usec=usec;
+		pthread_mutex_unlock(&ndo2db_db_batch_stats_lock);
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* writes batched rows and commits the current transaction */
+int ndo2db_db_commit(ndo2db_idi *idi){
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	ndo2db_db_flush_batches(idi);
+
+	if(ndo2db_db_transactions_enabled()==NDO_FALSE || idi->dbinfo.connected==NDO_FALSE)
+		return NDO_OK;
+
+	/* whatever we have left gets replayed first */
+	if(idi->dbinfo.transaction_failed==NDO_TRUE && idi->dbinfo.transaction_replaying==NDO_FALSE)
+		return ndo2db_db_replay_transaction(idi);
+
+	return ndo2db_db_commit_transaction(idi);
+        }
+
+
+/* returns the id of the row just inserted */
+unsigned long ndo2db_db_insert_id(ndo2db_idi *idi){
+	unsigned long id=0L;
+
+	if(idi==NULL || idi->dbinfo.connected==NDO_FALSE)
+		return 0L;
+
+	if(idi->dbinfo.last_stmt!=NULL && idi->dbinfo.last_stmt->handle!=NULL)
+		id=(unsigned long)mysql_stmt_insert_id(idi->dbinfo.last_stmt->handle);
+	else
+		id=(unsigned long)mysql_insert_id(idi->dbinfo.mysql_conn);
+
+	return id;
+        }
+
+
+
+/* logs write rates for each batched table and transaction statistics */
+int ndo2db_db_report_stats(void){
+	time_t current_time;
+	unsigned long rows=0L;
+	unsigned long statements=0L;
+	double elapsed=0.0;
+	int x=0;
+
+	time(&current_time);
+
+	pthread_mutex_lock(&ndo2db_db_batch_stats_lock);
+
+	if(ndo2db_db_batch_report_time==(time_t)0L)
+		ndo2db_db_batch_report_time=current_time;
+
+	if(current_time-ndo2db_db_batch_report_time<NDO2DB_BATCH_STATS_INTERVAL){
+		pthread_mutex_unlock(&ndo2db_db_batch_stats_lock);
+		return NDO_OK;
+	        }
+
+	elapsed=(double)(current_time-ndo2db_db_batch_report_time);
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+
+		rows=ndo2db_db_batch_rows[x]-ndo2db_db_batch_reported_rows[x];
+		statements=ndo2db_db_batch_statements[x]-ndo2db_db_batch_reported_statements[x];
+		if(statements==0L)
+			continue;
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Batched writes to %s: %.1f rows/sec, %.1f statements/sec (%lu rows in %lu statements)\n",ndo2db_db_tablenames[x],(double)rows/elapsed,(double)statements/elapsed,rows,statements);
+		if(ndo2db_db_settings.batch_rows>1)
+			syslog(LOG_USER|LOG_INFO,"Batched writes to %s: %.1f rows/sec, %.1f statements/sec",ndo2db_db_tablenames[x],(double)rows/elapsed,(double)statements/elapsed);
+
+		ndo2db_db_batch_reported_rows[x]=ndo2db_db_batch_rows[x];
+		ndo2db_db_batch_reported_statements[x]=ndo2db_db_batch_statements[x];
+	        }
+
+	if(ndo2db_db_commits>0L){
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Transactions: %.1f commits/sec, %.1f events/transaction, %.2f ms average commit latency, %.2f ms max, %lu replays\n",(double)ndo2db_db_commits/elapsed,(double)ndo2db_db_committed_events/(double)ndo2db_db_commits,(double)ndo2db_db_commit_usec/(double)ndo2db_db_commits/1000.0,(double)ndo2db_db_max_commit_usec/1000.0,ndo2db_db_replays);
+		syslog(LOG_USER|LOG_INFO,"Transactions: %.1f commits/sec, %.1f events/transaction, %.2f ms average commit latency, %.2f ms max, %lu replays",(double)ndo2db_db_commits/elapsed,(double)ndo2db_db_committed_events/(double)ndo2db_db_commits,(double)ndo2db_db_commit_usec/(double)ndo2db_db_commits/1000.0,(double)ndo2db_db_max_commit_usec/1000.0,ndo2db_db_replays);
+		ndo2db_db_commits=0L;
+		ndo2db_db_committed_events=0L;
+		ndo2db_db_commit_usec=0L;
+		ndo2db_db_max_commit_usec=0L;
+		ndo2db_db_replays=0L;
+	        }
+
+	ndo2db_db_batch_report_time=current_time;
+
+	pthread_mutex_unlock(&ndo2db_db_batch_stats_lock);
+
+	return NDO_OK;
+        }
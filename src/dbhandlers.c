@@ -29,6 +29,10 @@
 #include "../include/ndo2db.h"
 #include "../include/db.h"
 #include "../include/dbhandlers.h"
+#include "../include/objectfile.h"
+#include "../include/configload.h"
+#include "../include/configdigest.h"
+#include "../include/metrics.h"
 
 #include <pthread.h>
 
@@ -54,6 +58,13 @@
 extern int errno;
 
 extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern ndo2db_dbconfig ndo2db_db_settings;
+extern int ndo2db_config_digests;
+extern char *ndo2db_object_cache_file;
+
+/* the object cache may be shared by partition writer threads */
+static pthread_mutex_t ndo2db_object_cache_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ndo2db_object_insert_lock=PTHREAD_MUTEX_INITIALIZER;
 
 
 
@@ -90,9 +101,20 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 	/* see if the object already exists in cached lookup table */
 	if(ndo2db_get_cached_object_id(idi,object_type,name1,name2,&cached_object_id)==NDO_OK){
 		*object_id=cached_object_id;
+		ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_OBJECTS,NDO_TRUE);
+		return NDO_OK;
+	        }
+
+	/* another process may have added it */
+	ndo2db_object_file_refresh(idi);
+	if(ndo2db_get_cached_object_id(idi,object_type,name1,name2,&cached_object_id)==NDO_OK){
+		*object_id=cached_object_id;
+		ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_OBJECTS,NDO_TRUE);
 		return NDO_OK;
 	        }
 
+	ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_OBJECTS,NDO_FALSE);
+
 	if(name1==NULL){
 		es[0]=NULL;
 		if(asprintf(&buf1,"name1 IS NULL")==-1)
@@ -132,7 +154,7 @@ int ndo2db_get_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, u
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
 		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],object_id);
 			found_object=NDO_TRUE;
@@ -180,9 +202,25 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 		return NDO_OK;
 	        }
 
-	/* object already exists */
-	if((result=ndo2db_get_object_id(idi,object_type,name1,name2,object_id))==NDO_OK)
+	/* object is already cached */
+	if(ndo2db_get_cached_object_id(idi,object_type,name1,name2,object_id)==NDO_OK){
+		ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_OBJECTS,NDO_TRUE);
+		return NDO_OK;
+	        }
+
+	/* object already exists (don't let two writers insert the same object) */
+	pthread_mutex_lock(&ndo2db_object_insert_lock);
+
+	/* another writer may have added it, uncommitted rows don't show up in the table */
+	if(ndo2db_get_cached_object_id(idi,object_type,name1,name2,object_id)==NDO_OK){
+		pthread_mutex_unlock(&ndo2db_object_insert_lock);
+		return NDO_OK;
+	        }
+
+	if((result=ndo2db_get_object_id(idi,object_type,name1,name2,object_id))==NDO_OK){
+		pthread_mutex_unlock(&ndo2db_object_insert_lock);
 		return NDO_OK;
+	        }
 
 	if(name1!=NULL){
 		es[0]=ndo2db_db_escape_string(idi,name1);
@@ -208,12 +246,18 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 		   )==-1)
 		buf=NULL;
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		*object_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		*object_id=ndo2db_db_insert_id(idi);
 	}
 	free(buf);
 
 	/* cache object id for later lookups */
 	ndo2db_add_cached_object_id(idi,object_type,name1,name2,*object_id);
+	if(result==NDO_OK){
+		ndo2db_remember_new_object(idi,object_type,name1,name2,*object_id);
+		ndo2db_object_file_append(idi,object_type,name1,name2,*object_id);
+		ndo2db_object_file_flush(idi);
+	        }
+	pthread_mutex_unlock(&ndo2db_object_insert_lock);
 
 	/* free memory */
 	free(buf1);
@@ -228,12 +272,320 @@ int ndo2db_get_object_id_with_insert(ndo2db_idi *idi, int object_type, char *n1,
 
 
 
+/* orders keys by name, so repeats and keys sharing a first name end up next to each other */
+static int ndo2db_compare_object_keys(const void *p1, const void *p2){
+	const ndo2db_object_key *key1=(const ndo2db_object_key *)p1;
+	const ndo2db_object_key *key2=(const ndo2db_object_key *)p2;
+	int result=0;
+
+	if((result=ndo2db_compare_object_hashdata(key1->name1,key1->name2,key2->name1,key2->name2))!=0)
+		return result;
+
+	return key1->object_type-key2->object_type;
+        }
+
+
+/* drops repeated keys and the ones we already have ids for, returns how many are left */
+static int ndo2db_uncached_object_keys(ndo2db_idi *idi, ndo2db_object_key *key, int keys){
+	unsigned long object_id=0L;
+	int x=0;
+	int y=0;
+
+	for(x=0;x<keys;x++){
+		if(key[x].name1==NULL && key[x].name2==NULL)
+			continue;
+		if(y>0 && key[y-1].object_type==key[x].object_type && ndo2db_compare_object_hashdata(key[y-1].name1,key[y-1].name2,key[x].name1,key[x].name2)==0)
+			continue;
+		if(ndo2db_get_cached_object_id(idi,key[x].object_type,key[x].name1,key[x].name2,&object_id)==NDO_OK)
+			continue;
+		key[y++]=key[x];
+	        }
+
+	return y;
+        }
+
+
+/* caches an object id read from the database, and hands new ones to the object cache file */
+static int ndo2db_learn_object_id(ndo2db_idi *idi, int object_type, char *name1, char *name2, unsigned long object_id){
+	unsigned long cached_object_id=0L;
+
+	if(ndo2db_get_cached_object_id(idi,object_type,name1,name2,&cached_object_id)==NDO_OK)
+		return NDO_OK;
+
+	if(ndo2db_add_cached_object_id(idi,object_type,name1,name2,object_id)==NDO_ERROR)
+		return NDO_ERROR;
+
+	return ndo2db_object_file_append(idi,object_type,name1,name2,object_id);
+        }
+
+
+/* caches the ids of any objects named by the (sorted) keys, a statement per batch_bytes worth of names */
+static int ndo2db_load_object_ids(ndo2db_idi *idi, ndo2db_object_key *key, int keys){
+	int result=NDO_OK;
+	ndo_dbuf names;
+	ndo_dbuf types;
+	unsigned int type_mask=0;
+	unsigned long object_id=0L;
+	int objecttype_id=0;
+	char *buf=NULL;
+	char *es=NULL;
+	int first=0;
+	int x=0;
+
+	for(first=0;first<keys && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&names,4096);
+		ndo_dbuf_init(&types,64);
+		type_mask=0;
+
+		for(x=first;x<keys && (x==first || names.used_size<ndo2db_db_settings.batch_bytes);x++){
+
+			if(key[x].object_type>=0 && key[x].object_type<32 && !(type_mask&(1U<<key[x].object_type))){
+				type_mask|=(1U<<key[x].object_type);
+				if(asprintf(&buf,"%s'%d'",(types.used_size==0)?"":",",key[x].object_type)==-1)
+					buf=NULL;
+				ndo_dbuf_strcat(&types,buf);
+				free(buf);
+			        }
+
+			/* a missing first name is stored as an empty one */
+			if(x>first && ndo2db_compare_object_hashdata(key[x-1].name1,NULL,key[x].name1,NULL)==0)
+				continue;
+			es=ndo2db_db_escape_string(idi,(key[x].name1==NULL)?"":key[x].name1);
+			if(asprintf(&buf,"%s'%s'",(x==first)?"":",",(es==NULL)?"":es)==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&names,buf);
+			free(buf);
+			free(es);
+		        }
+
+		/* no BINARY here, or the index couldn't be used - names that only differ in case are real objects too */
+		if(asprintf(&buf,"SELECT object_id, objecttype_id, name1, name2 FROM %s WHERE instance_id='%lu' AND objecttype_id IN (%s) AND name1 IN (%s)"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+			    ,idi->dbinfo.instance_id
+			    ,(types.buf==NULL)?"":types.buf
+			    ,(names.buf==NULL)?"":names.buf
+			   )==-1)
+			buf=NULL;
+
+		if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+			idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+			if(idi->dbinfo.mysql_result!=NULL){
+				while((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+					ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&object_id);
+					ndo2db_convert_string_to_int(idi->dbinfo.mysql_row[1],&objecttype_id);
+					ndo2db_learn_object_id(idi,objecttype_id,idi->dbinfo.mysql_row[2],idi->dbinfo.mysql_row[3],object_id);
+				        }
+				mysql_free_result(idi->dbinfo.mysql_result);
+			        }
+			idi->dbinfo.mysql_result=NULL;
+		        }
+		free(buf);
+
+		ndo_dbuf_free(&names);
+		ndo_dbuf_free(&types);
+	        }
+
+	return result;
+        }
+
+
+/* adds objects named by the keys to the database, a statement per batch_bytes worth of rows */
+static int ndo2db_insert_object_ids(ndo2db_idi *idi, ndo2db_object_key *key, int keys){
+	int result=NDO_OK;
+	ndo_dbuf dbuf;
+	char *buf=NULL;
+	char *es[2];
+	int first=0;
+	int x=0;
+
+	for(first=0;first<keys && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&dbuf,4096);
+
+		if(asprintf(&buf,"INSERT INTO %s (instance_id, objecttype_id, name1, name2) VALUES ",ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS])==-1)
+			buf=NULL;
+		ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+
+		for(x=first;x<keys && (x==first || dbuf.used_size<ndo2db_db_settings.batch_bytes);x++){
+
+			es[0]=ndo2db_db_escape_string(idi,(key[x].name1==NULL)?"":key[x].name1);
+			es[1]=ndo2db_db_escape_string(idi,key[x].name2);
+
+			if(es[1]==NULL){
+				if(asprintf(&buf,"%s('%lu','%d','%s',NULL)",(x==first)?"":",",idi->dbinfo.instance_id,key[x].object_type,(es[0]==NULL)?"":es[0])==-1)
+					buf=NULL;
+			        }
+			else{
+				if(asprintf(&buf,"%s('%lu','%d','%s','%s')",(x==first)?"":",",idi->dbinfo.instance_id,key[x].object_type,(es[0]==NULL)?"":es[0],es[1])==-1)
+					buf=NULL;
+			        }
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+			free(es[0]);
+			free(es[1]);
+		        }
+
+		/* a lone row's id needn't be read back */
+		if((result=ndo2db_db_query(idi,dbuf.buf))==NDO_OK && x==first+1)
+			ndo2db_learn_object_id(idi,key[first].object_type,key[first].name1,key[first].name2,ndo2db_db_insert_id(idi));
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	return result;
+        }
+
+
+/* finds the ids of many objects at once, adding the ones the database doesn't have yet */
+int ndo2db_get_object_ids_with_insert(ndo2db_idi *idi, ndo2db_object_key *key, int keys){
+	ndo2db_object_key *added=NULL;
+	unsigned long object_id=0L;
+	int result=NDO_OK;
+	int missing=0;
+	int unread=0;
+	int x=0;
+
+	if(idi==NULL || key==NULL || keys<=0)
+		return NDO_OK;
+
+	qsort(key,keys,sizeof(ndo2db_object_key),ndo2db_compare_object_keys);
+
+	if((keys=ndo2db_uncached_object_keys(idi,key,keys))==0)
+		return NDO_OK;
+
+	/* don't let two writers insert the same object */
+	pthread_mutex_lock(&ndo2db_object_insert_lock);
+
+	/* another process may have added some of them */
+	ndo2db_object_file_refresh(idi);
+	if((keys=ndo2db_uncached_object_keys(idi,key,keys))==0){
+		pthread_mutex_unlock(&ndo2db_object_insert_lock);
+		return NDO_OK;
+	        }
+
+	/* the table has no unique key to INSERT IGNORE against, so we look before we add */
+	if((result=ndo2db_load_object_ids(idi,key,keys))==NDO_OK && (missing=ndo2db_uncached_object_keys(idi,key,keys))>0){
+		/* reading the ids back reorders the keys, we want to remember all we added */
+		if((added=(ndo2db_object_key *)malloc(missing*sizeof(ndo2db_object_key)))!=NULL)
+			memcpy(added,key,missing*sizeof(ndo2db_object_key));
+		if((result=ndo2db_insert_object_ids(idi,key,missing))==NDO_OK && (unread=ndo2db_uncached_object_keys(idi,key,missing))>0)
+			result=ndo2db_load_object_ids(idi,key,unread);
+		for(x=0;added!=NULL && x<missing;x++){
+			if(ndo2db_get_cached_object_id(idi,added[x].object_type,added[x].name1,added[x].name2,&object_id)==NDO_OK)
+				ndo2db_remember_new_object(idi,added[x].object_type,added[x].name1,added[x].name2,object_id);
+		        }
+		free(added);
+	        }
+	ndo2db_object_file_flush(idi);
+
+	pthread_mutex_unlock(&ndo2db_object_insert_lock);
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Looked up %d objects at once, %d of them new\n",keys,missing);
+
+	return result;
+        }
+
+
+/* keeps an object added inside the open transaction, other rows and writers already use its id */
+int ndo2db_remember_new_object(ndo2db_idi *idi, int object_type, char *name1, char *name2, unsigned long object_id){
+	ndo2db_new_object *new_object=NULL;
+
+	if(idi==NULL || object_id==0L || ndo2db_db_transactions_enabled()==NDO_FALSE)
+		return NDO_OK;
+
+	if((new_object=(ndo2db_new_object *)malloc(sizeof(ndo2db_new_object)))==NULL)
+		return NDO_ERROR;
+	new_object->object_type=object_type;
+	new_object->name1=(name1==NULL)?NULL:strdup(name1);
+	new_object->name2=(name2==NULL)?NULL:strdup(name2);
+	new_object->object_id=object_id;
+	new_object->next=idi->dbinfo.new_objects;
+	idi->dbinfo.new_objects=new_object;
+
+	return NDO_OK;
+        }
+
+
+/* adds the objects of a lost transaction again, under the ids they were given the first time */
+int ndo2db_restore_new_objects(ndo2db_idi *idi){
+	ndo2db_new_object *new_object=NULL;
+	int result=NDO_OK;
+	char *buf=NULL;
+	char *es[2];
+	int restored=0;
+
+	if(idi==NULL || idi->dbinfo.new_objects_lost==NDO_FALSE)
+		return NDO_OK;
+
+	for(new_object=idi->dbinfo.new_objects;new_object!=NULL && result==NDO_OK;new_object=new_object->next){
+
+		es[0]=ndo2db_db_escape_string(idi,new_object->name1);
+		es[1]=ndo2db_db_escape_string(idi,new_object->name2);
+
+		/* the commit may have made it to the server after all */
+		if(asprintf(&buf,"INSERT INTO %s SET object_id='%lu', instance_id='%lu', objecttype_id='%d', name1=%s%s%s, name2=%s%s%s ON DUPLICATE KEY UPDATE object_id=object_id"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+			    ,new_object->object_id
+			    ,idi->dbinfo.instance_id
+			    ,new_object->object_type
+			    ,(es[0]==NULL)?"":"'",(es[0]==NULL)?"NULL":es[0],(es[0]==NULL)?"":"'"
+			    ,(es[1]==NULL)?"":"'",(es[1]==NULL)?"NULL":es[1],(es[1]==NULL)?"":"'"
+			   )==-1)
+			buf=NULL;
+		result=ndo2db_db_query(idi,buf);
+		free(buf);
+		free(es[0]);
+		free(es[1]);
+		restored++;
+	        }
+
+	if(result==NDO_OK){
+		idi->dbinfo.new_objects_lost=NDO_FALSE;
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Added %d objects of a lost transaction again\n",restored);
+	        }
+
+	return result;
+        }
+
+
+/* lets go of the objects added since the last commit, once they are safely in */
+int ndo2db_forget_new_objects(ndo2db_idi *idi){
+	ndo2db_new_object *new_object=NULL;
+	ndo2db_new_object *next_object=NULL;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	for(new_object=idi->dbinfo.new_objects;new_object!=NULL;new_object=next_object){
+		next_object=new_object->next;
+		free(new_object->name1);
+		free(new_object->name2);
+		free(new_object);
+	        }
+
+	idi->dbinfo.new_objects=NULL;
+	idi->dbinfo.new_objects_lost=NDO_FALSE;
+
+	return NDO_OK;
+        }
+
+
+
 int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 	int result=NDO_OK;
+	int rebuild=NDO_FALSE;
 	unsigned long object_id=0L;
 	int objecttype_id=0;
 	char *buf=NULL;
 
+	/* the object cache file saves reading the whole table if it's up to date */
+	if(ndo2db_object_cache_file!=NULL){
+		if(ndo2db_object_file_load(idi)==NDO_OK)
+			return NDO_OK;
+		rebuild=(ndo2db_object_file_rebuild_start(idi)==NDO_OK)?NDO_TRUE:NDO_FALSE;
+	        }
+
 	/* find all the object definitions we already have */
 	if(asprintf(&buf,"SELECT object_id, objecttype_id, name1, name2 FROM %s WHERE instance_id='%lu'"
 		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
@@ -242,8 +594,9 @@ int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 		buf=NULL;
 
 	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
 		if(NULL != idi->dbinfo.mysql_result) {
+			ndo2db_reserve_object_cache(idi,(unsigned long)mysql_num_rows(idi->dbinfo.mysql_result));
 			while((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
 
 				ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&object_id);
@@ -251,17 +604,24 @@ int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 
 				/* add object to cached list */
 				ndo2db_add_cached_object_id(idi,objecttype_id,idi->dbinfo.mysql_row[2],idi->dbinfo.mysql_row[3],object_id);
+				if(rebuild==NDO_TRUE)
+					ndo2db_object_file_rebuild_add(idi,objecttype_id,idi->dbinfo.mysql_row[2],idi->dbinfo.mysql_row[3],object_id);
 				}
 			mysql_free_result(idi->dbinfo.mysql_result);
 			}
-		else if(mysql_errno(&idi->dbinfo.mysql_conn) != 0) {
+		else if(mysql_errno(idi->dbinfo.mysql_conn) != 0) {
 			syslog(LOG_USER|LOG_INFO,
 					"Error: mysql_store_result() failed for '%s'\n", buf);
+			rebuild=NDO_ERROR;
 		}
 		idi->dbinfo.mysql_result=NULL;
 	}
 	free(buf);
 
+	/* a partial list mustn't be mistaken for the whole table */
+	if(rebuild!=NDO_FALSE)
+		ndo2db_object_file_rebuild_end(idi,(result==NDO_OK && rebuild==NDO_TRUE)?NDO_TRUE:NDO_FALSE);
+
 	return result;
         }
 
@@ -269,56 +629,130 @@ int ndo2db_get_cached_object_ids(ndo2db_idi *idi){
 
 int ndo2db_get_cached_object_id(ndo2db_idi *idi, int object_type, char *name1, char *name2, unsigned long *object_id){
 	int result=NDO_ERROR;
-	int hashslot=0;
-	int compare=0;
+	ndo2db_object_cache *cache=NULL;
 	ndo2db_dbobject *temp_object=NULL;
-	int y=0;
+	unsigned int hash=0;
+	unsigned long x=0L;
+	unsigned long y=0L;
 
-	hashslot=ndo2db_object_hashfunc(name1,name2,NDO2DB_OBJECT_HASHSLOTS);
+	hash=ndo2db_object_hash(object_type,name1,name2);
 #ifdef NDO2DB_DEBUG_CACHING
 	printf("OBJECT LOOKUP: type=%d, name1=%s, name2=%s\n",object_type,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
 #endif
 
-	if(idi->dbinfo.object_hashlist==NULL)
+	pthread_mutex_lock(&ndo2db_object_cache_lock);
+
+	if((cache=idi->dbinfo.object_cache)==NULL){
+		pthread_mutex_unlock(&ndo2db_object_cache_lock);
 		return NDO_ERROR;
+	        }
 
-	for(temp_object=idi->dbinfo.object_hashlist[hashslot],y=0;temp_object!=NULL;temp_object=temp_object->nexthash,y++){
+	/* the table is never full, so we always reach the object or an empty slot */
+	for(x=hash&(cache->slots-1),y=1;;x=(x+1)&(cache->slots-1),y++){
+		temp_object=&cache->slot[x];
+		if(temp_object->name1==NULL && temp_object->name2==NULL)
+			break;
+		if(temp_object->hash==hash && temp_object->object_type==object_type && ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2)==0){
 #ifdef NDO2DB_DEBUG_CACHING
-		printf("OBJECT LOOKUP LOOPING [%d][%d]: type=%d, id=%lu, name1=%s, name2=%s\n",hashslot,y,temp_object->object_type,temp_object->object_id,(temp_object->name1==NULL)?"NULL":temp_object->name1,(temp_object->name2==NULL)?"NULL":temp_object->name2);
+			printf("OBJECT CACHE HIT [%lu][%lu]: type=%d, id=%lu, name1=%s, name2=%s\n",x,y,object_type,temp_object->object_id,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
 #endif
-		compare=ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2);
-		if(compare==0 && temp_object->object_type==object_type)
+			*object_id=temp_object->object_id;
+			result=NDO_OK;
 			break;
+		        }
 	        }
 
-	/* we have a match! */
-	if(temp_object && (ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2)==0) && temp_object->object_type==object_type){
 #ifdef NDO2DB_DEBUG_CACHING
-		printf("OBJECT CACHE HIT [%d][%d]: type=%d, id=%lu, name1=%s, name2=%s\n",hashslot,y,object_type,temp_object->object_id,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
-#endif
-		*object_id=temp_object->object_id;
-		result=NDO_OK;
-	        }
-#ifdef NDO2DB_DEBUG_CACHING
-	else{
+	if(result==NDO_ERROR)
 		printf("OBJECT CACHE MISS: type=%d, name1=%s, name2=%s\n",object_type,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
-	        }
 #endif
+	cache->lookups++;
+	cache->probes+=y;
+
+	pthread_mutex_unlock(&ndo2db_object_cache_lock);
 
 	return result;
         }
 
 
 
+/* allocates the object cache if it doesn't exist yet */
+int ndo2db_init_object_cache(ndo2db_idi *idi){
+	int result=NDO_OK;
+	ndo2db_object_cache *cache=NULL;
+
+	pthread_mutex_lock(&ndo2db_object_cache_lock);
+
+	if(idi->dbinfo.object_cache==NULL){
+
+		if((cache=(ndo2db_object_cache *)calloc(1,sizeof(ndo2db_object_cache)))==NULL)
+			result=NDO_ERROR;
+		else if((cache->slot=(ndo2db_dbobject *)calloc(NDO2DB_OBJECT_HASHSLOTS,sizeof(ndo2db_dbobject)))==NULL){
+			free(cache);
+			result=NDO_ERROR;
+		        }
+		else{
+			cache->slots=NDO2DB_OBJECT_HASHSLOTS;
+			ndo_arena_init(&cache->names,65536L);
+			idi->dbinfo.object_cache=cache;
+		        }
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_cache_lock);
+
+	return result;
+        }
+
+
+/* doubles the object cache, called with the cache locked */
+static int ndo2db_grow_object_cache(ndo2db_object_cache *cache){
+	ndo2db_dbobject *new_slot=NULL;
+	unsigned long new_slots=0L;
+	unsigned long x=0L;
+	unsigned long y=0L;
+
+	new_slots=cache->slots*2;
+	if((new_slot=(ndo2db_dbobject *)calloc(new_slots,sizeof(ndo2db_dbobject)))==NULL)
+		return NDO_ERROR;
+
+	/* the hashes are kept, so moving an object doesn't look at its names */
+	for(x=0;x<cache->slots;x++){
+		if(cache->slot[x].name1==NULL && cache->slot[x].name2==NULL)
+			continue;
+		for(y=cache->slot[x].hash&(new_slots-1);new_slot[y].name1!=NULL || new_slot[y].name2!=NULL;y=(y+1)&(new_slots-1));
+		new_slot[y]=cache->slot[x];
+	        }
+
+	free(cache->slot);
+	cache->slot=new_slot;
+	cache->slots=new_slots;
+
+	return NDO_OK;
+        }
+
+
+/* makes room for this many objects up front, so filling the cache doesn't rehash it over and over */
+int ndo2db_reserve_object_cache(ndo2db_idi *idi, unsigned long objects){
+	int result=NDO_OK;
+
+	if(ndo2db_init_object_cache(idi)==NDO_ERROR)
+		return NDO_ERROR;
+
+	pthread_mutex_lock(&ndo2db_object_cache_lock);
+	while(result==NDO_OK && objects*2>idi->dbinfo.object_cache->slots)
+		result=ndo2db_grow_object_cache(idi->dbinfo.object_cache);
+	pthread_mutex_unlock(&ndo2db_object_cache_lock);
+
+	return result;
+        }
+
+
 int ndo2db_add_cached_object_id(ndo2db_idi *idi, int object_type, char *n1, char *n2, unsigned long object_id){
 	int result=NDO_OK;
+	ndo2db_object_cache *cache=NULL;
 	ndo2db_dbobject *temp_object=NULL;
-	ndo2db_dbobject *lastpointer=NULL;
-	ndo2db_dbobject *new_object=NULL;
-	int x=0;
-	int y=0;
-	int hashslot=0;
-	int compare=0;
+	unsigned int hash=0;
+	unsigned long x=0L;
 	char *name1=NULL;
 	char *name2=NULL;
 
@@ -335,174 +769,455 @@ int ndo2db_add_cached_object_id(ndo2db_idi *idi, int object_type, char *n1, char
 		return NDO_OK;
 	        }
 
-#ifdef NDO2DB_DEBUG_CACHING
-	printf("OBJECT CACHE ADD: type=%d, id=%lu, name1=%s, name2=%s\n",object_type,object_id,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
-#endif
-
-	/* initialize hash list if necessary */
-	if(idi->dbinfo.object_hashlist==NULL){
-
-		idi->dbinfo.object_hashlist=(ndo2db_dbobject **)malloc(sizeof(ndo2db_dbobject *)*NDO2DB_OBJECT_HASHSLOTS);
-		if(idi->dbinfo.object_hashlist==NULL)
-			return NDO_ERROR;
-
-		for(x=0;x<NDO2DB_OBJECT_HASHSLOTS;x++)
-			idi->dbinfo.object_hashlist[x]=NULL;
+#ifdef NDO2DB_DEBUG_CACHING
+	printf("OBJECT CACHE ADD: type=%d, id=%lu, name1=%s, name2=%s\n",object_type,object_id,(name1==NULL)?"NULL":name1,(name2==NULL)?"NULL":name2);
+#endif
+
+	/* initialize the cache if necessary */
+	if(ndo2db_init_object_cache(idi)==NDO_ERROR)
+		return NDO_ERROR;
+
+	hash=ndo2db_object_hash(object_type,name1,name2);
+
+	pthread_mutex_lock(&ndo2db_object_cache_lock);
+
+	cache=idi->dbinfo.object_cache;
+
+	/* keep probe sequences short - never more than half full */
+	if((cache->objects+1)*2>cache->slots && ndo2db_grow_object_cache(cache)==NDO_ERROR){
+		pthread_mutex_unlock(&ndo2db_object_cache_lock);
+		return NDO_ERROR;
+	        }
+
+	for(x=hash&(cache->slots-1);;x=(x+1)&(cache->slots-1)){
+		temp_object=&cache->slot[x];
+		if(temp_object->name1==NULL && temp_object->name2==NULL)
+			break;
+
+		/* the first id we learned for an object is the one we keep */
+		if(temp_object->hash==hash && temp_object->object_type==object_type && ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2)==0){
+			pthread_mutex_unlock(&ndo2db_object_cache_lock);
+			return NDO_OK;
+		        }
+	        }
+
+	temp_object->name1=(name1==NULL)?NULL:ndo_arena_strdup(&cache->names,name1);
+	temp_object->name2=(name2==NULL)?NULL:ndo_arena_strdup(&cache->names,name2);
+	if((name1!=NULL && temp_object->name1==NULL) || (name2!=NULL && temp_object->name2==NULL)){
+		temp_object->name1=NULL;
+		temp_object->name2=NULL;
+		result=NDO_ERROR;
+	        }
+	else{
+		temp_object->hash=hash;
+		temp_object->object_type=object_type;
+		temp_object->object_id=object_id;
+		cache->objects++;
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_cache_lock);
+
+	return result;
+        }
+
+
+
+/* FNV-1a over the type and both names, a byte that can't be in a name keeps ("ab","c") and ("a","bc") apart */
+unsigned int ndo2db_object_hash(int object_type, const char *name1, const char *name2){
+	register unsigned int result=2166136261U;
+	register const unsigned char *ptr=NULL;
+
+	result=(result^(unsigned int)(object_type&0xff))*16777619U;
+
+	if(name1){
+		for(ptr=(const unsigned char *)name1;*ptr;ptr++)
+			result=(result^*ptr)*16777619U;
+	        }
+	result=(result^0xffU)*16777619U;
+
+	if(name2){
+		for(ptr=(const unsigned char *)name2;*ptr;ptr++)
+			result=(result^*ptr)*16777619U;
+	        }
+
+	/* spread the last bytes into the low bits we use as the slot */
+	result^=result>>15;
+	result*=0x2c1b3c6dU;
+	result^=result>>12;
+
+	return result;
+        }
+
+
+
+int ndo2db_object_hashfunc(const char *name1,const char *name2,int hashslots){
+
+	return (int)(ndo2db_object_hash(0,name1,name2)%(unsigned int)hashslots);
+        }
+
+
+
+int ndo2db_compare_object_hashdata(const char *val1a, const char *val1b, const char *val2a, const char *val2b){
+	int result=0;
+
+	/* check first name */
+	if(val1a==NULL && val2a==NULL)
+		result=0;
+	else if(val1a==NULL)
+		result=1;
+	else if(val2a==NULL)
+		result=-1;
+	else
+		result=strcmp(val1a,val2a);
+
+	/* check second name if necessary */
+	if(result==0){
+		if(val1b==NULL && val2b==NULL)
+			result=0;
+		else if(val1b==NULL)
+			result=1;
+		else if(val2b==NULL)
+			result=-1;
+		else
+			return strcmp(val1b,val2b);
+	        }
+
+	return result;
+        }
+
+
+
+int ndo2db_free_cached_object_ids(ndo2db_idi *idi){
+	ndo2db_object_cache *cache=NULL;
+
+	if(idi==NULL)
+		return NDO_OK;
+
+	if((cache=idi->dbinfo.object_cache)!=NULL){
+
+		if(cache->lookups>0L)
+			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Object cache: %lu objects in %lu slots, %lu lookups, %.2f slots probed per lookup\n",cache->objects,cache->slots,cache->lookups,(double)cache->probes/(double)cache->lookups);
+
+		ndo2db_object_file_close(idi);
+		ndo_arena_free(&cache->names);
+		free(cache->slot);
+		free(cache);
+		idi->dbinfo.object_cache=NULL;
+	        }
+
+	return NDO_OK;
+        }
+
+
+
+/* starts over - the objects named from now until the config dump ends are the only active ones */
+int ndo2db_set_all_objects_as_inactive(ndo2db_idi *idi){
+
+	idi->active_objects.objects=0;
+	idi->active_objects.reconcile=NDO_TRUE;
+
+	return NDO_OK;
+         }
+
+
+
+/* remembers an active object, the table is updated when the config dump ends */
+int ndo2db_set_object_as_active(ndo2db_idi *idi, int object_type, unsigned long object_id){
+	ndo2db_active_objects *active=&idi->active_objects;
+	unsigned long *new_object_id=NULL;
+	int new_allocated=0;
+
+	if(object_id==0L)
+		return NDO_OK;
+
+	if(active->objects==active->allocated){
+		new_allocated=(active->allocated==0)?1024:active->allocated*2;
+		if((new_object_id=(unsigned long *)realloc(active->object_id,new_allocated*sizeof(unsigned long)))==NULL)
+			return NDO_ERROR;
+		active->object_id=new_object_id;
+		active->allocated=new_allocated;
+	        }
+	active->object_id[active->objects++]=object_id;
+
+	return NDO_OK;
+        }
+
+
+
+static int ndo2db_compare_object_ids(const void *p1, const void *p2){
+	unsigned long id1=*(const unsigned long *)p1;
+	unsigned long id2=*(const unsigned long *)p2;
+
+	return (id1<id2)?-1:(id1>id2)?1:0;
+        }
+
+
+/* sets is_active on a list of objects, a statement per batch_bytes worth of ids */
+static int ndo2db_update_active_objects(ndo2db_idi *idi, unsigned long *object_id, int objects, int is_active){
+	int result=NDO_OK;
+	ndo_dbuf dbuf;
+	char *buf=NULL;
+	int first=0;
+	int x=0;
+
+	for(first=0;first<objects && result==NDO_OK;first=x){
+
+		ndo_dbuf_init(&dbuf,4096);
+
+		if(asprintf(&buf,"UPDATE %s SET is_active='%d' WHERE instance_id='%lu' AND object_id IN (",ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS],is_active,idi->dbinfo.instance_id)==-1)
+			buf=NULL;
+		ndo_dbuf_strcat(&dbuf,buf);
+		free(buf);
+
+		for(x=first;x<objects && (x==first || dbuf.used_size<ndo2db_db_settings.batch_bytes);x++){
+			if(asprintf(&buf,"%s'%lu'",(x==first)?"":",",object_id[x])==-1)
+				buf=NULL;
+			ndo_dbuf_strcat(&dbuf,buf);
+			free(buf);
+		        }
+		ndo_dbuf_strcat(&dbuf,")");
+
+		result=ndo2db_db_query(idi,dbuf.buf);
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	return result;
+        }
+
+
+/* brings is_active in the objects table in line with the objects we were told about, touching only the rows that change */
+int ndo2db_save_active_objects(ndo2db_idi *idi){
+	ndo2db_active_objects *active=&idi->active_objects;
+	unsigned long *current=NULL;
+	unsigned long *changed=NULL;
+	unsigned long object_id=0L;
+	int currents=0;
+	int allocated=0;
+	int activated=0;
+	int deactivated=0;
+	int result=NDO_OK;
+	char *buf=NULL;
+	int x=0;
+	int y=0;
+
+	if(idi==NULL || (active->objects==0 && active->reconcile==NDO_FALSE))
+		return NDO_OK;
+
+	/* sort and drop duplicates */
+	qsort(active->object_id,active->objects,sizeof(unsigned long),ndo2db_compare_object_ids);
+	for(x=0,y=0;x<active->objects;x++){
+		if(y>0 && active->object_id[y-1]==active->object_id[x])
+			continue;
+		active->object_id[y++]=active->object_id[x];
+	        }
+	active->objects=y;
+
+	/* what the table says is active now */
+	if(asprintf(&buf,"SELECT object_id FROM %s WHERE instance_id='%lu' AND is_active='1'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+		    ,idi->dbinfo.instance_id
+		   )==-1)
+		buf=NULL;
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		if(idi->dbinfo.mysql_result!=NULL){
+			allocated=(int)mysql_num_rows(idi->dbinfo.mysql_result)+1;
+			if((current=(unsigned long *)malloc(allocated*sizeof(unsigned long)))==NULL)
+				result=NDO_ERROR;
+			while(result==NDO_OK && currents<allocated && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+				ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&object_id);
+				current[currents++]=object_id;
+			        }
+			mysql_free_result(idi->dbinfo.mysql_result);
+		        }
+		else if(mysql_errno(idi->dbinfo.mysql_conn)!=0)
+			result=NDO_ERROR;
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+
+	/* keep what we have for another try */
+	if(result==NDO_ERROR || (changed=(unsigned long *)malloc((active->objects+currents+1)*sizeof(unsigned long)))==NULL){
+		free(current);
+		return NDO_ERROR;
+	        }
+	qsort(current,currents,sizeof(unsigned long),ndo2db_compare_object_ids);
+
+	/* objects that are no longer active */
+	if(active->reconcile==NDO_TRUE){
+		for(x=0,y=0;x<currents;x++){
+			while(y<active->objects && active->object_id[y]<current[x])
+				y++;
+			if(y==active->objects || active->object_id[y]!=current[x])
+				changed[deactivated++]=current[x];
+		        }
+		result=ndo2db_update_active_objects(idi,changed,deactivated,0);
 	        }
 
-	/* allocate and populate new object */
-	if((new_object=(ndo2db_dbobject *)malloc(sizeof(ndo2db_dbobject)))==NULL)
-		return NDO_ERROR;
-	new_object->object_type=object_type;
-	new_object->object_id=object_id;
-	new_object->name1=NULL;
-	if(name1)
-		new_object->name1=strdup(name1);
-	new_object->name2=NULL;
-	if(name2)
-		new_object->name2=strdup(name2);
-
-	hashslot=ndo2db_object_hashfunc(new_object->name1,new_object->name2,NDO2DB_OBJECT_HASHSLOTS);
-
-	lastpointer=NULL;
-	for(temp_object=idi->dbinfo.object_hashlist[hashslot],y=0;temp_object!=NULL;temp_object=temp_object->nexthash,y++){
-		compare=ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,new_object->name1,new_object->name2);
-		if(compare<0)
-			break;
-		lastpointer=temp_object;
+	/* objects that have become active */
+	for(x=0,y=0;x<active->objects;x++){
+		while(y<currents && current[y]<active->object_id[x])
+			y++;
+		if(y==currents || current[y]!=active->object_id[x])
+			changed[activated++]=active->object_id[x];
 	        }
+	if(result==NDO_OK)
+		result=ndo2db_update_active_objects(idi,changed,activated,1);
 
-	if(lastpointer)
-		lastpointer->nexthash=new_object;
-	else
-		idi->dbinfo.object_hashlist[hashslot]=new_object;
-	new_object->nexthash=temp_object;
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Active objects: %d listed, %d were active, %d activated, %d deactivated\n",active->objects,currents,activated,deactivated);
 
-	return result;
-        }
+	free(current);
+	free(changed);
 
+	active->objects=0;
+	active->reconcile=NDO_FALSE;
 
+	return result;
+        }
 
-int ndo2db_object_hashfunc(const char *name1,const char *name2,int hashslots){
-	unsigned int i,result;
 
-	result=0;
-	if(name1)
-		for(i=0;i<strlen(name1);i++)
-			result+=name1[i];
+int ndo2db_free_active_objects(ndo2db_idi *idi){
 
-	if(name2)
-		for(i=0;i<strlen(name2);i++)
-			result+=name2[i];
+	if(idi==NULL)
+		return NDO_OK;
 
-	result=result%hashslots;
+	free(idi->active_objects.object_id);
+	idi->active_objects.object_id=NULL;
+	idi->active_objects.objects=0;
+	idi->active_objects.allocated=0;
+	idi->active_objects.reconcile=NDO_FALSE;
 
-	return result;
+	return NDO_OK;
         }
 
 
 
-int ndo2db_compare_object_hashdata(const char *val1a, const char *val1b, const char *val2a, const char *val2b){
-	int result=0;
+/****************************************************************************/
+/* ARCHIVED LOG DATA HANDLER                                                */
+/****************************************************************************/
 
-	/* check first name */
-	if(val1a==NULL && val2a==NULL)
-		result=0;
-	else if(val1a==NULL)
-		result=1;
-	else if(val2a==NULL)
-		result=-1;
-	else
-		result=strcmp(val1a,val2a);
+/* FNV-1a over a log entry's text as the database keeps it, never zero */
+/* (rows stored before the digests only have their first NDO2DB_LOGENTRY_DATA_SIZE bytes to hash) */
+static unsigned long long ndo2db_get_logentry_digest(const char *data){
+	register unsigned long long result=14695981039346656037ULL;
+	register const unsigned char *ptr=NULL;
+	register int x=0;
 
-	/* check second name if necessary */
-	if(result==0){
-		if(val1b==NULL && val2b==NULL)
-			result=0;
-		else if(val1b==NULL)
-			result=1;
-		else if(val2b==NULL)
-			result=-1;
-		else
-			return strcmp(val1b,val2b);
-	        }
+	for(ptr=(const unsigned char *)data;ptr!=NULL && *ptr && x<NDO2DB_LOGENTRY_DATA_SIZE;ptr++,x++)
+		result=(result^*ptr)*1099511628211ULL;
 
-	return result;
+	return (result==0ULL)?1ULL:result;
         }
 
 
+/* doubles the log entry window */
+static int ndo2db_grow_logentry_window(ndo2db_logentry_window *window){
+	ndo2db_logentry_digest *new_slot=NULL;
+	unsigned long new_slots=0L;
+	unsigned long x=0L;
+	unsigned long y=0L;
 
-int ndo2db_free_cached_object_ids(ndo2db_idi *idi){
-	int x=0;
-	ndo2db_dbobject *temp_object=NULL;
-	ndo2db_dbobject *next_object=NULL;
-
-	if(idi==NULL)
-		return NDO_OK;
-
-	if(idi->dbinfo.object_hashlist){
-
-		for(x=0;x<NDO2DB_OBJECT_HASHSLOTS;x++){
-			for(temp_object=idi->dbinfo.object_hashlist[x];temp_object!=NULL;temp_object=next_object){
-				next_object=temp_object->nexthash;
-				free(temp_object->name1);
-				free(temp_object->name2);
-				free(temp_object);
-			        }
-		        }
+	new_slots=(window->slots==0L)?NDO2DB_LOGENTRY_HASHSLOTS:window->slots*2;
+	if((new_slot=(ndo2db_logentry_digest *)calloc(new_slots,sizeof(ndo2db_logentry_digest)))==NULL)
+		return NDO_ERROR;
 
-		free(idi->dbinfo.object_hashlist);
-		idi->dbinfo.object_hashlist=NULL;
+	for(x=0;x<window->slots;x++){
+		if(window->slot[x].digest==0ULL)
+			continue;
+		for(y=(window->slot[x].digest^(unsigned long long)window->slot[x].logentry_time)&(new_slots-1);new_slot[y].digest!=0ULL;y=(y+1)&(new_slots-1));
+		new_slot[y]=window->slot[x];
 	        }
 
+	free(window->slot);
+	window->slot=new_slot;
+	window->slots=new_slots;
+
 	return NDO_OK;
         }
 
 
+/* records a stored log entry, returns NDO_FALSE if the window already had it */
+static int ndo2db_add_logentry_digest(ndo2db_idi *idi, time_t etime, unsigned long long digest){
+	ndo2db_logentry_window *window=&idi->dbinfo.logentry_window;
+	unsigned long x=0L;
 
-int ndo2db_set_all_objects_as_inactive(ndo2db_idi *idi){
-	int result=NDO_OK;
-	char *buf=NULL;
+	/* entries outside the window are left to the next one that covers them */
+	if(etime<window->start_time || etime>=window->end_time)
+		return NDO_TRUE;
 
-	/* mark all objects as being inactive */
-	if(asprintf(&buf,"UPDATE %s SET is_active='0' WHERE instance_id='%lu'"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
-		    ,idi->dbinfo.instance_id
-		   )==-1)
-		buf=NULL;
+	if((window->entries+1)*2>window->slots && ndo2db_grow_logentry_window(window)==NDO_ERROR)
+		return NDO_TRUE;
 
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+	for(x=(digest^(unsigned long long)etime)&(window->slots-1);window->slot[x].digest!=0ULL;x=(x+1)&(window->slots-1)){
+		if(window->slot[x].digest==digest && window->slot[x].logentry_time==etime)
+			return NDO_FALSE;
+	        }
 
-	return result;
-         }
+	window->slot[x].logentry_time=etime;
+	window->slot[x].digest=digest;
+	window->entries++;
 
+	return NDO_TRUE;
+        }
 
 
-int ndo2db_set_object_as_active(ndo2db_idi *idi, int object_type, unsigned long object_id){
-	int result=NDO_OK;
+/* reads the digests of the log entries stored around a time, replacing the ones read last */
+static int ndo2db_load_logentry_window(ndo2db_idi *idi, time_t etime){
+	ndo2db_logentry_window *window=&idi->dbinfo.logentry_window;
+	unsigned long long digest=0ULL;
+	unsigned long stored_time=0L;
 	char *buf=NULL;
+	int result=NDO_OK;
 
-	/* mark the object as being active */
-	if(asprintf(&buf,"UPDATE %s SET is_active='1' WHERE instance_id='%lu' AND objecttype_id='%d' AND object_id='%lu'"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+	/* entries still waiting in the batch wouldn't be found */
+	ndo2db_db_flush_batch(idi,NDO2DB_DBTABLE_LOGENTRIES);
+
+	ndo2db_free_logentry_window(idi);
+
+	if(asprintf(&buf,"SELECT UNIX_TIMESTAMP(logentry_time), logentry_digest, IF(logentry_digest=0,logentry_data,NULL) FROM %s WHERE instance_id='%lu' AND logentry_time>=FROM_UNIXTIME(%lu) AND logentry_time<FROM_UNIXTIME(%lu)"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_LOGENTRIES]
 		    ,idi->dbinfo.instance_id
-		    ,object_type
-		    ,object_id
+		    ,(unsigned long)(etime-(etime%NDO2DB_LOGENTRY_WINDOW))
+		    ,(unsigned long)(etime-(etime%NDO2DB_LOGENTRY_WINDOW)+NDO2DB_LOGENTRY_WINDOW)
 		   )==-1)
 		buf=NULL;
 
-	result=ndo2db_db_query(idi,buf);
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		window->start_time=etime-(etime%NDO2DB_LOGENTRY_WINDOW);
+		window->end_time=window->start_time+NDO2DB_LOGENTRY_WINDOW;
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		while(idi->dbinfo.mysql_result!=NULL && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&stored_time);
+			digest=(idi->dbinfo.mysql_row[1]==NULL)?0ULL:strtoull(idi->dbinfo.mysql_row[1],NULL,10);
+			/* entries stored before the digests were */
+			if(digest==0ULL)
+				digest=ndo2db_get_logentry_digest(idi->dbinfo.mysql_row[2]);
+			ndo2db_add_logentry_digest(idi,(time_t)stored_time,digest);
+		        }
+		mysql_free_result(idi->dbinfo.mysql_result);
+		idi->dbinfo.mysql_result=NULL;
+	        }
 	free(buf);
 
 	return result;
         }
 
 
+int ndo2db_free_logentry_window(ndo2db_idi *idi){
+
+	if(idi==NULL)
+		return NDO_OK;
+
+	free(idi->dbinfo.logentry_window.slot);
+	idi->dbinfo.logentry_window.slot=NULL;
+	idi->dbinfo.logentry_window.slots=0L;
+	idi->dbinfo.logentry_window.entries=0L;
+	idi->dbinfo.logentry_window.start_time=(time_t)0L;
+	idi->dbinfo.logentry_window.end_time=(time_t)0L;
+
+	return NDO_OK;
+        }
 
-/****************************************************************************/
-/* ARCHIVED LOG DATA HANDLER                                                */
-/****************************************************************************/
 
 int ndo2db_handle_logentry(ndo2db_idi *idi){
 	char *ptr=NULL;
@@ -511,29 +1226,29 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 	time_t etime=0L;
 	char *ts[1];
 	unsigned long type=0L;
+	unsigned long long digest=0ULL;
 	int result=NDO_OK;
-	int duplicate_record=NDO_FALSE;
 	int len=0;
 	int x=0;
+	char *saveptr=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
 
 	/* break log entry in pieces */
-	if((ptr=strtok(idi->buffered_input[NDO_DATA_LOGENTRY],"]"))==NULL)
+	if((ptr=strtok_r(idi->buffered_input[NDO_DATA_LOGENTRY],"]",&saveptr))==NULL)
 		return NDO_ERROR;
 	if((ndo2db_convert_string_to_unsignedlong(ptr+1,(unsigned long *)&etime))==NDO_ERROR)
 		return NDO_ERROR;
-	ts[0]=ndo2db_db_timet_to_sql(idi,etime);
-	if((ptr=strtok(NULL,"\x0"))==NULL)
+	if((ptr=strtok_r(NULL,"\x0",&saveptr))==NULL)
 		return NDO_ERROR;
-	es[0]=ndo2db_db_escape_string(idi,(ptr+1));
+	ptr++;
 
 	/* strip newline chars from end */
-	len=strlen(es[0]);
+	len=strlen(ptr);
 	for(x=len-1;x>=0;x--){
-		if(es[0][x]=='\n')
-			es[0][x]='\x0';
+		if(ptr[x]=='\n')
+			ptr[x]='\x0';
 		else
 			break;
 	        }
@@ -542,42 +1257,34 @@ int ndo2db_handle_logentry(ndo2db_idi *idi){
 	type=0;
 
 	/* make sure we aren't importing a duplicate log entry... */
-	if(asprintf(&buf,"SELECT * FROM %s WHERE instance_id='%lu' AND logentry_time=%s AND logentry_data='%s'"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_LOGENTRIES]
-		    ,idi->dbinfo.instance_id
-		    ,ts[0]
-		    ,es[0]
-		   )==-1)
-		buf=NULL;
-	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
-		idi->dbinfo.mysql_result=mysql_store_result(&idi->dbinfo.mysql_conn);
-		if((idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL)
-			duplicate_record=NDO_TRUE;
-		mysql_free_result(idi->dbinfo.mysql_result);
-		idi->dbinfo.mysql_result=NULL;
-	}
-	free(buf);
-
-	/*if(duplicate_record==NDO_TRUE && idi->last_logentry_time!=etime){*/
-	/*if(duplicate_record==NDO_TRUE && strcmp((es[0]==NULL)?"":es[0],idi->dbinfo.last_logentry_data)){*/
-	if(duplicate_record==NDO_TRUE){
+	digest=ndo2db_get_logentry_digest(ptr);
+	if(etime<idi->dbinfo.logentry_window.start_time || etime>=idi->dbinfo.logentry_window.end_time)
+		ndo2db_load_logentry_window(idi,etime);
+	if(ndo2db_add_logentry_digest(idi,etime,digest)==NDO_FALSE){
 #ifdef NDO2DB_DEBUG
 		printf("IGNORING DUPLICATE LOG RECORD!\n");
 #endif
 		return NDO_OK;
 	        }
 
-	/* save entry to db */
-	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', logentry_time=%s, entry_time=%s, entry_time_usec='0', logentry_type='%lu', logentry_data='%s', realtime_data='0', inferred_data_extracted='0'"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_LOGENTRIES]
+	ts[0]=ndo2db_db_timet_to_sql(idi,etime);
+	es[0]=ndo2db_db_escape_string(idi,ptr);
+
+	/* queue the entry, it is written with other archived entries */
+	if(asprintf(&buf,"('%lu',%s,%s,'0','%lu','%s','0','0','%llu')"
 		    ,idi->dbinfo.instance_id
 		    ,ts[0]
 		    ,ts[0]
 		    ,type
 		    ,(es[0]==NULL)?"":es[0]
+		    ,digest
 		   )==-1)
 		buf=NULL;
-	result=ndo2db_db_query(idi,buf);
+	result=ndo2db_db_batch_add(idi,NDO2DB_DBTABLE_LOGENTRIES
+		    ,"instance_id, logentry_time, entry_time, entry_time_usec, logentry_type, logentry_data, realtime_data, inferred_data_extracted, logentry_digest"
+		    ,NULL
+		    ,buf
+		   );
 	free(buf);
 
 	/* record timestamp of last log entry */
@@ -666,38 +1373,42 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 		/* clear config data */
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGFILES]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONFIGFILEVARIABLES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_COMMANDS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODTIMERANGES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPMEMBERS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPMEMBERS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPMEMBERS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTDEPENDENCIES]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEDEPENDENCIES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTADDRESSES]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTPARENTHOSTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICES]);
-#ifdef BUILD_NAGIOS_4X
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEPARENTSERVICES]);
-#endif
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTGROUPS]);
-		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTGROUPS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS]);
 		ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS]);
 
+		/* definitions with digests are brought up to date by the config dump instead */
+		if(ndo2db_config_digests==NDO_FALSE){
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CUSTOMVARIABLES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_COMMANDS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODTIMERANGES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPMEMBERS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTADDRESSES]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTPARENTHOSTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICES]);
+#ifdef BUILD_NAGIOS_4X
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEPARENTSERVICES]);
+#endif
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTGROUPS]);
+			ndo2db_db_clear_table(idi,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTGROUPS]);
+		        }
+
 		/* flag all objects as being inactive */
 		ndo2db_set_all_objects_as_inactive(idi);
 
@@ -717,6 +1428,10 @@ int ndo2db_handle_processdata(ndo2db_idi *idi){
 #endif
 	        }
 
+	/* the config dumps are over, in case they were turned off and only the active object lists were sent */
+	if(type==NEBTYPE_PROCESS_EVENTLOOPSTART)
+		ndo2db_save_active_objects(idi);
+
 	/* if process is shutting down or restarting, update process status data */
 	if((type==NEBTYPE_PROCESS_SHUTDOWN || type==NEBTYPE_PROCESS_RESTART) && tstamp.tv_sec>=idi->dbinfo.latest_realtime_data_time){
 
@@ -945,6 +1660,8 @@ int ndo2db_handle_logdata(ndo2db_idi *idi){
 	char *ts[2];
 	char *es[1];
 	char *buf=NULL;
+	char *ptr=NULL;
+	unsigned long long digest=0ULL;
 	int len=0;
 	int x=0;
 
@@ -961,26 +1678,32 @@ int ndo2db_handle_logdata(ndo2db_idi *idi){
 	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 	ts[1]=ndo2db_db_timet_to_sql(idi,etime);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LOGENTRY]);
-
 	/* strip newline chars from end */
-	len=strlen(es[0]);
+	ptr=idi->buffered_input[NDO_DATA_LOGENTRY];
+	len=(ptr==NULL)?0:strlen(ptr);
 	for(x=len-1;x>=0;x--){
-		if(es[0][x]=='\n')
-			es[0][x]='\x0';
+		if(ptr[x]=='\n')
+			ptr[x]='\x0';
 		else
 			break;
 	        }
 
+	es[0]=ndo2db_db_escape_string(idi,ptr);
+
+	/* archived copies of the entry will be duplicates */
+	digest=ndo2db_get_logentry_digest(ptr);
+	ndo2db_add_logentry_digest(idi,etime,digest);
+
 	/* save entry to db */
-	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', logentry_time=%s, entry_time=%s, entry_time_usec='%lu', logentry_type='%lu', logentry_data='%s', realtime_data='1', inferred_data_extracted='1'"
+	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', logentry_time=%s, entry_time=%s, entry_time_usec='%lu', logentry_type='%lu', logentry_data='%s', realtime_data='1', inferred_data_extracted='1', logentry_digest='%llu'"
 		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_LOGENTRIES]
 		    ,idi->dbinfo.instance_id
 		    ,ts[1]
 		    ,ts[0]
 		    ,tstamp.tv_usec
 		    ,letype
-		    ,es[0]
+		    ,(es[0]==NULL)?"":es[0]
+		    ,digest
 		   )==-1)
 		buf=NULL;
 	result=ndo2db_db_query(idi,buf);
@@ -1182,6 +1905,7 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	int escalated=0;
 	int contacts_notified=0;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 	char *ts[2];
 	char *es[2];
 	int x=0;
@@ -1204,60 +1928,84 @@ int ndo2db_handle_notificationdata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
-
 	/* get the object id */
 	if(notification_type==SERVICE_NOTIFICATION)
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	if(notification_type==HOST_NOTIFICATION)
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
-	/* save entry to db */
-	if(asprintf(&buf,"instance_id='%lu', notification_type='%d', notification_reason='%d', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', object_id='%lu', state='%d', output='%s', long_output='%s', escalated='%d', contacts_notified='%d'"
-		    ,idi->dbinfo.instance_id
-		    ,notification_type
-		    ,notification_reason
-		    ,ts[0]
-		    ,start_time.tv_usec
-		    ,ts[1]
-		    ,end_time.tv_usec
-		    ,object_id
-		    ,state
-		    ,es[0]
-		    ,es[1]
-		    ,escalated
-		    ,contacts_notified
-		   )==-1)
-		buf=NULL;
+	/* bind the values straight to a prepared statement if we can */
+	if((stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_NOTIFICATIONS
+		    ,"instance_id, notification_type, notification_reason, start_time, start_time_usec, end_time, end_time_usec, object_id, state, output, long_output, escalated, contacts_notified"
+		    ,"?,?,?,FROM_UNIXTIME(?),?,FROM_UNIXTIME(?),?,?,?,?,?,?,?"
+		    ,"instance_id, notification_type, notification_reason, start_time, start_time_usec, end_time, end_time_usec, object_id, state, output, long_output, escalated, contacts_notified"
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,notification_type);
+		ndo2db_db_stmt_bind_int(stmt,notification_reason);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,object_id);
+		ndo2db_db_stmt_bind_int(stmt,state);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_OUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_OUTPUT]);
+		ndo2db_db_stmt_bind_int(stmt,escalated);
+		ndo2db_db_stmt_bind_int(stmt,contacts_notified);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
+		es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_NOTIFICATIONS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
+		ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
+		ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
-	/* run the query */
-	result=ndo2db_db_query(idi,buf1);
+		/* save entry to db */
+		if(asprintf(&buf,"instance_id='%lu', notification_type='%d', notification_reason='%d', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', object_id='%lu', state='%d', output='%s', long_output='%s', escalated='%d', contacts_notified='%d'"
+			    ,idi->dbinfo.instance_id
+			    ,notification_type
+			    ,notification_reason
+			    ,ts[0]
+			    ,start_time.tv_usec
+			    ,ts[1]
+			    ,end_time.tv_usec
+			    ,object_id
+			    ,state
+			    ,es[0]
+			    ,es[1]
+			    ,escalated
+			    ,contacts_notified
+			   )==-1)
+			buf=NULL;
+
+		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_NOTIFICATIONS]
+			    ,buf
+			    ,buf
+			   )==-1)
+			buf1=NULL;
+
+		/* run the query */
+		result=ndo2db_db_query(idi,buf1);
+
+		free(buf);
+		free(buf1);
+
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
+			free(es[x]);
+	        }
 
 	/* save the notification id for later use... */
 	if(type==NEBTYPE_NOTIFICATION_START)
 		idi->dbinfo.last_notification_id=0L;
 	if(result==NDO_OK && type==NEBTYPE_NOTIFICATION_START){
-		idi->dbinfo.last_notification_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.last_notification_id=ndo2db_db_insert_id(idi);
 	}
-	free(buf);
-	free(buf1);
-
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
 
 	return NDO_OK;
         }
@@ -1270,6 +2018,7 @@ int ndo2db_handle_contactnotificationdata(ndo2db_idi *idi){
 	struct timeval start_time;
 	struct timeval end_time;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 	char *ts[2];
 	int x=0;
 	char *buf=NULL;
@@ -1286,46 +2035,64 @@ int ndo2db_handle_contactnotificationdata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
 
-	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
-
 	/* get the contact id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL,&contact_id);
 
-	/* save entry to db */
-	if(asprintf(&buf,"instance_id='%lu', notification_id='%lu', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', contact_object_id='%lu'"
-		    ,idi->dbinfo.instance_id
-		    ,idi->dbinfo.last_notification_id
-		    ,ts[0]
-		    ,start_time.tv_usec
-		    ,ts[1]
-		    ,end_time.tv_usec
-		    ,contact_id
-		   )==-1)
-		buf=NULL;
+	/* bind the values straight to a prepared statement if we can */
+	if((stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_CONTACTNOTIFICATIONS
+		    ,"instance_id, notification_id, start_time, start_time_usec, end_time, end_time_usec, contact_object_id"
+		    ,"?,?,FROM_UNIXTIME(?),?,FROM_UNIXTIME(?),?,?"
+		    ,"instance_id, notification_id, start_time, start_time_usec, end_time, end_time_usec, contact_object_id"
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.last_notification_id);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,contact_id);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
+		ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
+		/* save entry to db */
+		if(asprintf(&buf,"instance_id='%lu', notification_id='%lu', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', contact_object_id='%lu'"
+			    ,idi->dbinfo.instance_id
+			    ,idi->dbinfo.last_notification_id
+			    ,ts[0]
+			    ,start_time.tv_usec
+			    ,ts[1]
+			    ,end_time.tv_usec
+			    ,contact_id
+			   )==-1)
+			buf=NULL;
 
-	/* run the query */
-	result=ndo2db_db_query(idi,buf1);
+		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONS]
+			    ,buf
+			    ,buf
+			   )==-1)
+			buf1=NULL;
+
+		/* run the query */
+		result=ndo2db_db_query(idi,buf1);
+
+		free(buf);
+		free(buf1);
+
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+	        }
 
 	/* save the contact notification id for later use... */
 	if(type==NEBTYPE_CONTACTNOTIFICATION_START)
 		idi->dbinfo.last_contact_notification_id=0L;
 	if(result==NDO_OK && type==NEBTYPE_CONTACTNOTIFICATION_START){
-		idi->dbinfo.last_contact_notification_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		idi->dbinfo.last_contact_notification_id=ndo2db_db_insert_id(idi);
 	}
-	free(buf);
-	free(buf1);
-
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
 
 	return NDO_OK;
         }
@@ -1338,6 +2105,7 @@ int ndo2db_handle_contactnotificationmethoddata(ndo2db_idi *idi){
 	struct timeval start_time;
 	struct timeval end_time;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 	char *ts[2];
 	char *es[1];
 	int x=0;
@@ -1355,45 +2123,62 @@ int ndo2db_handle_contactnotificationmethoddata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
-
-
 	/* get the command id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,idi->buffered_input[NDO_DATA_COMMANDNAME],NULL,&command_id);
 
-	/* save entry to db */
-	if(asprintf(&buf,"instance_id='%lu', contactnotification_id='%lu', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', command_object_id='%lu', command_args='%s'"
-		    ,idi->dbinfo.instance_id
-		    ,idi->dbinfo.last_contact_notification_id
-		    ,ts[0]
-		    ,start_time.tv_usec
-		    ,ts[1]
-		    ,end_time.tv_usec
-		    ,command_id
-		    ,es[0]
-		   )==-1)
-		buf=NULL;
+	/* bind the values straight to a prepared statement if we can */
+	if((stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS
+		    ,"instance_id, contactnotification_id, start_time, start_time_usec, end_time, end_time_usec, command_object_id, command_args"
+		    ,"?,?,FROM_UNIXTIME(?),?,FROM_UNIXTIME(?),?,?,?"
+		    ,"instance_id, contactnotification_id, start_time, start_time_usec, end_time, end_time_usec, command_object_id, command_args"
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.last_contact_notification_id);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,command_id);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+
+		ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
+		ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
+
+		/* save entry to db */
+		if(asprintf(&buf,"instance_id='%lu', contactnotification_id='%lu', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', command_object_id='%lu', command_args='%s'"
+			    ,idi->dbinfo.instance_id
+			    ,idi->dbinfo.last_contact_notification_id
+			    ,ts[0]
+			    ,start_time.tv_usec
+			    ,ts[1]
+			    ,end_time.tv_usec
+			    ,command_id
+			    ,es[0]
+			   )==-1)
+			buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
+		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONMETHODS]
+			    ,buf
+			    ,buf
+			   )==-1)
+			buf1=NULL;
 
-	/* run the query */
-	result=ndo2db_db_query(idi,buf1);
-	free(buf);
-	free(buf1);
+		/* run the query */
+		result=ndo2db_db_query(idi,buf1);
+		free(buf);
+		free(buf1);
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
+			free(es[x]);
+	        }
 
 	return NDO_OK;
         }
@@ -1418,10 +2203,10 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 	int return_code=0;
 	unsigned long object_id=0L;
 	unsigned long command_id=0L;
-	char *buf=NULL;
 	char *buf1=NULL;
 	int x=0;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -1453,15 +2238,6 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
-
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 
@@ -1471,49 +2247,87 @@ int ndo2db_handle_servicecheckdata(ndo2db_idi *idi){
 	else
 		command_id=0L;
 
-	/* save entry to db */
-	if(asprintf(&buf1,"instance_id='%lu', service_object_id='%lu', check_type='%d', current_check_attempt='%d', max_check_attempts='%d', state='%d', state_type='%d', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', timeout='%d', early_timeout='%d', execution_time='%lf', latency='%lf', return_code='%d', output='%s', long_output='%s', perfdata='%s'"
-		    ,idi->dbinfo.instance_id
-		    ,object_id
-		    ,check_type
-		    ,current_check_attempt
-		    ,max_check_attempts
-		    ,state
-		    ,state_type
-		    ,ts[0]
-		    ,start_time.tv_usec
-		    ,ts[1]
-		    ,end_time.tv_usec
-		    ,timeout
-		    ,early_timeout
-		    ,execution_time
-		    ,latency
-		    ,return_code
-		    ,es[2]
-		    ,es[3]
-		    ,es[4]
-		   )==-1)
-		buf1=NULL;
+	/* batched rows are written as text, others go straight to a prepared statement */
+	if(ndo2db_db_settings.batch_rows<=1 && (stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_SERVICECHECKS
+		    ,"instance_id, service_object_id, check_type, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata, command_object_id, command_args, command_line"
+		    ,"?,?,?,?,?,?,?,FROM_UNIXTIME(?),?,FROM_UNIXTIME(?),?,?,?,?,?,?,?,?,?,?,?,?"
+		    ,"instance_id, service_object_id, check_type, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata"
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,object_id);
+		ndo2db_db_stmt_bind_int(stmt,check_type);
+		ndo2db_db_stmt_bind_int(stmt,current_check_attempt);
+		ndo2db_db_stmt_bind_int(stmt,max_check_attempts);
+		ndo2db_db_stmt_bind_int(stmt,state);
+		ndo2db_db_stmt_bind_int(stmt,state_type);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,timeout);
+		ndo2db_db_stmt_bind_int(stmt,early_timeout);
+		ndo2db_db_stmt_bind_double(stmt,execution_time);
+		ndo2db_db_stmt_bind_double(stmt,latency);
+		ndo2db_db_stmt_bind_int(stmt,return_code);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_OUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_PERFDATA]);
+		ndo2db_db_stmt_bind_int(stmt,command_id);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_COMMANDLINE]);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+		es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
+		es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
+		es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+		es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s, command_object_id='%lu', command_args='%s', command_line='%s' ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECHECKS]
-		    ,buf1
-		    ,command_id
-		    ,es[0]
-		    ,es[1]
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+		ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
+		ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
+		/* save entry to db */
+		if(asprintf(&buf1,"('%lu','%lu','%d','%d','%d','%d','%d',%s,'%lu',%s,'%lu','%d','%d','%lf','%lf','%d','%s','%s','%s','%lu','%s','%s')"
+			    ,idi->dbinfo.instance_id
+			    ,object_id
+			    ,check_type
+			    ,current_check_attempt
+			    ,max_check_attempts
+			    ,state
+			    ,state_type
+			    ,ts[0]
+			    ,start_time.tv_usec
+			    ,ts[1]
+			    ,end_time.tv_usec
+			    ,timeout
+			    ,early_timeout
+			    ,execution_time
+			    ,latency
+			    ,return_code
+			    ,es[2]
+			    ,es[3]
+			    ,es[4]
+			    ,command_id
+			    ,es[0]
+			    ,es[1]
+			   )==-1)
+			buf1=NULL;
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		/* queue the row, it is written with other rows for this table */
+		result=ndo2db_db_batch_add(idi,NDO2DB_DBTABLE_SERVICECHECKS
+			    ,"instance_id, service_object_id, check_type, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata, command_object_id, command_args, command_line"
+			    ,"instance_id, service_object_id, check_type, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata"
+			    ,buf1
+			   );
+		free(buf1);
+
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
+			free(es[x]);
+	        }
 
 	return NDO_OK;
         }
@@ -1539,10 +2353,10 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 	int return_code=0;
 	unsigned long object_id=0L;
 	unsigned long command_id=0L;
-	char *buf=NULL;
 	char *buf1=NULL;
 	int x=0;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -1576,15 +2390,6 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_STARTTIME],&start_time);
 	result=ndo2db_convert_string_to_timeval(idi->buffered_input[NDO_DATA_ENDTIME],&end_time);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
-
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
@@ -1600,50 +2405,89 @@ int ndo2db_handle_hostcheckdata(ndo2db_idi *idi){
 	else
 		is_raw_check=0;
 
-	/* save entry to db */
-	if(asprintf(&buf1,"instance_id='%lu', host_object_id='%lu', check_type='%d', is_raw_check='%d', current_check_attempt='%d', max_check_attempts='%d', state='%d', state_type='%d', start_time=%s, start_time_usec='%lu', end_time=%s, end_time_usec='%lu', timeout='%d', early_timeout='%d', execution_time='%lf', latency='%lf', return_code='%d', output='%s', long_output='%s', perfdata='%s'"
-		    ,idi->dbinfo.instance_id
-		    ,object_id
-		    ,check_type
-		    ,is_raw_check
-		    ,current_check_attempt
-		    ,max_check_attempts
-		    ,state
-		    ,state_type
-		    ,ts[0]
-		    ,start_time.tv_usec
-		    ,ts[1]
-		    ,end_time.tv_usec
-		    ,timeout
-		    ,early_timeout
-		    ,execution_time
-		    ,latency
-		    ,return_code
-		    ,es[2]
-		    ,es[3]
-		    ,es[4]
-		   )==-1)
-		buf1=NULL;
+	/* batched rows are written as text, others go straight to a prepared statement */
+	if(ndo2db_db_settings.batch_rows<=1 && (stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_HOSTCHECKS
+		    ,"instance_id, host_object_id, check_type, is_raw_check, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata, command_object_id, command_args, command_line"
+		    ,"?,?,?,?,?,?,?,?,FROM_UNIXTIME(?),?,FROM_UNIXTIME(?),?,?,?,?,?,?,?,?,?,?,?,?"
+		    ,"instance_id, host_object_id, check_type, is_raw_check, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata"
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,object_id);
+		ndo2db_db_stmt_bind_int(stmt,check_type);
+		ndo2db_db_stmt_bind_int(stmt,is_raw_check);
+		ndo2db_db_stmt_bind_int(stmt,current_check_attempt);
+		ndo2db_db_stmt_bind_int(stmt,max_check_attempts);
+		ndo2db_db_stmt_bind_int(stmt,state);
+		ndo2db_db_stmt_bind_int(stmt,state_type);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,start_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,end_time.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,timeout);
+		ndo2db_db_stmt_bind_int(stmt,early_timeout);
+		ndo2db_db_stmt_bind_double(stmt,execution_time);
+		ndo2db_db_stmt_bind_double(stmt,latency);
+		ndo2db_db_stmt_bind_int(stmt,return_code);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_OUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_PERFDATA]);
+		ndo2db_db_stmt_bind_int(stmt,command_id);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_COMMANDLINE]);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDARGS]);
+		es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_COMMANDLINE]);
+		es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
+		es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+		es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
 
-	if(asprintf(&buf,"INSERT INTO %s SET %s, command_object_id='%lu', command_args='%s', command_line='%s' ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCHECKS]
-		    ,buf1
-		    ,command_id
-		    ,es[0]
-		    ,es[1]
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+		ts[0]=ndo2db_db_timet_to_sql(idi,start_time.tv_sec);
+		ts[1]=ndo2db_db_timet_to_sql(idi,end_time.tv_sec);
 
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
+		/* save entry to db */
+		if(asprintf(&buf1,"('%lu','%lu','%d','%d','%d','%d','%d','%d',%s,'%lu',%s,'%lu','%d','%d','%lf','%lf','%d','%s','%s','%s','%lu','%s','%s')"
+			    ,idi->dbinfo.instance_id
+			    ,object_id
+			    ,check_type
+			    ,is_raw_check
+			    ,current_check_attempt
+			    ,max_check_attempts
+			    ,state
+			    ,state_type
+			    ,ts[0]
+			    ,start_time.tv_usec
+			    ,ts[1]
+			    ,end_time.tv_usec
+			    ,timeout
+			    ,early_timeout
+			    ,execution_time
+			    ,latency
+			    ,return_code
+			    ,es[2]
+			    ,es[3]
+			    ,es[4]
+			    ,command_id
+			    ,es[0]
+			    ,es[1]
+			   )==-1)
+			buf1=NULL;
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		/* queue the row, it is written with other rows for this table */
+		result=ndo2db_db_batch_add(idi,NDO2DB_DBTABLE_HOSTCHECKS
+			    ,"instance_id, host_object_id, check_type, is_raw_check, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata, command_object_id, command_args, command_line"
+			    ,"instance_id, host_object_id, check_type, is_raw_check, current_check_attempt, max_check_attempts, state, state_type, start_time, start_time_usec, end_time, end_time_usec, timeout, early_timeout, execution_time, latency, return_code, output, long_output, perfdata"
+			    ,buf1
+			   );
+		free(buf1);
+
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
+			free(es[x]);
+	        }
 
 	return NDO_OK;
         }
@@ -2090,32 +2934,45 @@ int ndo2db_handle_flappingdata(ndo2db_idi *idi){
         }
 
 
+/* argument indexes of the status rows */
+#define NDO2DB_STATUSARG_INSTANCE               0
+#define NDO2DB_STATUSARG_OBJECT                 1
+#define NDO2DB_STATUSARG_UPDATETIME             2
+#define NDO2DB_STATUSARG_TIMEPERIOD             3	/* host and service status */
+#define NDO2DB_STATUSARG_RUNNING                3	/* program status */
+
+static const ndo2db_dbfield ndo2db_programstatus_fields[]={
+	{"instance_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_INSTANCE},
+	{"status_update_time",NDO2DB_FIELD_ARGTIME,NDO2DB_STATUSARG_UPDATETIME},
+	{"program_start_time",NDO2DB_FIELD_TIME,NDO_DATA_PROGRAMSTARTTIME},
+	{"is_currently_running",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_RUNNING},
+	{"process_id",NDO2DB_FIELD_ULONG,NDO_DATA_PROCESSID},
+	{"daemon_mode",NDO2DB_FIELD_INT,NDO_DATA_DAEMONMODE},
+	{"last_command_check",NDO2DB_FIELD_TIME,NDO_DATA_LASTCOMMANDCHECK},
+	{"last_log_rotation",NDO2DB_FIELD_TIME,NDO_DATA_LASTLOGROTATION},
+	{"notifications_enabled",NDO2DB_FIELD_INT,NDO_DATA_NOTIFICATIONSENABLED},
+	{"active_service_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_ACTIVESERVICECHECKSENABLED},
+	{"passive_service_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_PASSIVESERVICECHECKSENABLED},
+	{"active_host_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_ACTIVEHOSTCHECKSENABLED},
+	{"passive_host_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_PASSIVEHOSTCHECKSENABLED},
+	{"event_handlers_enabled",NDO2DB_FIELD_INT,NDO_DATA_EVENTHANDLERSENABLED},
+	{"flap_detection_enabled",NDO2DB_FIELD_INT,NDO_DATA_FLAPDETECTIONENABLED},
+	{"failure_prediction_enabled",NDO2DB_FIELD_INT,NDO_DATA_FAILUREPREDICTIONENABLED},
+	{"process_performance_data",NDO2DB_FIELD_INT,NDO_DATA_PROCESSPERFORMANCEDATA},
+	{"obsess_over_hosts",NDO2DB_FIELD_INT,NDO_DATA_OBSESSOVERHOSTS},
+	{"obsess_over_services",NDO2DB_FIELD_INT,NDO_DATA_OBSESSOVERSERVICES},
+	{"modified_host_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDHOSTATTRIBUTES},
+	{"modified_service_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDSERVICEATTRIBUTES},
+	{"global_host_event_handler",NDO2DB_FIELD_STRING,NDO_DATA_GLOBALHOSTEVENTHANDLER},
+	{"global_service_event_handler",NDO2DB_FIELD_STRING,NDO_DATA_GLOBALSERVICEEVENTHANDLER}
+        };
+
+static ndo2db_dbrow ndo2db_programstatus_row=NDO2DB_DBROW(NDO2DB_DBTABLE_PROGRAMSTATUS,ndo2db_programstatus_fields);
+
 int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
-	int x = 0;
 	int type,flags,attr;
 	struct timeval tstamp;
-	unsigned long program_start_time=0L;
-	unsigned long process_id=0L;
-	int daemon_mode=0;
-	unsigned long last_command_check=0L;
-	unsigned long last_log_rotation=0L;
-	int notifications_enabled=0;
-	int active_service_checks_enabled=0;
-	int passive_service_checks_enabled=0;
-	int active_host_checks_enabled=0;
-	int passive_host_checks_enabled=0;
-	int event_handlers_enabled=0;
-	int flap_detection_enabled=0;
-	int failure_prediction_enabled=0;
-	int process_performance_data=0;
-	int obsess_over_hosts=0;
-	int obsess_over_services=0;
-	unsigned long modified_host_attributes=0L;
-	unsigned long modified_service_attributes=0L;
-	char *ts[4];
-	char *es[2];
-	char *buf=NULL;
-	char *buf1=NULL;
+	unsigned long args[4];
 	int result=NDO_OK;
 
 	if(idi==NULL)
@@ -2128,329 +2985,163 @@ int ndo2db_handle_programstatusdata(ndo2db_idi *idi){
 	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_PROGRAMSTARTTIME],&program_start_time);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_PROCESSID],&process_id);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_DAEMONMODE],&daemon_mode);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTCOMMANDCHECK],&last_command_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTLOGROTATION],&last_log_rotation);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVESERVICECHECKSENABLED],&active_service_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVESERVICECHECKSENABLED],&passive_service_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEHOSTCHECKSENABLED],&active_host_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVEHOSTCHECKSENABLED],&passive_host_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERSENABLED],&event_handlers_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERHOSTS],&obsess_over_hosts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERSERVICES],&obsess_over_services);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALHOSTEVENTHANDLER]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_GLOBALSERVICEEVENTHANDLER]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,program_start_time);
-	ts[2]=ndo2db_db_timet_to_sql(idi,last_command_check);
-	ts[3]=ndo2db_db_timet_to_sql(idi,last_log_rotation);
-
-	/* generate query string */
-	if(asprintf(&buf1,"instance_id='%lu', status_update_time=%s, program_start_time=%s, is_currently_running='1', process_id='%lu', daemon_mode='%d', last_command_check=%s, last_log_rotation=%s, notifications_enabled='%d', active_service_checks_enabled='%d', passive_service_checks_enabled='%d', active_host_checks_enabled='%d', passive_host_checks_enabled='%d', event_handlers_enabled='%d', flap_detection_enabled='%d', failure_prediction_enabled='%d', process_performance_data='%d', obsess_over_hosts='%d', obsess_over_services='%d', modified_host_attributes='%lu', modified_service_attributes='%lu', global_host_event_handler='%s', global_service_event_handler='%s'"
-		    ,idi->dbinfo.instance_id
-		    ,ts[0]
-		    ,ts[1]
-		    ,process_id
-		    ,daemon_mode
-		    ,ts[2]
-		    ,ts[3]
-		    ,notifications_enabled
-		    ,active_service_checks_enabled
-		    ,passive_service_checks_enabled
-		    ,active_host_checks_enabled
-		    ,passive_host_checks_enabled
-		    ,event_handlers_enabled
-		    ,flap_detection_enabled
-		    ,failure_prediction_enabled
-		    ,process_performance_data
-		    ,obsess_over_hosts
-		    ,obsess_over_services
-		    ,modified_host_attributes
-		    ,modified_service_attributes
-		    ,es[0]
-		    ,es[1]
-		   )==-1)
-		buf1=NULL;
-
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_PROGRAMSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+	args[NDO2DB_STATUSARG_INSTANCE]=idi->dbinfo.instance_id;
+	args[NDO2DB_STATUSARG_UPDATETIME]=tstamp.tv_sec;
+	args[NDO2DB_STATUSARG_RUNNING]=1L;
 
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
-
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+	result=ndo2db_db_write_row(idi,&ndo2db_programstatus_row,args);
 
 	return NDO_OK;
         }
 
 
+static const ndo2db_dbfield ndo2db_hoststatus_fields[]={
+	{"instance_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_INSTANCE},
+	{"host_object_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_OBJECT},
+	{"status_update_time",NDO2DB_FIELD_ARGTIME,NDO2DB_STATUSARG_UPDATETIME},
+	{"output",NDO2DB_FIELD_STRING,NDO_DATA_OUTPUT},
+	{"long_output",NDO2DB_FIELD_STRING,NDO_DATA_LONGOUTPUT},
+	{"perfdata",NDO2DB_FIELD_STRING,NDO_DATA_PERFDATA},
+	{"current_state",NDO2DB_FIELD_INT,NDO_DATA_CURRENTSTATE},
+	{"has_been_checked",NDO2DB_FIELD_INT,NDO_DATA_HASBEENCHECKED},
+	{"should_be_scheduled",NDO2DB_FIELD_INT,NDO_DATA_SHOULDBESCHEDULED},
+	{"current_check_attempt",NDO2DB_FIELD_INT,NDO_DATA_CURRENTCHECKATTEMPT},
+	{"max_check_attempts",NDO2DB_FIELD_INT,NDO_DATA_MAXCHECKATTEMPTS},
+	{"last_check",NDO2DB_FIELD_TIME,NDO_DATA_LASTHOSTCHECK},
+	{"next_check",NDO2DB_FIELD_TIME,NDO_DATA_NEXTHOSTCHECK},
+	{"check_type",NDO2DB_FIELD_INT,NDO_DATA_CHECKTYPE},
+	{"last_state_change",NDO2DB_FIELD_TIME,NDO_DATA_LASTSTATECHANGE},
+	{"last_hard_state_change",NDO2DB_FIELD_TIME,NDO_DATA_LASTHARDSTATECHANGE},
+	{"last_hard_state",NDO2DB_FIELD_INT,NDO_DATA_LASTHARDSTATE},
+	{"last_time_up",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEUP},
+	{"last_time_down",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEDOWN},
+	{"last_time_unreachable",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEUNREACHABLE},
+	{"state_type",NDO2DB_FIELD_INT,NDO_DATA_STATETYPE},
+	{"last_notification",NDO2DB_FIELD_TIME,NDO_DATA_LASTHOSTNOTIFICATION},
+	{"next_notification",NDO2DB_FIELD_TIME,NDO_DATA_NEXTHOSTNOTIFICATION},
+	{"no_more_notifications",NDO2DB_FIELD_INT,NDO_DATA_NOMORENOTIFICATIONS},
+	{"notifications_enabled",NDO2DB_FIELD_INT,NDO_DATA_NOTIFICATIONSENABLED},
+	{"problem_has_been_acknowledged",NDO2DB_FIELD_INT,NDO_DATA_PROBLEMHASBEENACKNOWLEDGED},
+	{"acknowledgement_type",NDO2DB_FIELD_INT,NDO_DATA_ACKNOWLEDGEMENTTYPE},
+	{"current_notification_number",NDO2DB_FIELD_INT,NDO_DATA_CURRENTNOTIFICATIONNUMBER},
+	{"passive_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_PASSIVEHOSTCHECKSENABLED},
+	{"active_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_ACTIVEHOSTCHECKSENABLED},
+	{"event_handler_enabled",NDO2DB_FIELD_INT,NDO_DATA_EVENTHANDLERENABLED},
+	{"flap_detection_enabled",NDO2DB_FIELD_INT,NDO_DATA_FLAPDETECTIONENABLED},
+	{"is_flapping",NDO2DB_FIELD_INT,NDO_DATA_ISFLAPPING},
+	{"percent_state_change",NDO2DB_FIELD_DOUBLE,NDO_DATA_PERCENTSTATECHANGE},
+	{"latency",NDO2DB_FIELD_DOUBLE,NDO_DATA_LATENCY},
+	{"execution_time",NDO2DB_FIELD_DOUBLE,NDO_DATA_EXECUTIONTIME},
+	{"scheduled_downtime_depth",NDO2DB_FIELD_INT,NDO_DATA_SCHEDULEDDOWNTIMEDEPTH},
+	{"failure_prediction_enabled",NDO2DB_FIELD_INT,NDO_DATA_FAILUREPREDICTIONENABLED},
+	{"process_performance_data",NDO2DB_FIELD_INT,NDO_DATA_PROCESSPERFORMANCEDATA},
+	{"obsess_over_host",NDO2DB_FIELD_INT,NDO_DATA_OBSESSOVERHOST},
+	{"modified_host_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDHOSTATTRIBUTES},
+	{"event_handler",NDO2DB_FIELD_STRING,NDO_DATA_EVENTHANDLER},
+	{"check_command",NDO2DB_FIELD_STRING,NDO_DATA_CHECKCOMMAND},
+	{"normal_check_interval",NDO2DB_FIELD_DOUBLE,NDO_DATA_NORMALCHECKINTERVAL},
+	{"retry_check_interval",NDO2DB_FIELD_DOUBLE,NDO_DATA_RETRYCHECKINTERVAL},
+	{"check_timeperiod_object_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_TIMEPERIOD}
+        };
+
+static ndo2db_dbrow ndo2db_hoststatus_row=NDO2DB_DBROW(NDO2DB_DBTABLE_HOSTSTATUS,ndo2db_hoststatus_fields);
+
 int ndo2db_handle_hoststatusdata(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
-	unsigned long last_check=0L;
-	unsigned long next_check=0L;
-	unsigned long last_state_change=0L;
-	unsigned long last_hard_state_change=0L;
-	unsigned long last_time_up=0L;
-	unsigned long last_time_down=0L;
-	unsigned long last_time_unreachable=0L;
-	unsigned long last_notification=0L;
-	unsigned long next_notification=0L;
-	unsigned long modified_host_attributes=0L;
-	double percent_state_change=0.0;
-	double latency=0.0;
-	double execution_time=0.0;
-	int current_state=0;
-	int has_been_checked=0;
-	int should_be_scheduled=0;
-	int current_check_attempt=0;
-	int max_check_attempts=0;
-	int check_type=0;
-	int last_hard_state=0;
-	int state_type=0;
-	int no_more_notifications=0;
-	int notifications_enabled=0;
-	int problem_has_been_acknowledged=0;
-	int acknowledgement_type=0;
-	int current_notification_number=0;
-	int passive_checks_enabled=0;
-	int active_checks_enabled=0;
-	int event_handler_enabled;
-	int flap_detection_enabled=0;
-	int is_flapping=0;
-	int scheduled_downtime_depth=0;
-	int failure_prediction_enabled=0;
-	int process_performance_data;
-	int obsess_over_host=0;
-	double normal_check_interval=0.0;
-	double retry_check_interval=0.0;
-	char *ts[10];
-	char *es[5];
-	char *buf=NULL;
-	char *buf1=NULL;
+	unsigned long args[4];
 	unsigned long object_id=0L;
 	unsigned long check_timeperiod_object_id=0L;
-	int x=0;
 	int result=NDO_OK;
 
 	if(idi==NULL)
 		return NDO_ERROR;
 
-	/* convert timestamp, etc */
-	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
-
-	/* don't store old data */
-	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
-		return NDO_OK;
-
-	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTCHECK],&last_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTHOSTCHECK],&next_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSTATECHANGE],&last_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHARDSTATECHANGE],&last_hard_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUP],&last_time_up);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEDOWN],&last_time_down);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUNREACHABLE],&last_time_unreachable);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTNOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTHOSTNOTIFICATION],&next_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTSTATE],&current_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HASBEENCHECKED],&has_been_checked);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SHOULDBESCHEDULED],&should_be_scheduled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOMORENOTIFICATIONS],&no_more_notifications);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROBLEMHASBEENACKNOWLEDGED],&problem_has_been_acknowledged);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACKNOWLEDGEMENTTYPE],&acknowledgement_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTNOTIFICATIONNUMBER],&current_notification_number);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVEHOSTCHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEHOSTCHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ISFLAPPING],&is_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SCHEDULEDDOWNTIMEDEPTH],&scheduled_downtime_depth);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERHOST],&obsess_over_host);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NORMALCHECKINTERVAL],&normal_check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_RETRYCHECKINTERVAL],&retry_check_interval);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,last_check);
-	ts[2]=ndo2db_db_timet_to_sql(idi,next_check);
-	ts[3]=ndo2db_db_timet_to_sql(idi,last_state_change);
-	ts[4]=ndo2db_db_timet_to_sql(idi,last_hard_state_change);
-	ts[5]=ndo2db_db_timet_to_sql(idi,last_time_up);
-	ts[6]=ndo2db_db_timet_to_sql(idi,last_time_down);
-	ts[7]=ndo2db_db_timet_to_sql(idi,last_time_unreachable);
-	ts[8]=ndo2db_db_timet_to_sql(idi,last_notification);
-	ts[9]=ndo2db_db_timet_to_sql(idi,next_notification);
-
-	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_HOSTCHECKPERIOD],NULL,&check_timeperiod_object_id);
-
-	/* generate query string */
-	if(asprintf(&buf1,"instance_id='%lu', host_object_id='%lu', status_update_time=%s, output='%s', long_output='%s', perfdata='%s', current_state='%d', has_been_checked='%d', should_be_scheduled='%d', current_check_attempt='%d', max_check_attempts='%d', last_check=%s, next_check=%s, check_type='%d', last_state_change=%s, last_hard_state_change=%s, last_hard_state='%d', last_time_up=%s, last_time_down=%s, last_time_unreachable=%s, state_type='%d', last_notification=%s, next_notification=%s, no_more_notifications='%d', notifications_enabled='%d', problem_has_been_acknowledged='%d', acknowledgement_type='%d', current_notification_number='%d', passive_checks_enabled='%d', active_checks_enabled='%d', event_handler_enabled='%d', flap_detection_enabled='%d', is_flapping='%d', percent_state_change='%lf', latency='%lf', execution_time='%lf', scheduled_downtime_depth='%d', failure_prediction_enabled='%d', process_performance_data='%d', obsess_over_host='%d', modified_host_attributes='%lu', event_handler='%s', check_command='%s', normal_check_interval='%lf', retry_check_interval='%lf', check_timeperiod_object_id='%lu'"
-		    ,idi->dbinfo.instance_id
-		    ,object_id
-		    ,ts[0]
-		    ,es[0]
-		    ,es[1]
-		    ,es[2]
-		    ,current_state
-		    ,has_been_checked
-		    ,should_be_scheduled
-		    ,current_check_attempt
-		    ,max_check_attempts
-		    ,ts[1]
-		    ,ts[2]
-		    ,check_type
-		    ,ts[3]
-		    ,ts[4]
-		    ,last_hard_state
-		    ,ts[5]
-		    ,ts[6]
-		    ,ts[7]
-		    ,state_type
-		    ,ts[8]
-		    ,ts[9]
-		    ,no_more_notifications
-		    ,notifications_enabled
-		    ,problem_has_been_acknowledged
-		    ,acknowledgement_type
-		    ,current_notification_number
-		    ,passive_checks_enabled
-		    ,active_checks_enabled
-		    ,event_handler_enabled
-		    ,flap_detection_enabled
-		    ,is_flapping
-		    ,percent_state_change
-		    ,latency
-		    ,execution_time
-		    ,scheduled_downtime_depth
-		    ,failure_prediction_enabled
-		    ,process_performance_data
-		    ,obsess_over_host
-		    ,modified_host_attributes
-		    ,es[3]
-		    ,es[4]
-		    ,normal_check_interval
-		    ,retry_check_interval
-		    ,check_timeperiod_object_id
-		   )==-1)
-		buf1=NULL;
-
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+	/* convert timestamp, etc */
+	result=ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp);
 
-	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
+	/* don't store old data */
+	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
+		return NDO_OK;
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+	/* get the object id */
+	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
+	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_HOSTCHECKPERIOD],NULL,&check_timeperiod_object_id);
 
-	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts[0]);
+	args[NDO2DB_STATUSARG_INSTANCE]=idi->dbinfo.instance_id;
+	args[NDO2DB_STATUSARG_OBJECT]=object_id;
+	args[NDO2DB_STATUSARG_UPDATETIME]=tstamp.tv_sec;
+	args[NDO2DB_STATUSARG_TIMEPERIOD]=check_timeperiod_object_id;
 
+	/* save entry to db */
+	result=ndo2db_db_write_row(idi,&ndo2db_hoststatus_row,args);
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
+	/* save custom variables to db */
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,tstamp.tv_sec);
 
 	return NDO_OK;
         }
 
 
+static const ndo2db_dbfield ndo2db_servicestatus_fields[]={
+	{"instance_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_INSTANCE},
+	{"service_object_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_OBJECT},
+	{"status_update_time",NDO2DB_FIELD_ARGTIME,NDO2DB_STATUSARG_UPDATETIME},
+	{"output",NDO2DB_FIELD_STRING,NDO_DATA_OUTPUT},
+	{"long_output",NDO2DB_FIELD_STRING,NDO_DATA_LONGOUTPUT},
+	{"perfdata",NDO2DB_FIELD_STRING,NDO_DATA_PERFDATA},
+	{"current_state",NDO2DB_FIELD_INT,NDO_DATA_CURRENTSTATE},
+	{"has_been_checked",NDO2DB_FIELD_INT,NDO_DATA_HASBEENCHECKED},
+	{"should_be_scheduled",NDO2DB_FIELD_INT,NDO_DATA_SHOULDBESCHEDULED},
+	{"current_check_attempt",NDO2DB_FIELD_INT,NDO_DATA_CURRENTCHECKATTEMPT},
+	{"max_check_attempts",NDO2DB_FIELD_INT,NDO_DATA_MAXCHECKATTEMPTS},
+	{"last_check",NDO2DB_FIELD_TIME,NDO_DATA_LASTSERVICECHECK},
+	{"next_check",NDO2DB_FIELD_TIME,NDO_DATA_NEXTSERVICECHECK},
+	{"check_type",NDO2DB_FIELD_INT,NDO_DATA_CHECKTYPE},
+	{"last_state_change",NDO2DB_FIELD_TIME,NDO_DATA_LASTSTATECHANGE},
+	{"last_hard_state_change",NDO2DB_FIELD_TIME,NDO_DATA_LASTHARDSTATECHANGE},
+	{"last_hard_state",NDO2DB_FIELD_INT,NDO_DATA_LASTHARDSTATE},
+	{"last_time_ok",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEOK},
+	{"last_time_warning",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEWARNING},
+	{"last_time_unknown",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMEUNKNOWN},
+	{"last_time_critical",NDO2DB_FIELD_TIME,NDO_DATA_LASTTIMECRITICAL},
+	{"state_type",NDO2DB_FIELD_INT,NDO_DATA_STATETYPE},
+	{"last_notification",NDO2DB_FIELD_TIME,NDO_DATA_LASTSERVICENOTIFICATION},
+	{"next_notification",NDO2DB_FIELD_TIME,NDO_DATA_NEXTSERVICENOTIFICATION},
+	{"no_more_notifications",NDO2DB_FIELD_INT,NDO_DATA_NOMORENOTIFICATIONS},
+	{"notifications_enabled",NDO2DB_FIELD_INT,NDO_DATA_NOTIFICATIONSENABLED},
+	{"problem_has_been_acknowledged",NDO2DB_FIELD_INT,NDO_DATA_PROBLEMHASBEENACKNOWLEDGED},
+	{"acknowledgement_type",NDO2DB_FIELD_INT,NDO_DATA_ACKNOWLEDGEMENTTYPE},
+	{"current_notification_number",NDO2DB_FIELD_INT,NDO_DATA_CURRENTNOTIFICATIONNUMBER},
+	{"passive_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_PASSIVESERVICECHECKSENABLED},
+	{"active_checks_enabled",NDO2DB_FIELD_INT,NDO_DATA_ACTIVESERVICECHECKSENABLED},
+	{"event_handler_enabled",NDO2DB_FIELD_INT,NDO_DATA_EVENTHANDLERENABLED},
+	{"flap_detection_enabled",NDO2DB_FIELD_INT,NDO_DATA_FLAPDETECTIONENABLED},
+	{"is_flapping",NDO2DB_FIELD_INT,NDO_DATA_ISFLAPPING},
+	{"percent_state_change",NDO2DB_FIELD_DOUBLE,NDO_DATA_PERCENTSTATECHANGE},
+	{"latency",NDO2DB_FIELD_DOUBLE,NDO_DATA_LATENCY},
+	{"execution_time",NDO2DB_FIELD_DOUBLE,NDO_DATA_EXECUTIONTIME},
+	{"scheduled_downtime_depth",NDO2DB_FIELD_INT,NDO_DATA_SCHEDULEDDOWNTIMEDEPTH},
+	{"failure_prediction_enabled",NDO2DB_FIELD_INT,NDO_DATA_FAILUREPREDICTIONENABLED},
+	{"process_performance_data",NDO2DB_FIELD_INT,NDO_DATA_PROCESSPERFORMANCEDATA},
+	{"obsess_over_service",NDO2DB_FIELD_INT,NDO_DATA_OBSESSOVERSERVICE},
+	{"modified_service_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDSERVICEATTRIBUTES},
+	{"event_handler",NDO2DB_FIELD_STRING,NDO_DATA_EVENTHANDLER},
+	{"check_command",NDO2DB_FIELD_STRING,NDO_DATA_CHECKCOMMAND},
+	{"normal_check_interval",NDO2DB_FIELD_DOUBLE,NDO_DATA_NORMALCHECKINTERVAL},
+	{"retry_check_interval",NDO2DB_FIELD_DOUBLE,NDO_DATA_RETRYCHECKINTERVAL},
+	{"check_timeperiod_object_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_TIMEPERIOD}
+        };
+
+static ndo2db_dbrow ndo2db_servicestatus_row=NDO2DB_DBROW(NDO2DB_DBTABLE_SERVICESTATUS,ndo2db_servicestatus_fields);
+
 int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
-	unsigned long last_check=0L;
-	unsigned long next_check=0L;
-	unsigned long last_state_change=0L;
-	unsigned long last_hard_state_change=0L;
-	unsigned long last_time_ok=0L;
-	unsigned long last_time_warning=0L;
-	unsigned long last_time_unknown=0L;
-	unsigned long last_time_critical=0L;
-	unsigned long last_notification=0L;
-	unsigned long next_notification=0L;
-	unsigned long modified_service_attributes=0L;
-	double percent_state_change=0.0;
-	double latency=0.0;
-	double execution_time=0.0;
-	int current_state=0;
-	int has_been_checked=0;
-	int should_be_scheduled=0;
-	int current_check_attempt=0;
-	int max_check_attempts=0;
-	int check_type=0;
-	int last_hard_state=0;
-	int state_type=0;
-	int no_more_notifications=0;
-	int notifications_enabled=0;
-	int problem_has_been_acknowledged=0;
-	int acknowledgement_type=0;
-	int current_notification_number=0;
-	int passive_checks_enabled=0;
-	int active_checks_enabled=0;
-	int event_handler_enabled;
-	int flap_detection_enabled=0;
-	int is_flapping=0;
-	int scheduled_downtime_depth=0;
-	int failure_prediction_enabled=0;
-	int process_performance_data;
-	int obsess_over_service=0;
-	double normal_check_interval=0.0;
-	double retry_check_interval=0.0;
-	char *ts[11];
-	char *es[5];
-	char *buf=NULL;
-	char *buf1=NULL;
+	unsigned long args[4];
 	unsigned long object_id=0L;
 	unsigned long check_timeperiod_object_id=0L;
-	int x=0;
 	int result=NDO_OK;
 
 	if(idi==NULL)
@@ -2463,162 +3154,45 @@ int ndo2db_handle_servicestatusdata(ndo2db_idi *idi){
 	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICECHECK],&last_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTSERVICECHECK],&next_check);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSTATECHANGE],&last_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHARDSTATECHANGE],&last_hard_state_change);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEOK],&last_time_ok);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEWARNING],&last_time_warning);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMEUNKNOWN],&last_time_unknown);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTTIMECRITICAL],&last_time_critical);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICENOTIFICATION],&last_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_NEXTSERVICENOTIFICATION],&next_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_LATENCY],&latency);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_EXECUTIONTIME],&execution_time);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTSTATE],&current_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HASBEENCHECKED],&has_been_checked);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SHOULDBESCHEDULED],&should_be_scheduled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_MAXCHECKATTEMPTS],&max_check_attempts);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CHECKTYPE],&check_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_STATETYPE],&state_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOMORENOTIFICATIONS],&no_more_notifications);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_NOTIFICATIONSENABLED],&notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROBLEMHASBEENACKNOWLEDGED],&problem_has_been_acknowledged);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACKNOWLEDGEMENTTYPE],&acknowledgement_type);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_CURRENTNOTIFICATIONNUMBER],&current_notification_number);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PASSIVESERVICECHECKSENABLED],&passive_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVESERVICECHECKSENABLED],&active_checks_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_EVENTHANDLERENABLED],&event_handler_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FLAPDETECTIONENABLED],&flap_detection_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ISFLAPPING],&is_flapping);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SCHEDULEDDOWNTIMEDEPTH],&scheduled_downtime_depth);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_FAILUREPREDICTIONENABLED],&failure_prediction_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_PROCESSPERFORMANCEDATA],&process_performance_data);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_OBSESSOVERSERVICE],&obsess_over_service);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_NORMALCHECKINTERVAL],&normal_check_interval);
-	result=ndo2db_convert_string_to_double(idi->buffered_input[NDO_DATA_RETRYCHECKINTERVAL],&retry_check_interval);
-
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PERFDATA]);
-	es[3]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_EVENTHANDLER]);
-	es[4]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_CHECKCOMMAND]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,last_check);
-	ts[2]=ndo2db_db_timet_to_sql(idi,next_check);
-	ts[3]=ndo2db_db_timet_to_sql(idi,last_state_change);
-	ts[4]=ndo2db_db_timet_to_sql(idi,last_hard_state_change);
-	ts[5]=ndo2db_db_timet_to_sql(idi,last_time_ok);
-	ts[6]=ndo2db_db_timet_to_sql(idi,last_time_warning);
-	ts[7]=ndo2db_db_timet_to_sql(idi,last_time_unknown);
-	ts[8]=ndo2db_db_timet_to_sql(idi,last_time_critical);
-	ts[9]=ndo2db_db_timet_to_sql(idi,last_notification);
-	ts[10]=ndo2db_db_timet_to_sql(idi,next_notification);
-
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_SERVICECHECKPERIOD],NULL,&check_timeperiod_object_id);
 
-	/* generate query string */
-	if(asprintf(&buf1,"instance_id='%lu', service_object_id='%lu', status_update_time=%s, output='%s', long_output='%s', perfdata='%s', current_state='%d', has_been_checked='%d', should_be_scheduled='%d', current_check_attempt='%d', max_check_attempts='%d', last_check=%s, next_check=%s, check_type='%d', last_state_change=%s, last_hard_state_change=%s, last_hard_state='%d', last_time_ok=%s, last_time_warning=%s, last_time_unknown=%s, last_time_critical=%s, state_type='%d', last_notification=%s, next_notification=%s, no_more_notifications='%d', notifications_enabled='%d', problem_has_been_acknowledged='%d', acknowledgement_type='%d', current_notification_number='%d', passive_checks_enabled='%d', active_checks_enabled='%d', event_handler_enabled='%d', flap_detection_enabled='%d', is_flapping='%d', percent_state_change='%lf', latency='%lf', execution_time='%lf', scheduled_downtime_depth='%d', failure_prediction_enabled='%d', process_performance_data='%d', obsess_over_service='%d', modified_service_attributes='%lu', event_handler='%s', check_command='%s', normal_check_interval='%lf', retry_check_interval='%lf', check_timeperiod_object_id='%lu'"
-		    ,idi->dbinfo.instance_id
-		    ,object_id
-		    ,ts[0]
-		    ,es[0]
-		    ,es[1]
-		    ,es[2]
-		    ,current_state
-		    ,has_been_checked
-		    ,should_be_scheduled
-		    ,current_check_attempt
-		    ,max_check_attempts
-		    ,ts[1]
-		    ,ts[2]
-		    ,check_type
-		    ,ts[3]
-		    ,ts[4]
-		    ,last_hard_state
-		    ,ts[5]
-		    ,ts[6]
-		    ,ts[7]
-		    ,ts[8]
-		    ,state_type
-		    ,ts[9]
-		    ,ts[10]
-		    ,no_more_notifications
-		    ,notifications_enabled
-		    ,problem_has_been_acknowledged
-		    ,acknowledgement_type
-		    ,current_notification_number
-		    ,passive_checks_enabled
-		    ,active_checks_enabled
-		    ,event_handler_enabled
-		    ,flap_detection_enabled
-		    ,is_flapping
-		    ,percent_state_change
-		    ,latency
-		    ,execution_time
-		    ,scheduled_downtime_depth
-		    ,failure_prediction_enabled
-		    ,process_performance_data
-		    ,obsess_over_service
-		    ,modified_service_attributes
-		    ,es[3]
-		    ,es[4]
-		    ,normal_check_interval
-		    ,retry_check_interval
-		    ,check_timeperiod_object_id
-		   )==-1)
-		buf1=NULL;
-
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICESTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+	args[NDO2DB_STATUSARG_INSTANCE]=idi->dbinfo.instance_id;
+	args[NDO2DB_STATUSARG_OBJECT]=object_id;
+	args[NDO2DB_STATUSARG_UPDATETIME]=tstamp.tv_sec;
+	args[NDO2DB_STATUSARG_TIMEPERIOD]=check_timeperiod_object_id;
 
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
-
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+	result=ndo2db_db_write_row(idi,&ndo2db_servicestatus_row,args);
 
 	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts[0]);
-
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,tstamp.tv_sec);
 
 	return NDO_OK;
         }
 
 
+static const ndo2db_dbfield ndo2db_contactstatus_fields[]={
+	{"instance_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_INSTANCE},
+	{"contact_object_id",NDO2DB_FIELD_ARG,NDO2DB_STATUSARG_OBJECT},
+	{"status_update_time",NDO2DB_FIELD_ARGTIME,NDO2DB_STATUSARG_UPDATETIME},
+	{"host_notifications_enabled",NDO2DB_FIELD_INT,NDO_DATA_HOSTNOTIFICATIONSENABLED},
+	{"service_notifications_enabled",NDO2DB_FIELD_INT,NDO_DATA_SERVICENOTIFICATIONSENABLED},
+	{"last_host_notification",NDO2DB_FIELD_TIME,NDO_DATA_LASTHOSTNOTIFICATION},
+	{"last_service_notification",NDO2DB_FIELD_TIME,NDO_DATA_LASTSERVICENOTIFICATION},
+	{"modified_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDCONTACTATTRIBUTES},
+	{"modified_host_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDHOSTATTRIBUTES},
+	{"modified_service_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDSERVICEATTRIBUTES}
+        };
+
+static ndo2db_dbrow ndo2db_contactstatus_row=NDO2DB_DBROW(NDO2DB_DBTABLE_CONTACTSTATUS,ndo2db_contactstatus_fields);
+
 int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
-	unsigned long last_host_notification=0L;
-	unsigned long last_service_notification=0L;
-	unsigned long modified_attributes=0L;
-	unsigned long modified_host_attributes=0L;
-	unsigned long modified_service_attributes=0L;
-	int host_notifications_enabled=0;
-	int service_notifications_enabled=0;
-	char *ts[3];
-	char *buf=NULL;
-	char *buf1=NULL;
+	unsigned long args[3];
 	unsigned long object_id=0L;
-	int x=0;
 	int result=NDO_OK;
 
 	if(idi==NULL)
@@ -2631,56 +3205,34 @@ int ndo2db_handle_contactstatusdata(ndo2db_idi *idi){
 	if(tstamp.tv_sec < idi->dbinfo.latest_realtime_data_time)
 		return NDO_OK;
 
-	/* covert vars */
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTHOSTNOTIFICATION],&last_host_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_LASTSERVICENOTIFICATION],&last_service_notification);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDCONTACTATTRIBUTES],&modified_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDHOSTATTRIBUTES],&modified_host_attributes);
-	result=ndo2db_convert_string_to_unsignedlong(idi->buffered_input[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_service_attributes);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONSENABLED],&host_notifications_enabled);
-	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONSENABLED],&service_notifications_enabled);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
-	ts[1]=ndo2db_db_timet_to_sql(idi,last_host_notification);
-	ts[2]=ndo2db_db_timet_to_sql(idi,last_service_notification);
-
 	/* get the object id */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL,&object_id);
 
-	/* generate query string */
-	if(asprintf(&buf1,"instance_id='%lu', contact_object_id='%lu', status_update_time=%s, host_notifications_enabled='%d', service_notifications_enabled='%d', last_host_notification=%s, last_service_notification=%s, modified_attributes='%lu', modified_host_attributes='%lu', modified_service_attributes='%lu'"
-		    ,idi->dbinfo.instance_id
-		    ,object_id
-		    ,ts[0]
-		    ,host_notifications_enabled
-		    ,service_notifications_enabled
-		    ,ts[1]
-		    ,ts[2]
-		    ,modified_attributes
-		    ,modified_host_attributes
-		    ,modified_service_attributes
-		   )==-1)
-		buf1=NULL;
-
-	if(asprintf(&buf,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTSTATUS]
-		    ,buf1
-		    ,buf1
-		   )==-1)
-		buf=NULL;
+	args[NDO2DB_STATUSARG_INSTANCE]=idi->dbinfo.instance_id;
+	args[NDO2DB_STATUSARG_OBJECT]=object_id;
+	args[NDO2DB_STATUSARG_UPDATETIME]=tstamp.tv_sec;
 
 	/* save entry to db */
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
-	free(buf1);
+	result=ndo2db_db_write_row(idi,&ndo2db_contactstatus_row,args);
 
 	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,ts[0]);
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS,object_id,tstamp.tv_sec);
+
+	return NDO_OK;
+        }
 
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
+/* sets up the status row descriptors, once before any writer starts */
+int ndo2db_init_status_rows(void){
+
+	if(ndo2db_db_init_row(&ndo2db_programstatus_row)==NDO_ERROR)
+		return NDO_ERROR;
+	if(ndo2db_db_init_row(&ndo2db_hoststatus_row)==NDO_ERROR)
+		return NDO_ERROR;
+	if(ndo2db_db_init_row(&ndo2db_servicestatus_row)==NDO_ERROR)
+		return NDO_ERROR;
+	if(ndo2db_db_init_row(&ndo2db_contactstatus_row)==NDO_ERROR)
+		return NDO_ERROR;
 
 	return NDO_OK;
         }
@@ -2895,6 +3447,7 @@ int ndo2db_handle_statechangedata(ndo2db_idi *idi){
 	int last_hard_state=-1;
 	unsigned long object_id=0L;
 	int result=NDO_OK;
+	ndo2db_dbstmt *stmt=NULL;
 	char *ts[1];
 	char *es[2];
 	char *buf=NULL;
@@ -2919,44 +3472,67 @@ int ndo2db_handle_statechangedata(ndo2db_idi *idi){
 	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTHARDSTATE],&last_hard_state);
 	result=ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_LASTSTATE],&last_state);
 
-	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
-	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
-
-	ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
-
 	/* get the object id */
 	if(statechange_type==SERVICE_STATECHANGE)
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,idi->buffered_input[NDO_DATA_HOST],idi->buffered_input[NDO_DATA_SERVICE],&object_id);
 	else
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_HOST,idi->buffered_input[NDO_DATA_HOST],NULL,&object_id);
 
-	/* save entry to db */
-	if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', state_time=%s, state_time_usec='%lu', object_id='%lu', state_change='%d', state='%d', state_type='%d', current_check_attempt='%d', max_check_attempts='%d', last_state='%d', last_hard_state='%d', output='%s', long_output='%s'"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_STATEHISTORY]
-		    ,idi->dbinfo.instance_id
-		    ,ts[0]
-		    ,tstamp.tv_usec
-		    ,object_id
-		    ,state_change_occurred
-		    ,state
-		    ,state_type
-		    ,current_attempt
-		    ,max_attempts
-		    ,last_state
-		    ,last_hard_state
-		    ,es[0]
-		    ,es[1]
-		   )==-1)
-		buf=NULL;
+	/* bind the values straight to a prepared statement if we can */
+	if((stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_STATEHISTORY
+		    ,"instance_id, state_time, state_time_usec, object_id, state_change, state, state_type, current_check_attempt, max_check_attempts, last_state, last_hard_state, output, long_output"
+		    ,"?,FROM_UNIXTIME(?),?,?,?,?,?,?,?,?,?,?,?"
+		    ,NULL
+		   ))!=NULL){
+		ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+		ndo2db_db_stmt_bind_int(stmt,tstamp.tv_sec);
+		ndo2db_db_stmt_bind_int(stmt,tstamp.tv_usec);
+		ndo2db_db_stmt_bind_int(stmt,object_id);
+		ndo2db_db_stmt_bind_int(stmt,state_change_occurred);
+		ndo2db_db_stmt_bind_int(stmt,state);
+		ndo2db_db_stmt_bind_int(stmt,state_type);
+		ndo2db_db_stmt_bind_int(stmt,current_attempt);
+		ndo2db_db_stmt_bind_int(stmt,max_attempts);
+		ndo2db_db_stmt_bind_int(stmt,last_state);
+		ndo2db_db_stmt_bind_int(stmt,last_hard_state);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_OUTPUT]);
+		ndo2db_db_stmt_bind_string(stmt,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
+		result=ndo2db_db_stmt_execute(idi,stmt);
+	        }
+	else{
+		es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_OUTPUT]);
+		es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_LONGOUTPUT]);
 
-	result=ndo2db_db_query(idi,buf);
-	free(buf);
+		ts[0]=ndo2db_db_timet_to_sql(idi,tstamp.tv_sec);
 
-        /* free memory */
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
-		free(ts[x]);
-	for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
-		free(es[x]);
+		/* save entry to db */
+		if(asprintf(&buf,"INSERT INTO %s SET instance_id='%lu', state_time=%s, state_time_usec='%lu', object_id='%lu', state_change='%d', state='%d', state_type='%d', current_check_attempt='%d', max_check_attempts='%d', last_state='%d', last_hard_state='%d', output='%s', long_output='%s'"
+			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_STATEHISTORY]
+			    ,idi->dbinfo.instance_id
+			    ,ts[0]
+			    ,tstamp.tv_usec
+			    ,object_id
+			    ,state_change_occurred
+			    ,state
+			    ,state_type
+			    ,current_attempt
+			    ,max_attempts
+			    ,last_state
+			    ,last_hard_state
+			    ,es[0]
+			    ,es[1]
+			   )==-1)
+			buf=NULL;
+
+		result=ndo2db_db_query(idi,buf);
+		free(buf);
+
+		/* free memory */
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(ts); x++)
+			free(ts[x]);
+		for (x = 0; x < NAGIOS_SIZEOF_ARRAY(es); x++)
+			free(es[x]);
+	        }
 
 	return NDO_OK;
         }
@@ -2979,6 +3555,7 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 	char *varname=NULL;
 	char *varvalue=NULL;
 	ndo2db_mbuf mbuf;
+	char *saveptr=NULL;
 
 	ndo2db_log_debug_info(NDO2DB_DEBUGL_SQL,0,"HANDLE_CONFIGFILEVARS [1]\n");
 
@@ -3015,7 +3592,7 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 		buf1=NULL;
 
 	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		configfile_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
+		configfile_id=ndo2db_db_insert_id(idi);
 	}
 	free(buf);
 	free(buf1);
@@ -3030,8 +3607,8 @@ int ndo2db_handle_configfilevariables(ndo2db_idi *idi, int configfile_type){
 			continue;
 
 		/* get var name/val pair */
-		varname=strtok(mbuf.buffer[x],"=");
-		varvalue=strtok(NULL,"\x0");
+		varname=strtok_r(mbuf.buffer[x],"=",&saveptr);
+		varvalue=strtok_r(NULL,"\x0",&saveptr);
 
 		es[1]=ndo2db_db_escape_string(idi,varname);
 		es[2]=ndo2db_db_escape_string(idi,varvalue);
@@ -3091,6 +3668,7 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 	char *varname=NULL;
 	char *varvalue=NULL;
 	ndo2db_mbuf mbuf;
+	char *saveptr=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -3110,8 +3688,8 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 			continue;
 
 		/* get var name/val pair */
-		varname=strtok(mbuf.buffer[x],"=");
-		varvalue=strtok(NULL,"\x0");
+		varname=strtok_r(mbuf.buffer[x],"=",&saveptr);
+		varvalue=strtok_r(NULL,"\x0",&saveptr);
 
 		es[0]=ndo2db_db_escape_string(idi,varname);
 		es[1]=ndo2db_db_escape_string(idi,varvalue);
@@ -3147,6 +3725,29 @@ int ndo2db_handle_runtimevariables(ndo2db_idi *idi){
 /* OBJECT DEFINITION DATA HANDLERS                                          */
 /****************************************************************************/
 
+/* writes a definition's row or one of its members, or holds it for the bulk load of a config dump */
+int ndo2db_save_config_row(ndo2db_idi *idi, int table, char *buf, unsigned long object_id, unsigned long *row_id){
+	int result=NDO_OK;
+	char *buf1=NULL;
+
+	if(ndo2db_config_load_add(idi,table,buf,object_id,row_id)==NDO_TRUE)
+		return NDO_OK;
+
+	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
+		    ,ndo2db_db_tablenames[table]
+		    ,buf
+		    ,buf
+		   )==-1)
+		buf1=NULL;
+
+	if((result=ndo2db_db_query(idi,buf1))==NDO_OK && row_id!=NULL)
+		*row_id=ndo2db_db_insert_id(idi);
+	free(buf1);
+
+	return result;
+        }
+
+
 int ndo2db_handle_configdumpstart(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
@@ -3161,12 +3762,26 @@ int ndo2db_handle_configdumpstart(ndo2db_idi *idi){
 	else
 		idi->current_object_config_type=0;
 
+	/* hold the dump's rows back if we're bulk loading */
+	ndo2db_config_load_start(idi);
+
+	/* and read the digests of the definitions it's likely to repeat */
+	ndo2db_config_digest_start(idi);
+
 	return NDO_OK;
         }
 
 
 int ndo2db_handle_configdumpend(ndo2db_idi *idi){
 
+	ndo2db_config_load_end(idi);
+
+	/* store the digests of what was written, and delete what wasn't defined */
+	ndo2db_config_digest_end(idi);
+
+	/* the dump named every object that is active now */
+	ndo2db_save_active_objects(idi);
+
 	return NDO_OK;
         }
 
@@ -3222,10 +3837,10 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 	char *es[13];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 	char *cmdptr=NULL;
 	char *argptr=NULL;
+	char *saveptr=NULL;
 #ifdef BUILD_NAGIOS_4X
 	int	importance=0;
 #endif
@@ -3286,14 +3901,14 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 	es[1]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_HOSTFAILUREPREDICTIONOPTIONS]);
 
 	/* get the check command */
-	cmdptr=strtok(idi->buffered_input[NDO_DATA_HOSTCHECKCOMMAND],"!");
-	argptr=strtok(NULL,"\x0");
+	cmdptr=strtok_r(idi->buffered_input[NDO_DATA_HOSTCHECKCOMMAND],"!",&saveptr);
+	argptr=strtok_r(NULL,"\x0",&saveptr);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&check_command_id);
 	es[2]=ndo2db_db_escape_string(idi,argptr);
 
 	/* get the event handler command */
-	cmdptr=strtok(idi->buffered_input[NDO_DATA_HOSTEVENTHANDLER],"!");
-	argptr=strtok(NULL,"\x0");
+	cmdptr=strtok_r(idi->buffered_input[NDO_DATA_HOSTEVENTHANDLER],"!",&saveptr);
+	argptr=strtok_r(NULL,"\x0",&saveptr);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&eventhandler_command_id);
 	es[3]=ndo2db_db_escape_string(idi,argptr);
 
@@ -3385,22 +4000,16 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		host_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTS,buf,object_id,&host_id);
 	free(buf);
-	free(buf1);
 
 	for(x=0;x<13;x++)
 		free(es[x]);
 
+	/* everything below refers to the host's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save parent hosts to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_PARENTHOST];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -3418,16 +4027,8 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTPARENTHOSTS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTPARENTHOSTS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	/* save contact groups to db */
@@ -3447,16 +4048,8 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTGROUPS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTCONTACTGROUPS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	/* save contacts to db */
@@ -3476,20 +4069,12 @@ int ndo2db_handle_hostdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTCONTACTS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTCONTACTS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	}
 
 	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,object_id,NULL);
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,object_id,(time_t)0);
 
 	return NDO_OK;
         }
@@ -3505,7 +4090,6 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 	char *es[1];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 
 	if(idi==NULL)
@@ -3535,21 +4119,15 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTGROUPS,buf,object_id,&group_id);
 	free(buf);
-	free(buf1);
 
 	free(es[0]);
 
+	/* everything below refers to the host group's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save hostgroup members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_HOSTGROUPMEMBER];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -3567,16 +4145,8 @@ int ndo2db_handle_hostgroupdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTGROUPMEMBERS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTGROUPMEMBERS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -3632,10 +4202,10 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 	char *es[9];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 	char *cmdptr=NULL;
 	char *argptr=NULL;
+	char *saveptr=NULL;
 #ifdef BUILD_NAGIOS_4X
 	int	importance=0;
 	char *hptr=NULL;
@@ -3694,14 +4264,14 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 	es[0]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_SERVICEFAILUREPREDICTIONOPTIONS]);
 
 	/* get the check command */
-	cmdptr=strtok(idi->buffered_input[NDO_DATA_SERVICECHECKCOMMAND],"!");
-	argptr=strtok(NULL,"\x0");
+	cmdptr=strtok_r(idi->buffered_input[NDO_DATA_SERVICECHECKCOMMAND],"!",&saveptr);
+	argptr=strtok_r(NULL,"\x0",&saveptr);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&check_command_id);
 	es[1]=ndo2db_db_escape_string(idi,argptr);
 
 	/* get the event handler command */
-	cmdptr=strtok(idi->buffered_input[NDO_DATA_SERVICEEVENTHANDLER],"!");
-	argptr=strtok(NULL,"\x0");
+	cmdptr=strtok_r(idi->buffered_input[NDO_DATA_SERVICEEVENTHANDLER],"!",&saveptr);
+	argptr=strtok_r(NULL,"\x0",&saveptr);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_COMMAND,cmdptr,NULL,&eventhandler_command_id);
 	es[2]=ndo2db_db_escape_string(idi,argptr);
 
@@ -3785,22 +4355,16 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICES]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		service_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICES,buf,object_id,&service_id);
 	free(buf);
-	free(buf1);
 
 	for(x=0;x<9;x++)
 		free(es[x]);
 
+	/* everything below refers to the service's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 #ifdef BUILD_NAGIOS_4X
 	/* save parent services to db */
 	mbuf = idi->mbuf[NDO2DB_MBUF_PARENTSERVICE];
@@ -3809,8 +4373,8 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 		if(mbuf.buffer[x] == NULL) continue;
 
 		/* split the host/service name */
-		hptr=strtok(mbuf.buffer[x],";");
-		sptr=strtok(NULL,"\x0");
+		hptr=strtok_r(mbuf.buffer[x],";",&saveptr);
+		sptr=strtok_r(NULL,"\x0",&saveptr);
 
 		/* get the object id of the member */
 		result = ndo2db_get_object_id_with_insert(idi,
@@ -3822,15 +4386,8 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 			buf = NULL;
 			}
 
-		if(asprintf(&buf1, "INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s",
-				ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEPARENTSERVICES],
-				buf, buf) == -1) {
-			buf1=NULL;
-			}
-
-		result = ndo2db_db_query(idi, buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEPARENTSERVICES,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 		}
 #endif
 
@@ -3851,16 +4408,8 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTGROUPS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICECONTACTGROUPS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	/* save contacts to db */
@@ -3880,20 +4429,12 @@ int ndo2db_handle_servicedefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICECONTACTS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICECONTACTS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	}
 
 	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,object_id,NULL);
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,object_id,(time_t)0);
 
 	return NDO_OK;
         }
@@ -3909,10 +4450,10 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 	char *es[1];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 	char *hptr=NULL;
 	char *sptr=NULL;
+	char *saveptr=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -3941,21 +4482,15 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEGROUPS,buf,object_id,&group_id);
 	free(buf);
-	free(buf1);
 
 	free(es[0]);
 
+	/* everything below refers to the service group's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_SERVICEGROUPMEMBER];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -3964,8 +4499,8 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 			continue;
 
 		/* split the host/service name */
-		hptr=strtok(mbuf.buffer[x],";");
-		sptr=strtok(NULL,"\x0");
+		hptr=strtok_r(mbuf.buffer[x],";",&saveptr);
+		sptr=strtok_r(NULL,"\x0",&saveptr);
 
 		/* get the object id of the member */
 		result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_SERVICE,hptr,sptr,&member_id);
@@ -3977,16 +4512,8 @@ int ndo2db_handle_servicegroupdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEGROUPMEMBERS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEGROUPMEMBERS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -4006,7 +4533,6 @@ int ndo2db_handle_hostdependencydefinition(ndo2db_idi *idi){
 	int fail_on_unreachable=0;
 	int result=NDO_OK;
 	char *buf=NULL;
-	char *buf1=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -4045,16 +4571,8 @@ int ndo2db_handle_hostdependencydefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTDEPENDENCIES]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	result=ndo2db_db_query(idi,buf1);
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTDEPENDENCIES,buf,0L,NULL);
 	free(buf);
-	free(buf1);
 
 	return NDO_OK;
         }
@@ -4074,7 +4592,6 @@ int ndo2db_handle_servicedependencydefinition(ndo2db_idi *idi){
 	int fail_on_critical=0;
 	int result=NDO_OK;
 	char *buf=NULL;
-	char *buf1=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -4115,16 +4632,8 @@ int ndo2db_handle_servicedependencydefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEDEPENDENCIES]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	result=ndo2db_db_query(idi,buf1);
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEDEPENDENCIES,buf,0L,NULL);
 	free(buf);
-	free(buf1);
 
 	return NDO_OK;
         }
@@ -4146,7 +4655,6 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 	int result=NDO_OK;
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 
 	if(idi==NULL)
@@ -4188,18 +4696,12 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		escalation_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTESCALATIONS,buf,object_id,&escalation_id);
 	free(buf);
-	free(buf1);
+
+	/* everything below refers to the escalation's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
 
 	/* save contact groups to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTGROUP];
@@ -4218,16 +4720,8 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTESCALATIONCONTACTGROUPS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	/* save contacts to db */
@@ -4247,16 +4741,8 @@ int ndo2db_handle_hostescalationdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_HOSTESCALATIONCONTACTS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_HOSTESCALATIONCONTACTS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -4280,7 +4766,6 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 	int result=NDO_OK;
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 
 	if(idi==NULL)
@@ -4324,18 +4809,12 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		escalation_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEESCALATIONS,buf,object_id,&escalation_id);
 	free(buf);
-	free(buf1);
+
+	/* everything below refers to the escalation's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
 
 	/* save contact groups to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTGROUP];
@@ -4354,16 +4833,8 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTGROUPS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	/* save contacts to db */
@@ -4383,16 +4854,8 @@ int ndo2db_handle_serviceescalationdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_SERVICEESCALATIONCONTACTS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -4407,7 +4870,6 @@ int ndo2db_handle_commanddefinition(ndo2db_idi *idi){
 	char *es[1];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -4436,16 +4898,8 @@ int ndo2db_handle_commanddefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_COMMANDS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	result=ndo2db_db_query(idi,buf1);
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_COMMANDS,buf,0L,NULL);
 	free(buf);
-	free(buf1);
 
 	for(x=0;x<1;x++)
 		free(es[x]);
@@ -4469,8 +4923,8 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 	char *es[1];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
+	char *saveptr=NULL;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -4499,21 +4953,15 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		timeperiod_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_TIMEPERIODS,buf,object_id,&timeperiod_id);
 	free(buf);
-	free(buf1);
 
 	free(es[0]);
 
+	/* everything below refers to the timeperiod's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save timeranges to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_TIMERANGE];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -4522,9 +4970,9 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 			continue;
 
 		/* get var name/val pair */
-		dayptr=strtok(mbuf.buffer[x],":");
-		startptr=strtok(NULL,"-");
-		endptr=strtok(NULL,"\x0");
+		dayptr=strtok_r(mbuf.buffer[x],":",&saveptr);
+		startptr=strtok_r(NULL,"-",&saveptr);
+		endptr=strtok_r(NULL,"\x0",&saveptr);
 
 		if(startptr==NULL || endptr==NULL)
 			continue;
@@ -4542,16 +4990,8 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_TIMEPERIODTIMERANGES]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_TIMEPERIODTIMERANGES,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -4561,6 +5001,7 @@ int ndo2db_handle_timeperiodefinition(ndo2db_idi *idi){
 int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 	int type,flags,attr;
 	struct timeval tstamp;
+	unsigned long object_id=0L;
 	unsigned long contact_id=0L;
 	unsigned long host_timeperiod_id=0L;
 	unsigned long service_timeperiod_id=0L;
@@ -4583,13 +5024,13 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 	char *es[3];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 	char *numptr=NULL;
 	char *addressptr=NULL;
 	int address_number=0;
 	char *cmdptr=NULL;
 	char *argptr=NULL;
+	char *saveptr=NULL;
 #ifdef BUILD_NAGIOS_4X
 	int minimum_importance=0;
 #endif
@@ -4628,14 +5069,14 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 	es[2]=ndo2db_db_escape_string(idi,idi->buffered_input[NDO_DATA_PAGERADDRESS]);
 
 	/* get the object id */
-	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL,&contact_id);
+	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_CONTACT,idi->buffered_input[NDO_DATA_CONTACTNAME],NULL,&object_id);
 
 	/* get the timeperiod ids */
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_HOSTNOTIFICATIONPERIOD],NULL,&host_timeperiod_id);
 	result=ndo2db_get_object_id_with_insert(idi,NDO2DB_OBJECTTYPE_TIMEPERIOD,idi->buffered_input[NDO_DATA_SERVICENOTIFICATIONPERIOD],NULL,&service_timeperiod_id);
 
 	/* flag the object as being active */
-	ndo2db_set_object_as_active(idi,NDO2DB_OBJECTTYPE_CONTACT,contact_id);
+	ndo2db_set_object_as_active(idi,NDO2DB_OBJECTTYPE_CONTACT,object_id);
 
 	/* add definition to db */
 	if(asprintf(&buf,"instance_id='%lu', config_type='%d', contact_object_id='%lu', alias='%s', email_address='%s', pager_address='%s', host_timeperiod_object_id='%lu', service_timeperiod_object_id='%lu', host_notifications_enabled='%d', service_notifications_enabled='%d', can_submit_commands='%d', notify_service_recovery='%d', notify_service_warning='%d', notify_service_unknown='%d', notify_service_critical='%d', notify_service_flapping='%d', notify_service_downtime='%d', notify_host_recovery='%d', notify_host_down='%d', notify_host_unreachable='%d', notify_host_flapping='%d', notify_host_downtime='%d'"
@@ -4644,7 +5085,7 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 #endif
 		    ,idi->dbinfo.instance_id
 		    ,idi->current_object_config_type
-		    ,contact_id
+		    ,object_id
 		    ,es[0]
 		    ,es[1]
 		    ,es[2]
@@ -4670,22 +5111,16 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		contact_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTS,buf,object_id,&contact_id);
 	free(buf);
-	free(buf1);
 
 	for(x=0;x<3;x++)
 		free(es[x]);
 
+	/* everything below refers to the contact's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save addresses to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTADDRESS];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -4693,8 +5128,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		if(mbuf.buffer[x]==NULL)
 			continue;
 
-		numptr=strtok(mbuf.buffer[x],":");
-		addressptr=strtok(NULL,"\x0");
+		numptr=strtok_r(mbuf.buffer[x],":",&saveptr);
+		addressptr=strtok_r(NULL,"\x0",&saveptr);
 
 		if(numptr==NULL || addressptr==NULL)
 			continue;
@@ -4710,16 +5145,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTADDRESSES]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTADDRESSES,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 
 		free(es[0]);
 	        }
@@ -4731,8 +5158,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		if(mbuf.buffer[x]==NULL)
 			continue;
 
-		cmdptr=strtok(mbuf.buffer[x],"!");
-		argptr=strtok(NULL,"\x0");
+		cmdptr=strtok_r(mbuf.buffer[x],"!",&saveptr);
+		argptr=strtok_r(NULL,"\x0",&saveptr);
 
 		if(numptr==NULL)
 			continue;
@@ -4751,16 +5178,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 
 		free(es[0]);
 	        }
@@ -4772,8 +5191,8 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 		if(mbuf.buffer[x]==NULL)
 			continue;
 
-		cmdptr=strtok(mbuf.buffer[x],"!");
-		argptr=strtok(NULL,"\x0");
+		cmdptr=strtok_r(mbuf.buffer[x],"!",&saveptr);
+		argptr=strtok_r(NULL,"\x0",&saveptr);
 
 		if(numptr==NULL)
 			continue;
@@ -4792,22 +5211,14 @@ int ndo2db_handle_contactdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTNOTIFICATIONCOMMANDS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 
 		free(es[0]);
 	}
 
 	/* save custom variables to db */
-	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,contact_id,NULL);
+	result=ndo2db_save_custom_variables(idi,NDO2DB_DBTABLE_CUSTOMVARIABLES,object_id,(time_t)0);
 
 	return NDO_OK;
         }
@@ -4823,7 +5234,6 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 	char *es[1];
 	int x=0;
 	char *buf=NULL;
-	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
 
 	if(idi==NULL)
@@ -4853,21 +5263,15 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 		   )==-1)
 		buf=NULL;
 
-	if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPS]
-		    ,buf
-		    ,buf
-		   )==-1)
-		buf1=NULL;
-
-	if((result=ndo2db_db_query(idi,buf1))==NDO_OK){
-		group_id=mysql_insert_id(&idi->dbinfo.mysql_conn);
-	}
+	result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTGROUPS,buf,object_id,&group_id);
 	free(buf);
-	free(buf1);
 
 	free(es[0]);
 
+	/* everything below refers to the contact group's row */
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
 	/* save contact group members to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CONTACTGROUPMEMBER];
 	for(x=0;x<mbuf.used_lines;x++){
@@ -4885,16 +5289,8 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 			   )==-1)
 			buf=NULL;
 
-		if(asprintf(&buf1,"INSERT INTO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_CONTACTGROUPMEMBERS]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,NDO2DB_DBTABLE_CONTACTGROUPMEMBERS,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	        }
 
 	return NDO_OK;
@@ -4903,14 +5299,17 @@ int ndo2db_handle_contactgroupdefinition(ndo2db_idi *idi){
 /*
  * In this function, we get a list of up to 250 objects, with the object type
  * stored in idi->buffered_input[NDO_DATA_ACTIVEOBJECTSTYPE]. The list of
- * object names are in the idi->buffered_input with indexes from 1 to 250.
- * We generate an UPDATE query to set them all active at one time.
+ * object names are in the idi->buffered_input with indexes from 1 to 250
+ * (host and service description pairs for services).  The names are turned
+ * into ids with the object cache, and the database is only asked about the
+ * ones it doesn't know.  Objects that aren't in the table yet are added by
+ * their definitions.  The ids are saved when the config dump ends.
  */
 int ndo2db_handle_activeobjectlist(ndo2db_idi *idi)
 {
-	ndo_dbuf	dbuf;
-	char		*buf = NULL, *name1, *name2 = NULL;
-	int			rc, i, object_type, num_objs = 0, sz, first = 1;
+	ndo2db_object_key	*key = NULL;
+	unsigned long		object_id = 0L;
+	int			object_type, names, keys = 0, missing = 0, x;
 
 	if(idi==NULL)
 		return NDO_ERROR;
@@ -4918,13 +5317,6 @@ int ndo2db_handle_activeobjectlist(ndo2db_idi *idi)
 	/* What type of object are we dealing with? */
 	ndo2db_convert_string_to_int(idi->buffered_input[NDO_DATA_ACTIVEOBJECTSTYPE], &object_type);
 
-	/* Find out how many objects we're daling with */
-	while (idi->buffered_input[num_objs])
-		++num_objs;
-
-	/* Estimate the number of bytes we'll need for the SQL statement */
-	sz = ((num_objs * 25) & !0x3ff) | 0x800;
-
 	/* Convert object type into correct value for the table */
 	switch (object_type) {
 		case NDO_API_HOSTDEFINITION:
@@ -4955,85 +5347,70 @@ int ndo2db_handle_activeobjectlist(ndo2db_idi *idi)
 			return NDO_ERROR;
 	}
 
-	ndo_dbuf_init(&dbuf, sz);
+	/* Find out how many names we're dealing with */
+	for (names = 0; names + 1 < NDO_DATA_ACTIVEOBJECTSTYPE && idi->buffered_input[names + 1]; ++names)
+		;
+	if (names == 0)
+		return NDO_OK;
 
-	/* Build the first part of the query */
-	rc = asprintf(
-			&buf, "UPDATE %s SET is_active='1' WHERE instance_id='%lu' "
-			"AND objecttype_id='%d' AND ("
-		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS],
-			idi->dbinfo.instance_id, object_type);
-	if (rc == -1) {
-		ndo_dbuf_free(&dbuf);
-		syslog(LOG_ERR, "Error: memory allocation error in ndo2db_handle_activeobjectlist()");
-		return NDO_ERROR;
-	}
-	if (ndo_dbuf_strcat(&dbuf, buf) == NDO_ERROR) {
-		ndo_dbuf_free(&dbuf);
-		free(buf);
+	if ((key = (ndo2db_object_key *)calloc(names, sizeof(ndo2db_object_key))) == NULL) {
 		syslog(LOG_ERR, "Error: memory allocation error in ndo2db_handle_activeobjectlist()");
 		return NDO_ERROR;
 	}
-	free(buf);
-
-	while (num_objs) {
-		if (first)
-			first = 0;
-		else
-			ndo_dbuf_strcat(&dbuf, "OR ");
 
+	for (x = 1; x <= names; x++) {
+		key[keys].object_type = object_type;
+		key[keys].name1 = idi->buffered_input[x];
 		if (object_type == NDO2DB_OBJECTTYPE_SERVICE) {
-			name2 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
-			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
-			rc = asprintf(&buf, "(name1='%s' AND name2='%s')", name1, name2);
-
-		} else {
-			name1 = ndo2db_db_escape_string(idi, idi->buffered_input[num_objs--]);
-			rc = asprintf(&buf, "name1='%s'", name1);
-		}
-
-		free(name1);
-		free(name2);
-
-		if (rc == -1) {
-			ndo_dbuf_free(&dbuf);
-			free(buf);
-			syslog(LOG_ERR, "Error: memory allocation error in ndo2db_handle_activeobjectlist()");
-			return NDO_ERROR;
-		}
-		if (ndo_dbuf_strcat(&dbuf, buf) == NDO_ERROR) {
-			ndo_dbuf_free(&dbuf);
-			free(buf);
-			syslog(LOG_ERR, "Error: memory allocation error in ndo2db_handle_activeobjectlist()");
-			return NDO_ERROR;
+			if (x == names)
+				break;
+			key[keys].name2 = idi->buffered_input[++x];
 		}
+		if (key[keys].name1 && !strcmp(key[keys].name1, ""))
+			key[keys].name1 = NULL;
+		if (key[keys].name2 && !strcmp(key[keys].name2, ""))
+			key[keys].name2 = NULL;
+		if (key[keys].name1 || key[keys].name2)
+			keys++;
+	}
 
-		free(buf);
+	/* Most objects are in the cache already */
+	for (x = 0; x < keys; x++) {
+		if (ndo2db_get_cached_object_id(idi, object_type, key[x].name1, key[x].name2, &object_id) == NDO_OK)
+			ndo2db_set_object_as_active(idi, object_type, object_id);
+		else
+			key[missing++] = key[x];
 	}
 
-	if (ndo_dbuf_strcat(&dbuf, ")") == NDO_ERROR) {
-		ndo_dbuf_free(&dbuf);
-		syslog(LOG_ERR, "Error: memory allocation error in ndo2db_handle_activeobjectlist()");
-		return NDO_ERROR;
+	/* Look the rest up at once */
+	if (missing > 0) {
+		qsort(key, missing, sizeof(ndo2db_object_key), ndo2db_compare_object_keys);
+		ndo2db_load_object_ids(idi, key, missing);
+		ndo2db_object_file_flush(idi);
+		for (x = 0; x < missing; x++) {
+			if (ndo2db_get_cached_object_id(idi, object_type, key[x].name1, key[x].name2, &object_id) == NDO_OK)
+				ndo2db_set_object_as_active(idi, object_type, object_id);
+		}
 	}
 
-	if (!first)
-		rc = ndo2db_db_query(idi, dbuf.buf);
-	ndo_dbuf_free(&dbuf);
-	return rc;
+	free(key);
+	return NDO_OK;
 }
 
-int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_id, char *ts ){
+int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_id, time_t t){
 	char *buf=NULL;
 	char *buf1=NULL;
 	ndo2db_mbuf mbuf;
+	ndo2db_dbstmt *stmt=NULL;
 	char *es[2];
+	char *ts=NULL;
 	char *ptr1=NULL;
 	char *ptr2=NULL;
 	char *ptr3=NULL;
 	int result=NDO_OK;
 	int has_been_modified=0;
 	int x=0;
+	char *saveptr=NULL;
 
 	/* save custom variables to db */
 	mbuf=idi->mbuf[NDO2DB_MBUF_CUSTOMVARIABLE];
@@ -5042,15 +5419,31 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 		if(mbuf.buffer[x]==NULL)
 			continue;
 
-		if((ptr1=strtok(mbuf.buffer[x],":"))==NULL)
+		if((ptr1=strtok_r(mbuf.buffer[x],":",&saveptr))==NULL)
 			continue;
 
-		es[0]=strdup(ptr1);
-		if((ptr2=strtok(NULL,":"))==NULL)
+		if((ptr2=strtok_r(NULL,":",&saveptr))==NULL)
 			continue;
 		has_been_modified=atoi(ptr2);
-		ptr3=strtok(NULL,"\n");
+		ptr3=strtok_r(NULL,"\n",&saveptr);
+
+		/* status updates bind the values straight to a prepared statement if we can */
+		if(table_idx==NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS && (stmt=ndo2db_db_stmt_begin(idi,NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS
+			    ,"instance_id, object_id, status_update_time, has_been_modified, varname, varvalue"
+			    ,"?,?,FROM_UNIXTIME(?),?,?,?"
+			    ,"instance_id, object_id, status_update_time, has_been_modified, varname, varvalue"
+			   ))!=NULL){
+			ndo2db_db_stmt_bind_int(stmt,idi->dbinfo.instance_id);
+			ndo2db_db_stmt_bind_int(stmt,o_id);
+			ndo2db_db_stmt_bind_int(stmt,t);
+			ndo2db_db_stmt_bind_int(stmt,has_been_modified);
+			ndo2db_db_stmt_bind_string(stmt,ptr1);
+			ndo2db_db_stmt_bind_string(stmt,(ptr3==NULL)?"":ptr3);
+			result=ndo2db_db_stmt_execute(idi,stmt);
+			continue;
+		        }
 
+		es[0]=strdup(ptr1);
 		buf1=strdup((ptr3==NULL)?"":ptr3);
 		es[1]=ndo2db_db_escape_string(idi,buf1);
 		free(buf1);
@@ -5067,6 +5460,7 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 				buf=NULL;
 		}
 		if (table_idx==NDO2DB_DBTABLE_CUSTOMVARIABLESTATUS) {
+			ts=ndo2db_db_timet_to_sql(idi,t);
 			if(asprintf(&buf,"instance_id='%d', object_id='%lu',status_update_time=%s, has_been_modified='%d', varname='%s', varvalue='%s'"
 					,idi->dbinfo.instance_id
 					,o_id
@@ -5076,20 +5470,13 @@ int ndo2db_save_custom_variables(ndo2db_idi *idi,int table_idx, unsigned long o_
 					,(es[1]==NULL)?"":es[1]
 				)==-1)
 				buf=NULL;
+			free(ts);
 		}
 		free(es[0]);
 		free(es[1]);
 
-		if(asprintf(&buf1,"INSERT INtO %s SET %s ON DUPLICATE KEY UPDATE %s"
-			    ,ndo2db_db_tablenames[table_idx]
-			    ,buf
-			    ,buf
-			   )==-1)
-			buf1=NULL;
-
-		result=ndo2db_db_query(idi,buf1);
+		result=ndo2db_save_config_row(idi,table_idx,buf,0L,NULL);
 		free(buf);
-		free(buf1);
 	}
 	return result;
 }
@@ -0,0 +1,711 @@
+/**
+ * @file eventserver.c Event driven (epoll) connection handling for ndo2db daemon
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * All client sockets are multiplexed by a single epoll thread, which only
+ * reads.  Every client is pinned to one of a fixed number of writer threads
+ * when it connects, so its data is always parsed and written in order by
+ * the same thread.  Each writer owns one database connection and lends it
+ * to the ndo2db_idi of whichever client it is working on.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/eventserver.h"
+#include "../include/statuscache.h"
+#include "../include/objectbatch.h"
+#include "../include/configload.h"
+#include "../include/configdigest.h"
+#include "../include/trimmer.h"
+#include "../include/metrics.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+extern int ndo2db_writer_threads;
+extern unsigned long ndo2db_queue_size;
+extern char *ndo2db_capture_file;
+extern int ndo2db_status_flush_interval;
+
+#ifdef HAVE_SYS_EPOLL_H
+
+static ndo2db_writer *ndo2db_writers=NULL;
+static int ndo2db_num_writers=0;
+static ndo2db_event_client *ndo2db_paused_clients=NULL;
+
+
+/****************************************************************************/
+/* WRITER THREADS                                                           */
+/****************************************************************************/
+
+/* queues a unit of work for a writer thread */
+static void ndo2db_writer_push(ndo2db_writer *w, ndo2db_event_chunk *chunk){
+
+	chunk->next=NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->tail==NULL)
+		w->head=chunk;
+	else
+		w->tail->next=chunk;
+	w->tail=chunk;
+	w->queued_bytes+=chunk->len;
+	if(chunk->client!=NULL){
+		chunk->client->queued_bytes+=chunk->len;
+		ndo2db_metrics_queue(&chunk->client->idi,(unsigned long)chunk->client->queued_bytes);
+	        }
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+        }
+
+
+/* queues a control message (no data) for a client's writer */
+static int ndo2db_writer_push_control(ndo2db_event_client *c, int type){
+	ndo2db_event_chunk *chunk=NULL;
+
+	if((chunk=(ndo2db_event_chunk *)malloc(sizeof(ndo2db_event_chunk)))==NULL)
+		return NDO_ERROR;
+
+	chunk->type=type;
+	chunk->client=c;
+	chunk->len=0;
+	ndo2db_writer_push(c->writer,chunk);
+
+	return NDO_OK;
+        }
+
+
+/* number of bytes a writer has yet to handle */
+static size_t ndo2db_writer_backlog(ndo2db_writer *w){
+	size_t bytes=0;
+
+	pthread_mutex_lock(&w->lock);
+	bytes=w->queued_bytes;
+	pthread_mutex_unlock(&w->lock);
+
+	return bytes;
+        }
+
+
+/* passes the completed lines in a chunk of client data to the handlers */
+static void ndo2db_writer_handle_data(ndo2db_event_client *c, ndo2db_event_chunk *chunk){
+	unsigned long linelen=0L;
+	char *ptr=NULL;
+	char *line=NULL;
+
+	if((ptr=ndo_lbuf_reserve(&c->lbuf,(unsigned long)chunk->len))==NULL){
+		syslog(LOG_ERR,"Error: Could not grow the input line buffer, dropping %lu bytes\n",(unsigned long)chunk->len);
+		ndo2db_metrics_dropped(&c->idi,(unsigned long)chunk->len);
+		return;
+	        }
+	memcpy(ptr,chunk->data,chunk->len);
+	ndo_lbuf_commit(&c->lbuf,(unsigned long)chunk->len);
+
+	while((line=ndo_lbuf_next_line(&c->lbuf,&linelen))!=NULL){
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,2,"Handling: %s\n",line);
+		ndo2db_handle_client_input(&c->idi,line);
+
+		c->idi.lines_processed++;
+		c->idi.bytes_processed+=linelen+1;
+		ndo2db_metrics_input(&c->idi,1L,linelen+1);
+	        }
+        }
+
+
+/* lends our database connection to a client */
+static void ndo2db_writer_lend(ndo2db_writer *w, ndo2db_event_client *c){
+
+#ifdef USE_MYSQL
+	c->idi.dbinfo.mysql_conn=w->mysql_conn;
+#endif
+	c->idi.dbinfo.connected=w->connected;
+	c->idi.dbinfo.stmt=w->stmt;
+        }
+
+
+/* takes the connection back, the handlers may have reconnected or dropped it */
+static void ndo2db_writer_take_back(ndo2db_writer *w, ndo2db_event_client *c){
+
+#ifdef USE_MYSQL
+	w->mysql_conn=c->idi.dbinfo.mysql_conn;
+	c->idi.dbinfo.mysql_conn=NULL;
+#endif
+	w->connected=c->idi.dbinfo.connected;
+	w->stmt=c->idi.dbinfo.stmt;
+	c->idi.dbinfo.stmt=NULL;
+	c->idi.dbinfo.last_stmt=NULL;
+        }
+
+
+/* keeps track of the clients that have status updates held back */
+static void ndo2db_writer_track_status(ndo2db_writer *w, ndo2db_event_client *c){
+	ndo2db_event_client **cp=NULL;
+	int holding=NDO_FALSE;
+
+	if(c->idi.status_cache!=NULL && c->idi.status_cache->head!=NULL)
+		holding=NDO_TRUE;
+
+	if(holding==c->holding_status)
+		return;
+
+	if(holding==NDO_TRUE){
+		c->next_holding=w->holding;
+		w->holding=c;
+	        }
+	else{
+		for(cp=&w->holding;*cp!=NULL;cp=&(*cp)->next_holding){
+			if(*cp==c){
+				*cp=c->next_holding;
+				break;
+			        }
+		        }
+		c->next_holding=NULL;
+	        }
+	c->holding_status=holding;
+
+	/* the epoll thread wakes us up while any are held */
+	pthread_mutex_lock(&w->lock);
+	w->holding_clients+=(holding==NDO_TRUE)?1:-1;
+	pthread_mutex_unlock(&w->lock);
+        }
+
+
+/* writes the status updates of quiet clients once they have waited long enough */
+static void ndo2db_writer_flush_status(ndo2db_writer *w){
+	ndo2db_event_client *c=NULL;
+	ndo2db_event_client *next_c=NULL;
+
+	for(c=w->holding;c!=NULL;c=next_c){
+		next_c=c->next_holding;
+
+		ndo2db_writer_lend(w,c);
+		ndo2db_status_cache_flush_expired(&c->idi);
+		if(c->idi.status_cache->head==NULL)
+			ndo2db_db_commit(&c->idi);
+		ndo2db_writer_take_back(w,c);
+
+		ndo2db_writer_track_status(w,c);
+	        }
+        }
+
+
+/* lets the epoll thread know we're done with a chunk */
+static void ndo2db_writer_done(ndo2db_writer *w, ndo2db_event_chunk *chunk){
+
+	pthread_mutex_lock(&w->lock);
+	w->busy=NDO_FALSE;
+	pthread_mutex_unlock(&w->lock);
+
+	free(chunk);
+        }
+
+
+/* frees everything belonging to a client once its writer is done with it */
+static void ndo2db_writer_free_client(ndo2db_event_client *c){
+
+	ndo2db_trimmer_stop(&c->idi);
+
+	ndo2db_free_cached_object_ids(&c->idi);
+	ndo2db_db_free_batches(&c->idi);
+	ndo2db_db_free_transaction(&c->idi);
+	ndo2db_forget_new_objects(&c->idi);
+	ndo2db_status_cache_free(&c->idi);
+	ndo2db_object_batch_free(&c->idi);
+	ndo2db_config_load_free(&c->idi);
+	ndo2db_config_digest_free(&c->idi);
+	ndo2db_free_active_objects(&c->idi);
+	ndo2db_free_logentry_window(&c->idi);
+	ndo2db_free_input_memory(&c->idi);
+	ndo2db_free_connection_memory(&c->idi);
+	ndo_lbuf_free(&c->lbuf);
+	ndo2db_metrics_close(&c->idi);
+
+	close(c->sd);
+	free(c);
+        }
+
+
+/* writer thread main loop */
+static void *ndo2db_writer_thread(void *arg){
+	ndo2db_writer *w=(ndo2db_writer *)arg;
+	ndo2db_event_chunk *chunk=NULL;
+	ndo2db_event_client *c=NULL;
+
+#ifdef USE_MYSQL
+	mysql_thread_init();
+#endif
+
+	while(1){
+
+		/* wait for work */
+		pthread_mutex_lock(&w->lock);
+		while(w->head==NULL && w->shutdown==NDO_FALSE)
+			pthread_cond_wait(&w->cond,&w->lock);
+		if((chunk=w->head)==NULL){
+			pthread_mutex_unlock(&w->lock);
+			break;
+		        }
+		if((w->head=chunk->next)==NULL)
+			w->tail=NULL;
+		w->queued_bytes-=chunk->len;
+		w->busy=NDO_TRUE;
+		if(chunk->type==NDO2DB_EVENT_CHUNK_TICK)
+			w->tick_pending=NDO_FALSE;
+		if((c=chunk->client)!=NULL){
+			c->queued_bytes-=chunk->len;
+			ndo2db_metrics_queue(&c->idi,(unsigned long)c->queued_bytes);
+		        }
+		pthread_mutex_unlock(&w->lock);
+
+		/* a tick is for all of our clients that are holding status updates */
+		if(chunk->type==NDO2DB_EVENT_CHUNK_TICK){
+			ndo2db_writer_flush_status(w);
+			ndo2db_writer_done(w,chunk);
+			continue;
+		        }
+
+		/* lend our database connection to this client */
+		ndo2db_writer_lend(w,c);
+
+		switch(chunk->type){
+
+		case NDO2DB_EVENT_CHUNK_OPEN:
+			ndo2db_db_connect(&c->idi);
+			break;
+
+		case NDO2DB_EVENT_CHUNK_DATA:
+			if(c->idi.ignore_client_data==NDO_FALSE)
+				ndo2db_writer_handle_data(c,chunk);
+			/* batches and transactions can't outlive the loan of our connection */
+			ndo2db_db_commit(&c->idi);
+			break;
+
+		case NDO2DB_EVENT_CHUNK_CLOSE:
+			/* write the definitions and status updates we've been holding back */
+			ndo2db_object_batch_flush(&c->idi);
+			ndo2db_config_load_flush(&c->idi);
+			ndo2db_save_active_objects(&c->idi);
+			ndo2db_status_cache_flush(&c->idi);
+			/* gracefully back out of current operation... */
+			ndo2db_db_goodbye(&c->idi);
+			break;
+
+		default:
+			break;
+		        }
+
+		/* take the connection back */
+		ndo2db_writer_take_back(w,c);
+
+		/* a closed client has written everything it held */
+		ndo2db_writer_track_status(w,c);
+
+		if(chunk->type==NDO2DB_EVENT_CHUNK_CLOSE)
+			ndo2db_writer_free_client(c);
+
+		/* the epoll thread sees the hangup and closes the client (a lost database connection is replayed instead) */
+		else if(c->idi.ignore_client_data==NDO_TRUE && c->shut_down==NDO_FALSE){
+			c->shut_down=NDO_TRUE;
+			shutdown(c->sd,SHUT_RDWR);
+		        }
+
+		ndo2db_writer_done(w,chunk);
+	        }
+
+	/* the statements were prepared on our connection */
+	ndo2db_db_free_statements(w->stmt);
+	w->stmt=NULL;
+
+#ifdef USE_MYSQL
+	if(w->mysql_conn!=NULL)
+		mysql_close(w->mysql_conn);
+	w->mysql_conn=NULL;
+	mysql_thread_end();
+#endif
+
+	return NULL;
+        }
+
+
+/* starts the writer threads */
+static int ndo2db_start_writers(void){
+	int x=0;
+
+	ndo2db_num_writers=ndo2db_writer_threads;
+	if(ndo2db_num_writers<1)
+		ndo2db_num_writers=1;
+	if(ndo2db_num_writers>NDO2DB_MAX_WRITER_THREADS)
+		ndo2db_num_writers=NDO2DB_MAX_WRITER_THREADS;
+
+	if((ndo2db_writers=(ndo2db_writer *)calloc(ndo2db_num_writers,sizeof(ndo2db_writer)))==NULL){
+		ndo2db_num_writers=0;
+		return NDO_ERROR;
+	        }
+
+#ifdef USE_MYSQL
+	/* must happen before any thread calls mysql_init() */
+	mysql_library_init(0,NULL,NULL);
+#endif
+
+	for(x=0;x<ndo2db_num_writers;x++){
+		ndo2db_writers[x].id=x;
+		ndo2db_writers[x].shutdown=NDO_FALSE;
+		ndo2db_writers[x].connected=NDO_FALSE;
+		pthread_mutex_init(&ndo2db_writers[x].lock,NULL);
+		pthread_cond_init(&ndo2db_writers[x].cond,NULL);
+		if(pthread_create(&ndo2db_writers[x].thread,NULL,ndo2db_writer_thread,&ndo2db_writers[x])!=0){
+			syslog(LOG_ERR,"Error: Could not start database writer thread %d\n",x);
+			ndo2db_num_writers=x;
+			return NDO_ERROR;
+		        }
+	        }
+
+	syslog(LOG_INFO,"Started %d database writer threads\n",ndo2db_num_writers);
+
+	return NDO_OK;
+        }
+
+
+/* lets the writers finish their queued work and waits for them */
+static void ndo2db_stop_writers(void){
+	int x=0;
+
+	for(x=0;x<ndo2db_num_writers;x++){
+		pthread_mutex_lock(&ndo2db_writers[x].lock);
+		ndo2db_writers[x].shutdown=NDO_TRUE;
+		pthread_cond_signal(&ndo2db_writers[x].cond);
+		pthread_mutex_unlock(&ndo2db_writers[x].lock);
+	        }
+
+	for(x=0;x<ndo2db_num_writers;x++)
+		pthread_join(ndo2db_writers[x].thread,NULL);
+
+	free(ndo2db_writers);
+	ndo2db_writers=NULL;
+	ndo2db_num_writers=0;
+        }
+
+
+/****************************************************************************/
+/* EPOLL THREAD                                                             */
+/****************************************************************************/
+
+/* stop watching a client and hand it to its writer for cleanup */
+static void ndo2db_event_close_client(int epfd, ndo2db_event_client *c){
+
+	if(c->paused==NDO_FALSE)
+		epoll_ctl(epfd,EPOLL_CTL_DEL,c->sd,NULL);
+	c->writer->clients--;
+	ndo2db_capture_close(&c->capture);
+
+	/* the writer frees the client after saying goodbye */
+	if(ndo2db_writer_push_control(c,NDO2DB_EVENT_CHUNK_CLOSE)==NDO_ERROR)
+		syslog(LOG_ERR,"Error: Could not queue client disconnect, leaking connection\n");
+        }
+
+
+/* accepts all pending connections */
+static void ndo2db_event_accept(int epfd, int sd){
+	ndo2db_event_client *c=NULL;
+	ndo2db_writer *w=NULL;
+	struct epoll_event ev;
+	int new_sd=0;
+	int x=0;
+
+	while(1){
+
+		if((new_sd=accept(sd,NULL,NULL))<0){
+			if(errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)
+				syslog(LOG_ERR,"Error: accept() failed: %s\n",strerror(errno));
+			return;
+		        }
+
+		fcntl(new_sd,F_SETFL,fcntl(new_sd,F_GETFL)|O_NONBLOCK);
+
+		if((c=(ndo2db_event_client *)calloc(1,sizeof(ndo2db_event_client)))==NULL){
+			close(new_sd);
+			continue;
+		        }
+		c->sd=new_sd;
+
+		/* initialize input data information */
+		ndo2db_idi_init(&c->idi);
+		ndo2db_db_init(&c->idi);
+		if(ndo_lbuf_init(&c->lbuf,NDO2DB_EVENT_READ_SIZE*2)==NDO_ERROR){
+			close(new_sd);
+			free(c);
+			continue;
+		        }
+		ndo2db_metrics_open(&c->idi);
+		ndo2db_capture_open(&c->capture);
+
+		/* pin the client to the writer with the fewest clients */
+		w=&ndo2db_writers[0];
+		for(x=1;x<ndo2db_num_writers;x++){
+			if(ndo2db_writers[x].clients<w->clients)
+				w=&ndo2db_writers[x];
+		        }
+		c->writer=w;
+		w->clients++;
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Client connected on fd %d, using writer %d\n",new_sd,w->id);
+
+		ndo2db_writer_push_control(c,NDO2DB_EVENT_CHUNK_OPEN);
+
+		ev.events=EPOLLIN;
+		ev.data.ptr=c;
+		if(epoll_ctl(epfd,EPOLL_CTL_ADD,new_sd,&ev)<0){
+			syslog(LOG_ERR,"Error: Could not watch client socket: %s\n",strerror(errno));
+			ndo2db_event_close_client(epfd,c);
+		        }
+	        }
+        }
+
+
+/* reads what a client has sent and passes it to its writer */
+static void ndo2db_event_read(int epfd, ndo2db_event_client *c){
+	ndo2db_event_chunk *chunk=NULL;
+	ndo2db_event_chunk *newchunk=NULL;
+	size_t limit=(size_t)ndo2db_queue_size*1024*1024;
+	int result=0;
+	int x=0;
+
+	for(x=0;x<NDO2DB_EVENT_MAX_READS;x++){
+
+		if((chunk=(ndo2db_event_chunk *)malloc(sizeof(ndo2db_event_chunk)+NDO2DB_EVENT_READ_SIZE))==NULL)
+			return;
+
+		result=read(c->sd,chunk->data,NDO2DB_EVENT_READ_SIZE);
+
+		if(result<0){
+			free(chunk);
+			if(errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR)
+				return;
+			ndo2db_event_close_client(epfd,c);
+			return;
+		        }
+
+		/* zero bytes read means we lost the connection with the client */
+		if(result==0){
+			free(chunk);
+			ndo2db_event_close_client(epfd,c);
+			return;
+		        }
+
+		ndo2db_capture_write(&c->capture,chunk->data,(size_t)result);
+
+		/* give back what we didn't use */
+		if(result<NDO2DB_EVENT_READ_SIZE/2 && (newchunk=(ndo2db_event_chunk *)realloc(chunk,sizeof(ndo2db_event_chunk)+result))!=NULL)
+			chunk=newchunk;
+
+		chunk->type=NDO2DB_EVENT_CHUNK_DATA;
+		chunk->client=c;
+		chunk->len=(size_t)result;
+		ndo2db_writer_push(c->writer,chunk);
+
+		/* stop watching this client until its writer catches up */
+		if(ndo2db_writer_backlog(c->writer)>=limit){
+			epoll_ctl(epfd,EPOLL_CTL_DEL,c->sd,NULL);
+			c->paused=NDO_TRUE;
+			c->next_paused=ndo2db_paused_clients;
+			ndo2db_paused_clients=c;
+			return;
+		        }
+	        }
+        }
+
+
+/* resumes reading from paused clients whose writer has caught up */
+static void ndo2db_event_check_paused(int epfd){
+	ndo2db_event_client **cp=&ndo2db_paused_clients;
+	ndo2db_event_client *c=NULL;
+	size_t limit=(size_t)ndo2db_queue_size*1024*1024;
+	struct epoll_event ev;
+
+	while((c=*cp)!=NULL){
+
+		if(ndo2db_writer_backlog(c->writer)>=limit/2){
+			cp=&c->next_paused;
+			continue;
+		        }
+
+		*cp=c->next_paused;
+		c->next_paused=NULL;
+		c->paused=NDO_FALSE;
+
+		ev.events=EPOLLIN;
+		ev.data.ptr=c;
+		if(epoll_ctl(epfd,EPOLL_CTL_ADD,c->sd,&ev)<0)
+			ndo2db_event_close_client(epfd,c);
+	        }
+        }
+
+
+/* are any writers holding back status updates, or could they be once they're done with what we gave them? */
+static int ndo2db_event_holding_status(void){
+	int holding=NDO_FALSE;
+	int x=0;
+
+	for(x=0;x<ndo2db_num_writers && holding==NDO_FALSE;x++){
+		pthread_mutex_lock(&ndo2db_writers[x].lock);
+		if(ndo2db_writers[x].holding_clients>0 || ndo2db_writers[x].head!=NULL || ndo2db_writers[x].busy==NDO_TRUE)
+			holding=NDO_TRUE;
+		pthread_mutex_unlock(&ndo2db_writers[x].lock);
+	        }
+
+	return holding;
+        }
+
+
+/* twice every status_flush_interval, has the writers write out status updates that are due */
+static void ndo2db_event_tick_writers(void){
+	static struct timeval last_tick;
+	struct timeval now;
+	ndo2db_event_chunk *chunk=NULL;
+	int tick=NDO_FALSE;
+	int x=0;
+
+	gettimeofday(&now,NULL);
+	if((now.tv_sec-last_tick.tv_sec)*1000L+(now.tv_usec-last_tick.tv_usec)/1000L<ndo2db_status_flush_interval/2)
+		return;
+	last_tick=now;
+
+	for(x=0;x<ndo2db_num_writers;x++){
+
+		/* one tick at a time is enough */
+		pthread_mutex_lock(&ndo2db_writers[x].lock);
+		tick=(ndo2db_writers[x].holding_clients>0 && ndo2db_writers[x].tick_pending==NDO_FALSE)?NDO_TRUE:NDO_FALSE;
+		if(tick==NDO_TRUE)
+			ndo2db_writers[x].tick_pending=NDO_TRUE;
+		pthread_mutex_unlock(&ndo2db_writers[x].lock);
+
+		if(tick==NDO_FALSE)
+			continue;
+
+		if((chunk=(ndo2db_event_chunk *)malloc(sizeof(ndo2db_event_chunk)))==NULL){
+			pthread_mutex_lock(&ndo2db_writers[x].lock);
+			ndo2db_writers[x].tick_pending=NDO_FALSE;
+			pthread_mutex_unlock(&ndo2db_writers[x].lock);
+			continue;
+		        }
+		chunk->type=NDO2DB_EVENT_CHUNK_TICK;
+		chunk->client=NULL;
+		chunk->len=0;
+		ndo2db_writer_push(&ndo2db_writers[x],chunk);
+	        }
+        }
+
+
+/* multiplexes all client connections on the listening socket */
+int ndo2db_event_server(int sd){
+	struct epoll_event ev;
+	struct epoll_event events[NDO2DB_EVENT_MAX_EVENTS];
+	int epfd=-1;
+	int nfds=0;
+	int timeout=-1;
+	int x=0;
+
+	if((epfd=epoll_create(NDO2DB_EVENT_MAX_EVENTS))<0){
+		syslog(LOG_ERR,"Error: epoll_create() failed: %s\n",strerror(errno));
+		return NDO_ERROR;
+	        }
+
+	fcntl(sd,F_SETFL,fcntl(sd,F_GETFL)|O_NONBLOCK);
+
+	ev.events=EPOLLIN;
+	ev.data.ptr=NULL;
+	if(epoll_ctl(epfd,EPOLL_CTL_ADD,sd,&ev)<0){
+		syslog(LOG_ERR,"Error: Could not watch listening socket: %s\n",strerror(errno));
+		close(epfd);
+		return NDO_ERROR;
+	        }
+
+	if(ndo2db_start_writers()==NDO_ERROR){
+		ndo2db_stop_writers();
+		close(epfd);
+		return NDO_ERROR;
+	        }
+
+	while(1){
+
+		/* wake up now and then to write out the captures of quiet clients */
+		timeout=(ndo2db_paused_clients==NULL)?-1:NDO2DB_EVENT_PAUSE_CHECK;
+		if(ndo2db_capture_file!=NULL && (timeout<0 || timeout>NDO2DB_CAPTURE_FLUSH_TIME*1000))
+			timeout=NDO2DB_CAPTURE_FLUSH_TIME*1000;
+
+		/* and to have held back status updates written when the stream goes quiet */
+		if(ndo2db_status_flush_interval>0 && (timeout<0 || timeout>ndo2db_status_flush_interval/2) && ndo2db_event_holding_status()==NDO_TRUE)
+			timeout=ndo2db_status_flush_interval/2;
+
+		nfds=epoll_wait(epfd,events,NDO2DB_EVENT_MAX_EVENTS,timeout);
+
+		if(nfds<0){
+			if(errno==EINTR)
+				continue;
+			syslog(LOG_ERR,"Error: epoll_wait() failed: %s\n",strerror(errno));
+			break;
+		        }
+
+		for(x=0;x<nfds;x++){
+
+			/* new connections */
+			if(events[x].data.ptr==NULL)
+				ndo2db_event_accept(epfd,sd);
+
+			/* data or hangup from a client */
+			else
+				ndo2db_event_read(epfd,(ndo2db_event_client *)events[x].data.ptr);
+		        }
+
+		if(ndo2db_paused_clients!=NULL)
+			ndo2db_event_check_paused(epfd);
+
+		if(ndo2db_capture_file!=NULL)
+			ndo2db_capture_idle();
+
+		if(ndo2db_status_flush_interval>0)
+			ndo2db_event_tick_writers();
+	        }
+
+	ndo2db_stop_writers();
+	close(epfd);
+
+	return NDO_ERROR;
+        }
+
+#else
+
+int ndo2db_event_server(int sd){
+
+	syslog(LOG_ERR,"Error: The event driven server model is not supported on this platform\n");
+
+	return NDO_ERROR;
+        }
+
+#endif
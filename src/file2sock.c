@@ -30,13 +30,48 @@
 #include "../include/config.h"
 #include "../include/common.h"
 #include "../include/io.h"
+#include "../include/protoapi.h"
+#include "../include/capture.h"
 
 #define FILE2SOCK_VERSION "2.1.2"
 #define FILE2SOCK_NAME "FILE2SOCK"
 #define FILE2SOCK_DATE "11-14-2016"
 
+#define FILE2SOCK_CHUNK_SIZE	(64*1024)	/* bytes read at a time from plain files */
+#define FILE2SOCK_MAX_COPIES	1000
+
+
+/* what one copy of the stream did */
+typedef struct replay_stats_struct{
+	int copy;
+	unsigned long long events;
+	unsigned long long bytes;
+	double start;			/* connected */
+	double sent;			/* last byte written */
+	double done;			/* ndo2db closed the connection */
+	double max_lag;			/* furthest behind the capture's timing */
+	int timed;			/* the source was a capture replayed in time */
+	char instance[256];
+        }replay_stats;
+
+/* where a copy is in its stream */
+typedef struct replay_state_struct{
+	int sd;
+	int copy;
+	int in_header;			/* before STARTDATADUMP */
+	char *line;			/* partial line carried over between reads */
+	size_t linelen;
+	size_t linesize;
+	char *out;			/* complete lines waiting to be sent */
+	size_t outlen;
+	size_t outsize;
+	replay_stats *stats;
+        }replay_state;
+
 
 int process_arguments(int,char **);
+int replay_source(int,replay_stats *);
+void print_stats(const char *,replay_stats *);
 
 
 char *source_name=NULL;
@@ -46,14 +81,22 @@ int tcp_port=0;
 int show_version=NDO_FALSE;
 int show_license=NDO_FALSE;
 int show_help=NDO_FALSE;
+int show_stats=NDO_FALSE;
+int timed_replay=NDO_FALSE;
+double replay_speed=0.0;		/* 0 sends as fast as possible */
+char *instance_name=NULL;
+int copies=1;
+char enddata_line[16];			/* the line every event ends with */
+size_t enddata_len=0;
 
 int main(int argc, char **argv){
-	int sd=0;
-	int fd=0;
-	char ch[511];	/* Matches ndo2db read buffer size */
+	replay_stats *stats=NULL;
+	replay_stats total;
+	replay_stats done;
+	int pipefd[2];
+	pid_t pid;
 	int result=0;
-	int nbytesread,n,i;
-	char *p;
+	int x=0;
 
 
 	result=process_arguments(argc,argv);
@@ -74,7 +117,12 @@ int main(int argc, char **argv){
 		printf("the file are sent in their original format - no conversion, encapsulation, or\n");
 		printf("other processing is done before sending the contents to the destination socket.\n");
 		printf("\n");
-		printf("Usage: %s -s <source> -d <dest> [-t <type>] [-p <port>]\n",argv[0]);
+		printf("Files captured by ndo2db (see capture_file in ndo2db.cfg) are replayed: what\n");
+		printf("each read brought in is sent again, as fast as possible or at the pace it\n");
+		printf("originally arrived in.\n");
+		printf("\n");
+		printf("Usage: %s -s <source> -d <dest> [-t <type>] [-p <port>] [-r <speed>]\n",argv[0]);
+		printf("                 [-i <instance>] [-c <copies>] [-S]\n");
 		printf("\n");
 		printf("<source>   = Name of the file to read from.  Use '-' to read from stdin.\n");
 		printf("<dest>     = If destination is a TCP socket, the address/hostname to connect to.\n");
@@ -83,71 +131,378 @@ int main(int argc, char **argv){
 		printf("                 tcp\n");
 		printf("                 unix (default)\n");
 		printf("<port>     = Port number to connect to if destination is TCP socket.\n");
+		printf("<speed>    = Replay a capture at this multiple of the speed it was captured\n");
+		printf("             at, 1 for the original pace.  'max' sends it as fast as possible.\n");
+		printf("<instance> = Instance name to send instead of the one in the source.\n");
+		printf("<copies>   = Send the source over this many connections at once.  Each copy\n");
+		printf("             gets '-<n>' appended to its instance name.\n");
+		printf("-S         = Wait for ndo2db to handle everything, then print the events,\n");
+		printf("             bytes, rates and lag.  Implied by -r and -c.\n");
 		printf("\n");
 
 		exit(1);
 	        }
 
+	if(copies>1 && !strcmp(source_name,"-")){
+		printf("Cannot send several copies of stdin\n");
+		exit(1);
+	        }
+
+	enddata_len=(size_t)snprintf(enddata_line,sizeof(enddata_line),"%d",NDO_API_ENDDATA);
+
+	if((stats=(replay_stats *)calloc(copies,sizeof(replay_stats)))==NULL){
+		perror("Cannot allocate memory");
+		exit(1);
+	        }
+
+	/* a single copy is sent from here */
+	if(copies==1)
+		result=replay_source(0,&stats[0]);
+
+	/* every copy has its own process and reports back over a pipe */
+	else{
+		if(pipe(pipefd)==-1){
+			perror("Cannot create pipe");
+			exit(1);
+		        }
+
+		for(x=0;x<copies;x++){
+			if((pid=fork())==-1){
+				perror("Cannot fork");
+				result=1;
+				break;
+			        }
+			if(pid==0){
+				close(pipefd[0]);
+				result=replay_source(x+1,&stats[x]);
+				if(write(pipefd[1],&stats[x],sizeof(replay_stats))!=sizeof(replay_stats))
+					result=1;
+				_exit(result);
+			        }
+		        }
+		close(pipefd[1]);
+
+		for(x=0;x<copies;x++){
+			if(read(pipefd[0],&done,sizeof(replay_stats))!=sizeof(replay_stats))
+				break;
+			if(done.copy>=1 && done.copy<=copies)
+				stats[done.copy-1]=done;
+		        }
+		close(pipefd[0]);
+
+		while((pid=wait(&x))>0){
+			if(!WIFEXITED(x) || WEXITSTATUS(x)!=0)
+				result=1;
+		        }
+	        }
+
+	if(show_stats==NDO_TRUE && result==0){
+
+		memset(&total,0,sizeof(total));
+		for(x=0;x<copies;x++){
+			if(copies>1)
+				print_stats(stats[x].instance,&stats[x]);
+			total.events+=stats[x].events;
+			total.bytes+=stats[x].bytes;
+			if(x==0 || stats[x].start<total.start)
+				total.start=stats[x].start;
+			if(stats[x].sent>total.sent)
+				total.sent=stats[x].sent;
+			if(stats[x].done>total.done)
+				total.done=stats[x].done;
+			if(stats[x].max_lag>total.max_lag)
+				total.max_lag=stats[x].max_lag;
+			total.timed|=stats[x].timed;
+		        }
+		if(copies>1)
+			printf("\n");
+		print_stats((copies>1)?"Total":NULL,&total);
+	        }
+
+	free(stats);
+
+	return result;
+        }
+
+
+static double now_seconds(void){
+	struct timeval tv;
+
+	gettimeofday(&tv,NULL);
+
+	return (double)tv.tv_sec+(double)tv.tv_usec/1000000.0;
+        }
+
+
+/* prints what was sent and how long ndo2db took to handle it */
+void print_stats(const char *label, replay_stats *stats){
+	double sending=stats->sent-stats->start;
+	double handling=stats->done-stats->start;
+
+	if(sending<=0.0)
+		sending=0.000001;
+	if(handling<=0.0)
+		handling=0.000001;
+
+	if(label!=NULL)
+		printf("%s:\n",label);
+	printf("Sent %llu events (%llu bytes) in %.3f s: %.0f events/s, %.2f MB/s\n",stats->events,stats->bytes,sending,(double)stats->events/sending,(double)stats->bytes/sending/1048576.0);
+	if(stats->timed==NDO_TRUE)
+		printf("At most %.3f s behind the capture replayed at %gx\n",stats->max_lag,replay_speed);
+	printf("Handled %.3f s after the last byte, %.3f s end to end: %.0f events/s, %.2f MB/s\n",stats->done-stats->sent,handling,(double)stats->events/handling,(double)stats->bytes/handling/1048576.0);
+        }
+
+
+/* writes out the complete lines collected so far */
+static int replay_flush(replay_state *rs){
+	char *p=rs->out;
+	size_t n=rs->outlen;
+	ssize_t i=0;
+
+	while(n>0){
+		i=write(rs->sd,p,n);
+		if(i<0){
+			if(errno==EINTR)
+				continue;
+			perror("Error while writing to destination socket");
+			return NDO_ERROR;
+		        }
+		p+=i;
+		n-=(size_t)i;
+	        }
+
+	rs->stats->bytes+=rs->outlen;
+	rs->outlen=0;
+
+	return NDO_OK;
+        }
+
+
+/* appends bytes to a growing buffer */
+static int replay_append(char **buf, size_t *len, size_t *size, const char *data, size_t datalen){
+	char *newbuf=NULL;
+	size_t newsize=0;
+
+	if(*len+datalen>*size){
+		newsize=(*size>0)?*size:4096;
+		while(*len+datalen>newsize)
+			newsize*=2;
+		if((newbuf=(char *)realloc(*buf,newsize))==NULL){
+			perror("Cannot allocate memory");
+			return NDO_ERROR;
+		        }
+		*buf=newbuf;
+		*size=newsize;
+	        }
+
+	memcpy(*buf+*len,data,datalen);
+	*len+=datalen;
+
+	return NDO_OK;
+        }
+
+
+/* counts the events in a complete line and renames the instance in the hello */
+static int replay_line(replay_state *rs, const char *line, size_t len){
+	char name[256];
+	size_t namelen=0;
+	size_t prefix=strlen(NDO_API_INSTANCENAME)+2;
+
+	/* every event ends with NDO_API_ENDDATA */
+	if(len==enddata_len && !strncmp(line,enddata_line,len))
+		rs->stats->events++;
+
+	else if(rs->in_header==NDO_TRUE){
+
+		if(len==strlen(NDO_API_STARTDATADUMP) && !strncmp(line,NDO_API_STARTDATADUMP,len))
+			rs->in_header=NDO_FALSE;
+
+		else if(len>=prefix && !strncmp(line,NDO_API_INSTANCENAME ": ",prefix)){
+
+			if(instance_name!=NULL)
+				namelen=snprintf(name,sizeof(name),"%s",instance_name);
+			else
+				namelen=snprintf(name,sizeof(name),"%.*s",(int)(len-prefix),line+prefix);
+			if(rs->copy>0 && namelen<sizeof(name))
+				namelen+=snprintf(name+namelen,sizeof(name)-namelen,"-%d",rs->copy);
+			if(namelen>=sizeof(name))
+				namelen=sizeof(name)-1;
+			snprintf(rs->stats->instance,sizeof(rs->stats->instance),"%s",name);
+
+			if(instance_name!=NULL || rs->copy>0){
+				if(replay_append(&rs->out,&rs->outlen,&rs->outsize,line,prefix)==NDO_ERROR)
+					return NDO_ERROR;
+				return replay_append(&rs->out,&rs->outlen,&rs->outsize,name,namelen);
+			        }
+		        }
+	        }
+
+	return replay_append(&rs->out,&rs->outlen,&rs->outsize,line,len);
+        }
+
+
+/* passes what was read on to the destination, whole lines at a time */
+static int replay_data(replay_state *rs, const char *buf, size_t len){
+	const char *nl=NULL;
+	size_t linelen=0;
+
+	while(len>0){
+
+		/* keep the start of a line until the rest of it arrives */
+		if((nl=memchr(buf,'\n',len))==NULL)
+			return replay_append(&rs->line,&rs->linelen,&rs->linesize,buf,len);
+
+		linelen=(size_t)(nl-buf);
+		if(rs->linelen>0){
+			if(replay_append(&rs->line,&rs->linelen,&rs->linesize,buf,linelen)==NDO_ERROR)
+				return NDO_ERROR;
+			if(replay_line(rs,rs->line,rs->linelen)==NDO_ERROR)
+				return NDO_ERROR;
+			rs->linelen=0;
+		        }
+		else if(replay_line(rs,buf,linelen)==NDO_ERROR)
+			return NDO_ERROR;
+		if(replay_append(&rs->out,&rs->outlen,&rs->outsize,"\n",1)==NDO_ERROR)
+			return NDO_ERROR;
+
+		buf+=linelen+1;
+		len-=linelen+1;
+	        }
+
+	return replay_flush(rs);
+        }
+
+
+/* sends the source over a connection of its own; copy 0 is the only one */
+int replay_source(int copy, replay_stats *stats){
+	replay_state rs;
+	FILE *fp=NULL;
+	char *buf=NULL;
+	char header[64];
+	double first=0.0;
+	double when=0.0;
+	double due=0.0;
+	double now=0.0;
+	unsigned long len=0L;
+	size_t nread=0;
+	int capture=NDO_FALSE;
+	int sd=0;
+	int result=0;
+
+	memset(&rs,0,sizeof(rs));
+	rs.copy=copy;
+	rs.in_header=NDO_TRUE;
+	rs.stats=stats;
+	stats->copy=copy;
+	snprintf(stats->instance,sizeof(stats->instance),"copy %d",copy);
+
 	/* open the source file for reading */
 	if(!strcmp(source_name,"-"))
-		fd=STDIN_FILENO;
-	else if((fd=open(source_name,O_RDONLY))==-1){
+		fp=stdin;
+	else if((fp=fopen(source_name,"r"))==NULL){
 		perror("Unable to open source file for reading");
-		exit(1);
+		return 1;
+	        }
+
+	if((buf=(char *)malloc(FILE2SOCK_CHUNK_SIZE))==NULL){
+		perror("Cannot allocate memory");
+		fclose(fp);
+		return 1;
 	        }
 
 	/* open data sink */
 	if(ndo_sink_open(dest_name,sd,socket_type,tcp_port,0,&sd)==NDO_ERROR){
 		perror("Cannot open destination socket");
-		close(fd);
-		exit(1);
+		fclose(fp);
+		free(buf);
+		return 1;
 	        }
+	rs.sd=sd;
+	stats->start=now_seconds();
+
+	/* captures start with a line of their own, anything else is sent as it is */
+	if(fgets(buf,FILE2SOCK_CHUNK_SIZE,fp)!=NULL){
+		if(!strcmp(buf,NDO2DB_CAPTURE_MAGIC "\n"))
+			capture=NDO_TRUE;
+		else if(replay_data(&rs,buf,strlen(buf))==NDO_ERROR)
+			result=1;
+	        }
+	if(capture==NDO_FALSE && timed_replay==NDO_TRUE && replay_speed>0.0)
+		fprintf(stderr,"%s is not a capture, sending it as fast as possible\n",source_name);
+	stats->timed=(capture==NDO_TRUE && timed_replay==NDO_TRUE && replay_speed>0.0)?NDO_TRUE:NDO_FALSE;
 
-	/* we're reading from stdin... */
-#ifdef USE_SENDFILE
-	if(fd==STDIN_FILENO){
-#endif
-		while((nbytesread = read(fd,&ch,sizeof(ch))) > 0){
-			p = &ch[0];
-			n = nbytesread;
-			while (n > 0) {
-				i = write(sd, p, n);
-				if(i < 0){
-					perror("Error while writing to destination socket");
-					result=1;
-					goto breakout;
-					}
-				p += i;
-				n -= i;
-				}
+	while(result==0){
+
+		/* plain files are sent a chunk at a time */
+		if(capture==NDO_FALSE){
+			if((nread=fread(buf,1,FILE2SOCK_CHUNK_SIZE,fp))==0)
+				break;
 		        }
-		breakout:
-#ifdef USE_SENDFILE
-	        }
 
-	/* we're reading from a standard file... */
-	else{
+		/* captures a read at a time, at the pace they came in if asked to */
+		else{
+			if(fgets(header,sizeof(header),fp)==NULL)
+				break;
+			if(sscanf(header,"%lf %lu",&when,&len)!=2){
+				fprintf(stderr,"Malformed capture record: %s",header);
+				result=1;
+				break;
+			        }
+			if(stats->timed==NDO_TRUE){
+				if(first==0.0)
+					first=when;
+				due=stats->start+(when-first)/replay_speed;
+				if((now=now_seconds())<due)
+					usleep((useconds_t)((due-now)*1000000.0));
+				else if(now-due>stats->max_lag)
+					stats->max_lag=now-due;
+			        }
+			while(len>0){
+				nread=fread(buf,1,(len<FILE2SOCK_CHUNK_SIZE)?len:FILE2SOCK_CHUNK_SIZE,fp);
+				if(nread==0)
+					break;
+				if(replay_data(&rs,buf,nread)==NDO_ERROR){
+					result=1;
+					break;
+				        }
+				len-=nread;
+			        }
+			if(len>0 && result==0){
+				fprintf(stderr,"Capture ends in the middle of a record\n");
+				result=1;
+			        }
+			continue;
+		        }
 
-		/* get file size info */
-		if(fstat(fd,&stat_buf)==-1){
-			perror("fstat() error");
+		if(replay_data(&rs,buf,nread)==NDO_ERROR)
 			result=1;
-		        }
+	        }
 
-		/* send the file contents to the socket */
-		else if(sendfile(sd,fd,&offset,stat_buf.st_size)==-1){
-			perror("sendfile() error");
+	/* send what is left of an unfinished last line */
+	if(result==0 && rs.linelen>0){
+		if(replay_line(&rs,rs.line,rs.linelen)==NDO_ERROR || replay_flush(&rs)==NDO_ERROR)
 			result=1;
-		        }
 	        }
-#endif
+	stats->sent=now_seconds();
+
+	/* ndo2db closes the connection once it has handled everything */
+	if(show_stats==NDO_TRUE){
+		shutdown(sd,SHUT_WR);
+		while(read(sd,buf,FILE2SOCK_CHUNK_SIZE)>0);
+	        }
+	stats->done=now_seconds();
 
 	/* close the data sink */
 	ndo_sink_flush(sd);
 	ndo_sink_close(sd);
 
 	/* close the source file */
-	close(fd);
+	if(fp!=stdin)
+		fclose(fp);
+
+	free(buf);
+	free(rs.line);
+	free(rs.out);
 
 	return result;
         }
@@ -165,6 +520,10 @@ int process_arguments(int argc, char **argv){
 		{"dest", required_argument, 0, 'd'},
 		{"type", required_argument, 0, 't'},
 		{"port", required_argument, 0, 'p'},
+		{"rate", required_argument, 0, 'r'},
+		{"instance", required_argument, 0, 'i'},
+		{"copies", required_argument, 0, 'c'},
+		{"stats", no_argument, 0, 'S'},
 		{"help", no_argument, 0, 'h'},
 		{"license", no_argument, 0, 'l'},
 		{"version", no_argument, 0, 'V'},
@@ -178,7 +537,7 @@ int process_arguments(int argc, char **argv){
 		return NDO_OK;
 	        }
 
-	snprintf(optchars,sizeof(optchars),"s:d:t:p:hlV");
+	snprintf(optchars,sizeof(optchars),"s:d:t:p:r:i:c:ShlV");
 
 	while(1){
 #ifdef HAVE_GETOPT_H
@@ -215,6 +574,27 @@ int process_arguments(int argc, char **argv){
 			if(tcp_port<=0)
 				return NDO_ERROR;
 			break;
+		case 'r':
+			timed_replay=NDO_TRUE;
+			show_stats=NDO_TRUE;
+			if(!strcmp(optarg,"max"))
+				replay_speed=0.0;
+			else if((replay_speed=strtod(optarg,NULL))<=0.0)
+				return NDO_ERROR;
+			break;
+		case 'i':
+			instance_name=strdup(optarg);
+			break;
+		case 'c':
+			copies=atoi(optarg);
+			if(copies<1 || copies>FILE2SOCK_MAX_COPIES)
+				return NDO_ERROR;
+			if(copies>1)
+				show_stats=NDO_TRUE;
+			break;
+		case 'S':
+			show_stats=NDO_TRUE;
+			break;
 		case 's':
 			source_name=strdup(optarg);
 			break;
@@ -450,6 +450,225 @@ int ndo_inet_aton(register const char *cp, struct in_addr *addr){
         }
 
 
+/******************************************************************/
+/********************** CHARACTER SCANNING ************************/
+/******************************************************************/
+
+/*
+ * Plugin output is mostly plain text, so escaping spends nearly all its
+ * time looking for the few characters that need a backslash.  On x86 we
+ * look at 16 (SSE2) or 32 (AVX2, if the CPU we're running on has it)
+ * bytes at a time and copy blocks without any of them as they are.
+ * Define NDO_NO_SIMD to build the plain C version only.
+ */
+#if !defined(NDO_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define NDO_SCAN_SSE2
+#include <emmintrin.h>
+#if __GNUC__ >= 5 || defined(__clang__)
+#define NDO_SCAN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef NDO_SCAN_SSE2
+static int ndo_scan_level=-1;		/* 0 plain C, 1 SSE2, 2 AVX2, -1 not decided yet */
+#endif
+
+
+/* finds what goes after the backslash for a character we know is in the set */
+static char ndo_escaped_char(char c, const ndo_charset *set){
+	register int z;
+
+	for(z=0;z<set->count-1;z++){
+		if(c==set->chars[z])
+			break;
+	        }
+
+	return set->escaped[z];
+        }
+
+
+/* plain C version, also handles what's left over after the vector loops */
+static size_t ndo_escape_copy_scalar(char *dst, const char *src, size_t len, const ndo_charset *set){
+	unsigned int member[256/32];
+	unsigned char c;
+	register size_t x;
+	register size_t y=0;
+	register int z;
+
+	if(len==0)
+		return 0;
+
+	/* one bit per byte value, so plain characters cost a single test */
+	memset(member,0,sizeof(member));
+	for(z=0;z<set->count;z++){
+		c=(unsigned char)set->chars[z];
+		member[c>>5]|=1U<<(c&31);
+	        }
+
+	for(x=0;x<len;x++){
+		c=(unsigned char)src[x];
+		if(member[c>>5]&(1U<<(c&31))){
+			dst[y++]='\\';
+			dst[y++]=ndo_escaped_char(src[x],set);
+		        }
+		else
+			dst[y++]=src[x];
+	        }
+
+	return y;
+        }
+
+
+#ifdef NDO_SCAN_SSE2
+/*
+ * The vector loops store each block before they know whether it's clean.
+ * After a special character they start over right behind it, so dst only
+ * ever gets bytes that belong there or that are overwritten next.  Since
+ * a full block is left in src, there's room for it in dst too.
+ */
+static size_t ndo_escape_copy_sse2(char *dst, const char *src, size_t len, const ndo_charset *set){
+	__m128i want[NDO_CHARSET_MAX];
+	__m128i block;
+	__m128i hits;
+	size_t x=0;
+	size_t y=0;
+	unsigned int mask;
+	unsigned int at;
+	int count=set->count;
+	int z;
+
+	for(z=0;z<count;z++)
+		want[z]=_mm_set1_epi8(set->chars[z]);
+
+	while(x+16<=len){
+		block=_mm_loadu_si128((const __m128i *)(src+x));
+		hits=_mm_cmpeq_epi8(block,want[0]);
+		for(z=1;z<count;z++)
+			hits=_mm_or_si128(hits,_mm_cmpeq_epi8(block,want[z]));
+		mask=(unsigned int)_mm_movemask_epi8(hits);
+		_mm_storeu_si128((__m128i *)(dst+y),block);
+		if(mask==0){
+			x+=16;
+			y+=16;
+			continue;
+		        }
+		at=(unsigned int)__builtin_ctz(mask);
+		x+=at;
+		y+=at;
+		dst[y++]='\\';
+		dst[y++]=ndo_escaped_char(src[x++],set);
+	        }
+
+	return y+ndo_escape_copy_scalar(dst+y,src+x,len-x,set);
+        }
+#endif
+
+
+#ifdef NDO_SCAN_AVX2
+/* classifies 32 bytes at once with two nibble lookups, however many characters are in the set */
+__attribute__((target("avx2")))
+static size_t ndo_escape_copy_avx2(char *dst, const char *src, size_t len, const ndo_charset *set){
+	unsigned char low_table[16];
+	unsigned char high_table[16];
+	__m256i low_lookup;
+	__m256i high_lookup;
+	__m256i nibble;
+	__m256i block;
+	__m256i hits;
+	size_t x=0;
+	size_t y=0;
+	unsigned int mask;
+	unsigned int at;
+	unsigned char c;
+	int z;
+
+	/* a byte is special if its low nibble's entry has its high nibble's bit */
+	memset(low_table,0,sizeof(low_table));
+	memset(high_table,0,sizeof(high_table));
+	for(z=0;z<8;z++)
+		high_table[z]=(unsigned char)(1<<z);
+	for(z=0;z<set->count;z++){
+		c=(unsigned char)set->chars[z];
+		low_table[c&15]|=(unsigned char)(1<<(c>>4));
+	        }
+	low_lookup=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low_table));
+	high_lookup=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high_table));
+	nibble=_mm256_set1_epi8(0x0f);
+
+	while(x+32<=len){
+		block=_mm256_loadu_si256((const __m256i *)(src+x));
+		hits=_mm256_and_si256(_mm256_shuffle_epi8(low_lookup,_mm256_and_si256(block,nibble)),_mm256_shuffle_epi8(high_lookup,_mm256_and_si256(_mm256_srli_epi16(block,4),nibble)));
+		mask=~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits,_mm256_setzero_si256()));
+		_mm256_storeu_si256((__m256i *)(dst+y),block);
+		if(mask==0){
+			x+=32;
+			y+=32;
+			continue;
+		        }
+		at=(unsigned int)__builtin_ctz(mask);
+		x+=at;
+		y+=at;
+		dst[y++]='\\';
+		dst[y++]=ndo_escaped_char(src[x++],set);
+	        }
+
+	/* mixing in SSE code with the upper halves dirty is slow */
+	_mm256_zeroupper();
+
+	return y+ndo_escape_copy_sse2(dst+y,src+x,len-x,set);
+        }
+#endif
+
+
+/* chooses the escaping code: 0 plain C, 1 SSE2, 2 AVX2, or the best there is if negative - returns the level in use, which is never more than the build and CPU support */
+int ndo_escape_set_level(int level){
+#ifdef NDO_SCAN_SSE2
+	int best=1;
+
+#ifdef NDO_SCAN_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		best=2;
+#endif
+	if(level<0 || level>best)
+		level=best;
+
+	ndo_scan_level=level;
+
+	return level;
+#else
+	return 0;
+#endif
+        }
+
+
+/* copies len bytes of src to dst with a backslash before each character in the set, returns the length of the copy (dst is terminated and needs room for twice len plus one) */
+size_t ndo_escape_copy(char *dst, const char *src, size_t len, const ndo_charset *set){
+	size_t y=0;
+
+#ifdef NDO_SCAN_SSE2
+	/* every thread comes to the same answer, so a race here is harmless */
+	if(ndo_scan_level<0)
+		ndo_escape_set_level(-1);
+#ifdef NDO_SCAN_AVX2
+	if(ndo_scan_level>=2 && len>=32)
+		y=ndo_escape_copy_avx2(dst,src,len,set);
+	else
+#endif
+	if(ndo_scan_level>=1 && len>=16)
+		y=ndo_escape_copy_sse2(dst,src,len,set);
+	else
+#endif
+	y=ndo_escape_copy_scalar(dst,src,len,set);
+
+	dst[y]='\x0';
+
+	return y;
+        }
+
+
+
 /******************************************************************/
 /************************ STRING FUNCTIONS ************************/
 /******************************************************************/
@@ -477,45 +696,20 @@ void ndo_strip_buffer(char *buffer){
 
 /* escape special characters in string */
 char *ndo_escape_buffer(char *buffer){
+	static const ndo_charset special={4,{'\t','\r','\n','\\'},{'t','r','n','\\'}};
 	char *newbuf;
-	register int x=0;
-	register int y=0;
-	register int len=0;
+	size_t len=0;
 
 	if(buffer==NULL)
 		return NULL;
 
+	len=strlen(buffer);
+
 	/* allocate memory for escaped string */
-	if((newbuf=(char *)malloc((strlen(buffer)*2)+1))==NULL)
+	if((newbuf=(char *)malloc((len*2)+1))==NULL)
 		return NULL;
 
-	/* initialize string */
-	newbuf[0]='\x0';
-
-	len=(int)strlen(buffer);
-	for(x=0;x<len;x++){
-		if(buffer[x]=='\t'){
-			newbuf[y++]='\\';
-			newbuf[y++]='t';
-		        }
-		else if(buffer[x]=='\r'){
-			newbuf[y++]='\\';
-			newbuf[y++]='r';
-		        }
-		else if(buffer[x]=='\n'){
-			newbuf[y++]='\\';
-			newbuf[y++]='n';
-		        }
-		else if(buffer[x]=='\\'){
-			newbuf[y++]='\\';
-			newbuf[y++]='\\';
-		        }
-		else
-			newbuf[y++]=buffer[x];
-	        }
-
-	/* terminate new string */
-	newbuf[y++]='\x0';
+	ndo_escape_copy(newbuf,buffer,len,&special);
 
 	return newbuf;
         }
@@ -523,15 +717,24 @@ char *ndo_escape_buffer(char *buffer){
 
 /* unescape special characters in string */
 char *ndo_unescape_buffer(char *buffer){
-	register int x=0;
-	register int y=0;
-	register int len=0;
+	register size_t x=0;
+	register size_t y=0;
+	register size_t len=0;
+	char *ptr=NULL;
+	size_t plain=0;
 
 	if(buffer==NULL)
 		return NULL;
 
-	len=(int)strlen(buffer);
-	for(x=0;x<len;x++){
+	len=strlen(buffer);
+
+	/* most strings have nothing to unescape */
+	if((ptr=(char *)memchr(buffer,'\\',len))==NULL)
+		return buffer;
+	x=y=(size_t)(ptr-buffer);
+
+	while(x<len){
+
 		if(buffer[x]=='\\'){
 			if(buffer[x+1]=='t')
 				buffer[y++]='\t';
@@ -543,14 +746,20 @@ char *ndo_unescape_buffer(char *buffer){
 				buffer[y++]='\\';
 			else
 				buffer[y++]=buffer[x+1];
-			x++;
+			x+=2;
+			continue;
 		        }
-		else
-			buffer[y++]=buffer[x];
+
+		/* move the plain run up to the next escape */
+		ptr=(char *)memchr(buffer+x,'\\',len-x);
+		plain=(ptr==NULL)?len-x:(size_t)(ptr-(buffer+x));
+		memmove(buffer+y,buffer+x,plain);
+		x+=plain;
+		y+=plain;
 	        }
 
 	/* terminate string */
-	buffer[y++]='\x0';
+	buffer[y]='\x0';
 
 	return buffer;
         }
@@ -33,26 +33,63 @@
 
 
 
-int process_arguments(int,char **);
+#define LOG2NDO_CHUNK_SIZE	16384		/* default chunk size in KB */
+#define LOG2NDO_BUFFER_SIZE	65536		/* entries are sent in writes of about this size */
+
+/* part of a log file that is sent over its own connection */
+typedef struct log2ndo_chunk_struct{
+	int source;
+	unsigned long start;
+	unsigned long end;
+        }log2ndo_chunk;
+
+/* a chunk that an earlier run finished */
+typedef struct log2ndo_checkpoint_struct{
+	char *source;
+	unsigned long start;
+	unsigned long end;
+        }log2ndo_checkpoint;
 
-char *source_name=NULL;
+
+int process_arguments(int,char **);
+int log2ndo_add_source(char *);
+int log2ndo_add_chunks(int);
+int log2ndo_load_checkpoints(void);
+int log2ndo_chunk_done(log2ndo_chunk *);
+int log2ndo_save_checkpoint(log2ndo_chunk *);
+int log2ndo_open_session(int *);
+int log2ndo_close_session(int);
+int log2ndo_send_chunk(int,log2ndo_chunk *);
+int log2ndo_run_chunks(int,int);
+
+char **source_names=NULL;
+int source_count=0;
 char *dest_name=NULL;
 char *instance_name=NULL;
+char *checkpoint_name=NULL;
 int socket_type=NDO_SINK_UNIXSOCKET;
 int tcp_port=0;
+int jobs=1;
+unsigned long chunk_size=LOG2NDO_CHUNK_SIZE*1024L;
 int show_version=NDO_FALSE;
 int show_license=NDO_FALSE;
 int show_help=NDO_FALSE;
 
+log2ndo_chunk *chunks=NULL;
+int chunk_count=0;
+log2ndo_checkpoint *checkpoints=NULL;
+int checkpoint_count=0;
+int checkpoint_fd=-1;
+
 
 int main(int argc, char **argv){
-	ndo_mmapfile *thefile=NULL;
-	char *connection_type=NULL;
-	char *input=NULL;
-	char *input2=NULL;
-	int sd=2;
-	char tempbuf[1024];
+	pid_t *children=NULL;
+	pid_t pid;
+	int status=0;
+	int failed=0;
+	int sd=-1;
 	int result=0;
+	int x=0;
 
 
 	result=process_arguments(argc,argv);
@@ -69,13 +106,15 @@ int main(int argc, char **argv){
 		printf("Last Mofieid: %s\n",LOG2NDO_DATE);
 		printf("License: GPL v2\n");
 		printf("\n");
-		printf("Sends the contents of an archived Nagios or NetSaint log file to STDOUT,\n");
+		printf("Sends the contents of archived Nagios or NetSaint log files to STDOUT,\n");
 		printf("a TCP socket, or a Unix domain socket in a format that is understood by the\n");
 		printf("NDO2DB daemon.\n");
 		printf("\n");
 		printf("Usage: %s -s <source> -d <dest> -i <instance> [-t <type>] [-p <port>]\n",argv[0]);
+		printf("          [-j <jobs>] [-b <size>] [-c <checkpoint>] [<source> ...]\n");
 		printf("\n");
-		printf("<source>   = Name of the Nagios/NetSaint log file to read from.\n");
+		printf("<source>   = Name of the Nagios/NetSaint log file to read from.  More than one\n");
+		printf("             file may be given.\n");
 		printf("<dest>     = If destination is a TCP socket, the address/hostname to connect to.\n");
 		printf("             If destination is a Unix domain socket, the path to the socket.\n");
 		printf("             If destination is STDOUT (for redirection, etc), a single dash (-).\n");
@@ -83,31 +122,224 @@ int main(int argc, char **argv){
 		printf("                 tcp\n");
 		printf("                 unix (default)\n");
 		printf("<port>     = Port number to connect to if destination is TCP socket.\n");
+		printf("<jobs>     = Number of connections to send chunks of the files over at the\n");
+		printf("             same time (default 1).\n");
+		printf("<size>     = Size of the chunks the files are split into, in KB (default %d).\n",LOG2NDO_CHUNK_SIZE);
+		printf("             Each chunk is sent over its own connection.\n");
+		printf("<checkpoint> = File in which the chunks the NDO2DB daemon has finished are\n");
+		printf("             recorded.  Chunks found in it are skipped, so an interrupted\n");
+		printf("             import can be run again with the same files and chunk size.\n");
 		printf("\n");
 
 		exit(1);
 	        }
 
-	/* send output to STDOUT rather than a socket */
+	/* a broken connection fails its chunk instead of killing us */
+	signal(SIGPIPE,SIG_IGN);
+
+	if(log2ndo_load_checkpoints()==NDO_ERROR){
+		perror("Unable to open checkpoint file");
+		exit(1);
+	        }
+
+	/* split the files into chunks at line boundaries */
+	for(x=0;x<source_count;x++){
+		if(log2ndo_add_chunks(x)==NDO_ERROR){
+			fprintf(stderr,"Unable to open source file %s for reading: %s\n",source_names[x],strerror(errno));
+			exit(1);
+		        }
+	        }
+
+	/* send everything to STDOUT as one stream */
 	if(!strcmp(dest_name,"-")){
-		sd=STDOUT_FILENO;
 		socket_type=NDO_SINK_FD;
+		if(log2ndo_open_session(&sd)==NDO_ERROR)
+			exit(1);
+		for(x=0;x<chunk_count;x++){
+			if(log2ndo_send_chunk(sd,&chunks[x])==NDO_ERROR)
+				failed++;
+		        }
+		if(log2ndo_close_session(sd)==NDO_ERROR)
+			failed++;
+		return (failed>0)?1:0;
 	        }
 
-	/* open the file for reading */
-	if((thefile=ndo_mmap_fopen(source_name))==NULL){
-		perror("Unable to open source file for reading");
+	if(jobs>chunk_count)
+		jobs=chunk_count;
+	if(jobs<=1)
+		return (log2ndo_run_chunks(0,1)==NDO_OK)?0:1;
+
+	/* each child sends every jobs'th chunk */
+	if((children=(pid_t *)calloc(jobs,sizeof(pid_t)))==NULL)
 		exit(1);
+	for(x=0;x<jobs;x++){
+		if((pid=fork())==-1){
+			perror("Unable to fork");
+			failed++;
+			break;
+		        }
+		if(pid==0)
+			exit((log2ndo_run_chunks(x,jobs)==NDO_OK)?0:1);
+		children[x]=pid;
 	        }
 
-	/* open the destination */
-	if(ndo_sink_open(dest_name,sd,socket_type,tcp_port,0,&sd)==NDO_ERROR){
-		ndo_mmap_fclose(thefile);
-		exit(1);
+	for(x=0;x<jobs;x++){
+		if(children[x]<=0)
+			continue;
+		if(waitpid(children[x],&status,0)==-1 || !WIFEXITED(status) || WEXITSTATUS(status)!=0)
+			failed++;
 	        }
+	free(children);
+
+	return (failed>0)?1:0;
+        }
+
+
+/* moves a chunk boundary to the start of a line, and past lines logged in the same second as the one before */
+static unsigned long log2ndo_chunk_boundary(const char *buf, unsigned long size, unsigned long pos){
+	const char *ptr=NULL;
+	unsigned long prev=0L;
+	unsigned long len=0L;
 
+	if(pos==0L || pos>=size)
+		return (pos==0L)?0L:size;
+
+	/* the line that pos is in belongs to this chunk */
+	if(buf[pos-1]!='\n'){
+		if((ptr=memchr(buf+pos,'\n',size-pos))==NULL)
+			return size;
+		pos=(ptr-buf)+1;
+	        }
 
-	/***** SEND HEADER INFORMATION *****/
+	/* find the start of the line before it */
+	for(prev=pos-1;prev>0 && buf[prev-1]!='\n';prev--);
+
+	/* lines are "[timestamp] text", identical lines are only told apart by the daemon within a second */
+	while(pos<size && buf[prev]=='[' && buf[pos]=='['){
+		if((ptr=memchr(buf+prev,']',pos-prev))==NULL)
+			break;
+		len=(ptr-(buf+prev))+1;
+		if(pos+len>size || memcmp(buf+prev,buf+pos,len))
+			break;
+		prev=pos;
+		if((ptr=memchr(buf+pos,'\n',size-pos))==NULL)
+			return size;
+		pos=(ptr-buf)+1;
+	        }
+
+	return pos;
+        }
+
+
+/* splits a source file into chunks, leaving out those a checkpoint says are done */
+int log2ndo_add_chunks(int source){
+	ndo_mmapfile *thefile=NULL;
+	log2ndo_chunk *newchunks=NULL;
+	log2ndo_chunk chunk;
+	unsigned long next=0L;
+
+	if((thefile=ndo_mmap_fopen(source_names[source]))==NULL)
+		return NDO_ERROR;
+
+	chunk.source=source;
+	chunk.start=0L;
+	while(chunk.start<thefile->file_size){
+
+		/* boundaries only depend on the chunk size, so they come out the same on the next run */
+		next=((chunk.start/chunk_size)+1)*chunk_size;
+		chunk.end=log2ndo_chunk_boundary((const char *)thefile->mmap_buf,thefile->file_size,next);
+
+		if(log2ndo_chunk_done(&chunk)==NDO_FALSE){
+			if((newchunks=(log2ndo_chunk *)realloc(chunks,(chunk_count+1)*sizeof(log2ndo_chunk)))==NULL){
+				ndo_mmap_fclose(thefile);
+				return NDO_ERROR;
+			        }
+			chunks=newchunks;
+			chunks[chunk_count++]=chunk;
+		        }
+
+		chunk.start=chunk.end;
+	        }
+
+	ndo_mmap_fclose(thefile);
+
+	return NDO_OK;
+        }
+
+
+/* reads the chunks finished by earlier runs and opens the checkpoint file for this one */
+int log2ndo_load_checkpoints(void){
+	log2ndo_checkpoint *newcheckpoints=NULL;
+	FILE *fp=NULL;
+	char buf[8192];
+	unsigned long start=0L;
+	unsigned long end=0L;
+	int offset=0;
+
+	if(checkpoint_name==NULL)
+		return NDO_OK;
+
+	/* each line is "<start> <end> <source>" */
+	if((fp=fopen(checkpoint_name,"r"))!=NULL){
+		while(fgets(buf,sizeof(buf),fp)){
+			ndo_strip_buffer(buf);
+			if(sscanf(buf,"%lu %lu %n",&start,&end,&offset)<2 || buf[offset]=='\x0')
+				continue;
+			if((newcheckpoints=(log2ndo_checkpoint *)realloc(checkpoints,(checkpoint_count+1)*sizeof(log2ndo_checkpoint)))==NULL)
+				break;
+			checkpoints=newcheckpoints;
+			checkpoints[checkpoint_count].source=strdup(buf+offset);
+			checkpoints[checkpoint_count].start=start;
+			checkpoints[checkpoint_count].end=end;
+			checkpoint_count++;
+		        }
+		fclose(fp);
+	        }
+
+	if((checkpoint_fd=open(checkpoint_name,O_WRONLY|O_APPEND|O_CREAT,S_IRUSR|S_IWUSR|S_IRGRP))==-1)
+		return NDO_ERROR;
+
+	return NDO_OK;
+        }
+
+
+/* did an earlier run finish this chunk? */
+int log2ndo_chunk_done(log2ndo_chunk *chunk){
+	int x=0;
+
+	for(x=0;x<checkpoint_count;x++){
+		if(checkpoints[x].start==chunk->start && checkpoints[x].end==chunk->end && checkpoints[x].source!=NULL && !strcmp(checkpoints[x].source,source_names[chunk->source]))
+			return NDO_TRUE;
+	        }
+
+	return NDO_FALSE;
+        }
+
+
+/* records a finished chunk (a single append, so children can share the file) */
+int log2ndo_save_checkpoint(log2ndo_chunk *chunk){
+	char buf[8192];
+	int len=0;
+
+	if(checkpoint_fd<0)
+		return NDO_OK;
+
+	len=snprintf(buf,sizeof(buf),"%lu %lu %s\n",chunk->start,chunk->end,source_names[chunk->source]);
+	if(len<0 || len>=(int)sizeof(buf) || write(checkpoint_fd,buf,len)!=len)
+		return NDO_ERROR;
+
+	return NDO_OK;
+        }
+
+
+/* connects to the destination and sends the header */
+int log2ndo_open_session(int *sd){
+	char *connection_type=NULL;
+	char tempbuf[1024];
+
+	*sd=STDOUT_FILENO;
+	if(ndo_sink_open(dest_name,*sd,socket_type,tcp_port,0,sd)==NDO_ERROR)
+		return NDO_ERROR;
 
 	/* get the connection type string */
 	if(socket_type==NDO_SINK_FD || socket_type==NDO_SINK_FILE)
@@ -139,43 +371,21 @@ int main(int argc, char **argv){
 		 ,NDO_API_STARTDATADUMP
 		);
 	tempbuf[sizeof(tempbuf)-1]='\x0';
-	ndo_sink_write(sd,tempbuf,strlen(tempbuf));
 
-
-
-	/***** SEND THE LOG CONTENTS *****/
-
-	while((input=ndo_mmap_fgets(thefile))){
-
-		/* strip and escape log entry */
-		ndo_strip_buffer(input);
-		if((input2=ndo_escape_buffer(input))==NULL){
-			free(input);
-			input2=NULL;
-			continue;
-		        }
-
-		/* write log entry header */
-		snprintf(tempbuf,sizeof(tempbuf)-1
-			 ,"%d:\n%d=%s\n%d\n\n"
-			 ,NDO_API_LOGENTRY
-			 ,NDO_DATA_LOGENTRY
-			 ,input2
-			 ,NDO_API_ENDDATA
-			);
-		tempbuf[sizeof(tempbuf)-1]='\x0';
-		ndo_sink_write(sd,tempbuf,strlen(tempbuf));
-
-		/* free allocated memory */
-		free(input);
-		free(input2);
-		input=NULL;
-		input2=NULL;
+	if(ndo_sink_write(*sd,tempbuf,strlen(tempbuf))==NDO_ERROR){
+		ndo_sink_close(*sd);
+		return NDO_ERROR;
 	        }
 
+	return NDO_OK;
+        }
 
 
-	/***** SAY GOODBYE *****/
+/* says goodbye and, on a socket, waits for the daemon to close it once everything has been written */
+int log2ndo_close_session(int sd){
+	char tempbuf[1024];
+	int result=NDO_OK;
+	ssize_t bytes=0;
 
 	snprintf(tempbuf,sizeof(tempbuf)-1,"\n%d\n%s: %lu\n%s\n"
 		 ,NDO_API_ENDDATADUMP
@@ -184,18 +394,122 @@ int main(int argc, char **argv){
 		 ,NDO_API_GOODBYE
 		);
 	tempbuf[sizeof(tempbuf)-1]='\x0';
-	ndo_sink_write(sd,tempbuf,strlen(tempbuf));
-
+	if(ndo_sink_write(sd,tempbuf,strlen(tempbuf))==NDO_ERROR)
+		result=NDO_ERROR;
+	ndo_sink_flush(sd);
 
+	/* the daemon never answers, it hangs up when its writer is done */
+	if(result==NDO_OK && socket_type!=NDO_SINK_FD){
+		shutdown(sd,SHUT_WR);
+		while((bytes=read(sd,tempbuf,sizeof(tempbuf)))!=0){
+			if(bytes<0 && errno!=EINTR){
+				result=NDO_ERROR;
+				break;
+			        }
+		        }
+	        }
 
-	/* close the destination */
-	ndo_sink_flush(sd);
 	ndo_sink_close(sd);
 
-	/* close the file */
+	return result;
+        }
+
+
+/* sends the log entries of a chunk, many to a write */
+int log2ndo_send_chunk(int sd, log2ndo_chunk *chunk){
+	static const ndo_charset special={4,{'\t','\r','\n','\\'},{'t','r','n','\\'}};
+	ndo_mmapfile *thefile=NULL;
+	const char *buf=NULL;
+	const char *ptr=NULL;
+	char *outbuf=NULL;
+	size_t outsize=LOG2NDO_BUFFER_SIZE;
+	size_t used=0;
+	size_t needed=0;
+	unsigned long pos=0L;
+	unsigned long len=0L;
+	int result=NDO_OK;
+
+	if((thefile=ndo_mmap_fopen(source_names[chunk->source]))==NULL){
+		fprintf(stderr,"Unable to open source file %s for reading: %s\n",source_names[chunk->source],strerror(errno));
+		return NDO_ERROR;
+	        }
+	if(chunk->end>thefile->file_size || (outbuf=(char *)malloc(outsize))==NULL){
+		ndo_mmap_fclose(thefile);
+		return NDO_ERROR;
+	        }
+	buf=(const char *)thefile->mmap_buf;
+
+	for(pos=chunk->start;pos<chunk->end;){
+
+		/* find the end of the line, and strip newline and carriage return characters from it */
+		if((ptr=memchr(buf+pos,'\n',chunk->end-pos))==NULL)
+			ptr=buf+chunk->end;
+		len=ptr-(buf+pos);
+		while(len>0 && (buf[pos+len-1]=='\n' || buf[pos+len-1]=='\r'))
+			len--;
+
+		/* room for the header, the escaped entry and the trailer */
+		needed=used+(len*2)+64;
+		if(needed>outsize){
+			if(used>0 && ndo_sink_write(sd,outbuf,used)==NDO_ERROR){
+				result=NDO_ERROR;
+				break;
+			        }
+			used=0;
+			if(len*2+64>outsize){
+				free(outbuf);
+				outsize=len*2+64;
+				if((outbuf=(char *)malloc(outsize))==NULL){
+					result=NDO_ERROR;
+					break;
+				        }
+			        }
+		        }
+
+		used+=sprintf(outbuf+used,"%d:\n%d=",NDO_API_LOGENTRY,NDO_DATA_LOGENTRY);
+		used+=ndo_escape_copy(outbuf+used,buf+pos,len,&special);
+		used+=sprintf(outbuf+used,"\n%d\n\n",NDO_API_ENDDATA);
+
+		pos=(ptr-buf)+1;
+	        }
+
+	if(result==NDO_OK && used>0 && ndo_sink_write(sd,outbuf,used)==NDO_ERROR)
+		result=NDO_ERROR;
+
+	free(outbuf);
 	ndo_mmap_fclose(thefile);
 
-	return 0;
+	return result;
+        }
+
+
+/* sends every step'th chunk starting with the first'th, each over its own connection */
+int log2ndo_run_chunks(int first, int step){
+	int failed=0;
+	int sd=-1;
+	int x=0;
+
+	for(x=first;x<chunk_count;x+=step){
+
+		if(log2ndo_open_session(&sd)==NDO_ERROR){
+			fprintf(stderr,"Unable to connect to %s\n",dest_name);
+			return NDO_ERROR;
+		        }
+
+		if(log2ndo_send_chunk(sd,&chunks[x])==NDO_ERROR){
+			ndo_sink_close(sd);
+			failed++;
+			continue;
+		        }
+
+		/* only a chunk the daemon has finished counts as done */
+		if(log2ndo_close_session(sd)==NDO_ERROR || log2ndo_save_checkpoint(&chunks[x])==NDO_ERROR){
+			fprintf(stderr,"Could not confirm that %s (bytes %lu-%lu) was imported\n",source_names[chunks[x].source],chunks[x].start,chunks[x].end);
+			failed++;
+		        }
+	        }
+
+	return (failed>0)?NDO_ERROR:NDO_OK;
         }
 
 
@@ -212,6 +526,9 @@ int process_arguments(int argc, char **argv){
 		{"instance", required_argument, 0, 'i'},
 		{"type", required_argument, 0, 't'},
 		{"port", required_argument, 0, 'p'},
+		{"jobs", required_argument, 0, 'j'},
+		{"chunk-size", required_argument, 0, 'b'},
+		{"checkpoint", required_argument, 0, 'c'},
 		{"help", no_argument, 0, 'h'},
 		{"license", no_argument, 0, 'l'},
 		{"version", no_argument, 0, 'V'},
@@ -225,7 +542,7 @@ int process_arguments(int argc, char **argv){
 		return NDO_OK;
 	        }
 
-	snprintf(optchars,sizeof(optchars),"s:d:i:t:p:hlV");
+	snprintf(optchars,sizeof(optchars),"s:d:i:t:p:j:b:c:hlV");
 
 	while(1){
 #ifdef HAVE_GETOPT_H
@@ -262,8 +579,22 @@ int process_arguments(int argc, char **argv){
 			if(tcp_port<=0)
 				return NDO_ERROR;
 			break;
+		case 'j':
+			jobs=atoi(optarg);
+			if(jobs<=0)
+				return NDO_ERROR;
+			break;
+		case 'b':
+			chunk_size=strtoul(optarg,NULL,0)*1024L;
+			if(chunk_size==0L)
+				return NDO_ERROR;
+			break;
+		case 'c':
+			checkpoint_name=strdup(optarg);
+			break;
 		case 's':
-			source_name=strdup(optarg);
+			if(log2ndo_add_source(optarg)==NDO_ERROR)
+				return NDO_ERROR;
 			break;
 		case 'd':
 			dest_name=strdup(optarg);
@@ -277,9 +608,34 @@ int process_arguments(int argc, char **argv){
 		        }
 	        }
 
+	/* anything left over is another source file */
+	for(;optind<argc;optind++){
+		if(log2ndo_add_source(argv[optind])==NDO_ERROR)
+			return NDO_ERROR;
+	        }
+
 	/* make sure required args were supplied */
-	if((source_name==NULL || dest_name==NULL || instance_name==NULL) && show_help==NDO_FALSE && show_version==NDO_FALSE  && show_license==NDO_FALSE)
+	if((source_count==0 || dest_name==NULL || instance_name==NULL) && show_help==NDO_FALSE && show_version==NDO_FALSE  && show_license==NDO_FALSE)
+		return NDO_ERROR;
+
+	/* nothing comes back from STDOUT to say a chunk was finished */
+	if(checkpoint_name!=NULL && dest_name!=NULL && !strcmp(dest_name,"-"))
+		return NDO_ERROR;
+
+	return NDO_OK;
+        }
+
+
+/* adds a file to the list of sources */
+int log2ndo_add_source(char *name){
+	char **newnames=NULL;
+
+	if((newnames=(char **)realloc(source_names,(source_count+1)*sizeof(char *)))==NULL)
+		return NDO_ERROR;
+	source_names=newnames;
+	if((source_names[source_count]=strdup(name))==NULL)
 		return NDO_ERROR;
+	source_count++;
 
 	return NDO_OK;
         }
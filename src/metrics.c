@@ -0,0 +1,799 @@
+/**
+ * @file metrics.c Live ingest metrics for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With metrics_socket set, ndo2db counts what every client connection
+ * sends it and how long the handlers and the database take, and serves
+ * the counts in the Prometheus text format on that UNIX socket.  A
+ * plain connection gets the text right away; an HTTP GET gets it with
+ * headers, so curl --unix-socket and node_exporter style scrapers work.
+ * Asking for /profile (or sending "profile") gets the SQL profile instead.
+ *
+ * In the fork model each connection is handled by its own processes, so
+ * the counters live in anonymous shared memory set up before the first
+ * fork.  They are only ever added to, with atomic adds, and the lock is
+ * taken only to claim or retire a connection's slot and to read.  When a
+ * connection goes away its counts are added to the totals of closed
+ * connections, so the global counters never go backwards.  Rates are
+ * left to the scraper.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/metrics.h"
+#include "../include/profile.h"
+#include <sys/mman.h>
+#include <poll.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define NDO2DB_METRICS_ADD(counter,n)	__sync_fetch_and_add(&(counter),(n))
+
+static ndo2db_metrics *ndo2db_metrics_shm=NULL;
+static char *ndo2db_metrics_socket_name=NULL;
+static int ndo2db_metrics_sd=-1;
+static pid_t ndo2db_metrics_owner=0;
+
+/* upper bounds of the latency buckets, in microseconds */
+static const unsigned long ndo2db_metrics_bounds[NDO2DB_METRICS_BUCKETS]={
+	100,250,500,1000,2500,5000,10000,25000,50000,100000,250000,500000,1000000,2500000
+	};
+
+static const char *ndo2db_metrics_db_ops[NDO2DB_METRICS_DB_OPS]={
+	"query","execute","commit"
+	};
+
+static const char *ndo2db_metrics_caches[NDO2DB_METRICS_CACHES]={
+	"objects","status","configdigests"
+	};
+
+static const struct{
+	int type;
+	const char *name;
+	}ndo2db_metrics_types[]={
+	{NDO2DB_INPUT_DATA_CONFIGDUMPSTART,"configdumpstart"},
+	{NDO2DB_INPUT_DATA_CONFIGDUMPEND,"configdumpend"},
+	{NDO2DB_INPUT_DATA_LOGENTRY,"logentry"},
+	{NDO2DB_INPUT_DATA_PROCESSDATA,"processdata"},
+	{NDO2DB_INPUT_DATA_TIMEDEVENTDATA,"timedeventdata"},
+	{NDO2DB_INPUT_DATA_LOGDATA,"logdata"},
+	{NDO2DB_INPUT_DATA_SYSTEMCOMMANDDATA,"systemcommanddata"},
+	{NDO2DB_INPUT_DATA_EVENTHANDLERDATA,"eventhandlerdata"},
+	{NDO2DB_INPUT_DATA_NOTIFICATIONDATA,"notificationdata"},
+	{NDO2DB_INPUT_DATA_SERVICECHECKDATA,"servicecheckdata"},
+	{NDO2DB_INPUT_DATA_HOSTCHECKDATA,"hostcheckdata"},
+	{NDO2DB_INPUT_DATA_COMMENTDATA,"commentdata"},
+	{NDO2DB_INPUT_DATA_DOWNTIMEDATA,"downtimedata"},
+	{NDO2DB_INPUT_DATA_FLAPPINGDATA,"flappingdata"},
+	{NDO2DB_INPUT_DATA_PROGRAMSTATUSDATA,"programstatusdata"},
+	{NDO2DB_INPUT_DATA_HOSTSTATUSDATA,"hoststatusdata"},
+	{NDO2DB_INPUT_DATA_SERVICESTATUSDATA,"servicestatusdata"},
+	{NDO2DB_INPUT_DATA_ADAPTIVEPROGRAMDATA,"adaptiveprogramdata"},
+	{NDO2DB_INPUT_DATA_ADAPTIVEHOSTDATA,"adaptivehostdata"},
+	{NDO2DB_INPUT_DATA_ADAPTIVESERVICEDATA,"adaptiveservicedata"},
+	{NDO2DB_INPUT_DATA_EXTERNALCOMMANDDATA,"externalcommanddata"},
+	{NDO2DB_INPUT_DATA_AGGREGATEDSTATUSDATA,"aggregatedstatusdata"},
+	{NDO2DB_INPUT_DATA_RETENTIONDATA,"retentiondata"},
+	{NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONDATA,"contactnotificationdata"},
+	{NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONMETHODDATA,"contactnotificationmethoddata"},
+	{NDO2DB_INPUT_DATA_ACKNOWLEDGEMENTDATA,"acknowledgementdata"},
+	{NDO2DB_INPUT_DATA_STATECHANGEDATA,"statechangedata"},
+	{NDO2DB_INPUT_DATA_CONTACTSTATUSDATA,"contactstatusdata"},
+	{NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA,"adaptivecontactdata"},
+	{NDO2DB_INPUT_DATA_MAINCONFIGFILEVARIABLES,"mainconfigfilevariables"},
+	{NDO2DB_INPUT_DATA_RESOURCECONFIGFILEVARIABLES,"resourceconfigfilevariables"},
+	{NDO2DB_INPUT_DATA_CONFIGVARIABLES,"configvariables"},
+	{NDO2DB_INPUT_DATA_RUNTIMEVARIABLES,"runtimevariables"},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,"hostdefinition"},
+	{NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION,"hostgroupdefinition"},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,"servicedefinition"},
+	{NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION,"servicegroupdefinition"},
+	{NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION,"hostdependencydefinition"},
+	{NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION,"servicedependencydefinition"},
+	{NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION,"hostescalationdefinition"},
+	{NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION,"serviceescalationdefinition"},
+	{NDO2DB_INPUT_DATA_COMMANDDEFINITION,"commanddefinition"},
+	{NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION,"timeperioddefinition"},
+	{NDO2DB_INPUT_DATA_CONTACTDEFINITION,"contactdefinition"},
+	{NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION,"contactgroupdefinition"},
+	{NDO2DB_INPUT_DATA_HOSTEXTINFODEFINITION,"hostextinfodefinition"},
+	{NDO2DB_INPUT_DATA_SERVICEEXTINFODEFINITION,"serviceextinfodefinition"},
+	{NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST,"activeobjectslist"}
+	};
+
+#define NDO2DB_METRICS_NAMED_TYPES	(int)(sizeof(ndo2db_metrics_types)/sizeof(ndo2db_metrics_types[0]))
+
+static void *ndo2db_metrics_server(void *);
+static void ndo2db_metrics_abandon(void);
+
+
+
+/****************************************************************************/
+/* SETUP                                                                    */
+/****************************************************************************/
+
+/* sets up the shared counters and starts serving them on a UNIX socket */
+int ndo2db_metrics_init(char *socket_name){
+	pthread_mutexattr_t mattr;
+	struct sockaddr_un address;
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t newmask;
+	sigset_t oldmask;
+
+	if(socket_name==NULL || ndo2db_metrics_shm!=NULL)
+		return NDO_OK;
+
+	if(strlen(socket_name)>=sizeof(address.sun_path)){
+		syslog(LOG_USER|LOG_INFO,"Error: metrics_socket '%s' is too long\n",socket_name);
+		return NDO_ERROR;
+	        }
+
+	ndo2db_metrics_shm=(ndo2db_metrics *)mmap(NULL,sizeof(ndo2db_metrics),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+	if(ndo2db_metrics_shm==MAP_FAILED){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not map %lu bytes for metrics: %s\n",(unsigned long)sizeof(ndo2db_metrics),strerror(errno));
+		ndo2db_metrics_shm=NULL;
+		return NDO_ERROR;
+	        }
+
+	/* shared with the connection processes, any of which may die holding it */
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr,PTHREAD_PROCESS_SHARED);
+#ifdef __GLIBC__
+	pthread_mutexattr_setrobust(&mattr,PTHREAD_MUTEX_ROBUST);
+#endif
+	pthread_mutex_init(&ndo2db_metrics_shm->lock,&mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	/* a socket left behind by a daemon that died is in the way */
+	unlink(socket_name);
+
+	if((ndo2db_metrics_sd=socket(AF_UNIX,SOCK_STREAM,0))<0){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not create metrics socket: %s\n",strerror(errno));
+		ndo2db_metrics_abandon();
+		return NDO_ERROR;
+	        }
+
+	bzero((char *)&address,sizeof(address));
+	address.sun_family=AF_UNIX;
+	strncpy(address.sun_path,socket_name,sizeof(address.sun_path)-1);
+
+	if(bind(ndo2db_metrics_sd,(struct sockaddr *)&address,SUN_LEN(&address)) || listen(ndo2db_metrics_sd,SOMAXCONN)){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not listen on metrics socket '%s': %s\n",socket_name,strerror(errno));
+		ndo2db_metrics_abandon();
+		return NDO_ERROR;
+	        }
+
+	ndo2db_metrics_socket_name=strdup(socket_name);
+	ndo2db_metrics_owner=getpid();
+
+	/* signals are for the main thread */
+	sigfillset(&newmask);
+	pthread_sigmask(SIG_BLOCK,&newmask,&oldmask);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread,&attr,ndo2db_metrics_server,NULL)!=0){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not start the metrics thread\n");
+		pthread_attr_destroy(&attr);
+		pthread_sigmask(SIG_SETMASK,&oldmask,NULL);
+		ndo2db_metrics_abandon();
+		return NDO_ERROR;
+	        }
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK,&oldmask,NULL);
+
+	syslog(LOG_USER|LOG_INFO,"Serving metrics on '%s'\n",socket_name);
+
+	return NDO_OK;
+        }
+
+
+/* removes the socket, only in the process that created it */
+void ndo2db_metrics_cleanup(void){
+
+	if(ndo2db_metrics_owner!=0 && ndo2db_metrics_owner!=getpid())
+		return;
+
+	if(ndo2db_metrics_sd>=0){
+		close(ndo2db_metrics_sd);
+		ndo2db_metrics_sd=-1;
+	        }
+	if(ndo2db_metrics_socket_name!=NULL){
+		unlink(ndo2db_metrics_socket_name);
+		free(ndo2db_metrics_socket_name);
+		ndo2db_metrics_socket_name=NULL;
+	        }
+        }
+
+
+/* gives up on metrics after a failed start, nothing counts from then on */
+static void ndo2db_metrics_abandon(void){
+
+	ndo2db_metrics_cleanup();
+	munmap(ndo2db_metrics_shm,sizeof(ndo2db_metrics));
+	ndo2db_metrics_shm=NULL;
+	ndo2db_metrics_owner=0;
+        }
+
+
+static void ndo2db_metrics_lock(void){
+
+#ifdef __GLIBC__
+	if(pthread_mutex_lock(&ndo2db_metrics_shm->lock)==EOWNERDEAD)
+		pthread_mutex_consistent(&ndo2db_metrics_shm->lock);
+#else
+	pthread_mutex_lock(&ndo2db_metrics_shm->lock);
+#endif
+        }
+
+
+
+/****************************************************************************/
+/* CONNECTION SLOTS                                                         */
+/****************************************************************************/
+
+/* adds the counts of a slot to another one */
+static void ndo2db_metrics_merge(ndo2db_metrics_slot *to, ndo2db_metrics_slot *from){
+	int x=0;
+
+	NDO2DB_METRICS_ADD(to->lines,from->lines);
+	NDO2DB_METRICS_ADD(to->bytes,from->bytes);
+	for(x=0;x<NDO2DB_METRICS_TYPES;x++)
+		NDO2DB_METRICS_ADD(to->events[x],from->events[x]);
+	NDO2DB_METRICS_ADD(to->errors,from->errors);
+	NDO2DB_METRICS_ADD(to->dropped_bytes,from->dropped_bytes);
+	for(x=0;x<NDO2DB_METRICS_CACHES;x++){
+		NDO2DB_METRICS_ADD(to->cache_hits[x],from->cache_hits[x]);
+		NDO2DB_METRICS_ADD(to->cache_misses[x],from->cache_misses[x]);
+	        }
+        }
+
+
+/* gives a new client connection a slot of its own, if one is free */
+int ndo2db_metrics_open(ndo2db_idi *idi){
+	ndo2db_metrics_slot *slot=NULL;
+	int x=0;
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL)
+		return NDO_OK;
+
+	ndo2db_metrics_lock();
+
+	ndo2db_metrics_shm->connections++;
+
+	for(x=0;x<NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+
+		/* a process that died without closing its slot leaves it to us */
+		if(ndo2db_metrics_shm->slot[x].used==NDO_TRUE && kill(ndo2db_metrics_shm->slot[x].pid,0)<0 && errno==ESRCH){
+			ndo2db_metrics_merge(&ndo2db_metrics_shm->closed,&ndo2db_metrics_shm->slot[x]);
+			memset(&ndo2db_metrics_shm->slot[x],0,sizeof(ndo2db_metrics_slot));
+		        }
+
+		if(slot==NULL && ndo2db_metrics_shm->slot[x].used==NDO_FALSE)
+			slot=&ndo2db_metrics_shm->slot[x];
+	        }
+
+	if(slot!=NULL){
+		slot->used=NDO_TRUE;
+		slot->pid=getpid();
+		slot->connection=ndo2db_metrics_shm->connections;
+		slot->instance[0]='\x0';
+	        }
+	else{
+		slot=&ndo2db_metrics_shm->other;
+		slot->used++;
+	        }
+
+	pthread_mutex_unlock(&ndo2db_metrics_shm->lock);
+
+	idi->metrics=slot;
+
+	return NDO_OK;
+        }
+
+
+/* retires the slot of a connection that has been closed */
+int ndo2db_metrics_close(ndo2db_idi *idi){
+	ndo2db_metrics_slot *slot=NULL;
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || (slot=idi->metrics)==NULL)
+		return NDO_OK;
+
+	idi->metrics=NULL;
+
+	ndo2db_metrics_lock();
+
+	if(slot==&ndo2db_metrics_shm->other){
+		slot->used--;
+		slot->queue_bytes=0;
+	        }
+	else{
+		ndo2db_metrics_merge(&ndo2db_metrics_shm->closed,slot);
+		memset(slot,0,sizeof(ndo2db_metrics_slot));
+	        }
+
+	pthread_mutex_unlock(&ndo2db_metrics_shm->lock);
+
+	return NDO_OK;
+        }
+
+
+/* labels the slot with the instance the client says it is */
+void ndo2db_metrics_hello(ndo2db_idi *idi){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL || idi->metrics==&ndo2db_metrics_shm->other || idi->instance_name==NULL)
+		return;
+
+	ndo2db_metrics_lock();
+	strncpy(idi->metrics->instance,idi->instance_name,sizeof(idi->metrics->instance)-1);
+	idi->metrics->instance[sizeof(idi->metrics->instance)-1]='\x0';
+	pthread_mutex_unlock(&ndo2db_metrics_shm->lock);
+        }
+
+
+
+/****************************************************************************/
+/* COUNTING                                                                 */
+/****************************************************************************/
+
+/* notes when something we want to time started */
+void ndo2db_metrics_start(struct timeval *start){
+
+	if(ndo2db_metrics_shm==NULL){
+		start->tv_sec=0;
+		start->tv_usec=0;
+		return;
+	        }
+
+	gettimeofday(start,NULL);
+        }
+
+
+/* adds the time since start to a histogram */
+static void ndo2db_metrics_observe(ndo2db_metrics_histogram *h, struct timeval *start){
+	struct timeval now;
+	long usec=0L;
+	int x=0;
+
+	gettimeofday(&now,NULL);
+	usec=(now.tv_sec-start->tv_sec)*1000000L+(now.tv_usec-start->tv_usec);
+	if(usec<0)
+		usec=0;
+
+	for(x=0;x<NDO2DB_METRICS_BUCKETS;x++){
+		if((unsigned long)usec<=ndo2db_metrics_bounds[x])
+			break;
+	        }
+
+	NDO2DB_METRICS_ADD(h->bucket[x],1);
+	NDO2DB_METRICS_ADD(h->usec,(unsigned long long)usec);
+        }
+
+
+/* counts an event we received */
+void ndo2db_metrics_received(ndo2db_idi *idi, int type){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL || type<0 || type>=NDO2DB_METRICS_TYPES)
+		return;
+
+	NDO2DB_METRICS_ADD(idi->metrics->events[type],1);
+        }
+
+
+/* times the handler of an event */
+void ndo2db_metrics_handled(int type, struct timeval *start){
+
+	if(ndo2db_metrics_shm==NULL || start->tv_sec==0 || type<0 || type>=NDO2DB_METRICS_TYPES)
+		return;
+
+	ndo2db_metrics_observe(&ndo2db_metrics_shm->handler[type],start);
+        }
+
+
+/* times a database round trip, and counts it against the client if it failed */
+void ndo2db_metrics_db(ndo2db_idi *idi, int op, struct timeval *start, int result){
+
+	if(ndo2db_metrics_shm==NULL || start->tv_sec==0 || op<0 || op>=NDO2DB_METRICS_DB_OPS)
+		return;
+
+	ndo2db_metrics_observe(&ndo2db_metrics_shm->db[op],start);
+
+	if(result==NDO_ERROR && idi!=NULL && idi->metrics!=NULL)
+		NDO2DB_METRICS_ADD(idi->metrics->errors,1);
+        }
+
+
+/* counts complete lines handed to the parser */
+void ndo2db_metrics_input(ndo2db_idi *idi, unsigned long lines, unsigned long bytes){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL)
+		return;
+
+	NDO2DB_METRICS_ADD(idi->metrics->lines,lines);
+	NDO2DB_METRICS_ADD(idi->metrics->bytes,bytes);
+        }
+
+
+/* counts input we had to throw away */
+void ndo2db_metrics_dropped(ndo2db_idi *idi, unsigned long bytes){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL)
+		return;
+
+	NDO2DB_METRICS_ADD(idi->metrics->dropped_bytes,bytes);
+        }
+
+
+/* sets how much input is waiting for the writer */
+void ndo2db_metrics_queue(ndo2db_idi *idi, unsigned long bytes){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL || idi->metrics==&ndo2db_metrics_shm->other)
+		return;
+
+	idi->metrics->queue_bytes=bytes;
+        }
+
+
+/* counts a cache lookup */
+void ndo2db_metrics_cache(ndo2db_idi *idi, int cache, int hit){
+
+	if(ndo2db_metrics_shm==NULL || idi==NULL || idi->metrics==NULL || cache<0 || cache>=NDO2DB_METRICS_CACHES)
+		return;
+
+	if(hit==NDO_TRUE)
+		NDO2DB_METRICS_ADD(idi->metrics->cache_hits[cache],1);
+	else
+		NDO2DB_METRICS_ADD(idi->metrics->cache_misses[cache],1);
+        }
+
+
+
+/****************************************************************************/
+/* TEXT FORMAT                                                              */
+/****************************************************************************/
+
+/* writes a label value with the quotes, backslashes and newlines escaped */
+static void ndo2db_metrics_label(ndo_dbuf *dbuf, const char *value){
+	char buf[2*sizeof(((ndo2db_metrics_slot *)0)->instance)+1];
+	int y=0;
+
+	for(;*value && y<(int)sizeof(buf)-2;value++){
+		if(*value=='"' || *value=='\\')
+			buf[y++]='\\';
+		if(*value=='\n'){
+			buf[y++]='\\';
+			buf[y++]='n';
+			continue;
+		        }
+		buf[y++]=*value;
+	        }
+	buf[y]='\x0';
+
+	ndo_dbuf_strcat(dbuf,buf);
+        }
+
+
+/* writes the labels that name a connection */
+static void ndo2db_metrics_connection_labels(ndo_dbuf *dbuf, ndo2db_metrics_slot *slot, int other){
+	char buf[32];
+
+	if(other==NDO_TRUE)
+		ndo_dbuf_strcat(dbuf,"connection=\"other\",instance=\"");
+	else{
+		snprintf(buf,sizeof(buf),"connection=\"%lu\",instance=\"",slot->connection);
+		ndo_dbuf_strcat(dbuf,buf);
+		ndo2db_metrics_label(dbuf,slot->instance);
+	        }
+	ndo_dbuf_strcat(dbuf,"\"");
+        }
+
+
+static void ndo2db_metrics_header(ndo_dbuf *dbuf, const char *name, const char *type, const char *help){
+	char buf[256];
+
+	snprintf(buf,sizeof(buf),"# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+	ndo_dbuf_strcat(dbuf,buf);
+        }
+
+
+static void ndo2db_metrics_value(ndo_dbuf *dbuf, const char *name, const char *labels, unsigned long long value){
+	char buf[512];
+
+	if(labels==NULL || labels[0]=='\x0')
+		snprintf(buf,sizeof(buf),"%s %llu\n",name,value);
+	else
+		snprintf(buf,sizeof(buf),"%s{%s} %llu\n",name,labels,value);
+	ndo_dbuf_strcat(dbuf,buf);
+        }
+
+
+/* writes one value per live connection */
+static void ndo2db_metrics_per_connection(ndo_dbuf *dbuf, ndo2db_metrics *m, const char *name, const char *type, const char *help, size_t offset){
+	ndo2db_metrics_slot *slot=NULL;
+	char buf[64];
+	int x=0;
+
+	ndo2db_metrics_header(dbuf,name,type,help);
+
+	for(x=0;x<=NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+		slot=(x<NDO2DB_METRICS_MAX_CONNECTIONS)?&m->slot[x]:&m->other;
+		if(slot->used==0)
+			continue;
+		ndo_dbuf_strcat(dbuf,(char *)name);
+		ndo_dbuf_strcat(dbuf,"{");
+		ndo2db_metrics_connection_labels(dbuf,slot,(slot==&m->other)?NDO_TRUE:NDO_FALSE);
+		snprintf(buf,sizeof(buf),"} %llu\n",*(unsigned long long *)((char *)slot+offset));
+		ndo_dbuf_strcat(dbuf,buf);
+	        }
+        }
+
+
+static void ndo2db_metrics_histogram_write(ndo_dbuf *dbuf, const char *name, const char *labels, ndo2db_metrics_histogram *h){
+	unsigned long long count=0;
+	char metric[64];
+	char full[256];
+	char le[32];
+	int x=0;
+
+	snprintf(metric,sizeof(metric),"%s_bucket",name);
+	for(x=0;x<=NDO2DB_METRICS_BUCKETS;x++){
+		count+=h->bucket[x];
+		if(x<NDO2DB_METRICS_BUCKETS)
+			snprintf(le,sizeof(le),"%g",(double)ndo2db_metrics_bounds[x]/1000000.0);
+		else
+			strcpy(le,"+Inf");
+		snprintf(full,sizeof(full),"%s,le=\"%s\"",labels,le);
+		ndo2db_metrics_value(dbuf,metric,full,count);
+	        }
+
+	snprintf(full,sizeof(full),"%s_sum{%s} %.6f\n",name,labels,(double)h->usec/1000000.0);
+	ndo_dbuf_strcat(dbuf,full);
+	snprintf(metric,sizeof(metric),"%s_count",name);
+	ndo2db_metrics_value(dbuf,metric,labels,count);
+        }
+
+
+/* renders a snapshot of the counters */
+static void ndo2db_metrics_render(ndo_dbuf *dbuf, ndo2db_metrics *m){
+	ndo2db_metrics_slot total;
+	ndo2db_metrics_slot *slot=NULL;
+	unsigned long live=0L;
+	char labels[128];
+	int x=0;
+	int y=0;
+
+	/* what every connection there has ever been added up to */
+	memcpy(&total,&m->closed,sizeof(total));
+	total.queue_bytes=0;
+	for(x=0;x<=NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+		slot=(x<NDO2DB_METRICS_MAX_CONNECTIONS)?&m->slot[x]:&m->other;
+		if(slot==&m->other)
+			live+=slot->used;
+		else if(slot->used==0)
+			continue;
+		else
+			live++;
+		ndo2db_metrics_merge(&total,slot);
+		total.queue_bytes+=slot->queue_bytes;
+	        }
+
+	ndo2db_metrics_header(dbuf,"ndo2db_connections","gauge","Client connections currently open.");
+	ndo2db_metrics_value(dbuf,"ndo2db_connections",NULL,live);
+	ndo2db_metrics_header(dbuf,"ndo2db_connections_total","counter","Client connections accepted.");
+	ndo2db_metrics_value(dbuf,"ndo2db_connections_total",NULL,m->connections);
+	ndo2db_metrics_header(dbuf,"ndo2db_input_lines_total","counter","Lines received from clients.");
+	ndo2db_metrics_value(dbuf,"ndo2db_input_lines_total",NULL,total.lines);
+	ndo2db_metrics_header(dbuf,"ndo2db_input_bytes_total","counter","Bytes received from clients, in complete lines.");
+	ndo2db_metrics_value(dbuf,"ndo2db_input_bytes_total",NULL,total.bytes);
+	ndo2db_metrics_header(dbuf,"ndo2db_dropped_bytes_total","counter","Bytes of input thrown away for lack of memory.");
+	ndo2db_metrics_value(dbuf,"ndo2db_dropped_bytes_total",NULL,total.dropped_bytes);
+	ndo2db_metrics_header(dbuf,"ndo2db_db_errors_total","counter","Database statements that failed.");
+	ndo2db_metrics_value(dbuf,"ndo2db_db_errors_total",NULL,total.errors);
+	ndo2db_metrics_header(dbuf,"ndo2db_queue_bytes","gauge","Bytes read from clients that the database writers have yet to handle.");
+	ndo2db_metrics_value(dbuf,"ndo2db_queue_bytes",NULL,total.queue_bytes);
+
+	ndo2db_metrics_header(dbuf,"ndo2db_events_total","counter","Events received, by type.");
+	for(x=0;x<NDO2DB_METRICS_NAMED_TYPES;x++){
+		snprintf(labels,sizeof(labels),"type=\"%s\"",ndo2db_metrics_types[x].name);
+		ndo2db_metrics_value(dbuf,"ndo2db_events_total",labels,total.events[ndo2db_metrics_types[x].type]);
+	        }
+
+	ndo2db_metrics_header(dbuf,"ndo2db_cache_hits_total","counter","Cache lookups that saved a database round trip.");
+	for(x=0;x<NDO2DB_METRICS_CACHES;x++){
+		snprintf(labels,sizeof(labels),"cache=\"%s\"",ndo2db_metrics_caches[x]);
+		ndo2db_metrics_value(dbuf,"ndo2db_cache_hits_total",labels,total.cache_hits[x]);
+	        }
+	ndo2db_metrics_header(dbuf,"ndo2db_cache_misses_total","counter","Cache lookups that went to the database.");
+	for(x=0;x<NDO2DB_METRICS_CACHES;x++){
+		snprintf(labels,sizeof(labels),"cache=\"%s\"",ndo2db_metrics_caches[x]);
+		ndo2db_metrics_value(dbuf,"ndo2db_cache_misses_total",labels,total.cache_misses[x]);
+	        }
+
+	/* types that have never been handled would only be noise */
+	ndo2db_metrics_header(dbuf,"ndo2db_handler_seconds","histogram","Time taken to handle an event, by type.");
+	for(x=0;x<NDO2DB_METRICS_NAMED_TYPES;x++){
+		for(y=0;y<=NDO2DB_METRICS_BUCKETS;y++){
+			if(m->handler[ndo2db_metrics_types[x].type].bucket[y]>0)
+				break;
+		        }
+		if(y>NDO2DB_METRICS_BUCKETS)
+			continue;
+		snprintf(labels,sizeof(labels),"type=\"%s\"",ndo2db_metrics_types[x].name);
+		ndo2db_metrics_histogram_write(dbuf,"ndo2db_handler_seconds",labels,&m->handler[ndo2db_metrics_types[x].type]);
+	        }
+
+	ndo2db_metrics_header(dbuf,"ndo2db_db_seconds","histogram","Database round trip time, by operation.");
+	for(x=0;x<NDO2DB_METRICS_DB_OPS;x++){
+		snprintf(labels,sizeof(labels),"op=\"%s\"",ndo2db_metrics_db_ops[x]);
+		ndo2db_metrics_histogram_write(dbuf,"ndo2db_db_seconds",labels,&m->db[x]);
+	        }
+
+	/* the same again for each connection */
+	ndo2db_metrics_per_connection(dbuf,m,"ndo2db_connection_input_lines_total","counter","Lines received, by connection.",offsetof(ndo2db_metrics_slot,lines));
+	ndo2db_metrics_per_connection(dbuf,m,"ndo2db_connection_input_bytes_total","counter","Bytes received in complete lines, by connection.",offsetof(ndo2db_metrics_slot,bytes));
+	ndo2db_metrics_per_connection(dbuf,m,"ndo2db_connection_dropped_bytes_total","counter","Bytes of input thrown away, by connection.",offsetof(ndo2db_metrics_slot,dropped_bytes));
+	ndo2db_metrics_per_connection(dbuf,m,"ndo2db_connection_db_errors_total","counter","Database statements that failed, by connection.",offsetof(ndo2db_metrics_slot,errors));
+	ndo2db_metrics_per_connection(dbuf,m,"ndo2db_connection_queue_bytes","gauge","Bytes waiting for the database writer, by connection.",offsetof(ndo2db_metrics_slot,queue_bytes));
+
+	ndo2db_metrics_header(dbuf,"ndo2db_connection_events_total","counter","Events received, by connection and type.");
+	for(x=0;x<=NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+		slot=(x<NDO2DB_METRICS_MAX_CONNECTIONS)?&m->slot[x]:&m->other;
+		if(slot->used==0)
+			continue;
+		for(y=0;y<NDO2DB_METRICS_NAMED_TYPES;y++){
+			if(slot->events[ndo2db_metrics_types[y].type]==0)
+				continue;
+			ndo_dbuf_strcat(dbuf,"ndo2db_connection_events_total{");
+			ndo2db_metrics_connection_labels(dbuf,slot,(slot==&m->other)?NDO_TRUE:NDO_FALSE);
+			snprintf(labels,sizeof(labels),",type=\"%s\"} %llu\n",ndo2db_metrics_types[y].name,slot->events[ndo2db_metrics_types[y].type]);
+			ndo_dbuf_strcat(dbuf,labels);
+		        }
+	        }
+
+	ndo2db_metrics_header(dbuf,"ndo2db_connection_cache_hits_total","counter","Cache lookups that saved a database round trip, by connection.");
+	for(x=0;x<=NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+		slot=(x<NDO2DB_METRICS_MAX_CONNECTIONS)?&m->slot[x]:&m->other;
+		if(slot->used==0)
+			continue;
+		for(y=0;y<NDO2DB_METRICS_CACHES;y++){
+			ndo_dbuf_strcat(dbuf,"ndo2db_connection_cache_hits_total{");
+			ndo2db_metrics_connection_labels(dbuf,slot,(slot==&m->other)?NDO_TRUE:NDO_FALSE);
+			snprintf(labels,sizeof(labels),",cache=\"%s\"} %llu\n",ndo2db_metrics_caches[y],slot->cache_hits[y]);
+			ndo_dbuf_strcat(dbuf,labels);
+		        }
+	        }
+
+	ndo2db_metrics_header(dbuf,"ndo2db_connection_cache_misses_total","counter","Cache lookups that went to the database, by connection.");
+	for(x=0;x<=NDO2DB_METRICS_MAX_CONNECTIONS;x++){
+		slot=(x<NDO2DB_METRICS_MAX_CONNECTIONS)?&m->slot[x]:&m->other;
+		if(slot->used==0)
+			continue;
+		for(y=0;y<NDO2DB_METRICS_CACHES;y++){
+			ndo_dbuf_strcat(dbuf,"ndo2db_connection_cache_misses_total{");
+			ndo2db_metrics_connection_labels(dbuf,slot,(slot==&m->other)?NDO_TRUE:NDO_FALSE);
+			snprintf(labels,sizeof(labels),",cache=\"%s\"} %llu\n",ndo2db_metrics_caches[y],slot->cache_misses[y]);
+			ndo_dbuf_strcat(dbuf,labels);
+		        }
+	        }
+        }
+
+
+
+/****************************************************************************/
+/* SERVER                                                                   */
+/****************************************************************************/
+
+static int ndo2db_metrics_write(int sd, const char *buf, size_t len){
+	ssize_t result=0;
+
+	while(len>0){
+		if((result=write(sd,buf,len))<0){
+			if(errno==EINTR)
+				continue;
+			return NDO_ERROR;
+		        }
+		buf+=result;
+		len-=(size_t)result;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* answers one scrape */
+static void ndo2db_metrics_serve(int sd){
+	ndo2db_metrics *snapshot=NULL;
+	struct pollfd pfd;
+	ndo_dbuf dbuf;
+	char request[512];
+	char header[160];
+	ssize_t result=0;
+	int http=NDO_FALSE;
+	int profile=NDO_FALSE;
+
+	/* HTTP clients speak first, anything else gets the text right away */
+	pfd.fd=sd;
+	pfd.events=POLLIN;
+	if(poll(&pfd,1,NDO2DB_METRICS_REQUEST_WAIT)>0 && (result=read(sd,request,sizeof(request)-1))>0){
+		request[result]='\x0';
+		if(!strncmp(request,"GET ",4))
+			http=NDO_TRUE;
+		if(!strncmp(request,"GET /profile",12) || !strncmp(request,"profile",7))
+			profile=NDO_TRUE;
+	        }
+
+	ndo_dbuf_init(&dbuf,16384);
+
+	if(profile==NDO_TRUE)
+		ndo2db_profile_report(&dbuf);
+
+	else{
+		if((snapshot=(ndo2db_metrics *)malloc(sizeof(ndo2db_metrics)))==NULL)
+			return;
+
+		/* copy everything at once so the totals add up */
+		ndo2db_metrics_lock();
+		memcpy(snapshot,ndo2db_metrics_shm,sizeof(ndo2db_metrics));
+		pthread_mutex_unlock(&ndo2db_metrics_shm->lock);
+
+		ndo2db_metrics_render(&dbuf,snapshot);
+		free(snapshot);
+	        }
+
+	if(http==NDO_TRUE){
+		snprintf(header,sizeof(header),"HTTP/1.0 200 OK\r\nContent-Type: text/plain%s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",(profile==NDO_TRUE)?"":"; version=0.0.4",dbuf.used_size);
+		ndo2db_metrics_write(sd,header,strlen(header));
+	        }
+	if(dbuf.buf!=NULL)
+		ndo2db_metrics_write(sd,dbuf.buf,(size_t)dbuf.used_size);
+
+	ndo_dbuf_free(&dbuf);
+        }
+
+
+/* accepts scrapes one at a time */
+static void *ndo2db_metrics_server(void *arg){
+	int sd=-1;
+
+	while(1){
+
+		if((sd=accept(ndo2db_metrics_sd,NULL,NULL))<0){
+			if(errno==EINTR || errno==ECONNABORTED)
+				continue;
+			syslog(LOG_USER|LOG_INFO,"Error: accept() failed on metrics socket: %s\n",strerror(errno));
+			break;
+		        }
+
+		ndo2db_metrics_serve(sd);
+
+		shutdown(sd,SHUT_WR);
+		close(sd);
+	        }
+
+	return NULL;
+        }
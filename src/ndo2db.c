@@ -39,6 +39,18 @@
 #include "../include/db.h"
 #include "../include/dbhandlers.h"
 #include "../include/queue.h"
+#include "../include/eventserver.h"
+#include "../include/partition.h"
+#include "../include/statuscache.h"
+#include "../include/objectbatch.h"
+#include "../include/configload.h"
+#include "../include/configdigest.h"
+#include "../include/trimmer.h"
+#include "../include/metrics.h"
+#include "../include/profile.h"
+#include "../include/capture.h"
+
+#include <poll.h>
 
 #ifdef HAVE_SYSTEMD
 #include <systemd/sd_daemon.h>
@@ -80,15 +92,29 @@ int ndo2db_no_fork=NDO_FALSE;
 int ndo2db_show_version=NDO_FALSE;
 int ndo2db_show_license=NDO_FALSE;
 int ndo2db_show_help=NDO_FALSE;
+unsigned long ndo2db_queue_size=NDO_QUEUE_DEFAULT_SIZE;
+int ndo2db_server_model=NDO2DB_SERVER_FORK;
+int ndo2db_writer_threads=NDO2DB_DEFAULT_WRITER_THREADS;
+int ndo2db_partition_writers=0;
+int ndo2db_status_flush_interval=0;
+int ndo2db_object_batch_size=0;
+int ndo2db_config_bulk_load=NDO_FALSE;
+int ndo2db_config_digests=NDO_FALSE;
+char *ndo2db_object_cache_file=NULL;
+char *ndo2db_metrics_socket_name=NULL;
+int ndo2db_sql_profile=NDO_FALSE;
+unsigned long ndo2db_sql_profile_slow_time=NDO2DB_DEFAULT_PROFILE_SLOW_TIME;
+int ndo2db_sql_profile_slow_count=NDO2DB_DEFAULT_PROFILE_SLOW_COUNT;
+char *ndo2db_capture_file=NULL;
 
 ndo2db_dbconfig ndo2db_db_settings;
-time_t ndo2db_db_last_checkin_time=0L;
 
 char *ndo2db_debug_file=NULL;
 int ndo2db_debug_level=NDO2DB_DEBUGL_NONE;
 int ndo2db_debug_verbosity=NDO2DB_DEBUGV_BASIC;
 FILE *ndo2db_debug_file_fp=NULL;
 unsigned long ndo2db_max_debug_file_size=0L;
+pthread_mutex_t ndo2db_debug_file_lock=PTHREAD_MUTEX_INITIALIZER;
 
 extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
 
@@ -229,6 +255,12 @@ int main(int argc, char **argv){
 		exit(1);
 		}
 
+	/* the status row descriptors are shared by all writers */
+	if(ndo2db_init_status_rows()==NDO_ERROR){
+		printf("Could not set up the status row descriptors.\n");
+		exit(1);
+	        }
+
 	/* initialize signal handling */
 	signal(SIGQUIT,ndo2db_parent_sighandler);
 	signal(SIGTERM,ndo2db_parent_sighandler);
@@ -428,6 +460,63 @@ int ndo2db_process_config_var(char *arg){
 	else if(!strcmp(var,"tcp_port")){
 		ndo2db_tcp_port=atoi(val);
 	        }
+	else if(!strcmp(var,"queue_size")){
+		if((ndo2db_queue_size=strtoul(val,NULL,0))==0L)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"server_model")){
+		if(!strcmp(val,"event"))
+			ndo2db_server_model=NDO2DB_SERVER_EVENT;
+		else if(!strcmp(val,"fork"))
+			ndo2db_server_model=NDO2DB_SERVER_FORK;
+		else
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"writer_threads")){
+		ndo2db_writer_threads=atoi(val);
+		if(ndo2db_writer_threads<1 || ndo2db_writer_threads>NDO2DB_MAX_WRITER_THREADS)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"partition_writers")){
+		ndo2db_partition_writers=atoi(val);
+		if(ndo2db_partition_writers<0 || ndo2db_partition_writers>NDO2DB_MAX_PARTITION_WRITERS)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"status_flush_interval")){
+		ndo2db_status_flush_interval=atoi(val);
+		if(ndo2db_status_flush_interval<0)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"object_batch_size")){
+		ndo2db_object_batch_size=atoi(val);
+		if(ndo2db_object_batch_size<0)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"config_bulk_load"))
+		ndo2db_config_bulk_load=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+	else if(!strcmp(var,"config_digests"))
+		ndo2db_config_digests=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+	else if(!strcmp(var,"object_cache_file")){
+		if((ndo2db_object_cache_file=strdup(val))==NULL)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"metrics_socket")){
+		if((ndo2db_metrics_socket_name=strdup(val))==NULL)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"capture_file")){
+		if((ndo2db_capture_file=strdup(val))==NULL)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"sql_profile"))
+		ndo2db_sql_profile=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
+	else if(!strcmp(var,"sql_profile_slow_time"))
+		ndo2db_sql_profile_slow_time=strtoul(val,NULL,0);
+	else if(!strcmp(var,"sql_profile_slow_count")){
+		ndo2db_sql_profile_slow_count=atoi(val);
+		if(ndo2db_sql_profile_slow_count<1 || ndo2db_sql_profile_slow_count>NDO2DB_PROFILE_MAX_SLOW)
+			return NDO_ERROR;
+	        }
 	else if(!strcmp(var,"db_servertype")){
 		if(!strcmp(val,"mysql"))
 			ndo2db_db_settings.server_type=NDO2DB_DBSERVER_MYSQL;
@@ -496,6 +585,41 @@ int ndo2db_process_config_var(char *arg){
 
 	else if(!strcmp(var,"max_acknowledgements_age"))
 		ndo2db_db_settings.max_acknowledgements_age=strtoul(val,NULL,0)*60;
+
+	else if(!strcmp(var,"batch_rows")){
+		if((ndo2db_db_settings.batch_rows=atoi(val))<1)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"archive_batch_rows")){
+		if((ndo2db_db_settings.archive_batch_rows=atoi(val))<1)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"batch_bytes")){
+		if((ndo2db_db_settings.batch_bytes=strtoul(val,NULL,0))==0L)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"batch_delay"))
+		ndo2db_db_settings.batch_delay=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"commit_events")){
+		if((ndo2db_db_settings.commit_events=atoi(val))<0)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"commit_interval"))
+		ndo2db_db_settings.commit_interval=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"trim_chunk_rows"))
+		ndo2db_db_settings.trim_chunk_rows=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"trim_chunk_time")){
+		if((ndo2db_db_settings.trim_chunk_time=strtoul(val,NULL,0))==0L)
+			return NDO_ERROR;
+	        }
+	else if(!strcmp(var,"trim_pause"))
+		ndo2db_db_settings.trim_pause=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"prepared_statements"))
+		ndo2db_db_settings.prepared_statements=(atoi(val)>0)?NDO_TRUE:NDO_FALSE;
 		
 	else if(!strcmp(var,"ndo2db_user"))
 		ndo2db_user=strdup(val);
@@ -547,6 +671,16 @@ int ndo2db_initialize_variables(void){
 	ndo2db_db_settings.max_contactnotificationmethods_age=0L;
 	ndo2db_db_settings.max_logentries_age=0L;
 	ndo2db_db_settings.max_acknowledgements_age=0L;
+	ndo2db_db_settings.batch_rows=NDO2DB_DEFAULT_BATCH_ROWS;
+	ndo2db_db_settings.archive_batch_rows=NDO2DB_DEFAULT_ARCHIVE_BATCH_ROWS;
+	ndo2db_db_settings.batch_bytes=NDO2DB_DEFAULT_BATCH_BYTES;
+	ndo2db_db_settings.batch_delay=NDO2DB_DEFAULT_BATCH_DELAY;
+	ndo2db_db_settings.commit_events=0;
+	ndo2db_db_settings.commit_interval=0L;
+	ndo2db_db_settings.trim_chunk_rows=0L;
+	ndo2db_db_settings.trim_chunk_time=NDO2DB_DEFAULT_TRIM_CHUNK_TIME;
+	ndo2db_db_settings.trim_pause=NDO2DB_DEFAULT_TRIM_PAUSE;
+	ndo2db_db_settings.prepared_statements=NDO_TRUE;
 
 	return NDO_OK;
         }
@@ -576,6 +710,18 @@ int ndo2db_free_program_memory(void){
 		free(ndo2db_socket_name);
 		ndo2db_socket_name=NULL;
 		}
+	if(ndo2db_object_cache_file){
+		free(ndo2db_object_cache_file);
+		ndo2db_object_cache_file=NULL;
+		}
+	if(ndo2db_metrics_socket_name){
+		free(ndo2db_metrics_socket_name);
+		ndo2db_metrics_socket_name=NULL;
+		}
+	if(ndo2db_capture_file){
+		free(ndo2db_capture_file);
+		ndo2db_capture_file=NULL;
+		}
 	if(ndo2db_db_settings.host){
 		free(ndo2db_db_settings.host);
 		ndo2db_db_settings.host=NULL;
@@ -623,6 +769,17 @@ int ndo2db_check_init_reqs(void){
 		        }
 	        }
 
+	if(ndo2db_server_model==NDO2DB_SERVER_EVENT){
+#ifndef HAVE_SYS_EPOLL_H
+		printf("The event server model is not supported on this platform.\n");
+		return NDO_ERROR;
+#endif
+		if(use_ssl==NDO_TRUE){
+			printf("The event server model cannot be used with use_ssl.\n");
+			return NDO_ERROR;
+		        }
+	        }
+
 	return NDO_OK;
         }
 
@@ -848,6 +1005,8 @@ int ndo2db_cleanup_socket(void){
 	if(lock_file)
 		unlink(lock_file);
 
+	ndo2db_metrics_cleanup();
+
 	return NDO_OK;
         }
 
@@ -993,6 +1152,19 @@ int ndo2db_wait_for_connections(void){
 		return NDO_ERROR;
 #endif
 
+	/* the counters must be shared before any client is forked */
+	if(ndo2db_profile_init()==NDO_ERROR || ndo2db_metrics_init(ndo2db_metrics_socket_name)==NDO_ERROR){
+		ndo2db_cleanup_socket();
+		return NDO_ERROR;
+	        }
+
+	/* handle all clients in this process */
+	if(ndo2db_server_model==NDO2DB_SERVER_EVENT){
+		ndo2db_event_server(ndo2db_sd);
+		ndo2db_cleanup_socket();
+		return NDO_ERROR;
+	        }
+
 	/* accept connections... */
 	while(1){
 
@@ -1067,10 +1239,11 @@ int ndo2db_wait_for_connections(void){
 
 
 int ndo2db_handle_client_connection(int sd){
-	ndo_dbuf dbuf;
-	int dbuf_chunk=2048;
-	ndo2db_idi idi;
-	char buf[512];
+	ndo2db_capture capture;
+	struct pollfd pfd;
+	char *buf=NULL;
+	size_t bufsize=0;
+	pid_t chpid;
 	int result=0;
 	int error=NDO_FALSE;
 
@@ -1092,20 +1265,25 @@ int ndo2db_handle_client_connection(int sd){
 	signal(SIGSEGV,ndo2db_child_sighandler);
 	signal(SIGFPE,ndo2db_child_sighandler);
 
-	pid_t chpid;
-	if ((chpid = fork()) == 0) {
-		ndo2db_async_client_handle();
-	}
+	/* create the queue we share with the database writer */
+	if(ndo_queue_init((size_t)ndo2db_queue_size*1024*1024)==NDO_ERROR)
+		return NDO_ERROR;
 
-	/* initialize input data information */
-	ndo2db_idi_init(&idi);
+	/* fork the database writer */
+	if((chpid=fork())<0){
+		syslog(LOG_ERR,"Error: Could not fork the database writer process: %s",strerror(errno));
+		ndo_queue_free();
+		return NDO_ERROR;
+	        }
+	else if(chpid==0){
+		ndo2db_async_client_handle();
+		_exit(0);
+	        }
 
-	/* initialize dynamic buffer (2KB chunk size) */
-	ndo_dbuf_init(&dbuf,dbuf_chunk);
+	ndo_queue_set_reader(chpid);
 
-	/* initialize database connection */
-	ndo2db_db_init(&idi);
-	ndo2db_db_connect(&idi);
+	/* record what the client sends, if asked to */
+	ndo2db_capture_open(&capture);
 
 #ifdef HAVE_SSL
 	if(use_ssl==NDO_TRUE){
@@ -1127,18 +1305,39 @@ int ndo2db_handle_client_connection(int sd){
 
 	/* read all data from client */
 	while(1){
+
+		/* read straight into free space in the queue */
+		if((buf=ndo_queue_reserve(&bufsize))==NULL){
+			error=NDO_TRUE;
+			break;
+		        }
+
+		/* don't sit on captured input while the client is quiet */
+#ifdef HAVE_SSL
+		if(capture.used>0 && (use_ssl==NDO_FALSE || SSL_pending(ssl)==0)){
+#else
+		if(capture.used>0){
+#endif
+			pfd.fd=sd;
+			pfd.events=POLLIN;
+			if(poll(&pfd,1,NDO2DB_CAPTURE_FLUSH_TIME*1000)==0){
+				ndo2db_capture_idle();
+				continue;
+			        }
+		        }
+
 #ifdef HAVE_SSL
 		if(use_ssl==NDO_FALSE)
-			result=read(sd,buf,sizeof(buf)-1);
+			result=read(sd,buf,bufsize);
 		else{
-			result=SSL_read(ssl,buf,sizeof(buf)-1);
+			result=SSL_read(ssl,buf,bufsize);
 			if(result==-1 && (SSL_get_error(ssl,result)==SSL_ERROR_WANT_READ)){
 				syslog(LOG_ERR,"SSL read error\n");
 			}
 		}
 #else
 
-		result=read(sd,buf,sizeof(buf)-1);
+		result=read(sd,buf,bufsize);
 #endif
 		/* bail out on hard errors */
 		if(result==-1) {
@@ -1170,10 +1369,6 @@ int ndo2db_handle_client_connection(int sd){
 				}
 #endif
 
-			/* gracefully back out of current operation... */
-			ndo2db_db_goodbye(&idi);
-			kill (chpid, SIGTERM);
-
 			break;
 		        }
 
@@ -1181,48 +1376,23 @@ int ndo2db_handle_client_connection(int sd){
 		printf("BYTESREAD: %d\n",result);
 #endif
 
-		/* append data we just read to dynamic buffer */
-		buf[result]='\x0';
-		ndo_dbuf_strcat(&dbuf,buf);
-
-		/* check for completed lines of input */
-		ndo2db_check_for_client_input(&idi,&dbuf);
-		/* reinitialize buffer */
-		ndo_dbuf_free(&dbuf);
-		ndo_dbuf_init(&dbuf,dbuf_chunk);
-
-		/* should we disconnect the client? */
-		if(idi.disconnect_client==NDO_TRUE){
+		ndo2db_capture_write(&capture,buf,(size_t)result);
 
-			/* gracefully back out of current operation... */
-			ndo2db_db_goodbye(&idi);
-			kill (chpid, SIGTERM);
-
-			break;
-		        }
+		/* hand the data we just read to the database writer */
+		ndo_queue_commit((size_t)result);
 	        }
 
-#ifdef DEBUG_NDO2DB2
-	printf("BYTES: %lu, LINES: %lu\n",idi.bytes_processed,idi.lines_processed);
-#endif
-
-	/* free memory allocated to dynamic buffer */
-	ndo_dbuf_free(&dbuf);
-
-	/* disconnect from database */
-	ndo2db_db_disconnect(&idi);
-	ndo2db_db_deinit(&idi);
-
-	/* free memory */
-	ndo2db_free_input_memory(&idi);
-	ndo2db_free_connection_memory(&idi);
+	ndo2db_capture_close(&capture);
 
-	/* clean queue */
-	del_queue();
+	/* let the database writer finish what is queued and say goodbye */
+	ndo_queue_close();
 
 	/* wait for child to end work */
 	waitpid(chpid, NULL, 0);
 
+	/* clean queue */
+	ndo_queue_free();
+
 	/* close syslog facility */
 	/*closelog();*/
 
@@ -1258,6 +1428,20 @@ int ndo2db_idi_init(ndo2db_idi *idi){
 	idi->current_object_config_type=NDO2DB_CONFIGTYPE_ORIGINAL;
 	idi->data_start_time=0L;
 	idi->data_end_time=0L;
+	idi->partitions=NULL;
+	idi->status_cache=NULL;
+	idi->object_batch=NULL;
+	idi->config_load=NULL;
+	idi->config_digests=NULL;
+	idi->trimmer=NULL;
+	idi->metrics=NULL;
+	idi->active_objects.object_id=NULL;
+	idi->active_objects.objects=0;
+	idi->active_objects.allocated=0;
+	idi->active_objects.reconcile=NDO_FALSE;
+	ndo_arena_init(&idi->input_arena,NDO2DB_INPUT_ARENA_BLOCK);
+	idi->input_slots=NULL;
+	idi->input_in_arena=NDO_FALSE;
 
 	/* initialize mbuf */
 	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
@@ -1270,95 +1454,111 @@ int ndo2db_idi_init(ndo2db_idi *idi){
         }
 
 
-/* checks for single lines of input from a client connection */
-int ndo2db_check_for_client_input(ndo2db_idi *idi,ndo_dbuf *dbuf){
-	char *buf=NULL;
-	register int x;
-
-
-	if(dbuf==NULL)
-		return NDO_OK;
-	if(dbuf->buf==NULL)
-		return NDO_OK;
-
-#ifdef DEBUG_NDO2DB2
-	printf("RAWBUF: %s\n",dbuf->buf);
-	printf("  USED1: %lu, BYTES: %lu, LINES: %lu\n",dbuf->used_size,idi->bytes_processed,idi->lines_processed);
-#endif
-
-	get_queue_id(getpid());
-	push_into_queue(dbuf->buf);
-
-	return NDO_OK;
-        }
-
 /* asynchronous handle clients events */
 void ndo2db_async_client_handle() {
 	ndo2db_idi idi;
-	size_t len = 0, curlen, insz, maxbuf = 1024 * 64, bufsz = 1024 * 66;
-    int i;
-	char *buf = (char*)calloc(bufsz, sizeof(char));
-	char *temp_buf;
+	ndo_lbuf lbuf;
+	size_t insz;
+	unsigned long linelen;
+	char *qbuf;
+	char *ptr;
+	char *line;
+	int idle_wait;
 
 	/* initialize input data information */
 	ndo2db_idi_init(&idi);
+	ndo2db_metrics_open(&idi);
+
+	/* initialize the line buffer, it grows to fit the longest line seen */
+	if (ndo_lbuf_init(&lbuf, NDO_QUEUE_MAX_CHUNK * 2) == NDO_ERROR) {
+		syslog(LOG_ERR, "Error: Could not allocate the input line buffer\n");
+		ndo2db_metrics_close(&idi);
+		return;
+	}
 
 	/* initialize database connection */
 	ndo2db_db_init(&idi);
 	ndo2db_db_connect(&idi);
 
-	get_queue_id(getppid());
+	/* spread events over several database connections if asked to */
+	if (ndo2db_partition_writers > 0)
+		ndo2db_partition_start(&idi, ndo2db_partition_writers);
+
+	/* don't sit on held back status updates while the client is quiet */
+	idle_wait = NDO2DB_QUEUE_IDLE_WAIT;
+	if (ndo2db_status_flush_interval > 0 && ndo2db_status_flush_interval < idle_wait)
+		idle_wait = ndo2db_status_flush_interval;
 
 	for (;;) {
-		char * qbuf = pop_from_queue();
-
-		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Queue Message: %s\n", qbuf);
-
-		insz = strlen(qbuf);
-		curlen = len + insz;
-		strcat(buf, qbuf);
-		free(qbuf);
-
-        i = 0;
-		for ( ; i < curlen; i++) {
-			if (buf[i] == '\n') {
-				temp_buf = (char*)malloc((curlen + 4) * sizeof(char));
-				strncpy(temp_buf, buf, i);
-				temp_buf[i] = '\x0';
-
-				ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Handling: %s\n", temp_buf);
-				ndo2db_handle_client_input(&idi,temp_buf);
-/*				ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Full Buffer: %s\n", buf); */
-
-				memmove(buf, &buf[i+1], bufsz - i);
-				len = 0;
-				curlen = strlen(buf);
-				free(temp_buf);
-
-				idi.lines_processed++;
-				idi.bytes_processed += i+1;
-                i = -1;
-			}
+		/* nothing more to read right now, so don't hold on to batched rows */
+		if (ndo_queue_used() == 0)
+			ndo2db_db_commit(&idi);
+
+		/* the reader is done and everything queued has been handled */
+		if ((qbuf = ndo_queue_peek(&insz, idle_wait)) == NULL)
+			break;
+
+		/* nothing came in for a while */
+		if (insz == 0) {
+			ndo2db_status_cache_flush_expired(&idi);
+			continue;
 		}
 
-		len = curlen;
-		if (len  > maxbuf) {
-			buf[maxbuf+1] = 0;
-			len = curlen = maxbuf;
-			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Truncating text at position %d - %s\n", maxbuf+1, &buf[maxbuf+2]);
-		} else if (len == 0)
-			memset(buf, 0, bufsz * sizeof(char));
+		ndo2db_metrics_queue(&idi, (unsigned long)ndo_queue_used());
+
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Queue Message: %.*s\n", (int)insz, qbuf);
+
+		if ((ptr = ndo_lbuf_reserve(&lbuf, (unsigned long)insz)) == NULL) {
+			syslog(LOG_ERR, "Error: Could not grow the input line buffer, dropping %lu bytes\n", (unsigned long)insz);
+			ndo2db_metrics_dropped(&idi, (unsigned long)insz);
+			ndo_queue_release(insz);
+			continue;
+		}
+		memcpy(ptr, qbuf, insz);
+		ndo_lbuf_commit(&lbuf, (unsigned long)insz);
+		ndo_queue_release(insz);
+
+		/* hand each completed line over in place */
+		while ((line = ndo_lbuf_next_line(&lbuf, &linelen)) != NULL) {
+
+			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO, 2,"Handling: %s\n", line);
+			ndo2db_handle_client_input(&idi, line);
+
+			idi.lines_processed++;
+			idi.bytes_processed += linelen + 1;
+			ndo2db_metrics_input(&idi, 1L, linelen + 1);
+		}
 	}
 
-	free(buf);
+	ndo_lbuf_free(&lbuf);
+
+	/* write the definitions and status updates we've been holding back */
+	ndo2db_object_batch_flush(&idi);
+	ndo2db_config_load_flush(&idi);
+	ndo2db_save_active_objects(&idi);
+	ndo2db_status_cache_flush(&idi);
+
+	/* wait for the partition writers to finish */
+	ndo2db_partition_stop(&idi);
+	ndo2db_trimmer_stop(&idi);
+
+	/* gracefully back out of current operation... */
+	ndo2db_db_goodbye(&idi);
 
 	/* disconnect from database */
 	ndo2db_db_disconnect(&idi);
 	ndo2db_db_deinit(&idi);
 
 	/* free memory */
+	ndo2db_status_cache_free(&idi);
+	ndo2db_object_batch_free(&idi);
+	ndo2db_config_load_free(&idi);
+	ndo2db_config_digest_free(&idi);
+	ndo2db_free_active_objects(&idi);
 	ndo2db_free_input_memory(&idi);
 	ndo2db_free_connection_memory(&idi);
+
+	ndo2db_metrics_close(&idi);
 }
 
 /* handles a single line of input from a client connection */
@@ -1368,6 +1568,7 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 	unsigned long data_type_long=0L;
 	int data_type=NDO_DATA_NONE;
 	int input_type=NDO2DB_INPUT_DATA_NONE;
+	char *saveptr=NULL;
 
 #ifdef DEBUG_NDO2DB2
 	printf("HANDLING: '%s'\n",buf);
@@ -1388,8 +1589,8 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 
 	case NDO2DB_INPUT_SECTION_NONE:
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+		var=strtok_r(buf,":",&saveptr);
+		val=strtok_r(NULL,"\n",&saveptr);
 
 		if(!strcmp(var,NDO_API_HELLO)){
 
@@ -1404,8 +1605,8 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 
 	case NDO2DB_INPUT_SECTION_HEADER:
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+		var=strtok_r(buf,":",&saveptr);
+		val=strtok_r(NULL,"\n",&saveptr);
 
 		if(!strcmp(var,NDO_API_STARTDATADUMP)){
 
@@ -1451,8 +1652,8 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 
 	case NDO2DB_INPUT_SECTION_FOOTER:
 
-		var=strtok(buf,":");
-		val=strtok(NULL,"\n");
+		var=strtok_r(buf,":",&saveptr);
+		val=strtok_r(NULL,"\n",&saveptr);
 
 		/* client is saying goodbye... */
 		if(!strcmp(var,NDO_API_GOODBYE))
@@ -1467,8 +1668,8 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 
 		if(idi->current_input_data==NDO2DB_INPUT_DATA_NONE){
 
-			var=strtok(buf,":");
-			val=strtok(NULL,"\n");
+			var=strtok_r(buf,":",&saveptr);
+			val=strtok_r(NULL,"\n",&saveptr);
 
 			input_type=atoi(var);
 
@@ -1644,8 +1845,15 @@ int ndo2db_handle_client_input(ndo2db_idi *idi, char *buf){
 		/* we are processing some type of data already... */
 		else{
 
-			var=strtok(buf,"=");
-			val=strtok(NULL,"\n");
+			/* split at the first '=', the value may have more of them */
+			var=buf;
+			while(*var=='=')
+				var++;
+			if((val=strchr(var,'='))!=NULL){
+				*val++='\x0';
+				if(*val=='\x0')
+					val=NULL;
+			        }
 
 			/* get the data type */
 			data_type_long=strtoul(var,NULL,0);
@@ -1702,18 +1910,35 @@ int ndo2db_start_input_data(ndo2db_idi *idi){
 	/* sometimes ndo2db_end_input_data() isn't called, so free memory if we find it */
 	ndo2db_free_input_memory(idi);
 
-	/* allocate memory for holding buffered input */
-	if((idi->buffered_input=(char **)malloc(sizeof(char *)*NDO_MAX_DATA_TYPES))==NULL)
-		return NDO_ERROR;
+	/* buffered input slots are allocated once per connection */
+	if(idi->input_slots==NULL){
+		if((idi->input_slots=(char **)malloc(sizeof(char *)*NDO_MAX_DATA_TYPES))==NULL)
+			return NDO_ERROR;
+		for(x=0;x<NDO_MAX_DATA_TYPES;x++)
+			idi->input_slots[x]=NULL;
+	        }
 
-	/* initialize buffered input slots */
-	for(x=0;x<NDO_MAX_DATA_TYPES;x++)
-		idi->buffered_input[x]=NULL;
+	/* the event's data lives in the arena until the event is done */
+	idi->buffered_input=idi->input_slots;
+	idi->input_in_arena=NDO_TRUE;
 
 	return NDO_OK;
         }
 
 
+/* copies a data item for the event being parsed */
+static char *ndo2db_copy_input_item(ndo2db_idi *idi, char *buf){
+
+	if(buf==NULL)
+		buf="";
+
+	if(idi->input_in_arena==NDO_TRUE)
+		return ndo_arena_strdup(&idi->input_arena,buf);
+
+	return strdup(buf);
+        }
+
+
 int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 	char *newbuf=NULL;
 	int mbuf_used=NDO_TRUE;
@@ -1722,14 +1947,13 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 		return NDO_ERROR;
 
 	if (idi->current_input_data == NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST) {
-		if(buf==NULL)
-			newbuf=strdup("");
-		else
-			newbuf=strdup(buf);
+		if((newbuf=ndo2db_copy_input_item(idi,buf))==NULL)
+			return NDO_ERROR;
 		if (type != NDO_DATA_ACTIVEOBJECTSTYPE)
 			ndo_unescape_buffer(newbuf);
 		if(idi->buffered_input[type]!=NULL){
-			free(idi->buffered_input[type]);
+			if(idi->input_in_arena==NDO_FALSE)
+				free(idi->buffered_input[type]);
 			idi->buffered_input[type]=NULL;
 		}
 		/* save buffered item */
@@ -1811,20 +2035,14 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 	case NDO_DATA_PARENTSERVICE:
 
 		/* strings are escaped when they arrive */
-		if(buf==NULL)
-			newbuf=strdup("");
-		else
-			newbuf=strdup(buf);
-		ndo_unescape_buffer(newbuf);
+		if((newbuf=ndo2db_copy_input_item(idi,buf))!=NULL)
+			ndo_unescape_buffer(newbuf);
 		break;
 
 	default:
 
 		/* data hasn't been escaped */
-		if(buf==NULL)
-			newbuf=strdup("");
-		else
-			newbuf=strdup(buf);
+		newbuf=ndo2db_copy_input_item(idi,buf);
 		break;
 	}
 
@@ -1894,7 +2112,8 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 
 		/* if there was already a matching item, discard the old one */
 		if(idi->buffered_input[type]!=NULL){
-			free(idi->buffered_input[type]);
+			if(idi->input_in_arena==NDO_FALSE)
+				free(idi->buffered_input[type]);
 			idi->buffered_input[type]=NULL;
 		        }
 
@@ -1909,6 +2128,7 @@ int ndo2db_add_input_data_item(ndo2db_idi *idi, int type, char *buf){
 
 int ndo2db_add_input_data_mbuf(ndo2db_idi *idi, int type, int mbuf_slot, char *buf){
 	int allocation_chunk=80;
+	int new_lines=0;
 	char **newbuffer=NULL;
 
 	if(idi==NULL || buf==NULL)
@@ -1917,6 +2137,22 @@ int ndo2db_add_input_data_mbuf(ndo2db_idi *idi, int type, int mbuf_slot, char *b
 	if(mbuf_slot>=NDO2DB_MAX_MBUF_ITEMS)
 		return NDO_ERROR;
 
+	/* the arena gives up the old array when the event is done, so grow by doubling */
+	if(idi->input_in_arena==NDO_TRUE){
+		if(idi->mbuf[mbuf_slot].used_lines==idi->mbuf[mbuf_slot].allocated_lines){
+			new_lines=(idi->mbuf[mbuf_slot].allocated_lines>0)?idi->mbuf[mbuf_slot].allocated_lines*2:allocation_chunk;
+			if((newbuffer=(char **)ndo_arena_alloc(&idi->input_arena,sizeof(char *)*new_lines))==NULL)
+				return NDO_ERROR;
+			if(idi->mbuf[mbuf_slot].used_lines>0)
+				memcpy(newbuffer,idi->mbuf[mbuf_slot].buffer,sizeof(char *)*idi->mbuf[mbuf_slot].used_lines);
+			idi->mbuf[mbuf_slot].buffer=newbuffer;
+			idi->mbuf[mbuf_slot].allocated_lines=new_lines;
+		        }
+		idi->mbuf[mbuf_slot].buffer[idi->mbuf[mbuf_slot].used_lines]=buf;
+		idi->mbuf[mbuf_slot].used_lines++;
+		return NDO_OK;
+	        }
+
 	/* create buffer */
 	if(idi->mbuf[mbuf_slot].buffer==NULL){
 #ifdef NDO2DB_DEBUG_MBUF
@@ -1960,13 +2196,81 @@ int ndo2db_end_input_data(ndo2db_idi *idi){
 		return NDO_ERROR;
 
 	/* update db stats occassionally */
-	if(ndo2db_db_last_checkin_time<(time(NULL)-60))
+	if(idi->dbinfo.last_checkin_time<(time(NULL)-60)){
 		ndo2db_db_checkin(idi);
+		ndo2db_db_report_stats();
+	        }
+
+	ndo2db_metrics_received(idi,idi->current_input_data);
+
+	/* hold definitions back so the objects they name can be added together, */
+	/* and status updates so repeated ones can replace each other */
+	if(ndo2db_object_batch_add(idi)==NDO_FALSE && ndo2db_status_cache_add(idi)==NDO_FALSE)
+		result=ndo2db_write_input_data(idi);
+
+	/* free input memory */
+	ndo2db_free_input_memory(idi);
+
+	/* adjust items processed */
+	idi->entries_processed++;
+
+	/* write status updates and batched rows that have waited long enough */
+	ndo2db_status_cache_flush_expired(idi);
+	ndo2db_db_flush_expired_batches(idi);
+
+	/* perform periodic maintenance... */
+	ndo2db_db_perform_maintenance(idi);
+
+	return result;
+        }
+
+
+/* writes the current event, through a partition writer if there is one */
+int ndo2db_write_input_data(ndo2db_idi *idi){
+	int result=NDO_OK;
+
+	/* let a partition writer handle it, unless it's a global event */
+	if(ndo2db_partition_dispatch(idi)==NDO_FALSE){
+		/* keep it for replay until it's committed */
+		ndo2db_db_begin_event(idi);
+		result=ndo2db_handle_input_data(idi);
+		ndo2db_db_end_event(idi);
+	        }
+
+	return result;
+        }
+
+
+/* passes a completed event to its handler */
+int ndo2db_handle_input_data(ndo2db_idi *idi){
+	struct timeval start;
+	int result=NDO_OK;
 
 #ifdef DEBUG_NDO2DB2
 	printf("HANDLING TYPE: %d\n",idi->current_input_data);
 #endif
 
+	ndo2db_metrics_start(&start);
+
+	/* these clear or rebuild tables we may have batched rows for */
+	switch(idi->current_input_data){
+	case NDO2DB_INPUT_DATA_PROCESSDATA:
+	case NDO2DB_INPUT_DATA_CONFIGDUMPSTART:
+	case NDO2DB_INPUT_DATA_CONFIGDUMPEND:
+	case NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST:
+		ndo2db_db_flush_batches(idi);
+		ndo2db_config_load_flush(idi);
+		break;
+	default:
+		break;
+	        }
+
+	/* definitions that haven't changed since the last dump aren't written again */
+	if(ndo2db_config_digest_check(idi)==NDO_TRUE){
+		ndo2db_metrics_handled(idi->current_input_data,&start);
+		return NDO_OK;
+	        }
+
 	switch(idi->current_input_data){
 
 	/* archived log entries */
@@ -2125,57 +2429,178 @@ int ndo2db_end_input_data(ndo2db_idi *idi){
 		break;
 	        }
 
-	/* free input memory */
-	ndo2db_free_input_memory(idi);
-
-	/* adjust items processed */
-	idi->entries_processed++;
-
-	/* perform periodic maintenance... */
-	ndo2db_db_perform_maintenance(idi);
+	ndo2db_metrics_handled(idi->current_input_data,&start);
 
 	return result;
         }
 
 
-/* free memory allocated to data input */
-int ndo2db_free_input_memory(ndo2db_idi *idi){
+/* free single and multi-instance data buffers */
+static void ndo2db_free_input_buffers(char ***buffered_input, ndo2db_mbuf *mbuf){
 	register int x=0;
 	register int y=0;
 
-	if(idi==NULL)
-		return NDO_ERROR;
-
 	/* free memory allocated to single-instance data buffers */
-	if(idi->buffered_input){
+	if(*buffered_input){
 
 		for(x=0;x<NDO_MAX_DATA_TYPES;x++){
-			if(idi->buffered_input[x])
-				free(idi->buffered_input[x]);
-			idi->buffered_input[x]=NULL;
+			if((*buffered_input)[x])
+				free((*buffered_input)[x]);
+			(*buffered_input)[x]=NULL;
 	                }
 
-		free(idi->buffered_input);
-		idi->buffered_input=NULL;
+		free(*buffered_input);
+		*buffered_input=NULL;
 	        }
 
 	/* free memory allocated to multi-instance data buffers */
-	if(idi->mbuf){
+	if(mbuf){
 		for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
-			if(idi->mbuf[x].buffer){
-				for(y=0;y<idi->mbuf[x].used_lines;y++){
-					if(idi->mbuf[x].buffer[y]){
-						free(idi->mbuf[x].buffer[y]);
-						idi->mbuf[x].buffer[y]=NULL;
+			if(mbuf[x].buffer){
+				for(y=0;y<mbuf[x].used_lines;y++){
+					if(mbuf[x].buffer[y]){
+						free(mbuf[x].buffer[y]);
+						mbuf[x].buffer[y]=NULL;
 						}
 					}
-				free(idi->mbuf[x].buffer);
-				idi->mbuf[x].buffer=NULL;
+				free(mbuf[x].buffer);
+				mbuf[x].buffer=NULL;
 				}
-			idi->mbuf[x].used_lines=0;
-			idi->mbuf[x].allocated_lines=0;
+			mbuf[x].used_lines=0;
+			mbuf[x].allocated_lines=0;
 			}
 		}
+	}
+
+
+/* free memory allocated to data input */
+int ndo2db_free_input_memory(ndo2db_idi *idi){
+	register int x=0;
+
+	if(idi==NULL)
+		return NDO_ERROR;
+
+	if(idi->input_in_arena==NDO_FALSE){
+		ndo2db_free_input_buffers(&idi->buffered_input,idi->mbuf);
+		return NDO_OK;
+	        }
+
+	/* everything the event was parsed into goes back to the arena at once */
+	for(x=0;x<NDO_MAX_DATA_TYPES;x++)
+		idi->input_slots[x]=NULL;
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		idi->mbuf[x].used_lines=0;
+		idi->mbuf[x].allocated_lines=0;
+		idi->mbuf[x].buffer=NULL;
+	        }
+	ndo_arena_reset(&idi->input_arena);
+	idi->buffered_input=NULL;
+	idi->input_in_arena=NDO_FALSE;
+
+	return NDO_OK;
+	}
+
+
+/* moves the current event's data out of the idi (copying it out of the arena) */
+int ndo2db_save_input_data(ndo2db_idi *idi, ndo2db_input_event *ev){
+	int x=0;
+
+	if(idi==NULL || ev==NULL)
+		return NDO_ERROR;
+
+	/* an event in the arena is only good until the next one starts */
+	if(idi->input_in_arena==NDO_TRUE){
+		ndo2db_copy_input_data(idi,ev);
+		ndo2db_free_input_memory(idi);
+		return NDO_OK;
+	        }
+
+	ev->input_data=idi->current_input_data;
+	ev->buffered_input=idi->buffered_input;
+	memcpy(ev->mbuf,idi->mbuf,sizeof(ev->mbuf));
+	ev->next=NULL;
+
+	idi->buffered_input=NULL;
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		idi->mbuf[x].used_lines=0;
+		idi->mbuf[x].allocated_lines=0;
+		idi->mbuf[x].buffer=NULL;
+	        }
+
+	return NDO_OK;
+	}
+
+
+/* makes a saved event the idi's current event again */
+int ndo2db_restore_input_data(ndo2db_idi *idi, ndo2db_input_event *ev){
+	int x=0;
+
+	if(idi==NULL || ev==NULL)
+		return NDO_ERROR;
+
+	ndo2db_free_input_memory(idi);
+
+	idi->current_input_data=ev->input_data;
+	idi->buffered_input=ev->buffered_input;
+	idi->input_in_arena=NDO_FALSE;
+	memcpy(idi->mbuf,ev->mbuf,sizeof(idi->mbuf));
+
+	ev->buffered_input=NULL;
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		ev->mbuf[x].used_lines=0;
+		ev->mbuf[x].allocated_lines=0;
+		ev->mbuf[x].buffer=NULL;
+	        }
+
+	return NDO_OK;
+	}
+
+
+/* copies the current event's data, the handlers may modify their input */
+int ndo2db_copy_input_data(ndo2db_idi *idi, ndo2db_input_event *ev){
+	register int x=0;
+	register int y=0;
+
+	if(idi==NULL || ev==NULL)
+		return NDO_ERROR;
+
+	ev->input_data=idi->current_input_data;
+	ev->buffered_input=NULL;
+	ev->next=NULL;
+
+	if(idi->buffered_input){
+		if((ev->buffered_input=(char **)malloc(sizeof(char *)*NDO_MAX_DATA_TYPES))==NULL)
+			return NDO_ERROR;
+		for(x=0;x<NDO_MAX_DATA_TYPES;x++)
+			ev->buffered_input[x]=(idi->buffered_input[x]==NULL)?NULL:strdup(idi->buffered_input[x]);
+	        }
+
+	for(x=0;x<NDO2DB_MAX_MBUF_ITEMS;x++){
+		ev->mbuf[x].used_lines=0;
+		ev->mbuf[x].allocated_lines=0;
+		ev->mbuf[x].buffer=NULL;
+		if(idi->mbuf[x].buffer==NULL || idi->mbuf[x].used_lines==0)
+			continue;
+		if((ev->mbuf[x].buffer=(char **)malloc(sizeof(char *)*idi->mbuf[x].used_lines))==NULL)
+			continue;
+		for(y=0;y<idi->mbuf[x].used_lines;y++)
+			ev->mbuf[x].buffer[y]=(idi->mbuf[x].buffer[y]==NULL)?NULL:strdup(idi->mbuf[x].buffer[y]);
+		ev->mbuf[x].used_lines=idi->mbuf[x].used_lines;
+		ev->mbuf[x].allocated_lines=idi->mbuf[x].used_lines;
+	        }
+
+	return NDO_OK;
+	}
+
+
+/* frees a saved event */
+int ndo2db_free_input_event(ndo2db_input_event *ev){
+
+	if(ev==NULL)
+		return NDO_OK;
+
+	ndo2db_free_input_buffers(&ev->buffered_input,ev->mbuf);
+	free(ev);
 
 	return NDO_OK;
 	}
@@ -2184,6 +2609,10 @@ int ndo2db_free_input_memory(ndo2db_idi *idi){
 /* free memory allocated to connection */
 int ndo2db_free_connection_memory(ndo2db_idi *idi){
 
+	ndo2db_free_input_memory(idi);
+	ndo_arena_free(&idi->input_arena);
+	my_free(idi->input_slots);
+
 	if(idi->instance_name){
 		free(idi->instance_name);
 		idi->instance_name=NULL;
@@ -2324,6 +2753,7 @@ int ndo2db_convert_string_to_timeval(char *buf, struct timeval *tv){
 	char *newbuf=NULL;
 	char *ptr=NULL;
 	int result=NDO_OK;
+	char *saveptr=NULL;
 
 	if(buf==NULL)
 		return NDO_ERROR;
@@ -2334,9 +2764,9 @@ int ndo2db_convert_string_to_timeval(char *buf, struct timeval *tv){
 	if((newbuf=strdup(buf))==NULL)
 		return NDO_ERROR;
 
-	ptr=strtok(newbuf,".");
+	ptr=strtok_r(newbuf,".",&saveptr);
 	if((result=ndo2db_convert_string_to_unsignedlong(ptr,(unsigned long *)&tv->tv_sec))==NDO_OK){
-		ptr=strtok(NULL,"\n");
+		ptr=strtok_r(NULL,"\n",&saveptr);
 		result=ndo2db_convert_string_to_unsignedlong(ptr,(unsigned long *)&tv->tv_usec);
 	        }
 
@@ -2394,8 +2824,13 @@ int ndo2db_log_debug_info(int level, int verbosity, const char *fmt, ...){
 	if(verbosity>ndo2db_debug_verbosity)
 		return NDO_OK;
 
-	if(ndo2db_debug_file_fp==NULL)
+	/* writer threads share the debug log in the event driven server */
+	pthread_mutex_lock(&ndo2db_debug_file_lock);
+
+	if(ndo2db_debug_file_fp==NULL){
+		pthread_mutex_unlock(&ndo2db_debug_file_lock);
 		return NDO_ERROR;
+		}
 
 	/* write the timestamp */
 	gettimeofday(&current_time,NULL);
@@ -2433,6 +2868,8 @@ int ndo2db_log_debug_info(int level, int verbosity, const char *fmt, ...){
 		ndo2db_open_debug_log();
 		}
 
+	pthread_mutex_unlock(&ndo2db_debug_file_lock);
+
 	return NDO_OK;
 	}
 
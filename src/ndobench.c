@@ -0,0 +1,1312 @@
+/**
+ * @file ndobench.c Checks and timings of the NDOUtils input paths
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every test first checks that the code in the tree gives the same
+ * results as a plain reference implementation (usually what the tree did
+ * before), then times both.  The input is a synthetic stream of service
+ * status events like the ones ndomod sends, or a recorded stream given
+ * with -f (a plain dump, e.g. from ndomod's output file, not a capture).
+ * The exit status is 0 if every check passed.
+ */
+
+#define _GNU_SOURCE		/* asprintf() */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/queue.h"
+#include "../include/partition.h"
+
+#define NDOBENCH_NAME "NDOBENCH"
+
+#define NDOBENCH_EVENTS		200000		/* synthetic events by default */
+#define NDOBENCH_CHUNK_SIZE	(64*1024)	/* bytes read from the client at a time */
+#define NDOBENCH_LONG_EVERY	100		/* every n-th event has a multiline long output */
+#define NDOBENCH_HUGE_EVERY	20000		/* every n-th event has perfdata longer than 64KB */
+#define NDOBENCH_HUGE_SIZE	(100*1024)
+#define NDOBENCH_WRITERS	"0,1,2,4,8"	/* partition_writers values timed by default */
+#define NDOBENCH_ROW_EVENTS	1000		/* distinct events the row tests cycle through */
+#define NDOBENCH_WARMUP_EVENTS	1000		/* events parsed before allocations are counted */
+#define NDOBENCH_ESCAPE_STRINGS	20000		/* random strings each escape level is checked with */
+#define NDOBENCH_ESCAPE_MAX	300		/* longest of them */
+#define NDOBENCH_OBJECTS	100000		/* objects in the object cache test */
+#define NDOBENCH_OBJECT_HOSTS	2000		/* hosts among them, the rest are their services */
+#define NDOBENCH_OLD_HASHSLOTS	1024		/* chains of the old object cache */
+#define NDOBENCH_OLD_LOOKUPS	10000		/* lookups timed in the old object cache */
+
+
+/* the input all tests work on */
+typedef struct ndobench_input_struct{
+	char *buf;
+	size_t len;
+	int rounds;
+	char *config_file;		/* ndo2db.cfg for tests that need a database */
+	char *writers;
+        }ndobench_input;
+
+/* a test that can be asked for on the command line */
+typedef struct ndobench_test_struct{
+	const char *name;
+	int (*run)(ndobench_input *);
+	const char *description;
+        }ndobench_test;
+
+/* a growing output buffer */
+typedef struct ndobench_buf_struct{
+	char *buf;
+	size_t len;
+	size_t size;
+        }ndobench_buf;
+
+
+static int ndobench_lines(ndobench_input *);
+static int ndobench_writers(ndobench_input *);
+static int ndobench_rows(ndobench_input *);
+static int ndobench_arena(ndobench_input *);
+static int ndobench_escape(ndobench_input *);
+static int ndobench_objects(ndobench_input *);
+
+extern int ndo2db_partition_writers;
+extern ndo2db_dbconfig ndo2db_db_settings;
+
+static ndobench_test ndobench_tests[]={
+	{"lines",ndobench_lines,"splitting client input into lines"},
+	{"escape",ndobench_escape,"escaping text for the protocol and for SQL, per SIMD level"},
+	{"arena",ndobench_arena,"allocations made while parsing events"},
+	{"objects",ndobench_objects,"object id cache lookups"},
+	{"rows",ndobench_rows,"rendering status rows from field tables"},
+	{"writers",ndobench_writers,"events/s into the database by partition_writers (needs -c)"},
+	{NULL,NULL,NULL}
+        };
+
+
+#ifdef __GLIBC__
+/* count heap calls by standing in for glibc's allocator */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t,size_t);
+extern void *__libc_realloc(void *,size_t);
+extern void __libc_free(void *);
+
+static int ndobench_counting=NDO_FALSE;
+static unsigned long ndobench_allocs=0L;
+static unsigned long ndobench_frees=0L;
+
+void *malloc(size_t size){
+	if(ndobench_counting==NDO_TRUE)
+		ndobench_allocs++;
+	return __libc_malloc(size);
+        }
+
+void *calloc(size_t nmemb, size_t size){
+	if(ndobench_counting==NDO_TRUE)
+		ndobench_allocs++;
+	return __libc_calloc(nmemb,size);
+        }
+
+void *realloc(void *ptr, size_t size){
+	if(ndobench_counting==NDO_TRUE)
+		ndobench_allocs++;
+	return __libc_realloc(ptr,size);
+        }
+
+void free(void *ptr){
+	if(ndobench_counting==NDO_TRUE && ptr!=NULL)
+		ndobench_frees++;
+	__libc_free(ptr);
+        }
+#define NDOBENCH_COUNT_ALLOCS(on)	(ndobench_counting=(on))
+#else
+#define NDOBENCH_COUNT_ALLOCS(on)
+#endif
+
+
+static double ndobench_now(void){
+	struct timeval tv;
+
+	gettimeofday(&tv,NULL);
+	return (double)tv.tv_sec+(double)tv.tv_usec/1000000.0;
+        }
+
+
+static void ndobench_append(ndobench_buf *b, const char *fmt, ...){
+	va_list ap;
+	int len=0;
+
+	for(;;){
+		va_start(ap,fmt);
+		len=vsnprintf(b->buf+b->len,b->size-b->len,fmt,ap);
+		va_end(ap);
+		if(len>=0 && (size_t)len<b->size-b->len)
+			break;
+		b->size=(b->size+(size_t)len+1)*2;
+		if((b->buf=(char *)realloc(b->buf,b->size))==NULL){
+			perror("Cannot allocate memory");
+			exit(2);
+		        }
+	        }
+	b->len+=(size_t)len;
+        }
+
+
+/* builds a stream of service status events like ndomod sends them */
+static char *ndobench_make_stream(unsigned long events, size_t *len){
+	ndobench_buf b={NULL,0,1024*1024};
+	char *huge=NULL;
+	unsigned long x=0L;
+	int y=0;
+
+	if((b.buf=(char *)malloc(b.size))==NULL || (huge=(char *)malloc(NDOBENCH_HUGE_SIZE+1))==NULL){
+		perror("Cannot allocate memory");
+		exit(2);
+	        }
+	memset(huge,'x',NDOBENCH_HUGE_SIZE);
+	huge[NDOBENCH_HUGE_SIZE]='\x0';
+
+	ndobench_append(&b,"HELLO\n%s: %d\n%s: NDOMOD\n%s: 2.1.2\n%s: 1700000000\n%s: %s\n%s: UNIXSOCKET\n%s: %s\n%s: bench\n%s\n\n",
+		NDO_API_PROTOCOL,NDO_API_PROTOVERSION,NDO_API_AGENT,NDO_API_AGENTVERSION,NDO_API_STARTTIME,
+		NDO_API_DISPOSITION,NDO_API_DISPOSITION_REALTIME,NDO_API_CONNECTION,NDO_API_CONNECTTYPE,
+		NDO_API_CONNECTTYPE_INITIAL,NDO_API_INSTANCENAME,NDO_API_STARTDATADUMP);
+
+	for(x=0L;x<events;x++){
+		ndobench_append(&b,"%d:\n%d=%d\n%d=0\n%d=0\n%d=%lu.%06lu\n%d=host%lu\n%d=svc%lu\n%d=OK - all good %lu\n%d=",
+			NDO_API_SERVICESTATUSDATA,NDO_DATA_TYPE,1500,
+			NDO_DATA_FLAGS,NDO_DATA_ATTRIBUTES,NDO_DATA_TIMESTAMP,1700000000L+x,x%1000000L,
+			NDO_DATA_HOST,x%1000L,NDO_DATA_SERVICE,x%7L,NDO_DATA_OUTPUT,x,NDO_DATA_LONGOUTPUT);
+		/* escaped newlines, tabs and backslashes the way ndomod sends them */
+		if(x%NDOBENCH_LONG_EVERY==0L){
+			for(y=0;y<40;y++)
+				ndobench_append(&b,"line %d of the long output\\twith a tab, a \\\\ and 'quotes'\\n",y);
+		        }
+		ndobench_append(&b,"\n%d=time=%lu.%03lus;1;2;0 size=%luB;;;0",NDO_DATA_PERFDATA,x%10L,x%1000L,x*17L);
+		if(x%NDOBENCH_HUGE_EVERY==1L)
+			ndobench_append(&b," pad=%s",huge);
+		ndobench_append(&b,"\n%d=%lu\n%d\n\n",NDO_DATA_CURRENTSTATE,x%4L,NDO_API_ENDDATA);
+	        }
+
+	ndobench_append(&b,"%d\n\n%s: %lu\n%s\n\n",NDO_API_ENDDATADUMP,NDO_API_ENDTIME,1700000000L+events,NDO_API_GOODBYE);
+
+	free(huge);
+	*len=b.len;
+	return b.buf;
+        }
+
+
+static char *ndobench_read_file(const char *name, size_t *len){
+	ndobench_buf b={NULL,0,1024*1024};
+	ssize_t result=0;
+	int fd=-1;
+
+	if((fd=open(name,O_RDONLY))==-1){
+		perror("Cannot open input file");
+		exit(2);
+	        }
+	if((b.buf=(char *)malloc(b.size))==NULL){
+		perror("Cannot allocate memory");
+		exit(2);
+	        }
+
+	while((result=read(fd,b.buf+b.len,b.size-b.len))!=0){
+		if(result<0){
+			if(errno==EINTR)
+				continue;
+			perror("Cannot read input file");
+			exit(2);
+		        }
+		b.len+=(size_t)result;
+		if(b.len==b.size && (b.buf=(char *)realloc(b.buf,b.size*=2))==NULL){
+			perror("Cannot allocate memory");
+			exit(2);
+		        }
+	        }
+	close(fd);
+
+	*len=b.len;
+	return b.buf;
+        }
+
+
+static void ndobench_report(const char *label, double elapsed, unsigned long long count, const char *unit, size_t bytes){
+
+	printf("  %-10s %8.3f s  %10.1f ns/%s",label,elapsed,elapsed*1000000000.0/(double)((count>0)?count:1),unit);
+	if(bytes>0)
+		printf("  %9.1f MB/s",(double)bytes/elapsed/1048576.0);
+	printf("\n");
+        }
+
+
+/* 32-bit FNV-1a over a line and its end, so both sides can be compared in one number */
+static unsigned long ndobench_hash_line(unsigned long hash, const char *line, unsigned long len){
+	unsigned long x=0L;
+
+	for(x=0L;x<len;x++)
+		hash=((hash^(unsigned char)line[x])*16777619UL)&0xffffffffUL;
+	return ((hash^'\n')*16777619UL)&0xffffffffUL;
+        }
+
+
+
+/****************************************************************************/
+/* LINE SPLITTING                                                           */
+/****************************************************************************/
+
+/* the line loop ndo2db had before ndo_lbuf: strcat into 66KB, memmove after every line */
+static unsigned long ndobench_lines_old(ndobench_input *in, unsigned long *count){
+	size_t len=0, curlen, insz, maxbuf=1024*64, bufsz=1024*66, pos=0;
+	unsigned long hash=2166136261UL;
+	char *buf=(char *)calloc(bufsz,sizeof(char));
+	char *temp_buf;
+	size_t i;
+
+	*count=0L;
+	while(pos<in->len){
+		insz=(in->len-pos<NDOBENCH_CHUNK_SIZE)?in->len-pos:NDOBENCH_CHUNK_SIZE;
+		if(insz>bufsz-1-len)
+			insz=bufsz-1-len;
+		memcpy(buf+len,in->buf+pos,insz);
+		buf[len+insz]='\x0';
+		pos+=insz;
+		curlen=len+insz;
+
+		for(i=0;i<curlen;i++){
+			if(buf[i]=='\n'){
+				temp_buf=(char *)malloc((curlen+4)*sizeof(char));
+				strncpy(temp_buf,buf,i);
+				temp_buf[i]='\x0';
+				hash=ndobench_hash_line(hash,temp_buf,(unsigned long)i);
+				memmove(buf,&buf[i+1],bufsz-i-1);
+				curlen=strlen(buf);
+				free(temp_buf);
+				(*count)++;
+				i=(size_t)-1;
+			        }
+		        }
+
+		len=curlen;
+		if(len>maxbuf){
+			buf[maxbuf+1]=0;
+			len=maxbuf;
+		        }
+		else if(len==0)
+			memset(buf,0,bufsz*sizeof(char));
+	        }
+
+	free(buf);
+	return hash;
+        }
+
+
+/* the same chunks through ndo_lbuf, as ndo2db does now */
+static unsigned long ndobench_lines_lbuf(ndobench_input *in, unsigned long *count){
+	ndo_lbuf lbuf;
+	unsigned long hash=2166136261UL;
+	unsigned long linelen=0L;
+	size_t insz, pos=0;
+	char *ptr;
+	char *line;
+
+	*count=0L;
+	if(ndo_lbuf_init(&lbuf,NDOBENCH_CHUNK_SIZE*2)==NDO_ERROR)
+		return 0L;
+
+	while(pos<in->len){
+		insz=(in->len-pos<NDOBENCH_CHUNK_SIZE)?in->len-pos:NDOBENCH_CHUNK_SIZE;
+		if((ptr=ndo_lbuf_reserve(&lbuf,(unsigned long)insz))==NULL)
+			break;
+		memcpy(ptr,in->buf+pos,insz);
+		ndo_lbuf_commit(&lbuf,(unsigned long)insz);
+		pos+=insz;
+
+		while((line=ndo_lbuf_next_line(&lbuf,&linelen))!=NULL){
+			hash=ndobench_hash_line(hash,line,linelen);
+			(*count)++;
+		        }
+	        }
+
+	ndo_lbuf_free(&lbuf);
+	return hash;
+        }
+
+
+static int ndobench_lines(ndobench_input *in){
+	unsigned long expect_hash=2166136261UL, expect_count=0L, longest=0L;
+	unsigned long hash=0L, count=0L, old_count=0L;
+	double start=0.0, lbuf_time=0.0, old_time=0.0;
+	const char *ptr=in->buf;
+	const char *nl=NULL;
+	int result=NDO_OK;
+	int x=0;
+
+	/* what the lines are, from the whole input at once */
+	while((nl=(const char *)memchr(ptr,'\n',in->len-(size_t)(ptr-in->buf)))!=NULL){
+		expect_hash=ndobench_hash_line(expect_hash,ptr,(unsigned long)(nl-ptr));
+		if((unsigned long)(nl-ptr)>longest)
+			longest=(unsigned long)(nl-ptr);
+		expect_count++;
+		ptr=nl+1;
+	        }
+	printf("lines: %lu lines, %.1f MB, longest %lu bytes, %d KB chunks\n",expect_count,(double)in->len/1048576.0,longest,NDOBENCH_CHUNK_SIZE/1024);
+
+	for(x=0;x<in->rounds;x++){
+		start=ndobench_now();
+		hash=ndobench_lines_lbuf(in,&count);
+		lbuf_time+=ndobench_now()-start;
+		start=ndobench_now();
+		ndobench_lines_old(in,&old_count);
+		old_time+=ndobench_now()-start;
+	        }
+
+	if(hash!=expect_hash || count!=expect_count){
+		printf("  check      FAILED: ndo_lbuf gave %lu lines, expected %lu\n",count,expect_count);
+		result=NDO_ERROR;
+	        }
+	else
+		printf("  check      ok, every line intact\n");
+	if(longest>=64*1024)
+		printf("  (the old loop truncates lines longer than 64KB, it gave %lu lines)\n",old_count);
+
+	ndobench_report("ndo_lbuf",lbuf_time/in->rounds,expect_count,"line",in->len);
+	ndobench_report("old",old_time/in->rounds,expect_count,"line",in->len);
+
+	return result;
+        }
+
+
+/****************************************************************************/
+/* ESCAPING                                                                 */
+/****************************************************************************/
+
+/* what ndomod escapes in the protocol, and what ndo2db escapes for SQL */
+static const ndo_charset ndobench_protocol_set={4,{'\t','\r','\n','\\'},{'t','r','n','\\'}};
+static const ndo_charset ndobench_sql_set={13,{'\'','\"','*','\\','$','?','.','^','+','[',']','(',')'},{'\'','\"','*','\\','$','?','.','^','+','[',']','(',')'}};
+
+static const char *ndobench_level_name[]={"scalar","sse2","avx2"};
+
+
+/* escapes one byte at a time, the way ndo_escape_buffer() used to */
+static size_t ndobench_escape_reference(char *dst, const char *src, size_t len, const ndo_charset *set){
+	size_t x=0, y=0;
+	int z=0;
+
+	for(x=0;x<len;x++){
+		for(z=0;z<set->count;z++){
+			if(src[x]==set->chars[z])
+				break;
+		        }
+		if(z<set->count){
+			dst[y++]='\\';
+			dst[y++]=set->escaped[z];
+		        }
+		else
+			dst[y++]=src[x];
+	        }
+	dst[y]='\x0';
+
+	return y;
+        }
+
+
+/* random text: mostly plain, some with many characters to escape, some with high bytes */
+static void ndobench_random_text(char *buf, size_t len){
+	static const char special[]="\t\r\n\\'\"*$?.^+[]()";
+	int kind=(int)(random()%4);
+	size_t x=0;
+
+	for(x=0;x<len;x++){
+		if(kind==1 && random()%3==0)
+			buf[x]=special[random()%(sizeof(special)-1)];
+		else if(kind==2 && random()%5==0)
+			buf[x]=(char)(0x80+random()%0x80);
+		else if(random()%40==0)
+			buf[x]=special[random()%(sizeof(special)-1)];
+		else
+			buf[x]=(char)(' '+random()%95);
+	        }
+	buf[len]='\x0';
+        }
+
+
+/* checks one level of ndo_escape_copy() against the reference on random strings at random alignments */
+static unsigned long ndobench_escape_check(const ndo_charset *set){
+	char src[NDOBENCH_ESCAPE_MAX+64];
+	char expected[NDOBENCH_ESCAPE_MAX*2+64];
+	char dst[NDOBENCH_ESCAPE_MAX*2+64];
+	size_t len=0, expected_len=0, dst_len=0, offset=0;
+	unsigned long failed=0L;
+	int x=0;
+
+	for(x=0;x<NDOBENCH_ESCAPE_STRINGS;x++){
+		len=(size_t)(random()%(NDOBENCH_ESCAPE_MAX+1));
+		offset=(size_t)(random()%32);
+		ndobench_random_text(src+offset,len);
+		expected_len=ndobench_escape_reference(expected,src+offset,len,set);
+		memset(dst,'#',sizeof(dst));
+		dst_len=ndo_escape_copy(dst+offset,src+offset,len,set);
+		if(dst_len!=expected_len || memcmp(dst+offset,expected,expected_len+1) || dst[offset+dst_len+1]!='#'){
+			if(failed++==0)
+				printf("  first difference at length %lu:\n    expected '%s'\n    got      '%.*s'\n",(unsigned long)len,expected,(int)dst_len,dst+offset);
+			continue;
+		        }
+
+		/* and it comes back the same */
+		if(strcmp(ndo_unescape_buffer(dst+offset),src+offset)){
+			if(failed++==0)
+				printf("  unescaping '%s' did not give back the original\n",expected);
+		        }
+	        }
+
+	return failed;
+        }
+
+
+static int ndobench_escape(ndobench_input *in){
+	const ndo_charset *set[2]={&ndobench_protocol_set,&ndobench_sql_set};
+	const char *set_name[2]={"protocol","sql"};
+	char **text=NULL;
+	char *dst=NULL;
+	unsigned long failed=0L, strings=0L, longest=0L;
+	unsigned long long bytes=0LL;
+	double start=0.0;
+	const char *ptr=NULL;
+	const char *nl=NULL;
+	const char *eq=NULL;
+	int best=0;
+	int level=0;
+	int result=NDO_OK;
+	int x=0, y=0, s=0;
+
+	best=ndo_escape_set_level(-1);
+	printf("escape: levels up to %s here, %d random strings of up to %d bytes per level and set\n",ndobench_level_name[best],NDOBENCH_ESCAPE_STRINGS,NDOBENCH_ESCAPE_MAX);
+
+	srandom(1);
+	for(level=0;level<=best;level++){
+		ndo_escape_set_level(level);
+		for(s=0;s<2;s++){
+			if((failed=ndobench_escape_check(set[s]))>0){
+				printf("  check      FAILED: %s, %s set, %lu strings differ\n",ndobench_level_name[level],set_name[s],failed);
+				result=NDO_ERROR;
+			        }
+		        }
+	        }
+	if(result==NDO_OK)
+		printf("  check      ok, every level gives what the reference does\n");
+
+	/* time the text items of the input, unescaped, as the handlers see them */
+	for(ptr=in->buf;(nl=(const char *)memchr(ptr,'\n',in->len-(size_t)(ptr-in->buf)))!=NULL;ptr=nl+1){
+		if((eq=(const char *)memchr(ptr,'=',(size_t)(nl-ptr)))!=NULL && eq-ptr<=3 && nl-eq>2)
+			strings++;
+	        }
+	if((text=(char **)malloc(sizeof(char *)*(strings+1)))==NULL)
+		return NDO_ERROR;
+	for(ptr=in->buf,x=0;(nl=(const char *)memchr(ptr,'\n',in->len-(size_t)(ptr-in->buf)))!=NULL;ptr=nl+1){
+		if((eq=(const char *)memchr(ptr,'=',(size_t)(nl-ptr)))!=NULL && eq-ptr<=3 && nl-eq>2){
+			if((text[x]=strndup(eq+1,(size_t)(nl-eq-1)))==NULL)
+				break;
+			ndo_unescape_buffer(text[x]);
+			bytes+=strlen(text[x]);
+			if(strlen(text[x])>longest)
+				longest=(unsigned long)strlen(text[x]);
+			x++;
+		        }
+	        }
+	strings=(unsigned long)x;
+	if((dst=(char *)malloc(longest*2+1))==NULL)
+		return NDO_ERROR;
+
+	printf("  timing the %lu text items of the input (%.1f MB)\n",strings,(double)bytes/1048576.0);
+	for(s=0;s<2;s++){
+		start=ndobench_now();
+		for(y=0;y<in->rounds;y++){
+			for(x=0;x<(int)strings;x++)
+				ndobench_escape_reference(dst,text[x],strlen(text[x]),set[s]);
+		        }
+		printf("  %-8s",set_name[s]);
+		ndobench_report("reference",(ndobench_now()-start)/in->rounds,strings,"item",(size_t)bytes);
+
+		for(level=0;level<=best;level++){
+			ndo_escape_set_level(level);
+			start=ndobench_now();
+			for(y=0;y<in->rounds;y++){
+				for(x=0;x<(int)strings;x++)
+					ndo_escape_copy(dst,text[x],strlen(text[x]),set[s]);
+			        }
+			printf("  %-8s",set_name[s]);
+			ndobench_report(ndobench_level_name[level],(ndobench_now()-start)/in->rounds,strings,"item",(size_t)bytes);
+		        }
+	        }
+
+	ndo_escape_set_level(-1);
+	for(x=0;x<(int)strings;x++)
+		free(text[x]);
+	free(text);
+	free(dst);
+
+	return result;
+        }
+
+
+
+/****************************************************************************/
+/* EVENT PARSING                                                            */
+/****************************************************************************/
+
+/* the items the arena test checks, as they should come out of the parser */
+static const int ndobench_arena_items[]={NDO_DATA_HOST,NDO_DATA_SERVICE,NDO_DATA_OUTPUT,NDO_DATA_LONGOUTPUT,NDO_DATA_PERFDATA};
+#define NDOBENCH_ARENA_ITEMS	(int)(sizeof(ndobench_arena_items)/sizeof(ndobench_arena_items[0]))
+
+static int ndobench_arena(ndobench_input *in){
+	ndo2db_idi idi;
+	ndo_lbuf lbuf;
+	ndo_arena_block *blk=NULL;
+	char *expected[NDOBENCH_ARENA_ITEMS];
+	unsigned long linelen=0L, events=0L, counted=0L, failed=0L, blocks=0L, warm_blocks=0L;
+	unsigned long long bytes=0LL;
+	double start=0.0, parse_time=0.0;
+	char enddata[16];
+	char key[16];
+	char *line=NULL;
+	char *ptr=NULL;
+	int in_data=NDO_FALSE;
+	int result=NDO_OK;
+	size_t pos=0, insz=0;
+	int x=0, y=0;
+
+	snprintf(enddata,sizeof(enddata),"%d",NDO_API_ENDDATA);
+	for(x=0;x<NDOBENCH_ARENA_ITEMS;x++)
+		expected[x]=NULL;
+
+	ndo2db_idi_init(&idi);
+	if(ndo_lbuf_init(&lbuf,NDOBENCH_CHUNK_SIZE*2)==NDO_ERROR)
+		return NDO_ERROR;
+
+	/* events are parsed as usual, but end here instead of going to the handlers */
+	while(pos<in->len){
+		insz=(in->len-pos<NDOBENCH_CHUNK_SIZE)?in->len-pos:NDOBENCH_CHUNK_SIZE;
+		if((ptr=ndo_lbuf_reserve(&lbuf,(unsigned long)insz))==NULL)
+			break;
+		memcpy(ptr,in->buf+pos,insz);
+		ndo_lbuf_commit(&lbuf,(unsigned long)insz);
+		pos+=insz;
+
+		while((line=ndo_lbuf_next_line(&lbuf,&linelen))!=NULL){
+
+			/* only the data section, the header and footer talk to the database */
+			if(in_data==NDO_FALSE){
+				if(!strcmp(line,NDO_API_STARTDATADUMP)){
+					in_data=NDO_TRUE;
+					idi.current_input_section=NDO2DB_INPUT_SECTION_DATA;
+				        }
+				continue;
+			        }
+			if(idi.current_input_section!=NDO2DB_INPUT_SECTION_DATA)
+				continue;
+
+			if(!strcmp(line,enddata) && idi.current_input_data!=NDO2DB_INPUT_DATA_NONE){
+				for(x=0;x<NDOBENCH_ARENA_ITEMS;x++){
+					if(expected[x]!=NULL && (idi.buffered_input==NULL || idi.buffered_input[ndobench_arena_items[x]]==NULL || strcmp(idi.buffered_input[ndobench_arena_items[x]],expected[x]))){
+						if(failed++==0)
+							printf("  first difference: item %d of event %lu\n",ndobench_arena_items[x],events);
+					        }
+					my_free(expected[x]);
+				        }
+
+				NDOBENCH_COUNT_ALLOCS(events>=NDOBENCH_WARMUP_EVENTS);
+				start=ndobench_now();
+				ndo2db_free_input_memory(&idi);
+				parse_time+=ndobench_now()-start;
+				NDOBENCH_COUNT_ALLOCS(NDO_FALSE);
+				idi.current_input_data=NDO2DB_INPUT_DATA_NONE;
+
+				if(++events==NDOBENCH_WARMUP_EVENTS){
+					for(blk=idi.input_arena.head;blk!=NULL;blk=blk->next)
+						warm_blocks++;
+				        }
+				if(events>NDOBENCH_WARMUP_EVENTS)
+					counted++;
+				continue;
+			        }
+
+			/* what the parser should make of the items we check */
+			for(x=0;x<NDOBENCH_ARENA_ITEMS;x++){
+				y=snprintf(key,sizeof(key),"%d=",ndobench_arena_items[x]);
+				if(!strncmp(line,key,(size_t)y)){
+					my_free(expected[x]);
+					if((expected[x]=strdup(line+y))!=NULL)
+						ndo_unescape_buffer(expected[x]);
+				        }
+			        }
+
+			bytes+=linelen+1;
+			NDOBENCH_COUNT_ALLOCS(events>=NDOBENCH_WARMUP_EVENTS);
+			start=ndobench_now();
+			ndo2db_handle_client_input(&idi,line);
+			parse_time+=ndobench_now()-start;
+			NDOBENCH_COUNT_ALLOCS(NDO_FALSE);
+		        }
+	        }
+
+	for(blk=idi.input_arena.head;blk!=NULL;blk=blk->next)
+		blocks++;
+
+	printf("arena: %lu events parsed, %.1f MB\n",events,(double)bytes/1048576.0);
+	if(failed>0){
+		printf("  check      FAILED: %lu items differ\n",failed);
+		result=NDO_ERROR;
+	        }
+	else
+		printf("  check      ok, every item parsed and unescaped as expected\n");
+	printf("  arena      %lu blocks after %d events, %lu at the end\n",warm_blocks,NDOBENCH_WARMUP_EVENTS,blocks);
+#ifdef __GLIBC__
+	if(counted>0)
+		printf("  heap       %lu allocations, %lu frees in %lu events after warm-up (%.2f per event)\n",ndobench_allocs,ndobench_frees,counted,(double)(ndobench_allocs+ndobench_frees)/(double)counted);
+	if(ndobench_allocs>0L)
+		result=NDO_ERROR;
+#else
+	printf("  heap       not counted, this needs glibc\n");
+#endif
+	ndobench_report("parse",parse_time,events,"event",(size_t)bytes);
+
+	for(x=0;x<NDOBENCH_ARENA_ITEMS;x++)
+		my_free(expected[x]);
+	ndo_lbuf_free(&lbuf);
+	ndo2db_free_input_memory(&idi);
+	ndo2db_free_connection_memory(&idi);
+
+	return result;
+        }
+
+
+
+/****************************************************************************/
+/* OBJECT CACHE                                                             */
+/****************************************************************************/
+
+/* the object cache ndo2db had before: 1024 chains picked by the sum of the name characters */
+typedef struct ndobench_old_object_struct{
+	char *name1;
+	char *name2;
+	int object_type;
+	unsigned long object_id;
+	struct ndobench_old_object_struct *nexthash;
+        }ndobench_old_object;
+
+static unsigned long ndobench_old_compares=0L;
+
+
+static int ndobench_old_hashfunc(const char *name1, const char *name2){
+	unsigned int i,result;
+
+	result=0;
+	if(name1)
+		for(i=0;i<strlen(name1);i++)
+			result+=name1[i];
+	if(name2)
+		for(i=0;i<strlen(name2);i++)
+			result+=name2[i];
+
+	return (int)(result%NDOBENCH_OLD_HASHSLOTS);
+        }
+
+
+static void ndobench_old_add(ndobench_old_object **list, int object_type, char *name1, char *name2, unsigned long object_id){
+	ndobench_old_object *temp_object=NULL;
+	ndobench_old_object *lastpointer=NULL;
+	ndobench_old_object *new_object=NULL;
+	int hashslot=0;
+
+	if((new_object=(ndobench_old_object *)malloc(sizeof(ndobench_old_object)))==NULL)
+		return;
+	new_object->object_type=object_type;
+	new_object->object_id=object_id;
+	new_object->name1=(name1)?strdup(name1):NULL;
+	new_object->name2=(name2)?strdup(name2):NULL;
+
+	hashslot=ndobench_old_hashfunc(name1,name2);
+	for(temp_object=list[hashslot];temp_object!=NULL;temp_object=temp_object->nexthash){
+		if(ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2)<0)
+			break;
+		lastpointer=temp_object;
+	        }
+	if(lastpointer)
+		lastpointer->nexthash=new_object;
+	else
+		list[hashslot]=new_object;
+	new_object->nexthash=temp_object;
+        }
+
+
+static int ndobench_old_get(ndobench_old_object **list, int object_type, char *name1, char *name2, unsigned long *object_id){
+	ndobench_old_object *temp_object=NULL;
+
+	for(temp_object=list[ndobench_old_hashfunc(name1,name2)];temp_object!=NULL;temp_object=temp_object->nexthash){
+		ndobench_old_compares++;
+		if(ndo2db_compare_object_hashdata(temp_object->name1,temp_object->name2,name1,name2)==0 && temp_object->object_type==object_type){
+			*object_id=temp_object->object_id;
+			return NDO_OK;
+		        }
+	        }
+
+	return NDO_ERROR;
+        }
+
+
+/* names like a real configuration: similar service descriptions on every host */
+static void ndobench_object_names(int x, int *object_type, char *name1, char *name2, size_t size){
+
+	snprintf(name1,size,"web-%04d.dc1.example.com",x%NDOBENCH_OBJECT_HOSTS);
+	if(x<NDOBENCH_OBJECT_HOSTS){
+		*object_type=NDO2DB_OBJECTTYPE_HOST;
+		name2[0]='\x0';
+		return;
+	        }
+	*object_type=NDO2DB_OBJECTTYPE_SERVICE;
+	snprintf(name2,size,"Disk usage /srv/vol%02d",(x/NDOBENCH_OBJECT_HOSTS)-1);
+        }
+
+/* hosts have no second name, lookups (like ndo2db_get_object_id) pass NULL for it */
+#define NDOBENCH_NAME2(name2)	(((name2)[0]=='\x0')?NULL:(name2))
+
+
+static int ndobench_objects(ndobench_input *in){
+	ndo2db_idi idi;
+	ndo2db_object_cache *cache=NULL;
+	ndobench_old_object **old=NULL;
+	ndobench_old_object *temp_object=NULL;
+	ndobench_old_object *next_object=NULL;
+	char (*name1)[64]=NULL;
+	char (*name2)[64]=NULL;
+	int *type=NULL;
+	int *order=NULL;
+	unsigned long object_id=0L;
+	unsigned long failed=0L, missed=0L, lookups=0L, probes=0L, max_probe=0L, probe=0L, used=0L;
+	unsigned long x=0L, y=0L;
+	double start=0.0, table_time=0.0, old_time=0.0;
+	int result=NDO_OK;
+
+	name1=malloc(sizeof(*name1)*NDOBENCH_OBJECTS);
+	name2=malloc(sizeof(*name2)*NDOBENCH_OBJECTS);
+	type=(int *)malloc(sizeof(int)*NDOBENCH_OBJECTS);
+	order=(int *)malloc(sizeof(int)*NDOBENCH_OBJECTS);
+	old=(ndobench_old_object **)calloc(NDOBENCH_OLD_HASHSLOTS,sizeof(ndobench_old_object *));
+	if(name1==NULL || name2==NULL || type==NULL || order==NULL || old==NULL)
+		return NDO_ERROR;
+
+	ndo2db_idi_init(&idi);
+	ndo2db_db_init(&idi);
+
+	/* ids are the object's number plus one, lookups come in random order */
+	for(x=0;x<NDOBENCH_OBJECTS;x++){
+		ndobench_object_names((int)x,&type[x],name1[x],name2[x],sizeof(name1[x]));
+		ndo2db_add_cached_object_id(&idi,type[x],name1[x],name2[x],x+1);
+		ndobench_old_add(old,type[x],name1[x],NDOBENCH_NAME2(name2[x]),x+1);
+		order[x]=(int)x;
+	        }
+	srandom(1);
+	for(x=NDOBENCH_OBJECTS-1;x>0;x--){
+		y=(unsigned long)random()%(x+1);
+		probe=(unsigned long)order[x];
+		order[x]=order[y];
+		order[y]=(int)probe;
+	        }
+
+	/* every object is found with its own id, a service of a host under the host's type is not */
+	for(x=0;x<NDOBENCH_OBJECTS;x++){
+		if(ndo2db_get_cached_object_id(&idi,type[x],name1[x],NDOBENCH_NAME2(name2[x]),&object_id)==NDO_ERROR || object_id!=x+1)
+			failed++;
+		if(type[x]==NDO2DB_OBJECTTYPE_SERVICE && ndo2db_get_cached_object_id(&idi,NDO2DB_OBJECTTYPE_HOST,name1[x],NDOBENCH_NAME2(name2[x]),&object_id)==NDO_OK)
+			failed++;
+		if(ndo2db_get_cached_object_id(&idi,type[x],name1[x],"No such service",&object_id)==NDO_OK)
+			failed++;
+		else
+			missed++;
+	        }
+
+	/* how far every object is from its home slot */
+	cache=idi.dbinfo.object_cache;
+	for(x=0;x<cache->slots;x++){
+		if(cache->slot[x].name1==NULL && cache->slot[x].name2==NULL)
+			continue;
+		used++;
+		probe=((x-(cache->slot[x].hash&(cache->slots-1)))&(cache->slots-1))+1;
+		probes+=probe;
+		if(probe>max_probe)
+			max_probe=probe;
+	        }
+
+	printf("objects: %d objects, %d hosts with %d services each\n",NDOBENCH_OBJECTS,NDOBENCH_OBJECT_HOSTS,NDOBENCH_OBJECTS/NDOBENCH_OBJECT_HOSTS-1);
+	if(failed>0 || used!=NDOBENCH_OBJECTS){
+		printf("  check      FAILED: %lu wrong lookups, %lu objects in the table\n",failed,used);
+		result=NDO_ERROR;
+	        }
+	else
+		printf("  check      ok, every object found with its id, %lu misses not found\n",missed);
+	printf("  table      %lu slots, %.2f slots probed per hit on average, %lu at most\n",cache->slots,(double)probes/(double)used,max_probe);
+
+	/* time hits in random order */
+	cache->lookups=0L;
+	cache->probes=0L;
+	start=ndobench_now();
+	for(y=0;y<(unsigned long)in->rounds*10L;y++){
+		for(x=0;x<NDOBENCH_OBJECTS;x++)
+			ndo2db_get_cached_object_id(&idi,type[order[x]],name1[order[x]],NDOBENCH_NAME2(name2[order[x]]),&object_id);
+	        }
+	table_time=ndobench_now()-start;
+	lookups=cache->lookups;
+	probes=cache->probes;
+
+	/* the old chains are far too slow for that many, a sample will do */
+	start=ndobench_now();
+	for(x=0;x<NDOBENCH_OLD_LOOKUPS;x++)
+		ndobench_old_get(old,type[order[x]],name1[order[x]],NDOBENCH_NAME2(name2[order[x]]),&object_id);
+	old_time=ndobench_now()-start;
+
+	printf("  probes     %.2f slots per lookup, the old chains took %.1f compares\n",(double)probes/(double)lookups,(double)ndobench_old_compares/(double)NDOBENCH_OLD_LOOKUPS);
+	ndobench_report("table",table_time,lookups,"lookup",0);
+	ndobench_report("old",old_time,NDOBENCH_OLD_LOOKUPS,"lookup",0);
+
+	for(x=0;x<NDOBENCH_OLD_HASHSLOTS;x++){
+		for(temp_object=old[x];temp_object!=NULL;temp_object=next_object){
+			next_object=temp_object->nexthash;
+			free(temp_object->name1);
+			free(temp_object->name2);
+			free(temp_object);
+		        }
+	        }
+	free(old);
+	ndo2db_db_deinit(&idi);
+	free(name1);
+	free(name2);
+	free(type);
+	free(order);
+
+	return result;
+        }
+
+
+
+/****************************************************************************/
+/* ROW RENDERING                                                            */
+/****************************************************************************/
+
+/* a service status row with every kind of field */
+static const ndo2db_dbfield ndobench_row_fields[]={
+	{"instance_id",NDO2DB_FIELD_ARG,0},
+	{"service_object_id",NDO2DB_FIELD_ARG,1},
+	{"status_update_time",NDO2DB_FIELD_ARGTIME,2},
+	{"output",NDO2DB_FIELD_STRING,NDO_DATA_OUTPUT},
+	{"long_output",NDO2DB_FIELD_STRING,NDO_DATA_LONGOUTPUT},
+	{"perfdata",NDO2DB_FIELD_STRING,NDO_DATA_PERFDATA},
+	{"current_state",NDO2DB_FIELD_INT,NDO_DATA_CURRENTSTATE},
+	{"current_check_attempt",NDO2DB_FIELD_INT,NDO_DATA_CURRENTCHECKATTEMPT},
+	{"last_check",NDO2DB_FIELD_TIME,NDO_DATA_LASTSERVICECHECK},
+	{"next_check",NDO2DB_FIELD_TIME,NDO_DATA_NEXTSERVICECHECK},
+	{"last_state_change",NDO2DB_FIELD_TIME,NDO_DATA_LASTSTATECHANGE},
+	{"percent_state_change",NDO2DB_FIELD_DOUBLE,NDO_DATA_PERCENTSTATECHANGE},
+	{"latency",NDO2DB_FIELD_DOUBLE,NDO_DATA_LATENCY},
+	{"execution_time",NDO2DB_FIELD_DOUBLE,NDO_DATA_EXECUTIONTIME},
+	{"modified_service_attributes",NDO2DB_FIELD_ULONG,NDO_DATA_MODIFIEDSERVICEATTRIBUTES},
+	{"check_command",NDO2DB_FIELD_STRING,NDO_DATA_CHECKCOMMAND},
+	{"check_timeperiod_object_id",NDO2DB_FIELD_ARG,3}
+        };
+
+static ndo2db_dbrow ndobench_row=NDO2DB_DBROW(NDO2DB_DBTABLE_SERVICESTATUS,ndobench_row_fields);
+
+/* the input items and handler arguments of one event */
+typedef struct ndobench_row_event_struct{
+	char *item[NDO_MAX_DATA_TYPES];
+	unsigned long args[4];
+        }ndobench_row_event;
+
+
+/* escapes a string for SQL one byte at a time, as ndo2db_db_escape_string() used to */
+static char *ndobench_escape_sql(const char *buf){
+	char *newbuf=NULL;
+	int x=0, y=0;
+
+	if((newbuf=(char *)malloc(strlen(buf)*2+1))==NULL)
+		return NULL;
+
+	for(x=0,y=0;buf[x]!='\x0';x++){
+		if(strchr("'\"*\\$?.^+[]()",buf[x])!=NULL)
+			newbuf[y++]='\\';
+		newbuf[y++]=buf[x];
+	        }
+	newbuf[y]='\x0';
+
+	return newbuf;
+        }
+
+
+/* the same row the way the handlers built it before field tables: escape, asprintf, free */
+static char *ndobench_row_asprintf(ndobench_row_event *ev){
+	char *es[4]={NULL,NULL,NULL,NULL};
+	char *ts[3]={NULL,NULL,NULL};
+	char *buf=NULL;
+	int current_state=0, current_check_attempt=0;
+	unsigned long last_check=0L, next_check=0L, last_state_change=0L, modified_attributes=0L;
+	double percent_state_change=0.0, latency=0.0, execution_time=0.0;
+	int x=0;
+
+	ndo2db_convert_string_to_int(ev->item[NDO_DATA_CURRENTSTATE],&current_state);
+	ndo2db_convert_string_to_int(ev->item[NDO_DATA_CURRENTCHECKATTEMPT],&current_check_attempt);
+	ndo2db_convert_string_to_unsignedlong(ev->item[NDO_DATA_LASTSERVICECHECK],&last_check);
+	ndo2db_convert_string_to_unsignedlong(ev->item[NDO_DATA_NEXTSERVICECHECK],&next_check);
+	ndo2db_convert_string_to_unsignedlong(ev->item[NDO_DATA_LASTSTATECHANGE],&last_state_change);
+	ndo2db_convert_string_to_double(ev->item[NDO_DATA_PERCENTSTATECHANGE],&percent_state_change);
+	ndo2db_convert_string_to_double(ev->item[NDO_DATA_LATENCY],&latency);
+	ndo2db_convert_string_to_double(ev->item[NDO_DATA_EXECUTIONTIME],&execution_time);
+	ndo2db_convert_string_to_unsignedlong(ev->item[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],&modified_attributes);
+
+	es[0]=ndobench_escape_sql(ev->item[NDO_DATA_OUTPUT]);
+	es[1]=ndobench_escape_sql(ev->item[NDO_DATA_LONGOUTPUT]);
+	es[2]=ndobench_escape_sql(ev->item[NDO_DATA_PERFDATA]);
+	es[3]=ndobench_escape_sql(ev->item[NDO_DATA_CHECKCOMMAND]);
+
+	if(asprintf(&ts[0],"FROM_UNIXTIME(%lu)",last_check)==-1)
+		ts[0]=NULL;
+	if(asprintf(&ts[1],"FROM_UNIXTIME(%lu)",next_check)==-1)
+		ts[1]=NULL;
+	if(asprintf(&ts[2],"FROM_UNIXTIME(%lu)",last_state_change)==-1)
+		ts[2]=NULL;
+
+	if(es[0]==NULL || es[1]==NULL || es[2]==NULL || es[3]==NULL || ts[0]==NULL || ts[1]==NULL || ts[2]==NULL)
+		buf=NULL;
+	else if(asprintf(&buf,"('%lu','%lu',FROM_UNIXTIME(%lu),'%s','%s','%s','%d','%d',%s,%s,%s,'%lf','%lf','%lf','%lu','%s','%lu')"
+		,ev->args[0]
+		,ev->args[1]
+		,ev->args[2]
+		,es[0]
+		,es[1]
+		,es[2]
+		,current_state
+		,current_check_attempt
+		,ts[0]
+		,ts[1]
+		,ts[2]
+		,percent_state_change
+		,latency
+		,execution_time
+		,modified_attributes
+		,es[3]
+		,ev->args[3]
+	        )==-1)
+		buf=NULL;
+
+	for(x=0;x<4;x++)
+		free(es[x]);
+	for(x=0;x<3;x++)
+		free(ts[x]);
+
+	return buf;
+        }
+
+
+/* renders a row through the field table engine and takes it back out of its batch */
+static const char *ndobench_row_render(ndo2db_idi *idi, ndobench_row_event *ev){
+	ndo2db_dbbatch *batch=NULL;
+
+	idi->buffered_input=ev->item;
+	if(ndo2db_db_write_row(idi,&ndobench_row,ev->args)==NDO_ERROR)
+		return NULL;
+	idi->buffered_input=NULL;
+
+	/* nothing is written, the batch is emptied again */
+	batch=idi->dbinfo.batch[ndobench_row.table];
+	batch->rows=0;
+	batch->used_size=batch->prefix_size;
+	idi->dbinfo.batched_rows=0;
+
+	return batch->buffer+batch->prefix_size;
+        }
+
+
+static int ndobench_rows(ndobench_input *in){
+	ndobench_row_event *ev=NULL;
+	ndo2db_idi idi;
+	ndobench_buf b={NULL,0,0};
+	const char *row=NULL;
+	char *expected=NULL;
+	unsigned long count=0L;
+	unsigned long failed=0L;
+	double start=0.0, table_time=0.0, old_time=0.0;
+	int x=0, y=0, z=0;
+
+	if((ev=(ndobench_row_event *)calloc(NDOBENCH_ROW_EVENTS,sizeof(ndobench_row_event)))==NULL)
+		return NDO_ERROR;
+
+	/* varied values, text with every character SQL needs escaped */
+	for(x=0;x<NDOBENCH_ROW_EVENTS;x++){
+		for(y=0;y<4;y++)
+			ev[x].args[y]=(unsigned long)(random()%100000);
+		ev[x].args[2]+=1700000000L;
+		asprintf(&ev[x].item[NDO_DATA_OUTPUT],"%s - 'svc%d' is $%d.%02d (%d%%) [ok?]",(x%3)?"OK":"CRITICAL",x,x%100,x%97,x%101);
+		b.len=0;
+		for(y=0,z=(int)(random()%((x%10)?3:40));y<z;y++)
+			ndobench_append(&b,"line %d: \"C:\\\\temp\\\\%d.log\" matched ^a+b*$\n",y,x);
+		ev[x].item[NDO_DATA_LONGOUTPUT]=strdup((b.buf==NULL)?"":b.buf);
+		asprintf(&ev[x].item[NDO_DATA_PERFDATA],"time=%d.%03ds;1;2;0 size=%ldB;;;0",x%10,x%1000,random());
+		asprintf(&ev[x].item[NDO_DATA_CURRENTSTATE],"%d",x%4);
+		asprintf(&ev[x].item[NDO_DATA_CURRENTCHECKATTEMPT],"%d",x%3+1);
+		asprintf(&ev[x].item[NDO_DATA_LASTSERVICECHECK],"%ld.%06d",1700000000L+random()%100000,x);
+		asprintf(&ev[x].item[NDO_DATA_NEXTSERVICECHECK],"%ld",1700000000L+random()%100000);
+		asprintf(&ev[x].item[NDO_DATA_LASTSTATECHANGE],"%ld",(x%5)?1700000000L+random()%100000:0L);
+		asprintf(&ev[x].item[NDO_DATA_PERCENTSTATECHANGE],"%.2f",(double)(random()%10000)/100.0);
+		asprintf(&ev[x].item[NDO_DATA_LATENCY],"%.6f",(double)random()/(double)RAND_MAX);
+		asprintf(&ev[x].item[NDO_DATA_EXECUTIONTIME],"%g",(double)random()/1000.0);
+		asprintf(&ev[x].item[NDO_DATA_MODIFIEDSERVICEATTRIBUTES],"%ld",random());
+		asprintf(&ev[x].item[NDO_DATA_CHECKCOMMAND],"check_by_ssh!-C '/usr/lib/nagios/check_load -w %d.0 -c %d.0'",x%10,x%20);
+	        }
+	free(b.buf);
+
+	/* rows are rendered for a batch, which is taken apart before anything is written */
+	ndo2db_db_settings.batch_rows=2;
+	ndo2db_idi_init(&idi);
+	ndo2db_db_init(&idi);
+
+	for(x=0;x<NDOBENCH_ROW_EVENTS;x++){
+		expected=ndobench_row_asprintf(&ev[x]);
+		row=ndobench_row_render(&idi,&ev[x]);
+		if(expected==NULL || row==NULL || strcmp(row,expected)){
+			if(failed++==0)
+				printf("  first difference:\n    expected %s\n    got      %s\n",(expected==NULL)?"(null)":expected,(row==NULL)?"(null)":row);
+		        }
+		free(expected);
+	        }
+
+	count=(unsigned long)NDOBENCH_ROW_EVENTS*100L*in->rounds;
+	printf("rows: %d distinct service status rows of %d fields, %lu rendered\n",NDOBENCH_ROW_EVENTS,ndobench_row.fields,count);
+	if(failed>0)
+		printf("  check      FAILED: %lu of %d rows differ\n",failed,NDOBENCH_ROW_EVENTS);
+	else
+		printf("  check      ok, identical rows\n");
+
+	start=ndobench_now();
+	for(x=0;x<count;x++)
+		ndobench_row_render(&idi,&ev[x%NDOBENCH_ROW_EVENTS]);
+	table_time=ndobench_now()-start;
+
+	start=ndobench_now();
+	for(x=0;x<count;x++)
+		free(ndobench_row_asprintf(&ev[x%NDOBENCH_ROW_EVENTS]));
+	old_time=ndobench_now()-start;
+
+	ndobench_report("table",table_time,count,"row",0);
+	ndobench_report("asprintf",old_time,count,"row",0);
+
+	ndo2db_db_deinit(&idi);
+	for(x=0;x<NDOBENCH_ROW_EVENTS;x++){
+		for(y=0;y<NDO_MAX_DATA_TYPES;y++)
+			free(ev[x].item[y]);
+	        }
+	free(ev);
+
+	return (failed>0)?NDO_ERROR:NDO_OK;
+        }
+
+
+
+/****************************************************************************/
+/* PARTITION WRITERS                                                        */
+/****************************************************************************/
+
+/* sends the input through a database writer process, the way a fork-model connection does */
+static int ndobench_writers_run(ndobench_input *in, int writers, double *elapsed){
+	size_t pos=0, size=0;
+	double start=0.0;
+	char *buf=NULL;
+	pid_t pid;
+	int status=0;
+
+	if(ndo_queue_init((size_t)NDO_QUEUE_DEFAULT_SIZE*1024*1024)==NDO_ERROR)
+		return NDO_ERROR;
+
+	ndo2db_partition_writers=writers;
+	start=ndobench_now();
+
+	if((pid=fork())<0){
+		perror("Cannot fork");
+		ndo_queue_free();
+		return NDO_ERROR;
+	        }
+	else if(pid==0){
+		ndo2db_async_client_handle();
+		_exit(0);
+	        }
+	ndo_queue_set_reader(pid);
+
+	while(pos<in->len){
+		if((buf=ndo_queue_reserve(&size))==NULL)
+			break;
+		if(size>in->len-pos)
+			size=in->len-pos;
+		memcpy(buf,in->buf+pos,size);
+		ndo_queue_commit(size);
+		pos+=size;
+	        }
+	ndo_queue_close();
+
+	waitpid(pid,&status,0);
+	*elapsed=ndobench_now()-start;
+	ndo_queue_free();
+
+	return (pos==in->len && WIFEXITED(status) && WEXITSTATUS(status)==0)?NDO_OK:NDO_ERROR;
+        }
+
+
+static int ndobench_writers(ndobench_input *in){
+	unsigned long events=0L;
+	double elapsed=0.0, total=0.0;
+	const char *ptr=in->buf;
+	char *list=NULL;
+	char *temp_ptr=NULL;
+	char enddata[16];
+	int writers=0;
+	int x=0;
+
+	if(in->config_file==NULL){
+		printf("writers: skipped, needs -c <ndo2db.cfg> naming a database to write to\n");
+		return NDO_OK;
+	        }
+
+	ndo2db_initialize_variables();
+	if(ndo2db_process_config_file(in->config_file)!=NDO_OK){
+		printf("writers: cannot process config file '%s'\n",in->config_file);
+		return NDO_ERROR;
+	        }
+
+	/* every event ends with an NDO_API_ENDDATA line */
+	snprintf(enddata,sizeof(enddata),"\n%d\n",NDO_API_ENDDATA);
+	while((ptr=strstr(ptr,enddata))!=NULL){
+		events++;
+		ptr++;
+	        }
+	printf("writers: %lu events, %.1f MB\n",events,(double)in->len/1048576.0);
+
+	if((list=strdup(in->writers))==NULL)
+		return NDO_ERROR;
+	for(temp_ptr=strtok(list,",");temp_ptr!=NULL;temp_ptr=strtok(NULL,",")){
+		writers=atoi(temp_ptr);
+		if(writers<0 || writers>NDO2DB_MAX_PARTITION_WRITERS)
+			continue;
+
+		total=0.0;
+		for(x=0;x<in->rounds;x++){
+			if(ndobench_writers_run(in,writers,&elapsed)!=NDO_OK){
+				printf("  writers=%-2d the database writer failed\n",writers);
+				free(list);
+				return NDO_ERROR;
+			        }
+			total+=elapsed;
+		        }
+		total/=in->rounds;
+		printf("  writers=%-2d %8.3f s  %10.0f events/s  %9.1f MB/s\n",writers,total,(double)events/total,(double)in->len/total/1048576.0);
+	        }
+
+	free(list);
+	return NDO_OK;
+        }
+
+
+
+int main(int argc, char **argv){
+	ndobench_input in={NULL,0,1,NULL,NDOBENCH_WRITERS};
+	unsigned long events=NDOBENCH_EVENTS;
+	char *input_file=NULL;
+	int result=NDO_OK;
+	int ran=0;
+	int c=0;
+	int x=0;
+	int y=0;
+
+	while((c=getopt(argc,argv,"c:e:f:r:w:h"))!=-1){
+		switch(c){
+		case 'c':
+			in.config_file=optarg;
+			break;
+		case 'e':
+			events=strtoul(optarg,NULL,0);
+			break;
+		case 'f':
+			input_file=optarg;
+			break;
+		case 'r':
+			if((in.rounds=atoi(optarg))<1)
+				in.rounds=1;
+			break;
+		case 'w':
+			in.writers=optarg;
+			break;
+		default:
+			printf("%s - checks and timings of the NDOUtils input paths\n\n",NDOBENCH_NAME);
+			printf("Usage: %s [-e <events>] [-f <file>] [-r <rounds>] [-c <config>]\n",argv[0]);
+			printf("                [-w <writers>] [<test>...]\n\n");
+			printf("<events>   = Synthetic service status events to generate (default %d).\n",NDOBENCH_EVENTS);
+			printf("<file>     = Use a recorded ndomod stream instead of synthetic events.\n");
+			printf("<rounds>   = Repeat every timing this many times and report the average.\n");
+			printf("<config>   = ndo2db config file with the database to write to.\n");
+			printf("<writers>  = Comma separated partition_writers values to time (default %s).\n",NDOBENCH_WRITERS);
+			printf("<test>     = Tests to run, all of them if none are given:\n");
+			for(x=0;ndobench_tests[x].name!=NULL;x++)
+				printf("               %-10s %s\n",ndobench_tests[x].name,ndobench_tests[x].description);
+			exit((c=='h')?0:1);
+		        }
+	        }
+
+	if(input_file!=NULL)
+		in.buf=ndobench_read_file(input_file,&in.len);
+	else
+		in.buf=ndobench_make_stream(events,&in.len);
+
+	/* the daemon sets its row descriptors up before it starts any writers */
+	if(ndo2db_init_status_rows()==NDO_ERROR || ndo2db_db_init_row(&ndobench_row)==NDO_ERROR){
+		printf("Cannot set up the row descriptors\n");
+		exit(1);
+	        }
+
+	for(x=0;ndobench_tests[x].name!=NULL;x++){
+		if(optind<argc){
+			for(y=optind;y<argc;y++){
+				if(!strcmp(argv[y],ndobench_tests[x].name))
+					break;
+			        }
+			if(y==argc)
+				continue;
+		        }
+		if(ran++>0)
+			printf("\n");
+		if(ndobench_tests[x].run(&in)!=NDO_OK)
+			result=NDO_ERROR;
+	        }
+
+	if(ran==0){
+		printf("No such test, see %s -h\n",argv[0]);
+		result=NDO_ERROR;
+	        }
+
+	free(in.buf);
+
+	return (result==NDO_OK)?0:1;
+        }
@@ -129,6 +129,10 @@ int ndomod_allow_sink_activity=NDO_TRUE;
 unsigned long ndomod_process_options=0;
 int ndomod_config_output_options=NDOMOD_CONFIG_DUMP_ALL;
 unsigned long ndomod_sink_buffer_slots=5000;
+unsigned long ndomod_sink_buffer_flush_time=0L;
+unsigned long ndomod_sink_buffer_flush_bytes=0L;
+unsigned long ndomod_sink_buffer_flush_progress=0L;
+time_t ndomod_sink_buffer_last_flush_log=0L;
 ndomod_sink_buffer sinkbuf;
 int has_ver403_long_output = (CURRENT_OBJECT_STRUCTURE_VERSION >= 403);
 
@@ -269,6 +273,16 @@ int ndomod_init(void){
 	if(ndomod_register_callbacks()==NDO_ERROR)
 		return NDO_ERROR;
 
+	/* schedule a recurring event to keep draining the buffer when flushes are paced */
+	if(ndomod_sink_buffer_flush_time>0L || ndomod_sink_buffer_flush_bytes>0L){
+		time(&current_time);
+#ifdef BUILD_NAGIOS_2X
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+NDOMOD_FLUSH_EVENT_INTERVAL,TRUE,NDOMOD_FLUSH_EVENT_INTERVAL,NULL,TRUE,(void *)ndomod_flush_sink_buffer_event,NULL);
+#else
+		schedule_new_event(EVENT_USER_FUNCTION,TRUE,current_time+NDOMOD_FLUSH_EVENT_INTERVAL,TRUE,NDOMOD_FLUSH_EVENT_INTERVAL,NULL,TRUE,(void *)ndomod_flush_sink_buffer_event,NULL,0);
+#endif
+		}
+
 	if(ndomod_sink_type==NDO_SINK_FILE){
 
 		/* make sure we have a rotation command defined... */
@@ -465,6 +479,12 @@ int ndomod_process_config_var(char *arg){
 	else if(!strcmp(var,"output_buffer_items"))
 		ndomod_sink_buffer_slots=strtoul(val,NULL,0);
 
+	else if(!strcmp(var,"output_buffer_flush_time"))
+		ndomod_sink_buffer_flush_time=strtoul(val,NULL,0);
+
+	else if(!strcmp(var,"output_buffer_flush_bytes"))
+		ndomod_sink_buffer_flush_bytes=strtoul(val,NULL,0);
+
 	else if(!strcmp(var,"reconnect_interval"))
 		ndomod_sink_reconnect_interval=strtoul(val,NULL,0);
 
@@ -770,12 +790,10 @@ int ndomod_rotate_sink_file(void *args){
 /* writes data to sink */
 int ndomod_write_to_sink(char *buf, int buffer_write, int flush_buffer){
 	char *temp_buffer=NULL;
-	char *sbuf=NULL;
 	int buflen=0;
 	int result=NDO_OK;
 	time_t current_time;
 	int reconnect=NDO_FALSE;
-	unsigned long items_to_flush=0L;
 
 	/* we have nothing to write... */
 	if(buf==NULL)
@@ -860,51 +878,24 @@ int ndomod_write_to_sink(char *buf, int buffer_write, int flush_buffer){
 
 	/***** FLUSH BUFFERED DATA FIRST *****/
 
-	if(flush_buffer==NDO_TRUE && (items_to_flush=ndomod_sink_buffer_items(&sinkbuf))>0){
-
-		while(ndomod_sink_buffer_items(&sinkbuf)>0){
-
-			/* get next item from buffer */
-			sbuf=ndomod_sink_buffer_peek(&sinkbuf);
-
-			buflen=strlen(sbuf);
-			result=ndo_sink_write(ndomod_sink_fd,sbuf,buflen);
-
-			/* an error occurred... */
-			if(result<0){
+	if(flush_buffer==NDO_TRUE && ndomod_sink_buffer_items(&sinkbuf)>0){
 
-				/* sink problem! */
-				if(errno!=EAGAIN){
+		/* only pace the flush if the new output can wait in the buffer */
+		if(ndomod_flush_sink_buffer(buffer_write)==NDO_ERROR){
 
-					/* close the sink */
-					ndomod_close_sink();
+			/***** BUFFER ORIGINAL OUTPUT FOR LATER *****/
 
-					asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost.  %lu queued items to flush.",sinkbuf.items);
-					ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-					free(temp_buffer);
-					temp_buffer=NULL;
-
-					time(&current_time);
-					ndomod_sink_last_reconnect_attempt=current_time;
-					ndomod_sink_last_reconnect_warning=current_time;
-		                        }
-
-				/***** BUFFER ORIGINAL OUTPUT FOR LATER *****/
-
-				if(buffer_write==NDO_TRUE)
-					ndomod_sink_buffer_push(&sinkbuf,buf);
+			if(buffer_write==NDO_TRUE)
+				ndomod_sink_buffer_push(&sinkbuf,buf);
 
-				return NDO_ERROR;
-	                        }
-
-			/* buffer was written okay, so remove it from buffer */
-			ndomod_sink_buffer_pop(&sinkbuf);
+			return NDO_ERROR;
 		        }
 
-		asprintf(&temp_buffer,"ndomod: Successfully flushed %lu queued items to data sink.",items_to_flush);
-		ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
-		free(temp_buffer);
-		temp_buffer=NULL;
+		/* flush budget was used up - queue new output behind the backlog to keep ordering */
+		if(ndomod_sink_buffer_items(&sinkbuf)>0){
+			ndomod_sink_buffer_push(&sinkbuf,buf);
+			return NDO_OK;
+		        }
 	        }
 
 
@@ -950,6 +941,118 @@ int ndomod_write_to_sink(char *buf, int buffer_write, int flush_buffer){
 
 
 
+/* flushes buffered data to the sink, optionally limited by the configured time/byte budget */
+int ndomod_flush_sink_buffer(int paced){
+	char *temp_buffer=NULL;
+	char *sbuf=NULL;
+	int buflen=0;
+	int result=NDO_OK;
+	time_t current_time;
+	struct timeval start_time;
+	struct timeval now;
+	unsigned long bytes_flushed=0L;
+	unsigned long elapsed=0L;
+
+	if(ndomod_sink_is_open==NDO_FALSE)
+		return NDO_ERROR;
+
+	gettimeofday(&start_time,NULL);
+
+	while(ndomod_sink_buffer_items(&sinkbuf)>0){
+
+		/* stop when the budget is used up, unless the buffer is full and new output needs room */
+		if(paced==NDO_TRUE && sinkbuf.items<sinkbuf.maxitems){
+
+			if(ndomod_sink_buffer_flush_bytes>0L && bytes_flushed>=ndomod_sink_buffer_flush_bytes)
+				break;
+
+			if(ndomod_sink_buffer_flush_time>0L){
+				gettimeofday(&now,NULL);
+				elapsed=(unsigned long)((now.tv_sec-start_time.tv_sec)*1000L+(now.tv_usec-start_time.tv_usec)/1000L);
+				if(elapsed>=ndomod_sink_buffer_flush_time)
+					break;
+			        }
+		        }
+
+		/* get next item from buffer */
+		sbuf=ndomod_sink_buffer_peek(&sinkbuf);
+
+		buflen=strlen(sbuf);
+		result=ndo_sink_write(ndomod_sink_fd,sbuf,buflen);
+
+		/* an error occurred... */
+		if(result<0){
+
+			/* sink problem! */
+			if(errno!=EAGAIN){
+
+				/* close the sink */
+				ndomod_close_sink();
+
+				asprintf(&temp_buffer,"ndomod: Error writing to data sink!  Some output may get lost.  %lu queued items to flush.",sinkbuf.items);
+				ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+				free(temp_buffer);
+				temp_buffer=NULL;
+
+				time(&current_time);
+				ndomod_sink_last_reconnect_attempt=current_time;
+				ndomod_sink_last_reconnect_warning=current_time;
+		                }
+
+			return NDO_ERROR;
+	                }
+
+		/* buffer was written okay, so remove it from buffer */
+		free(ndomod_sink_buffer_pop(&sinkbuf));
+
+		bytes_flushed+=buflen;
+		sinkbuf.flushed_items++;
+		sinkbuf.flushed_bytes+=buflen;
+		ndomod_sink_buffer_flush_progress++;
+	        }
+
+	/* the backlog is gone */
+	if(ndomod_sink_buffer_items(&sinkbuf)==0){
+		if(ndomod_sink_buffer_flush_progress>0L){
+			asprintf(&temp_buffer,"ndomod: Successfully flushed %lu queued items to data sink.  %lu items (%lu bytes) flushed from the buffer since startup.",ndomod_sink_buffer_flush_progress,ndomod_sink_buffer_get_flushed_items(&sinkbuf),ndomod_sink_buffer_get_flushed_bytes(&sinkbuf));
+			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+			free(temp_buffer);
+			temp_buffer=NULL;
+			}
+		ndomod_sink_buffer_flush_progress=0L;
+		}
+
+	/* log progress of a paced flush every now and then */
+	else{
+		time(&current_time);
+		if((unsigned long)(current_time-ndomod_sink_buffer_last_flush_log)>=NDOMOD_FLUSH_LOG_INTERVAL){
+			asprintf(&temp_buffer,"ndomod: Flushed %lu queued items to data sink so far, %lu queued items left to flush.  %lu items (%lu bytes) flushed from the buffer since startup.",ndomod_sink_buffer_flush_progress,sinkbuf.items,ndomod_sink_buffer_get_flushed_items(&sinkbuf),ndomod_sink_buffer_get_flushed_bytes(&sinkbuf));
+			ndomod_write_to_logs(temp_buffer,NSLOG_INFO_MESSAGE);
+			free(temp_buffer);
+			temp_buffer=NULL;
+
+			ndomod_sink_buffer_last_flush_log=current_time;
+			}
+		}
+
+	return NDO_OK;
+	}
+
+
+/* drains buffered data a bit at a time from the event loop */
+int ndomod_flush_sink_buffer_event(void *args){
+
+	if(ndomod_allow_sink_activity==NDO_FALSE || ndomod_sink_is_open==NDO_FALSE)
+		return NDO_OK;
+
+	if(ndomod_sink_buffer_items(&sinkbuf)>0)
+		ndomod_flush_sink_buffer(NDO_TRUE);
+
+	return NDO_OK;
+	}
+
+
+
 /* save unprocessed data to buffer file */
 int ndomod_save_unprocessed_data(char *f){
 	FILE *fp=NULL;
@@ -1044,6 +1147,8 @@ int ndomod_sink_buffer_init(ndomod_sink_buffer *sbuf,unsigned long maxitems){
 	sbuf->items=0L;
 	sbuf->maxitems=maxitems;
 	sbuf->overflow=0L;
+	sbuf->flushed_items=0L;
+	sbuf->flushed_bytes=0L;
 
 	return NDO_OK;
         }
@@ -1147,6 +1252,26 @@ unsigned long ndomod_sink_buffer_get_overflow(ndomod_sink_buffer *sbuf){
         }
 
 
+/* gets number of buffered items that have been flushed to the sink */
+unsigned long ndomod_sink_buffer_get_flushed_items(ndomod_sink_buffer *sbuf){
+
+	if(sbuf==NULL)
+		return 0;
+	else
+		return sbuf->flushed_items;
+        }
+
+
+/* gets number of buffered bytes that have been flushed to the sink */
+unsigned long ndomod_sink_buffer_get_flushed_bytes(ndomod_sink_buffer *sbuf){
+
+	if(sbuf==NULL)
+		return 0;
+	else
+		return sbuf->flushed_bytes;
+        }
+
+
 /* sets number of items lost due to buffer overflow */
 int ndomod_sink_buffer_set_overflow(ndomod_sink_buffer *sbuf, unsigned long num){
 
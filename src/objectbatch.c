@@ -0,0 +1,341 @@
+/**
+ * @file objectbatch.c Bulk object registration for ndo2db config dumps
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every object a definition names needs an id from the objects table,
+ * and the first time a name is seen that costs a query to look for it
+ * and another to add it.  A config dump of a fresh install is almost
+ * nothing but first times.  With object_batch_size set, definitions are
+ * held back until that many have arrived, the objects they name are
+ * looked up and added with a few multi-row statements, and only then
+ * are the definitions written - by which time every id they need is in
+ * the object cache.
+ *
+ * Any other event writes the held definitions first, so the order in
+ * which events reach the database doesn't change.  Names a definition
+ * uses that aren't listed below are still resolved one at a time, as
+ * are objects first seen outside a config dump.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/objectbatch.h"
+
+extern int ndo2db_object_batch_size;
+
+
+
+/****************************************************************************/
+/* OBJECT NAMES                                                             */
+/****************************************************************************/
+
+/* a definition field that names an object */
+typedef struct ndo2db_object_field_struct{
+	int input_data;
+	int object_type;
+	int name1;
+	int name2;		/* -1 if the object only has one name */
+	char split;		/* the name ends here, as in "command!args" */
+        }ndo2db_object_field;
+
+/* a definition list whose lines name objects */
+typedef struct ndo2db_object_list_struct{
+	int input_data;
+	int object_type;
+	int mbuf;
+	char split;		/* separates the names, as in "host;service" */
+        }ndo2db_object_list;
+
+/* these mirror the lookups the definition handlers make */
+static const ndo2db_object_field ndo2db_object_fields[]={
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_HOSTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_HOSTCHECKCOMMAND,-1,'!'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_HOSTEVENTHANDLER,-1,'!'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_HOSTCHECKPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_HOSTNOTIFICATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION,NDO2DB_OBJECTTYPE_HOSTGROUP,NDO_DATA_HOSTGROUPNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO_DATA_HOSTNAME,NDO_DATA_SERVICEDESCRIPTION,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_HOSTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_SERVICECHECKCOMMAND,-1,'!'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_SERVICEEVENTHANDLER,-1,'!'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_SERVICECHECKPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_SERVICENOTIFICATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION,NDO2DB_OBJECTTYPE_SERVICEGROUP,NDO_DATA_SERVICEGROUPNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_HOSTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_DEPENDENTHOSTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_DEPENDENCYPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO_DATA_HOSTNAME,NDO_DATA_SERVICEDESCRIPTION,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO_DATA_DEPENDENTHOSTNAME,NDO_DATA_DEPENDENTSERVICEDESCRIPTION,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_DEPENDENCYPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO_DATA_HOSTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_ESCALATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO_DATA_HOSTNAME,NDO_DATA_SERVICEDESCRIPTION,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_ESCALATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_COMMANDDEFINITION,NDO2DB_OBJECTTYPE_COMMAND,NDO_DATA_COMMANDNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_TIMEPERIODNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_CONTACTDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO_DATA_CONTACTNAME,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_CONTACTDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_HOSTNOTIFICATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_CONTACTDEFINITION,NDO2DB_OBJECTTYPE_TIMEPERIOD,NDO_DATA_SERVICENOTIFICATIONPERIOD,-1,'\x0'},
+	{NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO_DATA_CONTACTGROUPNAME,-1,'\x0'}
+        };
+
+static const ndo2db_object_list ndo2db_object_lists[]={
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO2DB_MBUF_PARENTHOST,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO2DB_MBUF_CONTACTGROUP,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_MBUF_CONTACT,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION,NDO2DB_OBJECTTYPE_HOST,NDO2DB_MBUF_HOSTGROUPMEMBER,'\x0'},
+#ifdef BUILD_NAGIOS_4X
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO2DB_MBUF_PARENTSERVICE,';'},
+#endif
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO2DB_MBUF_CONTACTGROUP,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_MBUF_CONTACT,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION,NDO2DB_OBJECTTYPE_SERVICE,NDO2DB_MBUF_SERVICEGROUPMEMBER,';'},
+	{NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO2DB_MBUF_CONTACTGROUP,'\x0'},
+	{NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_MBUF_CONTACT,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_CONTACTGROUP,NDO2DB_MBUF_CONTACTGROUP,'\x0'},
+	{NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_MBUF_CONTACT,'\x0'},
+	{NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION,NDO2DB_OBJECTTYPE_CONTACT,NDO2DB_MBUF_CONTACTGROUPMEMBER,'\x0'}
+        };
+
+
+/* copies part of a name into the batch, an empty name is no name */
+static char *ndo2db_object_batch_name(ndo2db_object_batch *batch, const char *name, size_t len){
+	char *result=NULL;
+
+	if(name==NULL || len==0)
+		return NULL;
+
+	if((result=(char *)ndo_arena_alloc(&batch->names,len+1))==NULL)
+		return NULL;
+	memcpy(result,name,len);
+	result[len]='\x0';
+
+	return result;
+        }
+
+
+/* remembers an object a held definition names, splitting the value the way the handler's strtok_r() calls do */
+static int ndo2db_object_batch_key(ndo2db_object_batch *batch, int object_type, const char *value1, const char *value2, char split){
+	ndo2db_object_key *new_key=NULL;
+	const char *ptr=NULL;
+	size_t len=0;
+	char *name1=NULL;
+	char *name2=NULL;
+
+	if(value1==NULL && value2==NULL)
+		return NDO_OK;
+
+	if(split=='\x0'){
+		name1=ndo2db_object_batch_name(batch,value1,(value1==NULL)?0:strlen(value1));
+		name2=ndo2db_object_batch_name(batch,value2,(value2==NULL)?0:strlen(value2));
+	        }
+	else if(value1!=NULL){
+		/* leading separators are skipped, the first name ends at the next one */
+		for(ptr=value1;*ptr==split;ptr++);
+		len=strcspn(ptr,(split=='!')?"!":";");
+		name1=ndo2db_object_batch_name(batch,ptr,len);
+
+		/* only "host;service" lists have a second name, the rest of the line */
+		if(split==';' && ptr[len]==split)
+			name2=ndo2db_object_batch_name(batch,ptr+len+1,strlen(ptr+len+1));
+	        }
+
+	if(name1==NULL && name2==NULL)
+		return NDO_OK;
+
+	if(batch->keys==batch->allocated_keys){
+		if((new_key=(ndo2db_object_key *)realloc(batch->key,sizeof(ndo2db_object_key)*(batch->allocated_keys+1024)))==NULL)
+			return NDO_ERROR;
+		batch->key=new_key;
+		batch->allocated_keys+=1024;
+	        }
+
+	batch->key[batch->keys].object_type=object_type;
+	batch->key[batch->keys].name1=name1;
+	batch->key[batch->keys].name2=name2;
+	batch->keys++;
+
+	return NDO_OK;
+        }
+
+
+/* remembers every object the current definition names */
+static int ndo2db_object_batch_keys(ndo2db_idi *idi, ndo2db_object_batch *batch){
+	const ndo2db_object_field *field=NULL;
+	const ndo2db_object_list *list=NULL;
+	int type,flags,attr;
+	struct timeval tstamp;
+	int x=0;
+	int y=0;
+
+	/* the handler won't look anything up for data it throws away */
+	if(ndo2db_convert_standard_data_elements(idi,&type,&flags,&attr,&tstamp)==NDO_ERROR || tstamp.tv_sec<idi->dbinfo.latest_realtime_data_time)
+		return NDO_OK;
+
+	for(x=0;x<(int)NAGIOS_SIZEOF_ARRAY(ndo2db_object_fields);x++){
+		field=&ndo2db_object_fields[x];
+		if(field->input_data!=idi->current_input_data)
+			continue;
+		ndo2db_object_batch_key(batch,field->object_type,idi->buffered_input[field->name1],(field->name2<0)?NULL:idi->buffered_input[field->name2],field->split);
+	        }
+
+	for(x=0;x<(int)NAGIOS_SIZEOF_ARRAY(ndo2db_object_lists);x++){
+		list=&ndo2db_object_lists[x];
+		if(list->input_data!=idi->current_input_data)
+			continue;
+		for(y=0;y<idi->mbuf[list->mbuf].used_lines;y++)
+			ndo2db_object_batch_key(batch,list->object_type,idi->mbuf[list->mbuf].buffer[y],NULL,list->split);
+	        }
+
+	return NDO_OK;
+        }
+
+
+
+/****************************************************************************/
+/* BATCH FUNCTIONS                                                          */
+/****************************************************************************/
+
+/* holds back a definition, returns NDO_TRUE if the batch took it */
+int ndo2db_object_batch_add(ndo2db_idi *idi){
+	ndo2db_object_batch *batch=NULL;
+	ndo2db_input_event *ev=NULL;
+
+	if(idi==NULL || ndo2db_object_batch_size<=0 || idi->buffered_input==NULL)
+		return NDO_FALSE;
+
+	switch(idi->current_input_data){
+
+	case NDO2DB_INPUT_DATA_HOSTDEFINITION:
+	case NDO2DB_INPUT_DATA_HOSTGROUPDEFINITION:
+	case NDO2DB_INPUT_DATA_SERVICEDEFINITION:
+	case NDO2DB_INPUT_DATA_SERVICEGROUPDEFINITION:
+	case NDO2DB_INPUT_DATA_HOSTDEPENDENCYDEFINITION:
+	case NDO2DB_INPUT_DATA_SERVICEDEPENDENCYDEFINITION:
+	case NDO2DB_INPUT_DATA_HOSTESCALATIONDEFINITION:
+	case NDO2DB_INPUT_DATA_SERVICEESCALATIONDEFINITION:
+	case NDO2DB_INPUT_DATA_COMMANDDEFINITION:
+	case NDO2DB_INPUT_DATA_TIMEPERIODDEFINITION:
+	case NDO2DB_INPUT_DATA_CONTACTDEFINITION:
+	case NDO2DB_INPUT_DATA_CONTACTGROUPDEFINITION:
+		break;
+
+	/* anything else has to wait for the definitions before it */
+	default:
+		ndo2db_object_batch_flush(idi);
+		return NDO_FALSE;
+	        }
+
+	/* the batch is only set up once there is something to hold */
+	if((batch=idi->object_batch)==NULL){
+		if((batch=(ndo2db_object_batch *)calloc(1,sizeof(ndo2db_object_batch)))==NULL)
+			return NDO_FALSE;
+		ndo_arena_init(&batch->names,NDO2DB_OBJECT_BATCH_NAMES);
+		idi->object_batch=batch;
+	        }
+
+	/* the names have to be read before the handler's strtok_r() calls cut them up */
+	if(ndo2db_object_batch_keys(idi,batch)==NDO_ERROR)
+		return NDO_FALSE;
+
+	if((ev=(ndo2db_input_event *)malloc(sizeof(ndo2db_input_event)))==NULL)
+		return NDO_FALSE;
+	ndo2db_save_input_data(idi,ev);
+
+	ev->next=NULL;
+	if(batch->tail==NULL)
+		batch->head=ev;
+	else
+		batch->tail->next=ev;
+	batch->tail=ev;
+	batch->definitions++;
+
+	if(batch->definitions>=ndo2db_object_batch_size)
+		ndo2db_object_batch_flush(idi);
+
+	return NDO_TRUE;
+        }
+
+
+/* registers the objects the held definitions name, then writes the definitions in the order they arrived */
+int ndo2db_object_batch_flush(ndo2db_idi *idi){
+	ndo2db_object_batch *batch=NULL;
+	ndo2db_input_event *ev=NULL;
+	ndo2db_input_event current;
+
+	if(idi==NULL || (batch=idi->object_batch)==NULL || batch->head==NULL)
+		return NDO_OK;
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Writing %d held definitions naming %d objects\n",batch->definitions,batch->keys);
+
+	/* a failure here just leaves the handlers to look the objects up themselves */
+	ndo2db_get_object_ids_with_insert(idi,batch->key,batch->keys);
+
+	/* step the event being parsed aside */
+	ndo2db_save_input_data(idi,&current);
+
+	while((ev=batch->head)!=NULL){
+		batch->head=ev->next;
+
+		ndo2db_restore_input_data(idi,ev);
+		ndo2db_write_input_data(idi);
+		ndo2db_free_input_memory(idi);
+
+		free(ev);
+	        }
+
+	batch->tail=NULL;
+	batch->definitions=0;
+	batch->keys=0;
+	ndo_arena_reset(&batch->names);
+
+	ndo2db_restore_input_data(idi,&current);
+
+	return NDO_OK;
+        }
+
+
+/* drops the batch, definitions still in it are lost */
+int ndo2db_object_batch_free(ndo2db_idi *idi){
+	ndo2db_object_batch *batch=NULL;
+	ndo2db_input_event *ev=NULL;
+
+	if(idi==NULL || (batch=idi->object_batch)==NULL)
+		return NDO_OK;
+
+	while((ev=batch->head)!=NULL){
+		batch->head=ev->next;
+		ndo2db_free_input_event(ev);
+	        }
+
+	ndo_arena_free(&batch->names);
+	free(batch->key);
+	free(batch);
+	idi->object_batch=NULL;
+
+	return NDO_OK;
+        }
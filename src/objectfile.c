@@ -0,0 +1,630 @@
+/**
+ * @file objectfile.c Object id dictionary shared by ndo2db processes
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every connection starts by reading the id of every object the instance
+ * has into its object cache, which on a large install is a SELECT of
+ * hundreds of thousands of rows.  With object_cache_file set, the ids are
+ * also kept in a file (one per instance) that all ndo2db processes map.
+ * A connection checks the file against the row count and highest object
+ * id in the objects table and, when they agree, fills its cache from the
+ * file instead.  Otherwise it reads the table as before and writes a new
+ * file, which replaces the old one with a rename() and marks it retired.
+ *
+ * Objects a process adds to the table are appended to the file under an
+ * exclusive flock(), and a process looks for objects other processes
+ * have appended before it asks the database about a cache miss.  Appends
+ * that would make the ids in the file go backwards (two processes adding
+ * objects for the same instance at once) are dropped; the counts then no
+ * longer match, so the next connection rebuilds the file.
+ */
+
+#define _GNU_SOURCE		/* asprintf() */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/objectfile.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/file.h>
+
+extern char *ndo2db_object_cache_file;
+extern ndo2db_dbconfig ndo2db_db_settings;
+extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+
+static pthread_mutex_t ndo2db_object_file_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/****************************************************************************/
+/* FILE ROUTINES                                                            */
+/****************************************************************************/
+
+/* does a header describe this instance's objects? */
+static int ndo2db_object_file_header_ok(ndo2db_idi *idi, ndo2db_object_file_header *header){
+	char table[sizeof(header->table)];
+
+	snprintf(table,sizeof(table),"%s.%s",(ndo2db_db_settings.dbname==NULL)?"":ndo2db_db_settings.dbname,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]);
+
+	if(memcmp(header->magic,NDO2DB_OBJECT_FILE_MAGIC,sizeof(header->magic)) || strncmp(header->table,table,sizeof(header->table)) || header->instance_id!=idi->dbinfo.instance_id)
+		return NDO_FALSE;
+
+	return NDO_TRUE;
+        }
+
+
+/* maps all of the file */
+static int ndo2db_object_file_map(ndo2db_object_file *file){
+	struct stat st;
+
+	if(fstat(file->fd,&st)==-1 || (size_t)st.st_size<sizeof(ndo2db_object_file_header))
+		return NDO_ERROR;
+
+	if(file->map!=NULL && file->mapped==(size_t)st.st_size)
+		return NDO_OK;
+
+	if(file->map!=NULL)
+		munmap(file->map,file->mapped);
+	file->mapped=0;
+
+	if((file->map=(char *)mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,file->fd,0))==MAP_FAILED){
+		file->map=NULL;
+		syslog(LOG_USER|LOG_INFO,"Error: Could not map object cache file '%s': %s\n",file->path,strerror(errno));
+		return NDO_ERROR;
+	        }
+	file->mapped=st.st_size;
+
+	return NDO_OK;
+        }
+
+
+static void ndo2db_object_file_unmap(ndo2db_object_file *file){
+
+	if(file->map!=NULL)
+		munmap(file->map,file->mapped);
+	file->map=NULL;
+	file->mapped=0;
+	if(file->fd>=0)
+		close(file->fd);
+	file->fd=-1;
+	file->used=0;
+        }
+
+
+/* opens whatever file is at the path now */
+static int ndo2db_object_file_open(ndo2db_idi *idi, ndo2db_object_file *file){
+
+	ndo2db_object_file_unmap(file);
+
+	if((file->fd=open(file->path,O_RDWR))==-1){
+		if(errno!=ENOENT)
+			syslog(LOG_USER|LOG_INFO,"Error: Could not open object cache file '%s': %s\n",file->path,strerror(errno));
+		return NDO_ERROR;
+	        }
+
+	if(ndo2db_object_file_map(file)==NDO_ERROR || ndo2db_object_file_header_ok(idi,(ndo2db_object_file_header *)file->map)==NDO_FALSE){
+		ndo2db_object_file_unmap(file);
+		return NDO_ERROR;
+	        }
+
+	return NDO_OK;
+        }
+
+
+/* flock()s the current file, following renames by other processes */
+static int ndo2db_object_file_lock_file(ndo2db_idi *idi, ndo2db_object_file *file, int operation){
+
+	while(file->fd>=0){
+
+		if(flock(file->fd,operation)==-1){
+			if(errno==EINTR)
+				continue;
+			ndo2db_object_file_unmap(file);
+			return NDO_ERROR;
+		        }
+
+		if(((ndo2db_object_file_header *)file->map)->retired==0L)
+			return NDO_OK;
+
+		/* it was replaced, so everything gets read again from the new one */
+		if(ndo2db_object_file_open(idi,file)==NDO_ERROR)
+			return NDO_ERROR;
+	        }
+
+	return NDO_ERROR;
+        }
+
+
+static void ndo2db_object_file_unlock_file(ndo2db_object_file *file){
+
+	if(file->fd>=0)
+		flock(file->fd,LOCK_UN);
+        }
+
+
+/* adds records other processes have appended to the cache */
+static int ndo2db_object_file_read(ndo2db_idi *idi, ndo2db_object_file *file){
+	ndo2db_object_record *record=NULL;
+	unsigned long used=0L;
+	unsigned long offset=0L;
+	unsigned long size=0L;
+	char *name1=NULL;
+	char *name2=NULL;
+
+	used=((ndo2db_object_file_header *)file->map)->used;
+	if(sizeof(ndo2db_object_file_header)+used>file->mapped && ndo2db_object_file_map(file)==NDO_ERROR)
+		return NDO_ERROR;
+	if(sizeof(ndo2db_object_file_header)+used>file->mapped)
+		return NDO_ERROR;
+
+	for(offset=file->used;offset+sizeof(ndo2db_object_record)<=used;offset+=size){
+
+		record=(ndo2db_object_record *)(file->map+sizeof(ndo2db_object_file_header)+offset);
+		size=sizeof(ndo2db_object_record);
+		name1=NULL;
+		name2=NULL;
+		if(record->name1_length!=NDO2DB_OBJECT_FILE_NONAME){
+			name1=(char *)record+size;
+			size+=record->name1_length+1;
+		        }
+		if(record->name2_length!=NDO2DB_OBJECT_FILE_NONAME){
+			name2=(char *)record+size;
+			size+=record->name2_length+1;
+		        }
+		size=(size+sizeof(long)-1) & ~(sizeof(long)-1);
+		if(offset+size>used)
+			break;
+
+		ndo2db_add_cached_object_id(idi,record->object_type,name1,name2,record->object_id);
+	        }
+
+	if(offset!=used){
+		syslog(LOG_USER|LOG_INFO,"Error: Object cache file '%s' is corrupt, ignoring it\n",file->path);
+		ndo2db_object_file_unmap(file);
+		return NDO_ERROR;
+	        }
+
+	file->used=used;
+
+	return NDO_OK;
+        }
+
+
+/* adds a record to the buffer */
+static int ndo2db_object_file_buffer(ndo2db_object_file *file, int object_type, char *name1, char *name2, unsigned long object_id){
+	ndo2db_object_record *record=NULL;
+	size_t length1=0;
+	size_t length2=0;
+	size_t size=0;
+	char *new_buffer=NULL;
+
+	length1=(name1==NULL)?0:strlen(name1);
+	length2=(name2==NULL)?0:strlen(name2);
+	if(length1>=NDO2DB_OBJECT_FILE_NONAME || length2>=NDO2DB_OBJECT_FILE_NONAME)
+		return NDO_ERROR;
+
+	size=sizeof(ndo2db_object_record)+((name1==NULL)?0:length1+1)+((name2==NULL)?0:length2+1);
+	size=(size+sizeof(long)-1) & ~(sizeof(long)-1);
+
+	if(file->buffered+size>file->allocated){
+		if((new_buffer=(char *)realloc(file->buffer,(file->buffered+size)*2))==NULL)
+			return NDO_ERROR;
+		file->buffer=new_buffer;
+		file->allocated=(file->buffered+size)*2;
+	        }
+
+	memset(file->buffer+file->buffered,0,size);
+	record=(ndo2db_object_record *)(file->buffer+file->buffered);
+	record->object_id=object_id;
+	record->object_type=object_type;
+	record->name1_length=(name1==NULL)?NDO2DB_OBJECT_FILE_NONAME:length1;
+	record->name2_length=(name2==NULL)?NDO2DB_OBJECT_FILE_NONAME:length2;
+	if(name1!=NULL)
+		memcpy((char *)(record+1),name1,length1);
+	if(name2!=NULL)
+		memcpy((char *)(record+1)+((name1==NULL)?0:length1+1),name2,length2);
+	file->buffered+=size;
+
+	if(file->new_header.objects==0L || object_id<file->min_object_id)
+		file->min_object_id=object_id;
+	if(object_id>file->new_header.max_object_id)
+		file->new_header.max_object_id=object_id;
+	file->new_header.objects++;
+	file->new_header.used+=size;
+
+	return NDO_OK;
+        }
+
+
+static void ndo2db_object_file_clear_buffer(ndo2db_object_file *file){
+
+	file->buffered=0;
+	file->min_object_id=0L;
+	memset(&file->new_header,0,sizeof(file->new_header));
+        }
+
+
+static int ndo2db_object_file_write(int fd, const char *buf, size_t size, off_t offset){
+	ssize_t written=0;
+
+	while(size>0){
+		if((written=pwrite(fd,buf,size,offset))==-1){
+			if(errno==EINTR)
+				continue;
+			return NDO_ERROR;
+		        }
+		buf+=written;
+		size-=written;
+		offset+=written;
+	        }
+
+	return NDO_OK;
+        }
+
+
+
+/****************************************************************************/
+/* CACHE ROUTINES                                                           */
+/****************************************************************************/
+
+/* fills the object cache from the file if it matches the database */
+int ndo2db_object_file_load(ndo2db_idi *idi){
+	ndo2db_object_cache *cache=NULL;
+	ndo2db_object_file *file=NULL;
+	ndo2db_object_file_header *header=NULL;
+	unsigned long objects=0L;
+	unsigned long max_object_id=0L;
+	int result=NDO_OK;
+	char *buf=NULL;
+
+	if(ndo2db_object_cache_file==NULL || ndo2db_init_object_cache(idi)==NDO_ERROR)
+		return NDO_ERROR;
+	cache=idi->dbinfo.object_cache;
+
+	/* what the database has */
+	if(asprintf(&buf,"SELECT COUNT(*), MAX(object_id) FROM %s WHERE instance_id='%lu'"
+		    ,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]
+		    ,idi->dbinfo.instance_id
+		   )==-1)
+		buf=NULL;
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		if(idi->dbinfo.mysql_result!=NULL && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&objects);
+			if(idi->dbinfo.mysql_row[1]!=NULL)
+				ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[1],&max_object_id);
+		        }
+		else
+			result=NDO_ERROR;
+		if(idi->dbinfo.mysql_result!=NULL)
+			mysql_free_result(idi->dbinfo.mysql_result);
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+	if(result==NDO_ERROR)
+		return NDO_ERROR;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=cache->file)==NULL){
+		if((file=(ndo2db_object_file *)calloc(1,sizeof(ndo2db_object_file)))==NULL || asprintf(&file->path,"%s-%lu",ndo2db_object_cache_file,idi->dbinfo.instance_id)==-1){
+			free(file);
+			pthread_mutex_unlock(&ndo2db_object_file_lock);
+			return NDO_ERROR;
+		        }
+		file->fd=-1;
+		file->new_fd=-1;
+		cache->file=file;
+	        }
+
+	result=NDO_ERROR;
+	if(ndo2db_object_file_open(idi,file)==NDO_OK && ndo2db_object_file_lock_file(idi,file,LOCK_SH)==NDO_OK){
+		header=(ndo2db_object_file_header *)file->map;
+		if(header->objects==objects && header->max_object_id==max_object_id && ndo2db_reserve_object_cache(idi,objects)==NDO_OK)
+			result=ndo2db_object_file_read(idi,file);
+		ndo2db_object_file_unlock_file(file);
+	        }
+
+	if(result==NDO_OK)
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Read %lu object ids from '%s'\n",objects,file->path);
+	else{
+		ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Object cache file '%s' doesn't match the %lu objects in the database\n",file->path,objects);
+		ndo2db_object_file_unmap(file);
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return result;
+        }
+
+
+/* picks up objects other processes have added since we last looked */
+int ndo2db_object_file_refresh(ndo2db_idi *idi){
+	ndo2db_object_file *file=NULL;
+	ndo2db_object_file_header *header=NULL;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)!=NULL && file->fd>=0){
+		header=(ndo2db_object_file_header *)file->map;
+		if(header->retired!=0L || header->used!=file->used){
+			if(ndo2db_object_file_lock_file(idi,file,LOCK_SH)==NDO_OK){
+				ndo2db_object_file_read(idi,file);
+				ndo2db_object_file_unlock_file(file);
+			        }
+		        }
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return NDO_OK;
+        }
+
+
+/* remembers an object we added to the database, it's written by the next flush */
+int ndo2db_object_file_append(ndo2db_idi *idi, int object_type, char *name1, char *name2, unsigned long object_id){
+	ndo2db_object_file *file=NULL;
+	int result=NDO_OK;
+
+	if(idi->dbinfo.object_cache==NULL || object_id==0L)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+	if((file=idi->dbinfo.object_cache->file)!=NULL && file->fd>=0)
+		result=ndo2db_object_file_buffer(file,object_type,name1,name2,object_id);
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return result;
+        }
+
+
+/* appends the objects we added to the file */
+int ndo2db_object_file_flush(ndo2db_idi *idi){
+	ndo2db_object_file *file=NULL;
+	ndo2db_object_file_header header;
+	int result=NDO_OK;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)==NULL || file->buffered==0){
+		pthread_mutex_unlock(&ndo2db_object_file_lock);
+		return NDO_OK;
+	        }
+
+	if(ndo2db_object_file_lock_file(idi,file,LOCK_EX)==NDO_OK){
+
+		/* other processes' records go in the cache first, so we can skip past them */
+		if((result=ndo2db_object_file_read(idi,file))==NDO_OK){
+
+			memcpy(&header,file->map,sizeof(header));
+			if(file->min_object_id>header.max_object_id){
+				if((result=ndo2db_object_file_write(file->fd,file->buffer,file->buffered,sizeof(header)+header.used))==NDO_OK){
+					header.objects+=file->new_header.objects;
+					header.max_object_id=file->new_header.max_object_id;
+					header.used+=file->buffered;
+					if((result=ndo2db_object_file_write(file->fd,(char *)&header,sizeof(header),0))==NDO_OK)
+						file->used=header.used;
+				        }
+				if(result==NDO_ERROR)
+					syslog(LOG_USER|LOG_INFO,"Error: Could not append to object cache file '%s': %s\n",file->path,strerror(errno));
+			        }
+			else
+				ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Another process added objects to '%s' first, it will be rebuilt\n",file->path);
+		        }
+
+		ndo2db_object_file_unlock_file(file);
+	        }
+
+	ndo2db_object_file_clear_buffer(file);
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return result;
+        }
+
+
+/* starts writing a new file next to the old one */
+int ndo2db_object_file_rebuild_start(ndo2db_idi *idi){
+	ndo2db_object_file *file=NULL;
+	ndo2db_object_file_header header;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_ERROR;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)==NULL){
+		pthread_mutex_unlock(&ndo2db_object_file_lock);
+		return NDO_ERROR;
+	        }
+
+	ndo2db_object_file_clear_buffer(file);
+
+	if(asprintf(&file->new_path,"%s.XXXXXX",file->path)==-1)
+		file->new_path=NULL;
+	if(file->new_path==NULL || (file->new_fd=mkstemp(file->new_path))==-1){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not create object cache file '%s': %s\n",(file->new_path==NULL)?file->path:file->new_path,strerror(errno));
+		free(file->new_path);
+		file->new_path=NULL;
+		file->new_fd=-1;
+		pthread_mutex_unlock(&ndo2db_object_file_lock);
+		return NDO_ERROR;
+	        }
+
+	/* the real header is written when we're done */
+	memset(&header,0,sizeof(header));
+	ndo2db_object_file_write(file->new_fd,(char *)&header,sizeof(header),0);
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return NDO_OK;
+        }
+
+
+int ndo2db_object_file_rebuild_add(ndo2db_idi *idi, int object_type, char *name1, char *name2, unsigned long object_id){
+	ndo2db_object_file *file=NULL;
+	int result=NDO_OK;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)!=NULL && file->new_fd>=0){
+		if(file->buffered>=NDO2DB_OBJECT_FILE_BUFFER){
+			result=ndo2db_object_file_write(file->new_fd,file->buffer,file->buffered,sizeof(ndo2db_object_file_header)+file->new_header.used-file->buffered);
+			file->buffered=0;
+		        }
+		if(result==NDO_OK)
+			result=ndo2db_object_file_buffer(file,object_type,name1,name2,object_id);
+		if(result==NDO_ERROR){
+			close(file->new_fd);
+			file->new_fd=-1;
+		        }
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return result;
+        }
+
+
+/* puts the new file in place of the old one, or throws it away */
+int ndo2db_object_file_rebuild_end(ndo2db_idi *idi, int keep){
+	ndo2db_object_file *file=NULL;
+	ndo2db_object_file_header *header=NULL;
+	struct stat old_st;
+	struct stat st;
+	unsigned long retired=1L;
+	int old_fd=-1;
+	int result=NDO_ERROR;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)==NULL || file->new_path==NULL){
+		pthread_mutex_unlock(&ndo2db_object_file_lock);
+		return NDO_OK;
+	        }
+
+	if(keep==NDO_TRUE && file->new_fd>=0){
+
+		header=&file->new_header;
+		memcpy(header->magic,NDO2DB_OBJECT_FILE_MAGIC,sizeof(header->magic));
+		snprintf(header->table,sizeof(header->table),"%s.%s",(ndo2db_db_settings.dbname==NULL)?"":ndo2db_db_settings.dbname,ndo2db_db_tablenames[NDO2DB_DBTABLE_OBJECTS]);
+		header->instance_id=idi->dbinfo.instance_id;
+		header->retired=0L;
+
+		if(ndo2db_object_file_write(file->new_fd,file->buffer,file->buffered,sizeof(ndo2db_object_file_header)+header->used-file->buffered)==NDO_OK && ndo2db_object_file_write(file->new_fd,(char *)header,sizeof(ndo2db_object_file_header),0)==NDO_OK)
+			result=NDO_OK;
+		else
+			syslog(LOG_USER|LOG_INFO,"Error: Could not write object cache file '%s': %s\n",file->new_path,strerror(errno));
+	        }
+
+	if(result==NDO_OK){
+
+		/* hold the old file while it's replaced, so nobody appends to it afterwards */
+		ndo2db_object_file_unmap(file);
+		while((old_fd=open(file->path,O_RDWR))>=0){
+			flock(old_fd,LOCK_EX);
+			if(fstat(old_fd,&old_st)==0 && stat(file->path,&st)==0 && old_st.st_dev==st.st_dev && old_st.st_ino==st.st_ino)
+				break;
+			close(old_fd);
+		        }
+
+		if(rename(file->new_path,file->path)==-1){
+			syslog(LOG_USER|LOG_INFO,"Error: Could not rename object cache file '%s': %s\n",file->new_path,strerror(errno));
+			result=NDO_ERROR;
+		        }
+		else if(old_fd>=0)
+			ndo2db_object_file_write(old_fd,(char *)&retired,sizeof(retired),offsetof(ndo2db_object_file_header,retired));
+
+		if(old_fd>=0)
+			close(old_fd);
+	        }
+
+	if(result==NDO_OK){
+		file->fd=file->new_fd;
+		if(ndo2db_object_file_map(file)==NDO_OK){
+			file->used=((ndo2db_object_file_header *)file->map)->used;
+			ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Wrote %lu object ids to '%s'\n",file->new_header.objects,file->path);
+		        }
+		else
+			ndo2db_object_file_unmap(file);
+	        }
+	else{
+		if(file->new_fd>=0)
+			close(file->new_fd);
+		unlink(file->new_path);
+	        }
+
+	file->new_fd=-1;
+	free(file->new_path);
+	file->new_path=NULL;
+	ndo2db_object_file_clear_buffer(file);
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return result;
+        }
+
+
+int ndo2db_object_file_close(ndo2db_idi *idi){
+	ndo2db_object_file *file=NULL;
+
+	if(idi->dbinfo.object_cache==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&ndo2db_object_file_lock);
+
+	if((file=idi->dbinfo.object_cache->file)!=NULL){
+		ndo2db_object_file_unmap(file);
+		if(file->new_path!=NULL){
+			if(file->new_fd>=0)
+				close(file->new_fd);
+			unlink(file->new_path);
+			free(file->new_path);
+		        }
+		free(file->buffer);
+		free(file->path);
+		free(file);
+		idi->dbinfo.object_cache->file=NULL;
+	        }
+
+	pthread_mutex_unlock(&ndo2db_object_file_lock);
+
+	return NDO_OK;
+        }
@@ -0,0 +1,377 @@
+/**
+ * @file partition.c Object-partitioned database writer threads for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The thread that parses a client's data normally also runs the handler for
+ * every completed event.  With partition_writers set, completed events are
+ * instead handed to a pool of writer threads, each with its own database
+ * connection.  Events about a host (or a contact) always go to the same
+ * writer, so updates to one object are applied in the order they arrived.
+ * Events that touch global state (process data, config dumps, definitions,
+ * log entries, ...) are barriers: the parser waits for every writer to go
+ * idle and handles them itself, then copies the resulting instance state
+ * to the writers before it dispatches anything else.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/partition.h"
+
+
+
+/****************************************************************************/
+/* EVENT ROUTING                                                            */
+/****************************************************************************/
+
+/* decides how an event type may be spread over the writers */
+static int ndo2db_partition_route(int input_data){
+
+	switch(input_data){
+
+	/* per-host realtime data */
+	case NDO2DB_INPUT_DATA_HOSTSTATUSDATA:
+	case NDO2DB_INPUT_DATA_SERVICESTATUSDATA:
+	case NDO2DB_INPUT_DATA_HOSTCHECKDATA:
+	case NDO2DB_INPUT_DATA_SERVICECHECKDATA:
+	case NDO2DB_INPUT_DATA_EVENTHANDLERDATA:
+	case NDO2DB_INPUT_DATA_STATECHANGEDATA:
+	case NDO2DB_INPUT_DATA_FLAPPINGDATA:
+	case NDO2DB_INPUT_DATA_COMMENTDATA:
+	case NDO2DB_INPUT_DATA_DOWNTIMEDATA:
+	case NDO2DB_INPUT_DATA_ACKNOWLEDGEMENTDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVEHOSTDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVESERVICEDATA:
+		return NDO2DB_PARTITION_BY_HOST;
+
+	/* per-contact realtime data */
+	case NDO2DB_INPUT_DATA_CONTACTSTATUSDATA:
+	case NDO2DB_INPUT_DATA_ADAPTIVECONTACTDATA:
+		return NDO2DB_PARTITION_BY_CONTACT;
+
+	/* notifications are chained through the last inserted ids, keep them together */
+	case NDO2DB_INPUT_DATA_NOTIFICATIONDATA:
+	case NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONDATA:
+	case NDO2DB_INPUT_DATA_CONTACTNOTIFICATIONMETHODDATA:
+	case NDO2DB_INPUT_DATA_LOGDATA:
+	case NDO2DB_INPUT_DATA_SYSTEMCOMMANDDATA:
+	case NDO2DB_INPUT_DATA_EXTERNALCOMMANDDATA:
+		return NDO2DB_PARTITION_SERIAL;
+
+	default:
+		break;
+	        }
+
+	return NDO2DB_PARTITION_BARRIER;
+        }
+
+
+/* picks the writer for an event */
+static int ndo2db_partition_select(ndo2db_partition_pool *pool, ndo2db_idi *idi, int route){
+	char *name=NULL;
+
+	if(route==NDO2DB_PARTITION_BY_HOST)
+		name=idi->buffered_input[NDO_DATA_HOST];
+	else if(route==NDO2DB_PARTITION_BY_CONTACT)
+		name=idi->buffered_input[NDO_DATA_CONTACTNAME];
+
+	if(name==NULL || pool->writers==1)
+		return 0;
+
+	return ndo2db_object_hashfunc(name,NULL,pool->writers);
+        }
+
+
+/* copies instance state the parser owns to the (idle) writers */
+static void ndo2db_partition_sync(ndo2db_idi *idi){
+	ndo2db_partition_pool *pool=idi->partitions;
+	ndo2db_dbconninfo *src=&idi->dbinfo;
+	ndo2db_dbconninfo *dst=NULL;
+	int x=0;
+
+	/* the writers share the parser's object cache */
+	ndo2db_init_object_cache(idi);
+
+	for(x=0;x<pool->writers;x++){
+		dst=&pool->writer[x].idi.dbinfo;
+
+		dst->instance_id=src->instance_id;
+		dst->conninfo_id=src->conninfo_id;
+		dst->latest_program_status_time=src->latest_program_status_time;
+		dst->latest_host_status_time=src->latest_host_status_time;
+		dst->latest_service_status_time=src->latest_service_status_time;
+		dst->latest_contact_status_time=src->latest_contact_status_time;
+		dst->latest_queued_event_time=src->latest_queued_event_time;
+		dst->latest_realtime_data_time=src->latest_realtime_data_time;
+		dst->latest_comment_time=src->latest_comment_time;
+		dst->clean_event_queue=src->clean_event_queue;
+		dst->object_cache=src->object_cache;
+
+		pool->writer[x].idi.current_object_config_type=idi->current_object_config_type;
+	        }
+
+	pool->sync_needed=NDO_FALSE;
+        }
+
+
+
+/****************************************************************************/
+/* WRITER THREADS                                                           */
+/****************************************************************************/
+
+/* writer thread main loop */
+static void *ndo2db_partition_thread(void *arg){
+	ndo2db_partition_writer *w=(ndo2db_partition_writer *)arg;
+	ndo2db_partition_pool *pool=w->pool;
+	ndo2db_input_event *item=NULL;
+
+#ifdef USE_MYSQL
+	mysql_thread_init();
+#endif
+
+	ndo2db_db_connect(&w->idi);
+
+	pthread_mutex_lock(&pool->lock);
+	while(1){
+
+		/* wait for work */
+		while(w->head==NULL && pool->shutdown==NDO_FALSE)
+			pthread_cond_wait(&w->cond,&pool->lock);
+		if((item=w->head)==NULL)
+			break;
+		if((w->head=item->next)==NULL)
+			w->tail=NULL;
+
+		/* let the parser continue if it was waiting for room */
+		if(w->queued--==NDO2DB_PARTITION_QUEUE_ITEMS)
+			pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+
+		/* the item's buffers become ours, the handler frees them */
+		ndo2db_restore_input_data(&w->idi,item);
+		free(item);
+
+		ndo2db_db_begin_event(&w->idi);
+		ndo2db_handle_input_data(&w->idi);
+		ndo2db_db_end_event(&w->idi);
+		ndo2db_free_input_memory(&w->idi);
+		ndo2db_db_flush_expired_batches(&w->idi);
+
+		/* write and commit everything before we go idle, so a drain sees it */
+		pthread_mutex_lock(&pool->lock);
+		if(w->head==NULL){
+			pthread_mutex_unlock(&pool->lock);
+			ndo2db_db_commit(&w->idi);
+			pthread_mutex_lock(&pool->lock);
+		        }
+		if(--pool->pending==0)
+			pthread_cond_broadcast(&pool->done);
+	        }
+	pthread_mutex_unlock(&pool->lock);
+
+	ndo2db_db_commit(&w->idi);
+	ndo2db_db_disconnect(&w->idi);
+
+#ifdef USE_MYSQL
+	mysql_thread_end();
+#endif
+
+	return NULL;
+        }
+
+
+/* starts the writer threads for a client connection */
+int ndo2db_partition_start(ndo2db_idi *idi, int writers){
+	ndo2db_partition_pool *pool=NULL;
+	ndo2db_partition_writer *w=NULL;
+	int x=0;
+
+	if(idi==NULL || writers<1)
+		return NDO_ERROR;
+
+	if(writers>NDO2DB_MAX_PARTITION_WRITERS)
+		writers=NDO2DB_MAX_PARTITION_WRITERS;
+
+	if((pool=(ndo2db_partition_pool *)calloc(1,sizeof(ndo2db_partition_pool)))==NULL)
+		return NDO_ERROR;
+	if((pool->writer=(ndo2db_partition_writer *)calloc(writers,sizeof(ndo2db_partition_writer)))==NULL){
+		free(pool);
+		return NDO_ERROR;
+	        }
+
+	pool->shutdown=NDO_FALSE;
+	pool->sync_needed=NDO_TRUE;
+	pthread_mutex_init(&pool->lock,NULL);
+	pthread_cond_init(&pool->done,NULL);
+
+#ifdef USE_MYSQL
+	/* must happen before any thread calls mysql_init() */
+	mysql_library_init(0,NULL,NULL);
+#endif
+
+	for(x=0;x<writers;x++){
+		w=&pool->writer[x];
+		w->id=x;
+		w->pool=pool;
+		pthread_cond_init(&w->cond,NULL);
+
+		ndo2db_idi_init(&w->idi);
+		ndo2db_db_init(&w->idi);
+		w->idi.dbinfo.partition_writer=NDO_TRUE;
+		/* what the writers do is counted against the client */
+		w->idi.metrics=idi->metrics;
+
+		if(pthread_create(&w->thread,NULL,ndo2db_partition_thread,w)!=0){
+			syslog(LOG_ERR,"Error: Could not start partition writer thread %d\n",x);
+			break;
+		        }
+		pool->running++;
+	        }
+	pool->writers=pool->running;
+
+	idi->partitions=pool;
+
+	/* we couldn't start any, the parser will do everything itself */
+	if(pool->writers==0){
+		ndo2db_partition_stop(idi);
+		return NDO_ERROR;
+	        }
+
+	syslog(LOG_INFO,"Started %d partition writer threads\n",pool->writers);
+
+	return NDO_OK;
+        }
+
+
+/* hands the current event to a writer, returns NDO_FALSE if the caller must handle it */
+int ndo2db_partition_dispatch(ndo2db_idi *idi){
+	ndo2db_partition_pool *pool=NULL;
+	ndo2db_input_event *item=NULL;
+	ndo2db_partition_writer *w=NULL;
+	int route=0;
+
+	if(idi==NULL || (pool=idi->partitions)==NULL)
+		return NDO_FALSE;
+
+	route=ndo2db_partition_route(idi->current_input_data);
+
+	/* global events wait until everything before them has been written */
+	if(route==NDO2DB_PARTITION_BARRIER || idi->buffered_input==NULL){
+		ndo2db_partition_drain(idi);
+		pool->sync_needed=NDO_TRUE;
+		return NDO_FALSE;
+	        }
+
+	if((item=(ndo2db_input_event *)malloc(sizeof(ndo2db_input_event)))==NULL){
+		ndo2db_partition_drain(idi);
+		return NDO_FALSE;
+	        }
+
+	/* nothing is in flight after a barrier, so this is safe */
+	if(pool->sync_needed==NDO_TRUE)
+		ndo2db_partition_sync(idi);
+
+	w=&pool->writer[ndo2db_partition_select(pool,idi,route)];
+
+	/* take over the event's buffers */
+	ndo2db_save_input_data(idi,item);
+
+	pthread_mutex_lock(&pool->lock);
+	while(w->queued>=NDO2DB_PARTITION_QUEUE_ITEMS)
+		pthread_cond_wait(&pool->done,&pool->lock);
+	if(w->tail==NULL)
+		w->head=item;
+	else
+		w->tail->next=item;
+	w->tail=item;
+	w->queued++;
+	pool->pending++;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NDO_TRUE;
+        }
+
+
+/* waits until every dispatched event has been written */
+int ndo2db_partition_drain(ndo2db_idi *idi){
+	ndo2db_partition_pool *pool=NULL;
+
+	if(idi==NULL || (pool=idi->partitions)==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending>0)
+		pthread_cond_wait(&pool->done,&pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NDO_OK;
+        }
+
+
+/* lets the writers finish their queued work, then stops them */
+int ndo2db_partition_stop(ndo2db_idi *idi){
+	ndo2db_partition_pool *pool=NULL;
+	ndo2db_partition_writer *w=NULL;
+	int x=0;
+
+	if(idi==NULL || (pool=idi->partitions)==NULL)
+		return NDO_OK;
+
+	ndo2db_partition_drain(idi);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown=NDO_TRUE;
+	for(x=0;x<pool->running;x++)
+		pthread_cond_signal(&pool->writer[x].cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(x=0;x<pool->running;x++){
+		w=&pool->writer[x];
+		pthread_join(w->thread,NULL);
+
+		/* the object cache and table names belong to the parser */
+		w->idi.dbinfo.object_cache=NULL;
+		if(w->idi.dbinfo.last_logentry_data)
+			free(w->idi.dbinfo.last_logentry_data);
+		ndo2db_free_logentry_window(&w->idi);
+		ndo2db_free_input_memory(&w->idi);
+		ndo2db_db_free_batches(&w->idi);
+		ndo2db_db_free_transaction(&w->idi);
+		ndo2db_db_free_statements(w->idi.dbinfo.stmt);
+		w->idi.dbinfo.stmt=NULL;
+		pthread_cond_destroy(&w->cond);
+	        }
+
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->writer);
+	free(pool);
+
+	idi->partitions=NULL;
+
+	return NDO_OK;
+        }
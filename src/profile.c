@@ -0,0 +1,460 @@
+/**
+ * @file profile.c SQL statement profiler for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With sql_profile set, every query and prepared statement is timed and
+ * counted against the table it writes or reads and its kind.  Besides
+ * running totals, each table and kind keeps a latency histogram for the
+ * current and the last minute, which the percentiles in the report come
+ * from, so they follow what the database is doing now.  Statements that
+ * take longer than sql_profile_slow_time milliseconds are kept, with
+ * their text, in a ring of the last sql_profile_slow_count of them; at
+ * most NDO2DB_PROFILE_SLOW_PER_SECOND are captured each second, so a
+ * database that slows down across the board doesn't turn the profiler
+ * into the bottleneck.
+ *
+ * The report is logged to syslog when the daemon gets SIGUSR1, and is
+ * served on the metrics socket at /profile.  Like the metrics, the
+ * counters live in anonymous shared memory, so the report covers every
+ * connection in either server model.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/profile.h"
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define NDO2DB_PROFILE_ADD(counter,n)	__sync_fetch_and_add(&(counter),(n))
+
+extern int ndo2db_sql_profile;
+extern unsigned long ndo2db_sql_profile_slow_time;
+extern int ndo2db_sql_profile_slow_count;
+
+extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern char *ndo2db_db_rawtablenames[NDO2DB_MAX_DBTABLES];
+
+static ndo2db_profile *ndo2db_profile_shm=NULL;
+static unsigned long ndo2db_profile_bounds[NDO2DB_PROFILE_BUCKETS];
+
+static const char *ndo2db_profile_kinds[NDO2DB_PROFILE_KINDS]={
+	"select","insert","upsert","update","delete","other"
+	};
+
+static void *ndo2db_profile_signal_thread(void *);
+
+
+
+/****************************************************************************/
+/* SETUP                                                                    */
+/****************************************************************************/
+
+/* sets up the shared counters and the thread that logs the report on SIGUSR1 */
+int ndo2db_profile_init(void){
+	pthread_mutexattr_t mattr;
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t mask;
+	double bound=16.0;
+	int x=0;
+
+	if(ndo2db_sql_profile==NDO_FALSE || ndo2db_profile_shm!=NULL)
+		return NDO_OK;
+
+	/* two buckets per doubling */
+	for(x=0;x<NDO2DB_PROFILE_BUCKETS;x++){
+		ndo2db_profile_bounds[x]=(unsigned long)bound;
+		bound*=1.41421356;
+	        }
+
+	ndo2db_profile_shm=(ndo2db_profile *)mmap(NULL,sizeof(ndo2db_profile),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+	if(ndo2db_profile_shm==MAP_FAILED){
+		syslog(LOG_USER|LOG_INFO,"Error: Could not map %lu bytes for the SQL profile: %s\n",(unsigned long)sizeof(ndo2db_profile),strerror(errno));
+		ndo2db_profile_shm=NULL;
+		return NDO_ERROR;
+	        }
+
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr,PTHREAD_PROCESS_SHARED);
+#ifdef __GLIBC__
+	pthread_mutexattr_setrobust(&mattr,PTHREAD_MUTEX_ROBUST);
+#endif
+	pthread_mutex_init(&ndo2db_profile_shm->lock,&mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	ndo2db_profile_shm->start_time=time(NULL);
+
+	/* every thread started from here on leaves SIGUSR1 to the one waiting for it */
+	sigemptyset(&mask);
+	sigaddset(&mask,SIGUSR1);
+	pthread_sigmask(SIG_BLOCK,&mask,NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread,&attr,ndo2db_profile_signal_thread,NULL)!=0)
+		syslog(LOG_USER|LOG_INFO,"Error: Could not start the SQL profile thread, SIGUSR1 won't log the report\n");
+	pthread_attr_destroy(&attr);
+
+	syslog(LOG_USER|LOG_INFO,"Profiling SQL statements\n");
+
+	return NDO_OK;
+        }
+
+
+static void ndo2db_profile_lock(void){
+
+#ifdef __GLIBC__
+	if(pthread_mutex_lock(&ndo2db_profile_shm->lock)==EOWNERDEAD)
+		pthread_mutex_consistent(&ndo2db_profile_shm->lock);
+#else
+	pthread_mutex_lock(&ndo2db_profile_shm->lock);
+#endif
+        }
+
+
+
+/****************************************************************************/
+/* COUNTING                                                                 */
+/****************************************************************************/
+
+/* copies the name after a keyword, without quotes */
+static const char *ndo2db_profile_word(const char *ptr, char *buf, size_t size){
+	size_t x=0;
+
+	while(*ptr==' ' || *ptr=='\t' || *ptr=='\n')
+		ptr++;
+	for(;*ptr && x<size-1;ptr++){
+		if(*ptr=='`')
+			continue;
+		if(!isalnum((int)*ptr) && *ptr!='_' && *ptr!='$' && *ptr!='.')
+			break;
+		buf[x++]=*ptr;
+	        }
+	buf[x]='\x0';
+
+	return ptr;
+        }
+
+
+/* works out the table and kind of a statement, as a key into the counters */
+int ndo2db_profile_classify(const char *sql){
+	const char *ptr=NULL;
+	char table[128];
+	int kind=NDO2DB_PROFILE_OTHER;
+	int x=0;
+
+	if(sql==NULL)
+		return NDO2DB_PROFILE_NO_TABLE*NDO2DB_PROFILE_KINDS+NDO2DB_PROFILE_OTHER;
+
+	while(*sql==' ' || *sql=='\t' || *sql=='\n')
+		sql++;
+
+	table[0]='\x0';
+	if(!strncasecmp(sql,"INSERT",6) || !strncasecmp(sql,"REPLACE",7)){
+		kind=(strstr(sql," ON DUPLICATE KEY UPDATE ")!=NULL || !strncasecmp(sql,"REPLACE",7))?NDO2DB_PROFILE_UPSERT:NDO2DB_PROFILE_INSERT;
+		if((ptr=strstr(sql,"INTO "))!=NULL)
+			ndo2db_profile_word(ptr+5,table,sizeof(table));
+	        }
+	else if(!strncasecmp(sql,"UPDATE",6)){
+		kind=NDO2DB_PROFILE_UPDATE;
+		ndo2db_profile_word(sql+6,table,sizeof(table));
+	        }
+	else if(!strncasecmp(sql,"DELETE",6) || !strncasecmp(sql,"SELECT",6)){
+		kind=(toupper((int)sql[0])=='D')?NDO2DB_PROFILE_DELETE:NDO2DB_PROFILE_SELECT;
+		if((ptr=strstr(sql,"FROM "))!=NULL)
+			ndo2db_profile_word(ptr+5,table,sizeof(table));
+	        }
+
+	for(x=0;x<NDO2DB_MAX_DBTABLES;x++){
+		if(ndo2db_db_tablenames[x]!=NULL && !strcmp(table,ndo2db_db_tablenames[x]))
+			break;
+	        }
+
+	return x*NDO2DB_PROFILE_KINDS+kind;
+        }
+
+
+/* keeps the text of a slow statement */
+static void ndo2db_profile_capture(int key, const char *sql, unsigned long usec){
+	ndo2db_profile_slow *slow=NULL;
+	time_t now=time(NULL);
+	size_t len=0;
+
+	ndo2db_profile_lock();
+
+	if(ndo2db_profile_shm->slow_second!=now){
+		ndo2db_profile_shm->slow_second=now;
+		ndo2db_profile_shm->slow_in_second=0;
+	        }
+
+	if(ndo2db_profile_shm->slow_in_second<NDO2DB_PROFILE_SLOW_PER_SECOND){
+		ndo2db_profile_shm->slow_in_second++;
+
+		slow=&ndo2db_profile_shm->slow[ndo2db_profile_shm->slow_next%ndo2db_sql_profile_slow_count];
+		ndo2db_profile_shm->slow_next++;
+
+		slow->time=now;
+		slow->pid=getpid();
+		slow->usec=usec;
+		slow->key=key;
+		len=strlen(sql);
+		if(len<sizeof(slow->sql))
+			memcpy(slow->sql,sql,len+1);
+		else{
+			memcpy(slow->sql,sql,sizeof(slow->sql)-4);
+			strcpy(slow->sql+sizeof(slow->sql)-4,"...");
+		        }
+	        }
+
+	pthread_mutex_unlock(&ndo2db_profile_shm->lock);
+        }
+
+
+/* counts a statement that started at start, classifying it if key is negative */
+void ndo2db_profile_statement(int key, const char *sql, struct timeval *start){
+	ndo2db_profile_stat *stat=NULL;
+	ndo2db_profile_window *window=NULL;
+	struct timeval now;
+	unsigned long long max=0;
+	unsigned long usec=0L;
+	time_t number=0;
+	int x=0;
+
+	if(ndo2db_profile_shm==NULL)
+		return;
+
+	gettimeofday(&now,NULL);
+	if(now.tv_sec>start->tv_sec || (now.tv_sec==start->tv_sec && now.tv_usec>start->tv_usec))
+		usec=(unsigned long)((now.tv_sec-start->tv_sec)*1000000L+(now.tv_usec-start->tv_usec));
+
+	if(key<0 || key>=NDO2DB_PROFILE_KEYS)
+		key=ndo2db_profile_classify(sql);
+	stat=&ndo2db_profile_shm->stat[key];
+
+	NDO2DB_PROFILE_ADD(stat->count,1);
+	NDO2DB_PROFILE_ADD(stat->usec,(unsigned long long)usec);
+	while((max=stat->max_usec)<usec && !__sync_bool_compare_and_swap(&stat->max_usec,max,(unsigned long long)usec));
+
+	/* whoever gets here first in a new minute clears what it held two minutes ago */
+	number=now.tv_sec/NDO2DB_PROFILE_WINDOW;
+	window=&stat->window[number&1];
+	if(window->number!=number){
+		ndo2db_profile_lock();
+		if(window->number!=number){
+			memset(window->bucket,0,sizeof(window->bucket));
+			window->number=number;
+		        }
+		pthread_mutex_unlock(&ndo2db_profile_shm->lock);
+	        }
+
+	for(x=0;x<NDO2DB_PROFILE_BUCKETS;x++){
+		if(usec<=ndo2db_profile_bounds[x])
+			break;
+	        }
+	NDO2DB_PROFILE_ADD(window->bucket[x],1);
+
+	if(ndo2db_sql_profile_slow_time>0 && usec>=ndo2db_sql_profile_slow_time*1000L && sql!=NULL)
+		ndo2db_profile_capture(key,sql,usec);
+        }
+
+
+
+/****************************************************************************/
+/* REPORT                                                                   */
+/****************************************************************************/
+
+/* the latency below which the given fraction of the last two windows' statements finished, never above the slowest one */
+static double ndo2db_profile_percentile(ndo2db_profile_stat *stat, time_t number, unsigned long long count, double fraction){
+	unsigned long long seen=0;
+	unsigned long long want=0;
+	int x=0;
+	int y=0;
+
+	want=(unsigned long long)(fraction*(double)count+0.5);
+	if(want<1)
+		want=1;
+
+	for(x=0;x<=NDO2DB_PROFILE_BUCKETS;x++){
+		for(y=0;y<2;y++){
+			if(stat->window[y].number==number || stat->window[y].number==number-1)
+				seen+=stat->window[y].bucket[x];
+		        }
+		if(seen>=want && x<NDO2DB_PROFILE_BUCKETS && ndo2db_profile_bounds[x]<stat->max_usec)
+			return (double)ndo2db_profile_bounds[x]/1000.0;
+		if(seen>=want)
+			break;
+	        }
+
+	return (double)stat->max_usec/1000.0;
+        }
+
+
+static const char *ndo2db_profile_table_name(int key){
+	int table=key/NDO2DB_PROFILE_KINDS;
+
+	if(table<NDO2DB_MAX_DBTABLES && ndo2db_db_rawtablenames[table]!=NULL)
+		return ndo2db_db_rawtablenames[table];
+	return "-";
+        }
+
+
+static int ndo2db_profile_compare_time(const void *a, const void *b){
+	const ndo2db_profile_stat *sa=*(const ndo2db_profile_stat **)a;
+	const ndo2db_profile_stat *sb=*(const ndo2db_profile_stat **)b;
+
+	if(sa->usec==sb->usec)
+		return 0;
+	return (sa->usec<sb->usec)?1:-1;
+        }
+
+
+static int ndo2db_profile_compare_slow(const void *a, const void *b){
+	const ndo2db_profile_slow *sa=(const ndo2db_profile_slow *)a;
+	const ndo2db_profile_slow *sb=(const ndo2db_profile_slow *)b;
+
+	if(sa->usec==sb->usec)
+		return 0;
+	return (sa->usec<sb->usec)?1:-1;
+        }
+
+
+/* writes the report, busiest table and kind first */
+int ndo2db_profile_report(ndo_dbuf *dbuf){
+	ndo2db_profile *snapshot=NULL;
+	ndo2db_profile_stat *order[NDO2DB_PROFILE_KEYS];
+	ndo2db_profile_stat *stat=NULL;
+	unsigned long long total_usec=0;
+	unsigned long long windowed=0;
+	unsigned long slow_count=0L;
+	time_t now=time(NULL);
+	time_t number=now/NDO2DB_PROFILE_WINDOW;
+	char buf[NDO2DB_PROFILE_SQL_LENGTH+256];
+	char when[32];
+	int stats=0;
+	int key=0;
+	int x=0;
+	int y=0;
+
+	if(ndo2db_profile_shm==NULL){
+		ndo_dbuf_strcat(dbuf,"SQL profiling is off, set sql_profile=1 to turn it on.\n");
+		return NDO_OK;
+	        }
+
+	if((snapshot=(ndo2db_profile *)malloc(sizeof(ndo2db_profile)))==NULL)
+		return NDO_ERROR;
+
+	ndo2db_profile_lock();
+	memcpy(snapshot,ndo2db_profile_shm,sizeof(ndo2db_profile));
+	pthread_mutex_unlock(&ndo2db_profile_shm->lock);
+
+	for(key=0;key<NDO2DB_PROFILE_KEYS;key++){
+		if(snapshot->stat[key].count==0)
+			continue;
+		order[stats++]=&snapshot->stat[key];
+		total_usec+=snapshot->stat[key].usec;
+	        }
+	qsort(order,stats,sizeof(ndo2db_profile_stat *),ndo2db_profile_compare_time);
+
+	snprintf(buf,sizeof(buf),"SQL profile for the last %lu seconds, %.3f seconds in statements; percentiles over the last %d to %d seconds\n",(unsigned long)(now-snapshot->start_time),(double)total_usec/1000000.0,NDO2DB_PROFILE_WINDOW,2*NDO2DB_PROFILE_WINDOW);
+	ndo_dbuf_strcat(dbuf,buf);
+	snprintf(buf,sizeof(buf),"%-32s %-6s %10s %10s %6s %9s %9s %9s %9s %9s\n","table","kind","count","seconds","share","avg_ms","p50_ms","p90_ms","p99_ms","max_ms");
+	ndo_dbuf_strcat(dbuf,buf);
+
+	for(x=0;x<stats;x++){
+		stat=order[x];
+		key=(int)(stat-snapshot->stat);
+
+		windowed=0;
+		for(y=0;y<=NDO2DB_PROFILE_BUCKETS;y++){
+			if(stat->window[0].number==number || stat->window[0].number==number-1)
+				windowed+=stat->window[0].bucket[y];
+			if(stat->window[1].number==number || stat->window[1].number==number-1)
+				windowed+=stat->window[1].bucket[y];
+		        }
+
+		snprintf(buf,sizeof(buf),"%-32s %-6s %10llu %10.3f %5.1f%% %9.3f",ndo2db_profile_table_name(key),ndo2db_profile_kinds[key%NDO2DB_PROFILE_KINDS],stat->count,(double)stat->usec/1000000.0,(total_usec==0)?0.0:100.0*(double)stat->usec/(double)total_usec,(double)stat->usec/1000.0/(double)stat->count);
+		ndo_dbuf_strcat(dbuf,buf);
+		if(windowed>0)
+			snprintf(buf,sizeof(buf)," %9.3f %9.3f %9.3f %9.3f\n",ndo2db_profile_percentile(stat,number,windowed,0.50),ndo2db_profile_percentile(stat,number,windowed,0.90),ndo2db_profile_percentile(stat,number,windowed,0.99),(double)stat->max_usec/1000.0);
+		else
+			snprintf(buf,sizeof(buf)," %9s %9s %9s %9.3f\n","-","-","-",(double)stat->max_usec/1000.0);
+		ndo_dbuf_strcat(dbuf,buf);
+	        }
+
+	if(ndo2db_sql_profile_slow_time==0){
+		free(snapshot);
+		return NDO_OK;
+	        }
+
+	/* slowest first */
+	slow_count=(snapshot->slow_next<(unsigned long)ndo2db_sql_profile_slow_count)?snapshot->slow_next:(unsigned long)ndo2db_sql_profile_slow_count;
+	qsort(snapshot->slow,slow_count,sizeof(ndo2db_profile_slow),ndo2db_profile_compare_slow);
+
+	snprintf(buf,sizeof(buf),"\nSlow statements (%lu of %lu that took %lums or more)\n",slow_count,snapshot->slow_next,ndo2db_sql_profile_slow_time);
+	ndo_dbuf_strcat(dbuf,buf);
+	for(x=0;x<(int)slow_count;x++){
+		strftime(when,sizeof(when),"%Y-%m-%d %H:%M:%S",localtime(&snapshot->slow[x].time));
+		snprintf(buf,sizeof(buf),"%s %9.3f ms pid %lu %s %s: %s\n",when,(double)snapshot->slow[x].usec/1000.0,(unsigned long)snapshot->slow[x].pid,ndo2db_profile_table_name(snapshot->slow[x].key),ndo2db_profile_kinds[snapshot->slow[x].key%NDO2DB_PROFILE_KINDS],snapshot->slow[x].sql);
+		ndo_dbuf_strcat(dbuf,buf);
+	        }
+
+	free(snapshot);
+
+	return NDO_OK;
+        }
+
+
+/* logs the report, a line at a time, whenever the daemon gets SIGUSR1 */
+static void *ndo2db_profile_signal_thread(void *arg){
+	ndo_dbuf dbuf;
+	sigset_t mask;
+	char *line=NULL;
+	char *next=NULL;
+	int sig=0;
+
+	sigemptyset(&mask);
+	sigaddset(&mask,SIGUSR1);
+
+	while(1){
+
+		if(sigwait(&mask,&sig)!=0 || sig!=SIGUSR1)
+			continue;
+
+		ndo_dbuf_init(&dbuf,16384);
+		ndo2db_profile_report(&dbuf);
+		for(line=dbuf.buf;line!=NULL && *line;line=next){
+			if((next=strchr(line,'\n'))!=NULL)
+				*next++='\x0';
+			syslog(LOG_USER|LOG_INFO,"%s",line);
+		        }
+		ndo_dbuf_free(&dbuf);
+	        }
+
+	return NULL;
+        }
@@ -1,5 +1,5 @@
 /**
- * @file queue.c Simple message queue for ndo2db daemon
+ * @file queue.c Shared memory byte queue for ndo2db daemon
  */
 /*
  * Copyright 2012-2014 Nagios Core Development Team and Community Contributors
@@ -19,170 +19,268 @@
  * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/msg.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <syslog.h>
 #include "../include/config.h"
+#include "../include/common.h"
 #include "../include/queue.h"
+#include <sys/mman.h>
 #include <errno.h>
 #include <time.h>
 
-#define RETRY_LOG_INTERVAL	600		/* Seconds */
-#define MAX_RETRIES	20				/* Max number of times to retry sending message */
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define FULL_LOG_INTERVAL	600		/* Seconds */
+#define FULL_WAIT_INTERVAL	1		/* Seconds to wait before re-checking the reader */
+#define EMPTY_WAIT_INTERVAL	1000		/* Milliseconds to wait before re-checking the writer */
+
+static time_t last_full_log_time = (time_t)0;
+static ndo_queue *queue = NULL;
+static size_t queue_map_size = 0;
+
 
-static time_t last_retry_log_time = ( time_t)0;
-static int queue_id;
-static const int queue_buff_size = sizeof(struct queue_msg) - sizeof(long);
+int ndo_queue_init(size_t size) {
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
 
-void zero_string(char *str, int size) {
-	int i;
+	if (size == 0)
+		return NDO_ERROR;
 
-	for (i = 0; i < size; i++) {
-		str[i] = '\0';
+	queue_map_size = sizeof(ndo_queue) + size;
+	queue = (ndo_queue *)mmap(NULL, queue_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (queue == MAP_FAILED) {
+		syslog(LOG_ERR, "Error: queue init error: could not map %lu bytes: %s\n", (unsigned long)queue_map_size, strerror(errno));
+		queue = NULL;
+		return NDO_ERROR;
 	}
+
+	/* the lock and conditions are used by both the reader and the writer process */
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&queue->lock, &mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&queue->readable, &cattr);
+	pthread_cond_init(&queue->writable, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	queue->head = 0;
+	queue->tail = 0;
+	queue->size = size;
+	queue->closed = NDO_FALSE;
+	queue->reader_waiting = NDO_FALSE;
+	queue->writer_waiting = NDO_FALSE;
+	queue->reader_pid = 0;
+	queue->writer_pid = getpid();
+	queue->writer_waits = 0;
+
+	return NDO_OK;
 }
 
-void del_queue() {
-	struct msqid_ds buf;
+void ndo_queue_free(void) {
 
-	if (msgctl(queue_id,IPC_RMID,&buf) < 0) {
-		syslog(LOG_ERR,"Error: queue remove error.\n");
-	}
+	if (queue == NULL)
+		return;
+
+	munmap(queue, queue_map_size);
+	queue = NULL;
+	queue_map_size = 0;
 }
 
-int get_queue_id(int id) {
-	key_t key = ftok(NDO_QUEUE_PATH, NDO_QUEUE_ID+id);
+void ndo_queue_set_reader(pid_t pid) {
+
+	if (queue != NULL)
+		queue->reader_pid = pid;
+}
 
-	if ((queue_id = msgget(key, IPC_CREAT | 0600)) < 0) {
-		syslog(LOG_ERR,"Error: queue init error.\n");
+static void log_full(void) {
+	time_t now;
+
+	time(&now);
+
+	/* only complain every so often */
+	if ((now - last_full_log_time) > FULL_LOG_INTERVAL) {
+		syslog(LOG_ERR, "Warning: Queue is full (%lu bytes), waiting for the database writer to catch up. Consider increasing queue_size in the ndo2db config file.\n", (unsigned long)queue->size);
+		last_full_log_time = now;
 	}
 }
 
-long get_msgmni( void) {
-	FILE *	fp;
-	char	buf[ 1024];
-	char *	endptr;
-	long	msgmni;
+char *ndo_queue_reserve(size_t *len) {
+	struct timespec deadline;
+	size_t used, pos, avail;
 
-	if( !( fp = fopen( "/proc/sys/kernel/msgmni", "r"))) {
-		return -1;
-		}
-	else {
-		fgets( buf, sizeof( buf), fp);
-		msgmni = strtol((const char *)buf, &endptr, 10);
-		return msgmni;
+	if (queue == NULL || len == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&queue->lock);
+
+	/* wait for the writer to make room, but don't wait for a writer that has gone away */
+	while ((used = (size_t)(queue->head - queue->tail)) == queue->size) {
+
+		if (queue->reader_pid > 0 && kill(queue->reader_pid, 0) < 0 && errno == ESRCH) {
+			pthread_mutex_unlock(&queue->lock);
+			syslog(LOG_ERR, "Error: queue reader process has exited, dropping data.\n");
+			return NULL;
 		}
+
+		log_full();
+		queue->writer_waits++;
+
+		deadline.tv_sec = time(NULL) + FULL_WAIT_INTERVAL;
+		deadline.tv_nsec = 0;
+		queue->writer_waiting = NDO_TRUE;
+		pthread_cond_timedwait(&queue->writable, &queue->lock, &deadline);
+		queue->writer_waiting = NDO_FALSE;
+	}
+
+	/* hand out the contiguous free space after head */
+	pos = (size_t)(queue->head % queue->size);
+	avail = queue->size - used;
+	if (avail > queue->size - pos)
+		avail = queue->size - pos;
+	if (avail > NDO_QUEUE_MAX_CHUNK)
+		avail = NDO_QUEUE_MAX_CHUNK;
+
+	pthread_mutex_unlock(&queue->lock);
+
+	*len = avail;
+	return queue->data + pos;
 }
 
-void log_retry( void) {
-
-	time_t			now;
-	struct msqid_ds	queue_stats;
-	FILE *			fp;
-	long			msgmni;
-	char 			logmsg[ 1024];
-	char 			curstats[ 1024];
-	const char *	logfmt = "Warning: Retrying message send. This can occur because you have too few messages allowed or too few total bytes allowed in message queues. %s See README for kernel tuning options.\n";
-#if defined( __linux__)
-	const char *	statsfmt = "You are currently using %lu of %lu messages and %lu of %lu bytes in the queue.";
-#endif
+void ndo_queue_commit(size_t len) {
 
-	time( &now);
-
-	/* if we've never logged a retry message or we've exceeded the retry log interval */
-	if(( now - last_retry_log_time) > RETRY_LOG_INTERVAL) {
-		/* Get the message queue statistics */
-		if(msgctl(queue_id, IPC_STAT, &queue_stats)) {
-			sprintf(curstats, "Unable to determine current message queue usage: error reading IPC_STAT: %d", errno);
-			sprintf(logmsg, logfmt, curstats);
-			syslog(LOG_ERR, logmsg);
-			}
-		else {
-#if defined( __linux__)
-			/* Get the maximum number of messages allowed in a queue */
-			msgmni = get_msgmni();
-			if( msgmni < 0) {
-				sprintf(curstats, "Unable to determine current message queue usage: error reading IPC_INFO: %d", errno);
-				sprintf(logmsg, logfmt, curstats);
-				syslog(LOG_ERR, logmsg);
-				}
-			else {
-				sprintf(curstats, statsfmt, queue_stats.msg_qnum,
-						(unsigned long)msgmni, queue_stats.__msg_cbytes,
-						queue_stats.msg_qbytes);
-				sprintf(logmsg, logfmt, curstats);
-				syslog(LOG_ERR, logmsg);
-				}
-#else
-			sprintf(logmsg, logfmt, "");
-			syslog(LOG_ERR, logmsg);
-#endif
-			}
-		last_retry_log_time = now;
-		}
-	else {
-		syslog(LOG_ERR,"Warning: queue send error, retrying...\n");
-		}
+	if (queue == NULL || len == 0)
+		return;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->head += len;
+	if (queue->reader_waiting == NDO_TRUE)
+		pthread_cond_signal(&queue->readable);
+	pthread_mutex_unlock(&queue->lock);
 }
 
-void push_into_queue (char* buf) {
-	struct queue_msg msg;
-	int size;
-	msg.type = NDO_MSG_TYPE;
-	zero_string(msg.text, NDO_MAX_MSG_SIZE);
-	struct timespec delay;
-	unsigned retrynum = 0;
-
-	strncpy(msg.text, buf, NDO_MAX_MSG_SIZE-1);
-
-	if (msgsnd(queue_id, &msg, queue_buff_size, IPC_NOWAIT) < 0) {
-		if (EAGAIN == errno) {
-			log_retry();
-			/* added retry loop, data was being dropped if queue was full 5/22/2012 -MG */
-			while((EAGAIN == errno) && ( retrynum++ < MAX_RETRIES)) {
-					if(msgsnd(queue_id, &msg, queue_buff_size, IPC_NOWAIT)==0)
-							break;
-					#ifdef USE_NANOSLEEP
-						delay.tv_sec = 0;
-						delay.tv_nsec = 250000000;
-						nanosleep(&delay,NULL);
-					#else
-						sleep(1);
-					#endif
-				}
-				if (retrynum < MAX_RETRIES) {
-					syslog(LOG_ERR,"Message sent to queue.\n");
-					}
-				else {
-					syslog(LOG_ERR,"Error: max retries exceeded sending message to queue. Kernel queue parameters may need to be tuned. See README.\n");
-				}
-			}
-		else {
-			syslog(LOG_ERR,"Error: queue send error.\n");
-			}
-		}
+void ndo_queue_close(void) {
+
+	if (queue == NULL)
+		return;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->closed = NDO_TRUE;
+	pthread_cond_broadcast(&queue->readable);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/* has the producer died without closing the queue? */
+static int writer_gone(void) {
+
+	if (queue->writer_pid <= 0)
+		return NDO_FALSE;
+
+	/* the consumer is forked by the producer and is handed to init when it exits */
+	if (getppid() != queue->writer_pid)
+		return NDO_TRUE;
+	if (kill(queue->writer_pid, 0) < 0 && errno == ESRCH)
+		return NDO_TRUE;
 
+	return NDO_FALSE;
 }
 
-char* pop_from_queue() {
-	struct queue_msg msg;
-	char *buf;
+/* the time a number of milliseconds from now */
+static void deadline_after(struct timespec *deadline, int msec) {
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	deadline->tv_sec = now.tv_sec + msec / 1000;
+	deadline->tv_nsec = (now.tv_usec + (msec % 1000) * 1000L) * 1000L;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+char *ndo_queue_peek(size_t *len, int timeout) {
+	struct timespec deadline;
+	size_t used, pos, avail;
+	int waited = 0;
+	int wait;
+
+	if (queue == NULL || len == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&queue->lock);
+
+	/* wait for data, unless the producer is done and everything has been read */
+	while ((used = (size_t)(queue->head - queue->tail)) == 0) {
+		if (queue->closed == NDO_TRUE) {
+			pthread_mutex_unlock(&queue->lock);
+			*len = 0;
+			return NULL;
+		}
+
+		/* a producer that died can't close the queue any more */
+		if (writer_gone() == NDO_TRUE) {
+			queue->closed = NDO_TRUE;
+			pthread_mutex_unlock(&queue->lock);
+			syslog(LOG_ERR, "Error: queue writer process has exited without closing the queue.\n");
+			*len = 0;
+			return NULL;
+		}
 
-	zero_string(msg.text, NDO_MAX_MSG_SIZE);
+		/* give the caller a chance to do its timed work */
+		if (timeout >= 0 && waited >= timeout) {
+			pthread_mutex_unlock(&queue->lock);
+			*len = 0;
+			return queue->data;
+		}
 
-	if (msgrcv(queue_id, &msg, queue_buff_size, NDO_MSG_TYPE, MSG_NOERROR) < 0) {
-		syslog(LOG_ERR,"Error: queue recv error.\n");
+		wait = EMPTY_WAIT_INTERVAL;
+		if (timeout >= 0 && timeout - waited < wait)
+			wait = timeout - waited;
+		deadline_after(&deadline, wait);
+
+		queue->reader_waiting = NDO_TRUE;
+		if (pthread_cond_timedwait(&queue->readable, &queue->lock, &deadline) == ETIMEDOUT)
+			waited += wait;
+		queue->reader_waiting = NDO_FALSE;
 	}
 
-	int size = strlen(msg.text);
-	buf = (char*)calloc(size+1, sizeof(char));
-	strncpy(buf, msg.text, size);
-	buf[size] = '\0';
+	/* hand out the contiguous queued bytes after tail */
+	pos = (size_t)(queue->tail % queue->size);
+	avail = used;
+	if (avail > queue->size - pos)
+		avail = queue->size - pos;
+	if (avail > NDO_QUEUE_MAX_CHUNK)
+		avail = NDO_QUEUE_MAX_CHUNK;
+
+	pthread_mutex_unlock(&queue->lock);
+
+	*len = avail;
+	return queue->data + pos;
+}
+
+void ndo_queue_release(size_t len) {
 
-	return buf;
+	if (queue == NULL || len == 0)
+		return;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->tail += len;
+	if (queue->writer_waiting == NDO_TRUE)
+		pthread_cond_signal(&queue->writable);
+	pthread_mutex_unlock(&queue->lock);
 }
 
+size_t ndo_queue_used(void) {
+	size_t used;
+
+	if (queue == NULL)
+		return 0;
+
+	pthread_mutex_lock(&queue->lock);
+	used = (size_t)(queue->head - queue->tail);
+	pthread_mutex_unlock(&queue->lock);
+
+	return used;
+}
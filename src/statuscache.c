@@ -0,0 +1,267 @@
+/**
+ * @file statuscache.c Write-behind cache for ndo2db status updates
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Nagios sends a new status for a host or service after every check, but
+ * the status tables only ever hold the latest one.  With
+ * status_flush_interval set, program, host, service and contact status
+ * updates are held back for up to that many milliseconds, and an update
+ * replaces any older one for the same object that hasn't been written
+ * yet.  The cache sits in front of the partition writers, so a flushed
+ * update is written exactly as if it had just arrived.  Held updates are
+ * written once the oldest has waited the interval, checked after every
+ * event and, while the client is quiet, by the database writer's idle
+ * wakeups (every half interval in the event server).  Everything is
+ * flushed before process data, config dumps and the active object list
+ * are handled, and before a client's connection is closed.
+ *
+ * Held back updates aren't in the database yet, so up to one and a half
+ * intervals of status updates are lost if the daemon dies.  The status tables are
+ * snapshots that the next update repairs; history and check rows are
+ * never held back.
+ */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/dbhandlers.h"
+#include "../include/statuscache.h"
+#include "../include/metrics.h"
+
+extern int ndo2db_status_flush_interval;
+
+
+
+/****************************************************************************/
+/* CACHE KEYS                                                               */
+/****************************************************************************/
+
+/* finds the names of the object a status update is about */
+static int ndo2db_status_cache_key(int input_data, char **buffered_input, char **name1, char **name2){
+
+	*name1=NULL;
+	*name2=NULL;
+
+	switch(input_data){
+
+	case NDO2DB_INPUT_DATA_PROGRAMSTATUSDATA:
+		break;
+	case NDO2DB_INPUT_DATA_HOSTSTATUSDATA:
+		*name1=buffered_input[NDO_DATA_HOST];
+		break;
+	case NDO2DB_INPUT_DATA_SERVICESTATUSDATA:
+		*name1=buffered_input[NDO_DATA_HOST];
+		*name2=buffered_input[NDO_DATA_SERVICE];
+		break;
+	case NDO2DB_INPUT_DATA_CONTACTSTATUSDATA:
+		*name1=buffered_input[NDO_DATA_CONTACTNAME];
+		break;
+
+	default:
+		return NDO_ERROR;
+	        }
+
+	return NDO_OK;
+        }
+
+
+
+/****************************************************************************/
+/* CACHE FUNCTIONS                                                          */
+/****************************************************************************/
+
+/* holds back a status update, returns NDO_TRUE if the cache took it */
+int ndo2db_status_cache_add(ndo2db_idi *idi){
+	ndo2db_status_cache *cache=NULL;
+	ndo2db_status_entry *entry=NULL;
+	ndo2db_input_event *ev=NULL;
+	char *name1=NULL;
+	char *name2=NULL;
+	int hashslot=0;
+
+	if(idi==NULL || ndo2db_status_flush_interval<=0 || idi->buffered_input==NULL)
+		return NDO_FALSE;
+
+	switch(idi->current_input_data){
+
+	/* these may depend on or clear the status tables */
+	case NDO2DB_INPUT_DATA_PROCESSDATA:
+	case NDO2DB_INPUT_DATA_CONFIGDUMPSTART:
+	case NDO2DB_INPUT_DATA_CONFIGDUMPEND:
+	case NDO2DB_INPUT_DATA_ACTIVEOBJECTSLIST:
+		ndo2db_status_cache_flush(idi);
+		return NDO_FALSE;
+
+	default:
+		break;
+	        }
+
+	if(ndo2db_status_cache_key(idi->current_input_data,idi->buffered_input,&name1,&name2)==NDO_ERROR)
+		return NDO_FALSE;
+
+	/* the cache is only set up once there is something to hold */
+	if((cache=idi->status_cache)==NULL){
+		if((cache=(ndo2db_status_cache *)calloc(1,sizeof(ndo2db_status_cache)))==NULL)
+			return NDO_FALSE;
+		if((cache->hashlist=(ndo2db_status_entry **)calloc(NDO2DB_STATUS_CACHE_HASHSLOTS,sizeof(ndo2db_status_entry *)))==NULL){
+			free(cache);
+			return NDO_FALSE;
+		        }
+		idi->status_cache=cache;
+	        }
+
+	hashslot=ndo2db_object_hashfunc(name1,name2,NDO2DB_STATUS_CACHE_HASHSLOTS);
+
+	for(entry=cache->hashlist[hashslot];entry!=NULL;entry=entry->nexthash){
+		if(entry->event->input_data==idi->current_input_data && ndo2db_compare_object_hashdata(entry->name1,entry->name2,name1,name2)==0)
+			break;
+	        }
+
+	if((ev=(ndo2db_input_event *)malloc(sizeof(ndo2db_input_event)))==NULL)
+		return NDO_FALSE;
+	ndo2db_save_input_data(idi,ev);
+
+	/* the names have to point at the held copy, not the parser's */
+	ndo2db_status_cache_key(ev->input_data,ev->buffered_input,&name1,&name2);
+
+	/* a newer update replaces the one we're holding, but keeps its place in line */
+	if(entry!=NULL){
+		ndo2db_free_input_event(entry->event);
+		entry->event=ev;
+		entry->name1=name1;
+		entry->name2=name2;
+		cache->updates++;
+		ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_STATUS,NDO_TRUE);
+		return NDO_TRUE;
+	        }
+
+	if((entry=(ndo2db_status_entry *)malloc(sizeof(ndo2db_status_entry)))==NULL){
+		ndo2db_restore_input_data(idi,ev);
+		free(ev);
+		return NDO_FALSE;
+	        }
+
+	entry->event=ev;
+	entry->name1=name1;
+	entry->name2=name2;
+
+	entry->nexthash=cache->hashlist[hashslot];
+	cache->hashlist[hashslot]=entry;
+
+	entry->next=NULL;
+	if(cache->tail==NULL){
+		cache->head=entry;
+		gettimeofday(&cache->first_update_time,NULL);
+	        }
+	else
+		cache->tail->next=entry;
+	cache->tail=entry;
+
+	cache->dirty++;
+	cache->updates++;
+	ndo2db_metrics_cache(idi,NDO2DB_METRICS_CACHE_STATUS,NDO_FALSE);
+
+	return NDO_TRUE;
+        }
+
+
+/* writes every status update we're holding, in the order the objects first changed */
+int ndo2db_status_cache_flush(ndo2db_idi *idi){
+	ndo2db_status_cache *cache=NULL;
+	ndo2db_status_entry *entry=NULL;
+	ndo2db_input_event current;
+	int x=0;
+
+	if(idi==NULL || (cache=idi->status_cache)==NULL || cache->head==NULL)
+		return NDO_OK;
+
+	ndo2db_log_debug_info(NDO2DB_DEBUGL_PROCESSINFO,0,"Writing %d cached status updates (%lu received since the last flush)\n",cache->dirty,cache->updates);
+
+	/* step the event being parsed aside */
+	ndo2db_save_input_data(idi,&current);
+
+	/* the hash chains only point at entries we're about to free */
+	for(x=0;x<NDO2DB_STATUS_CACHE_HASHSLOTS;x++)
+		cache->hashlist[x]=NULL;
+
+	while((entry=cache->head)!=NULL){
+		cache->head=entry->next;
+
+		ndo2db_restore_input_data(idi,entry->event);
+		ndo2db_write_input_data(idi);
+		ndo2db_free_input_memory(idi);
+
+		free(entry->event);
+		free(entry);
+	        }
+
+	cache->tail=NULL;
+	cache->dirty=0;
+	cache->updates=0L;
+
+	ndo2db_restore_input_data(idi,&current);
+
+	return NDO_OK;
+        }
+
+
+/* writes the held back status updates once the oldest has waited long enough */
+int ndo2db_status_cache_flush_expired(ndo2db_idi *idi){
+	ndo2db_status_cache *cache=NULL;
+	struct timeval now;
+	long waited=0L;
+
+	if(idi==NULL || (cache=idi->status_cache)==NULL || cache->head==NULL)
+		return NDO_OK;
+
+	gettimeofday(&now,NULL);
+	waited=(now.tv_sec-cache->first_update_time.tv_sec)*1000L+(now.tv_usec-cache->first_update_time.tv_usec)/1000L;
+	if(waited<ndo2db_status_flush_interval)
+		return NDO_OK;
+
+	return ndo2db_status_cache_flush(idi);
+        }
+
+
+/* drops the cache, anything still in it is lost */
+int ndo2db_status_cache_free(ndo2db_idi *idi){
+	ndo2db_status_cache *cache=NULL;
+	ndo2db_status_entry *entry=NULL;
+
+	if(idi==NULL || (cache=idi->status_cache)==NULL)
+		return NDO_OK;
+
+	while((entry=cache->head)!=NULL){
+		cache->head=entry->next;
+		ndo2db_free_input_event(entry->event);
+		free(entry);
+	        }
+
+	free(cache->hashlist);
+	free(cache);
+	idi->status_cache=NULL;
+
+	return NDO_OK;
+        }
@@ -0,0 +1,341 @@
+/**
+ * @file trimmer.c Background table trimming for ndo2db
+ */
+/*
+ * Copyright 2009-2014 Nagios Core Development Team and Community Contributors
+ *
+ * This file is part of NDOUtils.
+ *
+ * NDOUtils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NDOUtils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NDOUtils. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every minute the rows of the history tables that are older than their
+ * max_*_age are deleted.  A single DELETE on a large table can run for
+ * seconds, and the events that arrive meanwhile wait for it.  With
+ * trim_chunk_rows set, a thread with its own database connection does the
+ * deleting instead, a chunk at a time: it looks up the highest id among the
+ * next trim_chunk_rows old rows, deletes the old rows up to that id, and
+ * pauses for trim_pause milliseconds before the next chunk.  A chunk that
+ * takes longer than trim_chunk_time halves the chunk size, one that takes
+ * less than half of it doubles it.
+ */
+
+#define _GNU_SOURCE		/* asprintf() */
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/io.h"
+#include "../include/utils.h"
+#include "../include/protoapi.h"
+#include "../include/ndo2db.h"
+#include "../include/db.h"
+#include "../include/trimmer.h"
+
+extern ndo2db_dbconfig ndo2db_db_settings;
+extern ndo2db_dbtrimtable ndo2db_db_trimtables[NDO2DB_MAX_TRIMTABLES];
+extern char *ndo2db_db_tablenames[NDO2DB_MAX_DBTABLES];
+extern char *ndo2db_db_rawtablenames[NDO2DB_MAX_DBTABLES];
+
+
+
+/* has the connection gone away? */
+static int ndo2db_trimmer_stopping(ndo2db_trimmer *t){
+	int result=NDO_FALSE;
+
+	pthread_mutex_lock(&t->lock);
+	result=t->shutdown;
+	pthread_mutex_unlock(&t->lock);
+
+	return result;
+        }
+
+
+/* waits between chunks, returns NDO_FALSE if the connection has gone away meanwhile */
+static int ndo2db_trimmer_pause(ndo2db_trimmer *t, unsigned long msec){
+	struct timeval now;
+	struct timespec until;
+	int result=NDO_TRUE;
+
+	gettimeofday(&now,NULL);
+	until.tv_sec=now.tv_sec+(msec/1000L);
+	until.tv_nsec=(now.tv_usec*1000L)+((msec%1000L)*1000000L);
+	if(until.tv_nsec>=1000000000L){
+		until.tv_sec++;
+		until.tv_nsec-=1000000000L;
+	        }
+
+	pthread_mutex_lock(&t->lock);
+	while(t->shutdown==NDO_FALSE && pthread_cond_timedwait(&t->cond,&t->lock,&until)!=ETIMEDOUT);
+	if(t->shutdown==NDO_TRUE)
+		result=NDO_FALSE;
+	pthread_mutex_unlock(&t->lock);
+
+	return result;
+        }
+
+
+/* deletes up to chunk_rows of a table's old rows, returns how many were found (-1 on errors) */
+static long ndo2db_trimmer_chunk(ndo2db_trimmer *t, ndo2db_dbtrimtable *trim, ndo2db_trim_state *state, char *ts){
+	ndo2db_idi *idi=&t->idi;
+	unsigned long last_id=0L;
+	unsigned long found=0L;
+	char *buf=NULL;
+	int result=NDO_OK;
+
+	/* the chunk ends at the highest id among the oldest rows */
+	if(asprintf(&buf,"SELECT MAX(%s), COUNT(*) FROM (SELECT %s FROM %s WHERE instance_id='%lu' AND %s<%s ORDER BY %s LIMIT %lu) AS chunk"
+		    ,trim->id_column
+		    ,trim->id_column
+		    ,ndo2db_db_tablenames[trim->table]
+		    ,idi->dbinfo.instance_id
+		    ,trim->time_column
+		    ,ts
+		    ,trim->id_column
+		    ,state->chunk_rows
+		   )==-1)
+		buf=NULL;
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK){
+		idi->dbinfo.mysql_result=mysql_store_result(idi->dbinfo.mysql_conn);
+		if(idi->dbinfo.mysql_result!=NULL && (idi->dbinfo.mysql_row=mysql_fetch_row(idi->dbinfo.mysql_result))!=NULL){
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[0],&last_id);
+			ndo2db_convert_string_to_unsignedlong(idi->dbinfo.mysql_row[1],&found);
+		        }
+		mysql_free_result(idi->dbinfo.mysql_result);
+		idi->dbinfo.mysql_result=NULL;
+	        }
+	free(buf);
+	state->statements++;
+
+	if(result==NDO_ERROR)
+		return -1L;
+	if(found==0L)
+		return 0L;
+
+	if(asprintf(&buf,"DELETE FROM %s WHERE %s<='%lu' AND instance_id='%lu' AND %s<%s"
+		    ,ndo2db_db_tablenames[trim->table]
+		    ,trim->id_column
+		    ,last_id
+		    ,idi->dbinfo.instance_id
+		    ,trim->time_column
+		    ,ts
+		   )==-1)
+		buf=NULL;
+	if((result=ndo2db_db_query(idi,buf))==NDO_OK)
+		state->rows+=(unsigned long)mysql_affected_rows(idi->dbinfo.mysql_conn);
+	free(buf);
+	state->statements++;
+
+	/* with commit_events the connection doesn't commit by itself, and the locks go with the commit */
+	if(ndo2db_db_transactions_enabled()==NDO_TRUE && idi->dbinfo.connected==NDO_TRUE)
+		mysql_commit(idi->dbinfo.mysql_conn);
+
+	return (result==NDO_OK)?(long)found:-1L;
+        }
+
+
+/* trims every table that has a maximum age */
+static void ndo2db_trimmer_pass(ndo2db_trimmer *t){
+	ndo2db_dbtrimtable *trim=NULL;
+	ndo2db_trim_state *state=NULL;
+	struct timeval start;
+	struct timeval end;
+	unsigned long requested=0L;
+	unsigned long msec=0L;
+	unsigned long age=0L;
+	time_t current_time;
+	char *ts=NULL;
+	long found=0L;
+	int x=0;
+
+	time(&current_time);
+
+	/* whole days of old rows go with their partitions, the rest is deleted in chunks */
+	if((current_time-(time_t)NDO2DB_PARTITION_INTERVAL)>t->idi.dbinfo.last_partition_time){
+		ndo2db_db_partition_tables(&t->idi,current_time);
+		t->idi.dbinfo.last_partition_time=current_time;
+	        }
+
+	for(x=0;x<NDO2DB_MAX_TRIMTABLES && ndo2db_trimmer_stopping(t)==NDO_FALSE;x++){
+		trim=&ndo2db_db_trimtables[x];
+		state=&t->state[x];
+		age=ndo2db_db_trim_age(&t->idi,trim->table);
+
+		if(age==0L)
+			continue;
+
+		ts=ndo2db_db_timet_to_sql(&t->idi,(time_t)((unsigned long)current_time-age));
+		state->rows=0L;
+		state->statements=0L;
+		state->msec=0L;
+
+		while(1){
+			requested=state->chunk_rows;
+
+			gettimeofday(&start,NULL);
+			found=ndo2db_trimmer_chunk(t,trim,state,ts);
+			gettimeofday(&end,NULL);
+
+			msec=(end.tv_sec-start.tv_sec)*1000L+(end.tv_usec-start.tv_usec)/1000L;
+			state->msec+=msec;
+
+			/* the last chunk is only as large as what was left */
+			if(found<(long)requested)
+				break;
+
+			/* aim for chunks that take about trim_chunk_time */
+			if(msec>ndo2db_db_settings.trim_chunk_time && state->chunk_rows/2>=NDO2DB_TRIM_MIN_CHUNK)
+				state->chunk_rows/=2;
+			else if(msec*2<ndo2db_db_settings.trim_chunk_time && state->chunk_rows*2<=ndo2db_db_settings.trim_chunk_rows*NDO2DB_TRIM_MAX_CHUNK_GROWTH)
+				state->chunk_rows*=2;
+
+			if(ndo2db_trimmer_pause(t,ndo2db_db_settings.trim_pause)==NDO_FALSE)
+				break;
+		        }
+
+		free(ts);
+
+		if(state->rows>0L || found<0L)
+			syslog(LOG_USER|LOG_INFO,"Trimmed %lu rows from %s in %lu ms (%lu statements, %lu rows per chunk)%s\n",state->rows,ndo2db_db_rawtablenames[trim->table],state->msec,state->statements,state->chunk_rows,(found<0L)?", stopped by an error":"");
+	        }
+
+	return;
+        }
+
+
+/* trimming thread main loop */
+static void *ndo2db_trimmer_thread(void *arg){
+	ndo2db_trimmer *t=(ndo2db_trimmer *)arg;
+
+#ifdef USE_MYSQL
+	mysql_thread_init();
+#endif
+
+	ndo2db_db_connect(&t->idi);
+
+	pthread_mutex_lock(&t->lock);
+	while(1){
+
+		/* wait until a trim is due */
+		while(t->requested==NDO_FALSE && t->shutdown==NDO_FALSE)
+			pthread_cond_wait(&t->cond,&t->lock);
+		if(t->shutdown==NDO_TRUE)
+			break;
+		t->requested=NDO_FALSE;
+		pthread_mutex_unlock(&t->lock);
+
+		ndo2db_trimmer_pass(t);
+
+		pthread_mutex_lock(&t->lock);
+	        }
+	pthread_mutex_unlock(&t->lock);
+
+	ndo2db_db_disconnect(&t->idi);
+
+#ifdef USE_MYSQL
+	mysql_thread_end();
+#endif
+
+	return NULL;
+        }
+
+
+/* starts the trimming thread for a client connection */
+static int ndo2db_trimmer_start(ndo2db_idi *idi){
+	ndo2db_trimmer *t=NULL;
+	int x=0;
+
+	if((t=(ndo2db_trimmer *)calloc(1,sizeof(ndo2db_trimmer)))==NULL)
+		return NDO_ERROR;
+
+	t->requested=NDO_FALSE;
+	t->shutdown=NDO_FALSE;
+	pthread_mutex_init(&t->lock,NULL);
+	pthread_cond_init(&t->cond,NULL);
+
+	/* it trims the instance the client writes */
+	ndo2db_idi_init(&t->idi);
+	ndo2db_db_init(&t->idi);
+	t->idi.dbinfo.partition_writer=NDO_TRUE;
+	t->idi.dbinfo.instance_id=idi->dbinfo.instance_id;
+
+	for(x=0;x<NDO2DB_MAX_TRIMTABLES;x++)
+		t->state[x].chunk_rows=ndo2db_db_settings.trim_chunk_rows;
+
+#ifdef USE_MYSQL
+	/* must happen before any thread calls mysql_init() */
+	mysql_library_init(0,NULL,NULL);
+#endif
+
+	if(pthread_create(&t->thread,NULL,ndo2db_trimmer_thread,t)!=0){
+		syslog(LOG_ERR,"Error: Could not start the table trimming thread\n");
+		pthread_cond_destroy(&t->cond);
+		pthread_mutex_destroy(&t->lock);
+		ndo2db_free_input_memory(&t->idi);
+		free(t);
+		return NDO_ERROR;
+	        }
+
+	idi->trimmer=t;
+
+	return NDO_OK;
+        }
+
+
+/* asks the trimming thread (started the first time) to trim the tables, NDO_ERROR if the caller must do it */
+int ndo2db_trimmer_wake(ndo2db_idi *idi){
+	ndo2db_trimmer *t=NULL;
+
+	if(idi==NULL || idi->dbinfo.instance_id==0L)
+		return NDO_ERROR;
+
+	if(idi->trimmer==NULL && ndo2db_trimmer_start(idi)==NDO_ERROR)
+		return NDO_ERROR;
+	t=idi->trimmer;
+
+	/* a pass that is still running is followed by another */
+	pthread_mutex_lock(&t->lock);
+	t->requested=NDO_TRUE;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+
+	return NDO_OK;
+        }
+
+
+/* stops the trimming thread once its current chunk is done */
+int ndo2db_trimmer_stop(ndo2db_idi *idi){
+	ndo2db_trimmer *t=NULL;
+
+	if(idi==NULL || (t=idi->trimmer)==NULL)
+		return NDO_OK;
+
+	pthread_mutex_lock(&t->lock);
+	t->shutdown=NDO_TRUE;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+
+	pthread_join(t->thread,NULL);
+
+	/* the table names belong to the client */
+	ndo2db_free_input_memory(&t->idi);
+	ndo2db_db_free_statements(t->idi.dbinfo.stmt);
+	t->idi.dbinfo.stmt=NULL;
+	pthread_cond_destroy(&t->cond);
+	pthread_mutex_destroy(&t->lock);
+	free(t);
+
+	idi->trimmer=NULL;
+
+	return NDO_OK;
+        }
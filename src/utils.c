@@ -95,8 +95,8 @@ int ndo_dbuf_strcat(ndo_dbuf *db, char *buf){
 		db->buf[db->used_size]='\x0';
 	        }
 
-	/* append the new string */
-	strcat(db->buf,buf);
+	/* append the new string where the last one ended, rather than searching for the end */
+	memcpy(db->buf+db->used_size,buf,buflen+1);
 
 	/* update size allocated */
 	db->used_size+=buflen;
@@ -106,6 +106,228 @@ int ndo_dbuf_strcat(ndo_dbuf *db, char *buf){
 
 
 
+/****************************************************************************/
+/* LINE BUFFER FUNCTIONS                                                    */
+/****************************************************************************/
+
+/* initializes a line buffer */
+int ndo_lbuf_init(ndo_lbuf *lb, unsigned long initial_size){
+
+	if(lb==NULL)
+		return NDO_ERROR;
+
+	lb->start=0L;
+	lb->scanned=0L;
+	lb->used_size=0L;
+	lb->allocated_size=0L;
+	if((lb->buf=(char *)malloc((size_t)initial_size))!=NULL)
+		lb->allocated_size=initial_size;
+
+	return (lb->buf==NULL)?NDO_ERROR:NDO_OK;
+        }
+
+
+/* frees a line buffer */
+int ndo_lbuf_free(ndo_lbuf *lb){
+
+	if(lb==NULL)
+		return NDO_ERROR;
+
+	my_free(lb->buf);
+	lb->start=0L;
+	lb->scanned=0L;
+	lb->used_size=0L;
+	lb->allocated_size=0L;
+
+	return NDO_OK;
+        }
+
+
+/* returns room for at least len more bytes at the end of the buffer */
+char *ndo_lbuf_reserve(ndo_lbuf *lb, unsigned long len){
+	char *newbuf=NULL;
+	unsigned long partial=0L;
+	unsigned long new_size=0L;
+
+	if(lb==NULL)
+		return NULL;
+
+	if(lb->allocated_size-lb->used_size>=len)
+		return lb->buf+lb->used_size;
+
+	/* move the partial line (never the whole buffer) back to the front */
+	if(lb->start>0L){
+		partial=lb->used_size-lb->start;
+		memmove(lb->buf,lb->buf+lb->start,(size_t)partial);
+		lb->scanned-=lb->start;
+		lb->used_size=partial;
+		lb->start=0L;
+		if(lb->allocated_size-lb->used_size>=len)
+			return lb->buf+lb->used_size;
+	        }
+
+	/* a long line - grow the buffer, there is no line length limit */
+	new_size=(lb->allocated_size>0L)?lb->allocated_size:1024L;
+	while(new_size-lb->used_size<len)
+		new_size*=2;
+	if((newbuf=(char *)realloc((void *)lb->buf,(size_t)new_size))==NULL)
+		return NULL;
+	lb->buf=newbuf;
+	lb->allocated_size=new_size;
+
+	return lb->buf+lb->used_size;
+        }
+
+
+/* adds len bytes written into reserved space */
+void ndo_lbuf_commit(ndo_lbuf *lb, unsigned long len){
+
+	if(lb!=NULL)
+		lb->used_size+=len;
+        }
+
+
+/* returns the next complete line (terminated in place) or NULL if there is none yet */
+char *ndo_lbuf_next_line(ndo_lbuf *lb, unsigned long *len){
+	char *line=NULL;
+	char *nl=NULL;
+
+	if(lb==NULL || lb->used_size==lb->scanned)
+		return NULL;
+
+	/* only look at bytes we haven't searched before */
+	if((nl=(char *)memchr(lb->buf+lb->scanned,'\n',(size_t)(lb->used_size-lb->scanned)))==NULL){
+		lb->scanned=lb->used_size;
+		return NULL;
+	        }
+
+	*nl='\x0';
+	line=lb->buf+lb->start;
+	if(len!=NULL)
+		*len=(unsigned long)(nl-line);
+
+	lb->start=(unsigned long)(nl-lb->buf)+1;
+	lb->scanned=lb->start;
+
+	/* nothing left over, start from the front again */
+	if(lb->start==lb->used_size){
+		lb->start=0L;
+		lb->scanned=0L;
+		lb->used_size=0L;
+	        }
+
+	return line;
+        }
+
+
+
+/****************************************************************************/
+/* ARENA FUNCTIONS                                                          */
+/****************************************************************************/
+
+/* initializes an arena, blocks are allocated on first use */
+int ndo_arena_init(ndo_arena *ar, unsigned long block_size){
+
+	if(ar==NULL)
+		return NDO_ERROR;
+
+	ar->head=NULL;
+	ar->current=NULL;
+	ar->block_size=(block_size>0L)?block_size:4096L;
+
+	return NDO_OK;
+        }
+
+
+/* frees an arena and everything allocated from it */
+int ndo_arena_free(ndo_arena *ar){
+	ndo_arena_block *blk=NULL;
+	ndo_arena_block *next_blk=NULL;
+
+	if(ar==NULL)
+		return NDO_ERROR;
+
+	for(blk=ar->head;blk!=NULL;blk=next_blk){
+		next_blk=blk->next;
+		free(blk);
+	        }
+	ar->head=NULL;
+	ar->current=NULL;
+
+	return NDO_OK;
+        }
+
+
+/* returns len bytes that stay valid until the arena is reset */
+void *ndo_arena_alloc(ndo_arena *ar, unsigned long len){
+	ndo_arena_block *blk=NULL;
+	ndo_arena_block *last=NULL;
+	unsigned long size=0L;
+	void *ptr=NULL;
+
+	if(ar==NULL)
+		return NULL;
+
+	/* keep everything pointer-aligned */
+	len=(len+7L)&~7L;
+
+	/* use the current block, or one left over from a bigger event before a reset */
+	for(blk=ar->current;blk!=NULL;blk=blk->next){
+		if(blk->size-blk->used>=len)
+			break;
+		last=blk;
+	        }
+
+	/* no room anywhere - add a block, big enough for long values */
+	/* (rounded up, so a slightly longer value next time still fits) */
+	if(blk==NULL){
+		size=(len+ar->block_size-1L)/ar->block_size*ar->block_size;
+		if((blk=(ndo_arena_block *)malloc(sizeof(ndo_arena_block)+(size_t)size))==NULL)
+			return NULL;
+		blk->next=NULL;
+		blk->size=size;
+		blk->used=0L;
+		blk->data=(char *)(blk+1);
+		if(last!=NULL)
+			last->next=blk;
+		else
+			ar->head=blk;
+	        }
+
+	ptr=blk->data+blk->used;
+	blk->used+=len;
+	ar->current=blk;
+
+	return ptr;
+        }
+
+
+/* copies a string into the arena */
+char *ndo_arena_strdup(ndo_arena *ar, const char *str){
+	char *newstr=NULL;
+	size_t len=0;
+
+	len=strlen(str)+1;
+	if((newstr=(char *)ndo_arena_alloc(ar,(unsigned long)len))!=NULL)
+		memcpy(newstr,str,len);
+
+	return newstr;
+        }
+
+
+/* gives back everything allocated from the arena, but keeps its blocks for next time */
+void ndo_arena_reset(ndo_arena *ar){
+	ndo_arena_block *blk=NULL;
+
+	if(ar==NULL)
+		return;
+
+	for(blk=ar->head;blk!=NULL;blk=blk->next)
+		blk->used=0L;
+	ar->current=ar->head;
+        }
+
+
 /******************************************************************/
 /************************* FILE FUNCTIONS *************************/
 /******************************************************************/